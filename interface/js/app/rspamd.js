@@ -176,11 +176,14 @@ function ($, visibility, NProgress, stickyTabs, tab_stat, tab_graph, tab_config,
             case "#throughput_nav":
                 (function () {
                     var step = {
+                        hour: 1000,
                         day: 60000,
                         week: 300000
                     };
                     var refreshInterval = step[selData] || 3600000;
-                    $("#dynamic-item").text((refreshInterval / 60000) + " min");
+                    $("#dynamic-item").text((refreshInterval < 60000)
+                        ? (refreshInterval / 1000) + " sec"
+                        : (refreshInterval / 60000) + " min");
 
                     if (!$(".dropdown-menu a.active.dynamic").data("value")) {
                         refreshInterval = null;
@@ -24,6 +24,7 @@ local rspamd_logger = require "rspamd_logger"
 local rspamd_http = require "rspamd_http"
 local lua_util = require "lua_util"
 local rspamd_text = require "rspamd_text"
+local rspamd_util = require "rspamd_util"
 
 local exports = {}
 local N = 'clickhouse'
@@ -34,62 +35,10 @@ local function escape_spaces(query)
   return query:gsub('%s', '%%20')
 end
 
-local function ch_number(a)
-  if (a+2^52)-2^52 == a then
-    -- Integer
-    return tostring(math.floor(a))
-  end
-
-  return tostring(a)
-end
-
-local function clickhouse_quote(str)
-  if str then
-    return str:gsub('[\'\\\n\t\r]', {
-      ['\''] = [[\']],
-      ['\\'] = [[\\]],
-      ['\n'] = [[\n]],
-      ['\t'] = [[\t]],
-      ['\r'] = [[\r]],
-    })
-  end
-
-  return ''
-end
-
--- Converts an array to a string suitable for clickhouse
-local function array_to_string(ar)
-  for i,elt in ipairs(ar) do
-    local t = type(elt)
-    if t == 'string' then
-      ar[i] = string.format('\'%s\'', clickhouse_quote(elt))
-    elseif t == 'userdata' then
-      ar[i] = string.format('\'%s\'', clickhouse_quote(tostring(elt)))
-    elseif t == 'number' then
-      ar[i] = ch_number(elt)
-    end
-  end
-
-  return table.concat(ar, ',')
-end
-
 -- Converts a row into TSV, taking extra care about arrays
+-- Escaping and numbers formatting are done natively, see `util.clickhouse_row`
 local function row_to_tsv(row)
-
-  for i,elt in ipairs(row) do
-    local t = type(elt)
-    if t == 'table' then
-      row[i] = '[' .. array_to_string(elt) .. ']'
-    elseif t == 'number' then
-      row[i] = ch_number(elt)
-    elseif t == 'userdata' then
-      row[i] = clickhouse_quote(tostring(elt))
-    else
-      row[i] = clickhouse_quote(elt)
-    end
-  end
-
-  return rspamd_text.fromtable(row, '\t')
+  return rspamd_util.clickhouse_row(row)
 end
 
 exports.row_to_tsv = row_to_tsv
@@ -23,6 +23,7 @@ local rspamd_trie = require "rspamd_trie"
 local rspamd_util = require "rspamd_util"
 local rspamd_text = require "rspamd_text"
 local rspamd_url = require "rspamd_url"
+local rspamd_parsers = require "rspamd_parsers"
 local bit = require "bit"
 local N = "lua_content"
 local lua_util = require "lua_util"
@@ -126,8 +127,7 @@ local config = {
 ---- [{n1, pat_idx1}, ... {nn, pat_idxn}] where
 ---- pat_idxn is pattern index and n1 ... nn are match positions
 local processors = {}
--- PDF objects outer grammar in LPEG style (performing table captures)
-local pdf_outer_grammar
+-- PDF text grammar in LPEG style (performing table captures)
 local pdf_text_grammar
 
 -- Used to match objects
@@ -250,24 +250,6 @@ local function generic_grammar_elts()
 end
 
 
--- Generates a grammar to parse outer elements (external objects in PDF notation)
-local function gen_outer_grammar()
-  local V = lpeg.V
-  local gen = generic_grammar_elts()
-
-  return lpeg.P{
-    "EXPR";
-    EXPR = gen.ws^0 * V("ELT")^0 * gen.ws^0,
-    ELT = V("ARRAY") + V("DICT") + V("ATOM"),
-    ATOM = gen.ws^0 * (gen.comment + gen.boolean + gen.ref +
-        gen.number + V("STRING") + gen.id) * gen.ws^0,
-    DICT = "<<" * gen.ws^0  * lpeg.Cf(lpeg.Ct("") * V("KV_PAIR")^0, rawset) * gen.ws^0 * ">>",
-    KV_PAIR = lpeg.Cg(gen.id * gen.ws^0 * V("ELT") * gen.ws^0),
-    ARRAY = "[" * gen.ws^0 * lpeg.Ct(V("ELT")^0) * gen.ws^0 * "]",
-    STRING = lpeg.P{gen.str + gen.hexstr},
-  }
-end
-
 -- Graphic state in PDF
 local function gen_graphics_unary()
   local P = lpeg.P
@@ -347,7 +329,6 @@ end
 -- Call immediately on require
 compile_tries()
 config_module()
-pdf_outer_grammar = gen_outer_grammar()
 pdf_text_grammar = gen_text_grammar()
 
 local function extract_text_data(specific)
@@ -453,37 +434,32 @@ local function parse_object_grammar(obj, task, pdf)
   end
 
   if obj_dict_span:len() < config.max_processing_size then
-    local ret,obj_or_err = pcall(pdf_outer_grammar.match, pdf_outer_grammar, obj_dict_span)
+    local obj_or_err = rspamd_parsers.parse_pdf_object(obj_dict_span)
 
-    if ret then
-      if obj.stream then
-        if type(obj_or_err) == 'table' then
-          obj.dict = obj_or_err
-        else
-          obj.dict = {}
-        end
+    if obj.stream then
+      if type(obj_or_err) == 'table' then
+        obj.dict = obj_or_err
+      else
+        obj.dict = {}
+      end
 
-        lua_util.debugm(N, task, 'stream object %s:%s is parsed to: %s',
+      lua_util.debugm(N, task, 'stream object %s:%s is parsed to: %s',
+          obj.major, obj.minor, obj_or_err)
+    else
+      -- Direct object
+      if type(obj_or_err) == 'table' then
+        obj.dict = obj_or_err
+        obj.uncompressed = obj_or_err
+        lua_util.debugm(N, task, 'direct object %s:%s is parsed to: %s',
             obj.major, obj.minor, obj_or_err)
+        pdf.ref[obj_ref(obj.major, obj.minor)] = obj
       else
-        -- Direct object
-        if type(obj_or_err) == 'table' then
-          obj.dict = obj_or_err
-          obj.uncompressed = obj_or_err
-          lua_util.debugm(N, task, 'direct object %s:%s is parsed to: %s',
-              obj.major, obj.minor, obj_or_err)
-          pdf.ref[obj_ref(obj.major, obj.minor)] = obj
-        else
-          lua_util.debugm(N, task, 'direct object %s:%s is parsed to raw data: %s',
-              obj.major, obj.minor, obj_or_err)
-          pdf.ref[obj_ref(obj.major, obj.minor)] = obj_or_err
-          obj.dict = {}
-          obj.uncompressed = obj_or_err
-        end
+        lua_util.debugm(N, task, 'direct object %s:%s is parsed to raw data: %s',
+            obj.major, obj.minor, obj_or_err)
+        pdf.ref[obj_ref(obj.major, obj.minor)] = obj_or_err
+        obj.dict = {}
+        obj.uncompressed = obj_or_err
       end
-    else
-      lua_util.debugm(N, task, 'object %s:%s cannot be parsed: %s',
-          obj.major, obj.minor, obj_or_err)
     end
   else
     lua_util.debugm(N, task, 'object %s:%s cannot be parsed: too large %s',
@@ -0,0 +1,182 @@
+--[[
+Copyright (c) 2022, Vsevolod Stakhov <vsevolod@rspamd.com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+]]--
+
+--[[[
+-- @module lua_ffi/task
+-- This module contains ffi interfaces to the hot read only task accessors.
+-- Functions here take a task (or its raw pointer returned by `task_ptr`) as
+-- the first argument and mimic the corresponding task methods (in their
+-- simplest forms)
+--]]
+
+local ffi = require 'ffi'
+
+ffi.cdef[[
+int rspamd_task_ffi_has_symbol (void *task, const char *sym);
+double rspamd_task_ffi_get_symbol_score (void *task, const char *sym, int *found);
+unsigned rspamd_task_ffi_header_count (void *task, const char *name);
+const char *rspamd_task_ffi_get_header (void *task, const char *name,
+    unsigned idx, int raw, size_t *len);
+const char *rspamd_task_ffi_get_from (void *task, int mime, size_t *len);
+unsigned rspamd_task_ffi_text_parts_count (void *task);
+const char *rspamd_task_ffi_get_text_part_content (void *task, unsigned idx,
+    size_t *len);
+unsigned rspamd_task_ffi_urls_count (void *task);
+]]
+
+local C = ffi.C
+local NULL = ffi.new 'void*'
+-- Reused output arguments, so calls do not allocate
+local len_out = ffi.new 'size_t[1]'
+local found_out = ffi.new 'int[1]'
+
+-- Raw pointers of tasks: `task:topointer()` is a classic C API call that
+-- aborts a trace, so it is called once per task
+local task_ptrs = setmetatable({}, {__mode = 'k'})
+
+local exports = {}
+
+--[[[
+-- @function lua_ffi.task.task_ptr(task)
+-- Returns raw pointer of a task that can be passed to the other functions
+-- instead of the task itself. It must not be used after the task is destroyed.
+--]]
+local function task_ptr(task)
+  if type(task) == 'cdata' then
+    return task
+  end
+
+  local ptr = task_ptrs[task]
+
+  if not ptr then
+    ptr = ffi.cast('void *', task:topointer())
+    task_ptrs[task] = ptr
+  end
+
+  return ptr
+end
+
+exports.task_ptr = task_ptr
+
+--[[[
+-- @function lua_ffi.task.has_symbol(task, sym)
+-- Same as `task:has_symbol(sym)` for the default metric
+--]]
+exports.has_symbol = function(task, sym)
+  return C.rspamd_task_ffi_has_symbol(task_ptr(task), sym) ~= 0
+end
+
+--[[[
+-- @function lua_ffi.task.get_symbol_score(task, sym)
+-- Returns score of the symbol inserted or nil
+--]]
+exports.get_symbol_score = function(task, sym)
+  local score = C.rspamd_task_ffi_get_symbol_score(task_ptr(task), sym,
+      found_out)
+
+  if found_out[0] ~= 0 then
+    return score
+  end
+
+  return nil
+end
+
+--[[[
+-- @function lua_ffi.task.get_header_count(task, name)
+-- Returns number of headers with the specified name
+--]]
+exports.get_header_count = function(task, name)
+  return tonumber(C.rspamd_task_ffi_header_count(task_ptr(task), name))
+end
+
+--[[[
+-- @function lua_ffi.task.get_header(task, name[, idx])
+-- Same as `task:get_header(name)`, returns the decoded value of `idx`
+-- header (first by default) or nil
+--]]
+exports.get_header = function(task, name, idx)
+  local s = C.rspamd_task_ffi_get_header(task_ptr(task), name,
+      (idx or 1) - 1, 0, len_out)
+
+  if s ~= NULL then
+    return ffi.string(s, len_out[0])
+  end
+
+  return nil
+end
+
+--[[[
+-- @function lua_ffi.task.get_header_raw(task, name[, idx])
+-- Same as `task:get_header_raw(name)`
+--]]
+exports.get_header_raw = function(task, name, idx)
+  local s = C.rspamd_task_ffi_get_header(task_ptr(task), name,
+      (idx or 1) - 1, 1, len_out)
+
+  if s ~= NULL then
+    return ffi.string(s, len_out[0])
+  end
+
+  return nil
+end
+
+--[[[
+-- @function lua_ffi.task.get_from_addr(task, type)
+-- Returns the first address from either `mime` or `smtp` from (default: smtp)
+--]]
+exports.get_from_addr = function(task, type)
+  local s = C.rspamd_task_ffi_get_from(task_ptr(task),
+      type == 'mime' and 1 or 0, len_out)
+
+  if s ~= NULL then
+    return ffi.string(s, len_out[0])
+  end
+
+  return nil
+end
+
+--[[[
+-- @function lua_ffi.task.get_text_parts_count(task)
+-- Returns number of text parts
+--]]
+exports.get_text_parts_count = function(task)
+  return tonumber(C.rspamd_task_ffi_text_parts_count(task_ptr(task)))
+end
+
+--[[[
+-- @function lua_ffi.task.get_text_part_content(task, idx)
+-- Returns utf8 content of the text part number `idx` (starting from 1)
+--]]
+exports.get_text_part_content = function(task, idx)
+  local s = C.rspamd_task_ffi_get_text_part_content(task_ptr(task),
+      idx - 1, len_out)
+
+  if s ~= NULL then
+    return ffi.string(s, len_out[0])
+  end
+
+  return nil
+end
+
+--[[[
+-- @function lua_ffi.task.get_urls_count(task)
+-- Returns number of unique urls in a message
+--]]
+exports.get_urls_count = function(task)
+  return tonumber(C.rspamd_task_ffi_urls_count(task_ptr(task)))
+end
+
+return exports
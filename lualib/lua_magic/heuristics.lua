@@ -320,63 +320,21 @@ local function detect_archive_flaw(part, arch, log_obj, _)
   return arch_type:lower(),40
 end
 
-local csv_grammar
--- Returns a grammar that will count commas
-local function get_csv_grammar()
-  if not csv_grammar then
-    local lpeg = require'lpeg'
-
-    local field = '"' * lpeg.Cs(((lpeg.P(1) - '"') + lpeg.P'""' / '"')^0) * '"' +
-        lpeg.C((1 - lpeg.S',\n"')^0)
-
-    csv_grammar = lpeg.Cf(lpeg.Cc(0) * field * lpeg.P( (lpeg.P(',') +
-        lpeg.P('\t')) * field)^1 * (lpeg.S'\r\n' + -1),
-        function(acc) return acc + 1 end)
-  end
-
-  return csv_grammar
-end
 local function validate_csv(part, content, log_obj)
   local max_chunk = 32768
-  local chunk = content:sub(1, max_chunk)
-
-  local expected_commas
-  local matched_lines = 0
-  local max_matched_lines = 10
+  -- Number of the first lines that must be consistent records
+  local max_lines = 11
 
   lua_util.debugm(N, log_obj, "check for csv pattern")
 
-  for s in chunk:lines() do
-    local ncommas = get_csv_grammar():match(s)
+  local nfields = content:sub(1, max_chunk):count_csv_fields(max_lines)
 
-    if not ncommas then
-      lua_util.debugm(N, log_obj, "not a csv line at line number %s",
-          matched_lines)
-      return false
-    end
-
-    if expected_commas and ncommas ~= expected_commas then
-      -- Mismatched commas
-      lua_util.debugm(N, log_obj, "missmatched commas on line %s: %s != %s",
-          matched_lines, ncommas, expected_commas)
-      return false
-    elseif not expected_commas then
-      if ncommas == 0 then
-        lua_util.debugm(N, log_obj, "no commas in the first line")
-        return false
-      end
-      expected_commas = ncommas
-    end
-
-    matched_lines = matched_lines + 1
-
-    if matched_lines > max_matched_lines then
-      break
-    end
+  if not nfields then
+    lua_util.debugm(N, log_obj, "not a csv content or mismatched fields")
+    return false
   end
 
-  lua_util.debugm(N, log_obj, "csv content is sane: %s fields; %s lines checked",
-      expected_commas, matched_lines)
+  lua_util.debugm(N, log_obj, "csv content is sane: %s fields", nfields)
 
   return true
 end
@@ -390,75 +348,23 @@ exports.mime_part_heuristic = function(part, log_obj, _)
   return nil
 end
 
-exports.text_part_heuristic = function(part, log_obj, _)
-  -- We get some span of data and check it
-  local function is_span_text(span)
-    -- We examine 8 bit content, and we assume it might be localized text
-    -- if it has more than 3 subsequent 8 bit characters
-    local function rough_8bit_check(bytes, idx, remain, len)
-      local b = bytes[idx]
-      local n8bit = 0
-
-      while b >= 127 and idx < len do
-        -- utf8 part
-        if bit.band(b, 0xe0) == 0xc0 and remain > 1 and
-                bit.band(bytes[idx + 1], 0xc0) == 0x80 then
-          return true,1
-        elseif bit.band(b, 0xf0) == 0xe0 and remain > 2 and
-                bit.band(bytes[idx + 1], 0xc0) == 0x80 and
-                bit.band(bytes[idx + 2], 0xc0) == 0x80 then
-          return true,2
-        elseif bit.band(b, 0xf8) == 0xf0 and remain > 3 and
-                bit.band(bytes[idx + 1], 0xc0) == 0x80 and
-                bit.band(bytes[idx + 2], 0xc0) == 0x80 and
-                bit.band(bytes[idx + 3], 0xc0) == 0x80 then
-          return true,3
-        end
-
-        n8bit = n8bit + 1
-        idx = idx + 1
-        b = bytes[idx]
-        remain = remain - 1
-      end
-
-      if n8bit >= 3 then
-        return true,n8bit
-      end
-
-      return false,0
-    end
-
-    -- Convert to string as LuaJIT can optimise string.sub (and fun.iter) but not C calls
-    local tlen = #span
-    local non_printable = 0
-    local bytes = span:bytes()
-    local i = 1
-    repeat
-      local b = bytes[i]
-
-      if (b < 0x20) and not (b == 0x0d or b == 0x0a or b == 0x09) then
-        non_printable = non_printable + 1
-      elseif b >= 127 then
-        local c,nskip = rough_8bit_check(bytes, i, tlen - i, tlen)
-
-        if not c then
-          non_printable = non_printable + 1
-        else
-          i = i + nskip
-        end
-      end
-      i = i + 1
-    until i > tlen
-
-    lua_util.debugm(N, log_obj, "text part check: %s printable, %s non-printable, %s total",
-        tlen - non_printable, non_printable, tlen)
-    if non_printable / tlen > 0.0078125 then
-      return false
-    end
-
-    return true
+-- We get some span of data and check it
+local function is_span_text(span, log_obj)
+  -- 8 bit content is assumed to be localized text if it is valid utf8 or
+  -- if it has more than 3 subsequent 8 bit characters
+  local tlen = #span
+  local non_printable = span:count_nonprintable()
+
+  lua_util.debugm(N, log_obj, "text part check: %s printable, %s non-printable, %s total",
+      tlen - non_printable, non_printable, tlen)
+  if non_printable / tlen > 0.0078125 then
+    return false
   end
 
+  return true
+end
+
+exports.text_part_heuristic = function(part, log_obj, _)
   local parent = part:get_parent()
 
   if parent then
@@ -480,9 +386,10 @@ exports.text_part_heuristic = function(part, log_obj, _)
   if clen > 0 then
     if clen > 80 * 3 then
       -- Use chunks
-      is_text = is_span_text(content:span(1, 160)) and is_span_text(content:span(clen - 80, 80))
+      is_text = is_span_text(content:span(1, 160), log_obj) and
+          is_span_text(content:span(clen - 80, 80), log_obj)
     else
-      is_text = is_span_text(content)
+      is_text = is_span_text(content, log_obj)
     end
 
     if is_text and mtype ~= 'message' then
@@ -152,48 +152,52 @@ end
 
 process_patterns(rspamd_config)
 
-local function match_chunk(chunk, input, tlen, offset, trie, processed_tbl, log_obj, res, part)
-  local matches = trie:match(chunk)
+local function add_result(res, weight, ext, log_obj)
+  if not res[ext] then
+    res[ext] = 0
+  end
+  if weight then
+    res[ext] = res[ext] + weight
+  else
+    res[ext] = res[ext] + 1
+  end
 
-  local last = tlen
+  lua_util.debugm(N, log_obj,'add pattern for %s, weight %s, total weight %s',
+      ext, weight, res[ext])
+end
 
-  local function add_result(weight, ext)
-    if not res[ext] then
-      res[ext] = 0
-    end
-    if weight then
-      res[ext] = res[ext] + weight
-    else
-      res[ext] = res[ext] + 1
-    end
+local function match_position(pos, expected, last)
+  local op = '=='
+  if type(expected) == 'table' then
+    -- Something like {'>', 0}
+    op, expected = expected[1], expected[2]
+  end
 
-    lua_util.debugm(N, log_obj,'add pattern for %s, weight %s, total weight %s',
-        ext, weight, res[ext])
+  -- Tail match
+  if expected < 0 then
+    expected = last + expected + 1
   end
 
-  local function match_position(pos, expected)
-    local cmp = function(a, b) return a == b end
-    if type(expected) == 'table' then
-      -- Something like {'>', 0}
-      if expected[1] == '>' then
-        cmp = function(a, b) return a > b end
-      elseif expected[1] == '>=' then
-        cmp = function(a, b) return a >= b end
-      elseif expected[1] == '<' then
-        cmp = function(a, b) return a < b end
-      elseif expected[1] == '<=' then
-        cmp = function(a, b) return a <= b end
-      elseif expected[1] == '!=' then
-        cmp = function(a, b) return a ~= b end
-      end
-      expected = expected[2]
-    end
+  if op == '>' then
+    return pos > expected
+  elseif op == '>=' then
+    return pos >= expected
+  elseif op == '<' then
+    return pos < expected
+  elseif op == '<=' then
+    return pos <= expected
+  elseif op == '!=' then
+    return pos ~= expected
+  end
 
-    -- Tail match
-    if expected < 0 then
-      expected = last + expected + 1
-    end
-    return cmp(pos, expected)
+  return pos == expected
+end
+
+local function match_chunk(chunk, input, tlen, offset, trie, processed_tbl, log_obj, res, part)
+  local matches = trie:match(chunk)
+
+  if not matches then
+    return
   end
 
   for npat,matched_positions in pairs(matches) do
@@ -208,16 +212,16 @@ local function match_chunk(chunk, input, tlen, offset, trie, processed_tbl, log_
       for _,pos in ipairs(matched_positions) do
         lua_util.debugm(N, log_obj, 'found match %s at offset %s(from %s)',
             pattern.ext, pos, offset)
-        if match_position(pos + offset, position) then
+        if match_position(pos + offset, position, tlen) then
           if match.heuristic then
             local ext,weight = match.heuristic(input, log_obj, pos + offset, part)
 
             if ext then
-              add_result(weight, ext)
+              add_result(res, weight, ext, log_obj)
               break
             end
           else
-            add_result(match.weight, pattern.ext)
+            add_result(res, match.weight, pattern.ext, log_obj)
             break
           end
         end
@@ -231,7 +235,7 @@ local function match_chunk(chunk, input, tlen, offset, trie, processed_tbl, log_
         for _,pos in ipairs(matched_positions) do
           lua_util.debugm(N, log_obj, 'found match %s at offset %s(from %s)',
               pattern.ext, pos, offset)
-          if not match_position(pos + offset, position) then
+          if not match_position(pos + offset, position, tlen) then
             matched = true
             matched_pos = pos
             break
@@ -248,11 +252,11 @@ local function match_chunk(chunk, input, tlen, offset, trie, processed_tbl, log_
           local ext,weight = match.heuristic(input, log_obj, matched_pos + offset, part)
 
           if ext then
-            add_result(weight, ext)
+            add_result(res, weight, ext, log_obj)
             break
           end
         else
-          add_result(match.weight, pattern.ext)
+          add_result(res, match.weight, pattern.ext, log_obj)
           break
         end
       end
@@ -1002,6 +1002,134 @@ end
 exports.rspamd_redis_make_request = rspamd_redis_make_request
 exports.redis_make_request = rspamd_redis_make_request
 
+-- Returns connections opened by batched requests for this task, grouped by
+-- redis params and by read/write direction
+local function get_task_batch(task, redis_params, is_write)
+  local batch = task:cache_get('redis_batch')
+
+  if not batch then
+    batch = {}
+    task:cache_set('redis_batch', batch)
+  end
+
+  local per_params = batch[redis_params]
+
+  if not per_params then
+    per_params = {
+      read = { by_upstream = {} },
+      write = { by_upstream = {} },
+    }
+    batch[redis_params] = per_params
+  end
+
+  return is_write and per_params.write or per_params.read
+end
+
+local function redis_batch_request(task, redis_params, key, is_write,
+    callback, command, args)
+  if not task or not redis_params or not command then
+    return false,nil,nil
+  end
+
+  local conns = get_task_batch(task, redis_params, is_write)
+  local existing
+
+  if key then
+    local addr
+    if is_write then
+      addr = redis_params['write_servers']:get_upstream_by_hash(key)
+    else
+      addr = redis_params['read_servers']:get_upstream_by_hash(key)
+    end
+
+    if addr then
+      existing = conns.by_upstream[addr:get_name()]
+    end
+  else
+    -- Any upstream is fine for keyless requests, so reuse whatever we have
+    existing = conns.last
+  end
+
+  -- Connection is released by rspamd_redis as soon as all its replies are
+  -- received (or on error), so it must not be reused after that
+  local function finish_cmd(elt, err)
+    elt.pending = elt.pending - 1
+
+    if err or elt.pending <= 0 then
+      if elt.upstream and conns.by_upstream[elt.upstream] == elt then
+        conns.by_upstream[elt.upstream] = nil
+      end
+      if conns.last == elt then
+        conns.last = nil
+      end
+    end
+  end
+
+  if existing then
+    local addr = existing.addr
+    local function batch_cb(err, data)
+      finish_cmd(existing, err)
+      if err then
+        addr:fail()
+      else
+        addr:ok()
+      end
+      if callback then
+        callback(err, data, addr)
+      end
+    end
+
+    if redis_params['expand_keys'] then
+      local m = get_key_expansion_metadata(task)
+      local indexes = get_key_indexes(command, args)
+      for _, i in ipairs(indexes) do
+        args[i] = lutil.template(args[i], m)
+      end
+    end
+
+    if existing.conn:add_cmd(batch_cb, command, args) then
+      existing.pending = existing.pending + 1
+      lutil.debugm(N, task, 'pipelined %s to redis server %s',
+          command, addr:get_name())
+      return true,existing.conn,addr
+    end
+    -- Connection is done with, so forget it and fall back to a new one
+    existing.pending = 0
+    finish_cmd(existing, true)
+  end
+
+  local elt = { pending = 1 }
+  local function first_cb(err, data, addr)
+    finish_cmd(elt, err)
+    if callback then
+      callback(err, data, addr)
+    end
+  end
+
+  local ret,conn,addr = rspamd_redis_make_request(task, redis_params, key,
+      is_write, first_cb, command, args)
+
+  if ret then
+    elt.conn = conn
+    elt.addr = addr
+    elt.upstream = addr:get_name()
+    conns.by_upstream[elt.upstream] = elt
+    conns.last = elt
+  end
+
+  return ret,conn,addr
+end
+
+--[[[
+-- @function lua_redis.redis_batch_request(task, redis_params, key, is_write, callback, command, args)
+-- Same as redis_make_request(), but pipelines the command into a connection
+-- already opened by another batched request for the same task, redis params and
+-- upstream, if it is still active. Keyless requests may share any such
+-- connection. Each command gets its own callback, which can be nil if the
+-- reply is not needed.
+--]]
+exports.redis_batch_request = redis_batch_request
+
 local function redis_make_request_taskless(ev_base, cfg, redis_params, key,
     is_write, callback, command, args, extra_opts)
   if not ev_base or not redis_params or not callback or not command then
@@ -1330,7 +1458,11 @@ local function exec_redis_script(id, params, callback, keys, args)
     end
 
     if params.task then
-      if not rspamd_redis_make_request(params.task, script.redis_params,
+      local make_request = rspamd_redis_make_request
+      if params.batch then
+        make_request = redis_batch_request
+      end
+      if not make_request(params.task, script.redis_params,
         params.key, params.is_write, redis_cb, 'EVALSHA', redis_args) then
         callback('Cannot make redis request', nil)
       end
@@ -113,6 +113,8 @@ local function cloudmark_config(opts)
   }
 
   cloudmark_conf = lua_util.override_defaults(cloudmark_conf, opts)
+  -- Verdicts are not cached, so there is nothing to wait for
+  cloudmark_conf.no_single_flight = true
 
   if not cloudmark_conf.prefix then
     cloudmark_conf.prefix = 'rs_' .. cloudmark_conf.name .. '_'
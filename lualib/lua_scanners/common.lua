@@ -25,10 +25,25 @@ local rspamd_regexp = require "rspamd_regexp"
 local lua_util = require "lua_util"
 local lua_redis = require "lua_redis"
 local lua_magic_types = require "lua_magic/types"
+local rspamd_util = require "rspamd_util"
 local fun = require "fun"
 
 local exports = {}
 
+-- Verdicts and scans in flight are shared by all tasks of a worker, so
+-- identical objects that arrive together are scanned once. Redis (if defined)
+-- is used as the second tier shared between workers and hosts
+local local_cache_max = 8192
+local local_cache = {
+  cur = {},
+  prev = {},
+  count = 0,
+}
+-- Scans in flight indexed by the local cache key
+local inflight = {}
+-- How often tasks waiting for a scan in flight check for its result
+local inflight_poll_interval = 0.1
+
 local function log_clean(task, rule, msg)
 
   msg = msg or 'message or mime_part is clean'
@@ -41,6 +56,18 @@ local function log_clean(task, rule, msg)
 
 end
 
+-- Drops scans in flight started by the task for the rule, so other tasks do not
+-- wait for a verdict that is never going to be cached
+local function finish_flights(task, rule)
+  local uid = task:get_uid()
+
+  for lkey, flight in pairs(inflight) do
+    if flight.owner == uid and flight.rule == rule.name then
+      inflight[lkey] = nil
+    end
+  end
+end
+
 local function match_patterns(default_sym, found, patterns, dyn_weight)
   if type(patterns) ~= 'table' then return default_sym, dyn_weight end
   if not patterns[1] then
@@ -84,6 +111,7 @@ local function yield_result(task, rule, vname, dyn_weight, is_fail, maybe_part)
     threat_info = rule.detection_category .. 'found'
     if not dyn_weight then dyn_weight = 1.0 end
   elseif is_fail == 'fail' then
+    finish_flights(task, rule)
     patterns = rule.patterns_fail
     symbol = rule.symbol_fail
     threat_info = "FAILED with error"
@@ -209,42 +237,87 @@ local function dynamic_scan(task, rule)
   end
 end
 
+local function local_cache_key(rule, digest)
+  return rule.name .. ':' .. digest
+end
+
+local function local_cache_insert(key, elt)
+  if local_cache.count >= local_cache_max then
+    -- Older generation is dropped, so recently used elements survive
+    local_cache.prev = local_cache.cur
+    local_cache.cur = {}
+    local_cache.count = 0
+  end
+
+  if not local_cache.cur[key] then
+    local_cache.count = local_cache.count + 1
+  end
+
+  local_cache.cur[key] = elt
+end
+
+local function local_cache_get(key)
+  local elt = local_cache.cur[key]
+
+  if not elt then
+    elt = local_cache.prev[key]
+
+    if elt then
+      local_cache.prev[key] = nil
+      local_cache_insert(key, elt)
+    end
+  end
+
+  if elt then
+    if elt.expire > rspamd_util.get_time() then
+      return elt.value
+    end
+
+    local_cache.cur[key] = nil
+  end
+
+  return nil
+end
+
+local function local_cache_set(key, value, ttl)
+  local_cache_insert(key, {
+    value = value,
+    expire = rspamd_util.get_time() + ttl,
+  })
+end
+
 local function need_check(task, content, rule, digest, fn, maybe_part)
 
   local uncached = true
   local key = digest
-
-  local function redis_av_cb(err, data)
-    if data and type(data) == 'string' then
-      -- Cached
-      data = lua_util.str_split(data, '\t')
-      local threat_string = lua_util.str_split(data[1], '\v')
-      local score = data[2] or rule.default_score
-
-      if threat_string[1] ~= 'OK' then
-        if threat_string[1] == 'MACRO' then
-          yield_result(task, rule, 'File contains macros',
-              0.0, 'macro', maybe_part)
-        elseif threat_string[1] == 'ENCRYPTED' then
-          yield_result(task, rule, 'File is encrypted',
-              0.0, 'encrypted', maybe_part)
-        else
-          lua_util.debugm(rule.name, task, '%s: got cached threat result for %s: %s - score: %s',
-              rule.log_prefix, key, threat_string[1], score)
-          yield_result(task, rule, threat_string, score, false, maybe_part)
-        end
-
+  local lkey = local_cache_key(rule, digest)
+
+  local function process_cached(data, source)
+    data = lua_util.str_split(data, '\t')
+    local threat_string = lua_util.str_split(data[1], '\v')
+    local score = data[2] or rule.default_score
+
+    if threat_string[1] ~= 'OK' then
+      if threat_string[1] == 'MACRO' then
+        yield_result(task, rule, 'File contains macros',
+            0.0, 'macro', maybe_part)
+      elseif threat_string[1] == 'ENCRYPTED' then
+        yield_result(task, rule, 'File is encrypted',
+            0.0, 'encrypted', maybe_part)
       else
-        lua_util.debugm(rule.name, task, '%s: got cached negative result for %s: %s',
-          rule.log_prefix, key, threat_string[1])
+        lua_util.debugm(rule.name, task, '%s: got %s cached threat result for %s: %s - score: %s',
+            rule.log_prefix, source, key, threat_string[1], score)
+        yield_result(task, rule, threat_string, score, false, maybe_part)
       end
-      uncached = false
+
     else
-      if err then
-        rspamd_logger.errx(task, 'got error checking cache: %s', err)
-      end
+      lua_util.debugm(rule.name, task, '%s: got %s cached negative result for %s: %s',
+        rule.log_prefix, source, key, threat_string[1])
     end
+    uncached = false
+  end
 
+  local function maybe_scan()
     local f_message_not_too_large = message_not_too_large(task, content, rule)
     local f_message_not_too_small = message_not_too_small(task, content, rule)
     local f_message_min_words = message_min_words(task, rule)
@@ -257,33 +330,119 @@ local function need_check(task, content, rule, digest, fn, maybe_part)
       f_dynamic_scan then
 
       fn()
+    else
+      inflight[lkey] = nil
+    end
+  end
 
+  local function redis_av_cb(err, data)
+    if data and type(data) == 'string' then
+      -- Cached
+      local_cache_set(lkey, data, rule.cache_expire or 3600)
+      inflight[lkey] = nil
+      process_cached(data, 'redis')
+    else
+      if err then
+        rspamd_logger.errx(task, 'got error checking cache: %s', err)
+      end
     end
 
+    maybe_scan()
   end
 
-  if rule.redis_params and not rule.no_cache then
+  local function start_flight()
+    -- Other tasks wait for one scan attempt at most
+    local flight = {
+      deadline = rspamd_util.get_time() + (rule.timeout or 10.0),
+      owner = task:get_uid(),
+      rule = rule.name,
+    }
+    inflight[lkey] = flight
+    -- Scan might be abandoned without any result (e.g. task timeout)
+    task:get_mempool():add_destructor(function()
+      if inflight[lkey] == flight then
+        inflight[lkey] = nil
+      end
+    end)
+  end
 
-    key = rule.prefix .. key
+  local function check_redis()
+    if rule.redis_params then
+      key = rule.prefix .. key
+
+      if lua_redis.redis_make_request(task,
+          rule.redis_params, -- connect params
+          key, -- hash key
+          false, -- is write
+          redis_av_cb, --callback
+          'GET', -- command
+          {key} -- arguments)
+      ) then
+        return true
+      end
+    end
 
-    if lua_redis.redis_make_request(task,
-        rule.redis_params, -- connect params
-        key, -- hash key
-        false, -- is write
-        redis_av_cb, --callback
-        'GET', -- command
-        {key} -- arguments)
-    ) then
+    return false
+  end
+
+  if rule.no_cache then
+    return false
+  end
+
+  local cached = local_cache_get(lkey)
+
+  if cached then
+    process_cached(cached, 'local')
+    return true
+  end
+
+  if rule.no_single_flight then
+    return check_redis()
+  end
+
+  local now = rspamd_util.get_time()
+  local flight = inflight[lkey]
+
+  if flight and flight.deadline > now then
+    -- Wait for the result of the same scan started by another task
+    local function wait_cb()
+      local value = local_cache_get(lkey)
+
+      if value then
+        process_cached(value, 'in flight')
+        return
+      end
+
+      if inflight[lkey] == flight and flight.deadline > rspamd_util.get_time() then
+        return inflight_poll_interval
+      end
+
+      -- Scan has failed or timed out, so do it ourselves
+      lua_util.debugm(rule.name, task, '%s: scan in flight for %s has not returned any result',
+          rule.log_prefix, key)
+      start_flight()
+      if not check_redis() then
+        maybe_scan()
+      end
+    end
+
+    lua_util.debugm(rule.name, task, '%s: wait for scan in flight for %s',
+        rule.log_prefix, key)
+
+    if task:add_timer(inflight_poll_interval, wait_cb) then
       return true
     end
   end
 
-  return false
+  start_flight()
+
+  return check_redis()
 
 end
 
 local function save_cache(task, digest, rule, to_save, dyn_weight, maybe_part)
   local key = digest
+  local lkey = local_cache_key(rule, digest)
   if not dyn_weight then dyn_weight = 1.0 end
 
   local function redis_set_cb(err)
@@ -308,6 +467,11 @@ local function save_cache(task, digest, rule, to_save, dyn_weight, maybe_part)
   end
   local value = table.concat(value_tbl, '\t')
 
+  if not rule.no_cache then
+    local_cache_set(lkey, value, rule.cache_expire or 3600)
+  end
+  inflight[lkey] = nil
+
   if rule.redis_params and rule.prefix then
     key = rule.prefix .. key
 
@@ -115,6 +115,8 @@ local function vade_config(opts)
   }
 
   vade_conf = lua_util.override_defaults(vade_conf, opts)
+  -- Verdicts are not cached, so there is nothing to wait for
+  vade_conf.no_single_flight = true
 
   if not vade_conf.prefix then
     vade_conf.prefix = 'rs_' .. vade_conf.name .. '_'
@@ -1199,9 +1199,74 @@ rspamd_controller_graph_point (gulong t, gulong step,
 	}
 }
 
+/*
+ * Sends per-second series from the shared memory resampled to the desired
+ * number of points
+ */
+static void
+rspamd_controller_graph_series (struct rspamd_http_connection_entry *conn_ent,
+		struct rspamd_stat_series *series,
+		guint desired_points)
+{
+	ucl_object_t *res, *elt[METRIC_ACTION_MAX], *data_elt;
+	guint32 nslots, start, step, i, j, cnt;
+	guint64 last_update, t;
+	gdouble sum[METRIC_ACTION_MAX];
+	guint *slot;
+
+	/* The primary controller can update series concurrently, it is fine */
+	nslots = series->nslots;
+	start = (series->cur_slot + RSPAMD_STAT_SERIES_SLOTS - nslots) %
+			RSPAMD_STAT_SERIES_SLOTS;
+	last_update = series->last_update;
+	step = MAX (1, (nslots + desired_points - 1) / desired_points);
+
+	res = ucl_object_typed_new (UCL_ARRAY);
+
+	for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+		elt[j] = ucl_object_typed_new (UCL_ARRAY);
+		sum[j] = 0;
+	}
+
+	for (i = 0, cnt = 0; i < nslots; i ++) {
+		slot = series->actions[(start + i) % RSPAMD_STAT_SERIES_SLOTS];
+
+		for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+			sum[j] += slot[j];
+		}
+
+		cnt ++;
+
+		if (cnt == step || i == nslots - 1) {
+			/* Timestamp of the last second in a window */
+			t = last_update - (nslots - 1 - i);
+
+			for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+				data_elt = ucl_object_typed_new (UCL_OBJECT);
+				ucl_object_insert_key (data_elt, ucl_object_fromint (t),
+						"x", 1, false);
+				ucl_object_insert_key (data_elt,
+						ucl_object_fromdouble (sum[j] / (gdouble)cnt),
+						"y", 1, false);
+				ucl_array_append (elt[j], data_elt);
+				sum[j] = 0;
+			}
+
+			cnt = 0;
+		}
+	}
+
+	for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+		ucl_array_append (res, elt[j]);
+	}
+
+	rspamd_controller_send_ucl (conn_ent, res);
+	ucl_object_unref (res);
+}
+
 /*
  * Graph command handler:
- * request: /graph?type=<day|week|month|year>
+ * request: /graph?type=<hour|day|week|month|year>
  * headers: Password
  * reply: json [
  *      { label: "Foo", data: 11 },
@@ -1227,7 +1292,8 @@ rspamd_controller_handle_graph (
 		rra_week,
 		rra_month,
 		rra_year,
-		rra_invalid
+		rra_invalid,
+		rra_hour, /* Not an rrd archive, served from the shared memory */
 	} rra_num = rra_invalid;
 	/* How many points are we going to send to display */
 	static const guint desired_points = 500;
@@ -1238,13 +1304,6 @@ rspamd_controller_handle_graph (
 		return 0;
 	}
 
-	if (ctx->rrd == NULL) {
-		msg_err_session ("no rrd configured");
-		rspamd_controller_send_error (conn_ent, 404, "No rrd configured for graphs");
-
-		return 0;
-	}
-
 	query = rspamd_http_message_parse_query (msg);
 	srch.begin = (gchar *)"type";
 	srch.len = 4;
@@ -1260,7 +1319,10 @@ rspamd_controller_handle_graph (
 		return 0;
 	}
 
-	if (value->len == 3 && rspamd_lc_cmp (value->begin, "day", value->len) == 0) {
+	if (value->len == 4 && rspamd_lc_cmp (value->begin, "hour", value->len) == 0) {
+		rra_num = rra_hour;
+	}
+	else if (value->len == 3 && rspamd_lc_cmp (value->begin, "day", value->len) == 0) {
 		rra_num = rra_day;
 	}
 	else if (value->len == 4 && rspamd_lc_cmp (value->begin, "week", value->len) == 0) {
@@ -1282,6 +1344,26 @@ rspamd_controller_handle_graph (
 		return 0;
 	}
 
+	if (rra_num == rra_hour) {
+		if (ctx->srv->stat_series == NULL) {
+			rspamd_controller_send_error (conn_ent, 404, "No series available");
+
+			return 0;
+		}
+
+		rspamd_controller_graph_series (conn_ent, ctx->srv->stat_series,
+				desired_points);
+
+		return 0;
+	}
+
+	if (ctx->rrd == NULL) {
+		msg_err_session ("no rrd configured");
+		rspamd_controller_send_error (conn_ent, 404, "No rrd configured for graphs");
+
+		return 0;
+	}
+
 	rrd_result = rspamd_rrd_query (ctx->rrd, rra_num);
 
 	if (rrd_result == NULL) {
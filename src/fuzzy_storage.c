@@ -49,6 +49,9 @@
 #define DEFAULT_MAX_BUCKETS 2000
 #define DEFAULT_BUCKET_TTL 3600
 #define DEFAULT_BUCKET_MASK 24
+/* Geometry of the shared ratelimit sketch: 4 * 8192 * 24 bytes = 768Kb */
+#define RATELIMIT_SKETCH_ROWS 4
+#define RATELIMIT_SKETCH_WIDTH 8192
 
 static const gchar *local_db_name = "local";
 
@@ -123,9 +126,28 @@ struct rspamd_fuzzy_mirror {
 };
 
 struct rspamd_leaky_bucket_elt {
-	rspamd_inet_addr_t *addr;
 	gdouble last;
 	gdouble cur;
+	gdouble banned_until;
+};
+
+/*
+ * Count-min sketch of leaky buckets, allocated in shared memory before workers
+ * are forked, so all fuzzy processes see the same ratelimit state. Each network
+ * is mapped to one bucket per row, its level is the minimum over these buckets,
+ * so collisions can only make a network look heavier, never lighter, and
+ * memory usage does not depend on the number of distinct sources.
+ */
+struct rspamd_fuzzy_ratelimit_sketch {
+	rspamd_mempool_mutex_t *lock;
+	guint64 seed;
+	struct rspamd_leaky_bucket_elt buckets[RATELIMIT_SKETCH_ROWS][RATELIMIT_SKETCH_WIDTH];
+};
+
+enum rspamd_fuzzy_ratelimit_result {
+	RATELIMIT_PASS = 0,
+	RATELIMIT_BANNED,
+	RATELIMIT_NEW_BAN,
 };
 
 static const guint64 rspamd_fuzzy_storage_magic = 0x291a3253eb1b3ea5ULL;
@@ -167,7 +189,8 @@ struct rspamd_fuzzy_storage_ctx {
 	struct rspamd_keypair_cache *keypair_cache;
 	struct rspamd_http_context *http_ctx;
 	rspamd_lru_hash_t *errors_ips;
-	rspamd_lru_hash_t *ratelimit_buckets;
+	struct rspamd_fuzzy_ratelimit_sketch *ratelimit_sketch;
+	gboolean ratelimit_enabled;
 	struct rspamd_fuzzy_backend *backend;
 	GArray *updates_pending;
 	guint updates_failed;
@@ -242,12 +265,77 @@ static gboolean rspamd_fuzzy_process_updates_queue (
 		struct rspamd_fuzzy_storage_ctx *ctx,
 		const gchar *source, gboolean final);
 
+static enum rspamd_fuzzy_ratelimit_result
+rspamd_fuzzy_ratelimit_sketch_update (struct rspamd_fuzzy_storage_ctx *ctx,
+		const guchar *key, guint klen, ev_tstamp now)
+{
+	struct rspamd_fuzzy_ratelimit_sketch *sk = ctx->ratelimit_sketch;
+	struct rspamd_leaky_bucket_elt *row_elts[RATELIMIT_SKETCH_ROWS], *elt;
+	enum rspamd_fuzzy_ratelimit_result ret = RATELIMIT_PASS;
+	gdouble level = G_MAXDOUBLE, banned_until = G_MAXDOUBLE;
+	guint64 h;
+	guint32 h1, h2;
+	guint i;
+
+	/* Double hashing to select one bucket per row */
+	h = rspamd_cryptobox_fast_hash (key, klen, sk->seed);
+	h1 = (guint32)h;
+	h2 = (guint32)(h >> 32) | 1u;
+
+	rspamd_mempool_lock_mutex (sk->lock);
+
+	for (i = 0; i < RATELIMIT_SKETCH_ROWS; i ++) {
+		elt = &sk->buckets[i][(h1 + i * h2) % RATELIMIT_SKETCH_WIDTH];
+		row_elts[i] = elt;
+
+		/* Leak bucket */
+		if (elt->last < now) {
+			elt->cur -= ctx->leaky_bucket_rate * (now - elt->last);
+			elt->last = now;
+
+			if (elt->cur < 0) {
+				elt->cur = 0;
+			}
+		}
+
+		level = MIN (level, elt->cur);
+		banned_until = MIN (banned_until, elt->banned_until);
+	}
+
+	if (banned_until > now) {
+		/* Ratelimit exceeded, preserve it for the whole ttl */
+		ret = RATELIMIT_BANNED;
+	}
+	else if (level >= ctx->leaky_bucket_burst) {
+		ret = RATELIMIT_NEW_BAN;
+
+		for (i = 0; i < RATELIMIT_SKETCH_ROWS; i ++) {
+			row_elts[i]->banned_until = MAX (row_elts[i]->banned_until,
+					now + ctx->leaky_bucket_ttl);
+		}
+	}
+	else {
+		/* Allow one more request, conservative update */
+		level += 1.0;
+
+		for (i = 0; i < RATELIMIT_SKETCH_ROWS; i ++) {
+			row_elts[i]->cur = MAX (row_elts[i]->cur, level);
+		}
+	}
+
+	rspamd_mempool_unlock_mutex (sk->lock);
+
+	return ret;
+}
+
 static gboolean
 rspamd_fuzzy_check_ratelimit (struct fuzzy_session *session)
 {
 	rspamd_inet_addr_t *masked;
-	struct rspamd_leaky_bucket_elt *elt;
+	gboolean ratelimited = FALSE;
 	ev_tstamp now;
+	guchar *key;
+	guint klen;
 
 	if (session->ctx->ratelimit_whitelist != NULL) {
 		if (rspamd_match_radix_map_addr (session->ctx->ratelimit_whitelist,
@@ -275,63 +363,26 @@ rspamd_fuzzy_check_ratelimit (struct fuzzy_session *session)
 	}
 
 	now = ev_now (session->ctx->event_loop);
-	elt = rspamd_lru_hash_lookup (session->ctx->ratelimit_buckets, masked,
-			now);
-
-	if (elt) {
-		gboolean ratelimited = FALSE;
-
-		if (isnan (elt->cur)) {
-			/* Ratelimit exceeded, preserve it for the whole ttl */
-			ratelimited = TRUE;
-		}
-		else {
-			/* Update bucket */
-			if (elt->last < now) {
-				elt->cur -= session->ctx->leaky_bucket_rate * (now - elt->last);
-				elt->last = now;
-
-				if (elt->cur < 0) {
-					elt->cur = 0;
-				}
-			}
-			else {
-				elt->last = now;
-			}
-
-			/* Check bucket */
-			if (elt->cur >= session->ctx->leaky_bucket_burst) {
-
-				msg_info ("ratelimiting %s (%s), %.1f max elts",
-						rspamd_inet_address_to_string (session->addr),
-						rspamd_inet_address_to_string (masked),
-						session->ctx->leaky_bucket_burst);
-				elt->cur = NAN;
-			}
-			else {
-				elt->cur ++; /* Allow one more request */
-			}
-		}
-
-		rspamd_inet_address_free (masked);
-
-		return !ratelimited;
+	key = rspamd_inet_address_get_hash_key (masked, &klen);
+
+	switch (rspamd_fuzzy_ratelimit_sketch_update (session->ctx,
+			key, klen, now)) {
+	case RATELIMIT_NEW_BAN:
+		msg_info ("ratelimiting %s (%s), %.1f max elts",
+				rspamd_inet_address_to_string (session->addr),
+				rspamd_inet_address_to_string (masked),
+				session->ctx->leaky_bucket_burst);
+		/* FALLTHROUGH */
+	case RATELIMIT_BANNED:
+		ratelimited = TRUE;
+		break;
+	default:
+		break;
 	}
-	else {
-		/* New bucket */
-		elt = g_malloc (sizeof (*elt));
-		elt->addr = masked; /* transfer ownership */
-		elt->cur = 1;
-		elt->last = now;
 
-		rspamd_lru_hash_insert (session->ctx->ratelimit_buckets,
-				masked,
-				elt,
-				now,
-				session->ctx->leaky_bucket_ttl);
-	}
+	rspamd_inet_address_free (masked);
 
-	return TRUE;
+	return !ratelimited;
 }
 
 static gboolean
@@ -410,15 +461,6 @@ fuzzy_count_callback (guint64 count, void *ud)
 	ctx->stat.fuzzy_hashes = count;
 }
 
-static void
-fuzzy_rl_bucket_free (gpointer p)
-{
-	struct rspamd_leaky_bucket_elt *elt = (struct rspamd_leaky_bucket_elt *)p;
-
-	rspamd_inet_address_free (elt->addr);
-	g_free (elt);
-}
-
 static void
 fuzzy_stat_count_callback (guint64 count, void *ud)
 {
@@ -1112,7 +1154,7 @@ rspamd_fuzzy_process_command (struct fuzzy_session *session)
 	if (cmd->cmd == FUZZY_CHECK) {
 		bool can_continue = true;
 
-		if (session->ctx->ratelimit_buckets) {
+		if (session->ctx->ratelimit_enabled) {
 			if (session->ctx->ratelimit_log_only) {
 				(void)rspamd_fuzzy_check_ratelimit (session); /* Check but ignore */
 			}
@@ -2166,6 +2208,16 @@ init_fuzzy (struct rspamd_config *cfg)
 	ctx->leaky_bucket_ttl = DEFAULT_BUCKET_TTL;
 	ctx->max_buckets = DEFAULT_MAX_BUCKETS;
 	ctx->leaky_bucket_burst = NAN;
+	/*
+	 * Must be allocated before workers are forked, when worker options are not
+	 * yet parsed, hence it is allocated unconditionally
+	 */
+	ctx->ratelimit_sketch = rspamd_mempool_alloc_shared (cfg->cfg_pool,
+			sizeof (*ctx->ratelimit_sketch));
+	memset (ctx->ratelimit_sketch->buckets, 0,
+			sizeof (ctx->ratelimit_sketch->buckets));
+	ctx->ratelimit_sketch->lock = rspamd_mempool_get_mutex (cfg->cfg_pool);
+	ctx->ratelimit_sketch->seed = ottery_rand_uint64 ();
 	ctx->leaky_bucket_rate = NAN;
 	ctx->delay = NAN;
 
@@ -2309,7 +2361,7 @@ init_fuzzy (struct rspamd_config *cfg)
 			ctx,
 			G_STRUCT_OFFSET (struct rspamd_fuzzy_storage_ctx, max_buckets),
 			RSPAMD_CL_FLAG_UINT,
-			"Maximum number of leaky buckets (default: " G_STRINGIFY(DEFAULT_MAX_BUCKETS) ")");
+			"Deprecated: leaky buckets are now stored in a fixed size sketch shared by all fuzzy workers");
 	rspamd_rcl_register_worker_option (cfg,
 			type,
 			"ratelimit_network_mask",
@@ -2579,9 +2631,7 @@ start_fuzzy (struct rspamd_worker *worker)
 
 	/* Ratelimits */
 	if (!isnan (ctx->leaky_bucket_rate) && !isnan (ctx->leaky_bucket_burst)) {
-		ctx->ratelimit_buckets = rspamd_lru_hash_new_full (ctx->max_buckets,
-				NULL, fuzzy_rl_bucket_free,
-				rspamd_inet_address_hash, rspamd_inet_address_equal);
+		ctx->ratelimit_enabled = TRUE;
 	}
 
 	/* Maps events */
@@ -2664,10 +2714,6 @@ start_fuzzy (struct rspamd_worker *worker)
 		rspamd_keypair_cache_destroy (ctx->keypair_cache);
 	}
 
-	if (ctx->ratelimit_buckets) {
-		rspamd_lru_hash_destroy (ctx->ratelimit_buckets);
-	}
-
 	if (ctx->lua_pre_handler_cbref != -1) {
 		luaL_unref (ctx->cfg->lua_state, LUA_REGISTRYINDEX, ctx->lua_pre_handler_cbref);
 	}
@@ -1105,20 +1105,25 @@ rspamd_cryptobox_encryptv_nm_inplace (struct rspamd_cryptobox_segment *segments,
 
 			while (inremain > 0) {
 				if (sizeof (outbuf) <= inremain) {
-					memcpy (outbuf, in, sizeof (outbuf));
+					/*
+					 * Outbuf is empty here, so we can process all full
+					 * blocks directly in the segment without bouncing them
+					 * via outbuf
+					 */
+					gsize direct_len = inremain - inremain % sizeof (outbuf);
+
 					rspamd_cryptobox_encrypt_update (enc_ctx,
-							outbuf,
-							sizeof (outbuf),
-							outbuf,
+							in,
+							direct_len,
+							in,
 							NULL,
 							mode);
 					rspamd_cryptobox_auth_update (auth_ctx,
-							outbuf,
-							sizeof (outbuf),
+							in,
+							direct_len,
 							mode);
-					memcpy (in, outbuf, sizeof (outbuf));
-					in += sizeof (outbuf);
-					inremain -= sizeof (outbuf);
+					in += direct_len;
+					inremain -= direct_len;
 					remain = sizeof (outbuf);
 				}
 				else {
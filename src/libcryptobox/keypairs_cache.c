@@ -18,14 +18,29 @@
 #include "keypair_private.h"
 #include "libutil/util.h"
 #include "hash.h"
+#include "libutil/str_util.h"
 
 struct rspamd_keypair_elt {
 	struct rspamd_cryptobox_nm *nm;
 	guchar pair[rspamd_cryptobox_HASHBYTES * 2];
 };
 
+/*
+ * Parsed peer keys indexed by local key id + encoded peer key, so repeated
+ * requests from the same peer skip decoding and hashing of the public key
+ */
+struct rspamd_keypair_peer_elt {
+	rspamd_ftok_t key;
+	struct rspamd_cryptobox_pubkey *pk;
+	guchar data[];
+};
+
+/* Sanity limit for the encoded key size */
+#define RSPAMD_KEYPAIR_PEER_MAX_LEN 256
+
 struct rspamd_keypair_cache {
 	rspamd_lru_hash_t *hash;
+	rspamd_lru_hash_t *peers;
 };
 
 static void
@@ -37,6 +52,15 @@ rspamd_keypair_destroy (gpointer ptr)
 	g_free (elt);
 }
 
+static void
+rspamd_keypair_peer_destroy (gpointer ptr)
+{
+	struct rspamd_keypair_peer_elt *elt = (struct rspamd_keypair_peer_elt *)ptr;
+
+	rspamd_pubkey_unref (elt->pk);
+	g_free (elt);
+}
+
 static guint
 rspamd_keypair_hash (gconstpointer ptr)
 {
@@ -65,6 +89,8 @@ rspamd_keypair_cache_new (guint max_items)
 	c = g_malloc0 (sizeof (*c));
 	c->hash = rspamd_lru_hash_new_full (max_items, NULL,
 			rspamd_keypair_destroy, rspamd_keypair_hash, rspamd_keypair_equal);
+	c->peers = rspamd_lru_hash_new_full (max_items, NULL,
+			rspamd_keypair_peer_destroy, rspamd_ftok_hash, rspamd_ftok_equal);
 
 	return c;
 }
@@ -133,10 +159,65 @@ rspamd_keypair_cache_process (struct rspamd_keypair_cache *c,
 	REF_RETAIN (rk->nm);
 }
 
+struct rspamd_cryptobox_pubkey *
+rspamd_keypair_cache_peer_key (struct rspamd_keypair_cache *c,
+		struct rspamd_cryptobox_keypair *lk,
+		const gchar *b32, gsize len)
+{
+	struct rspamd_keypair_peer_elt *elt;
+	struct rspamd_cryptobox_pubkey *pk;
+	rspamd_ftok_t search;
+	guchar keybuf[rspamd_cryptobox_HASHBYTES + RSPAMD_KEYPAIR_PEER_MAX_LEN];
+	time_t now;
+
+	g_assert (lk != NULL);
+
+	if (len == 0 || len > RSPAMD_KEYPAIR_PEER_MAX_LEN) {
+		return NULL;
+	}
+
+	memcpy (keybuf, lk->id, rspamd_cryptobox_HASHBYTES);
+	memcpy (keybuf + rspamd_cryptobox_HASHBYTES, b32, len);
+	search.begin = (const gchar *)keybuf;
+	search.len = rspamd_cryptobox_HASHBYTES + len;
+	now = time (NULL);
+
+	elt = rspamd_lru_hash_lookup (c->peers, &search, now);
+
+	if (elt != NULL) {
+		pk = elt->pk;
+
+		if (rspamd_pubkey_get_nm (pk, lk) == NULL) {
+			/* nm has been replaced for another local key */
+			rspamd_keypair_cache_process (c, lk, pk);
+		}
+
+		return rspamd_pubkey_ref (pk);
+	}
+
+	pk = rspamd_pubkey_from_base32 (b32, len, lk->type, lk->alg);
+
+	if (pk == NULL) {
+		return NULL;
+	}
+
+	rspamd_keypair_cache_process (c, lk, pk);
+
+	elt = g_malloc (sizeof (*elt) + search.len);
+	memcpy (elt->data, keybuf, search.len);
+	elt->key.begin = (const gchar *)elt->data;
+	elt->key.len = search.len;
+	elt->pk = rspamd_pubkey_ref (pk);
+	rspamd_lru_hash_insert (c->peers, &elt->key, elt, now, -1);
+
+	return pk;
+}
+
 void
 rspamd_keypair_cache_destroy (struct rspamd_keypair_cache *c)
 {
 	if (c != NULL) {
+		rspamd_lru_hash_destroy (c->peers);
 		rspamd_lru_hash_destroy (c->hash);
 		g_free (c);
 	}
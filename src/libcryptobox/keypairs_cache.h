@@ -44,6 +44,21 @@ void rspamd_keypair_cache_process (struct rspamd_keypair_cache *c,
 								   struct rspamd_cryptobox_keypair *lk,
 								   struct rspamd_cryptobox_pubkey *rk);
 
+/**
+ * Returns a parsed peer public key for the base32 encoded key `b32`, with
+ * the shared secret for `lk` attached. Parsed keys are cached by the local
+ * key id and the encoded value, so the same peer is decoded only once
+ * @param c cache of keypairs
+ * @param lk local key
+ * @param b32 base32 encoded peer key
+ * @param len length of the encoded key
+ * @return new reference to the public key (must be unrefed) or NULL if the key is invalid
+ */
+struct rspamd_cryptobox_pubkey *rspamd_keypair_cache_peer_key (
+		struct rspamd_keypair_cache *c,
+		struct rspamd_cryptobox_keypair *lk,
+		const gchar *b32, gsize len);
+
 /**
  * Destroy old keypair cache
  * @param c cache object
@@ -20,6 +20,56 @@
 #include "printf.h"
 #include "smtp_parsers.h"
 
+/* Character classes for the address list scanner */
+enum rspamd_email_addr_char_class {
+	EMAIL_ADDR_CC_COMMENT = (1u << 0), /* significant when stripping comments */
+	EMAIL_ADDR_CC_NAME = (1u << 1), /* significant in a display name */
+	EMAIL_ADDR_CC_QUOTED = (1u << 2), /* significant in a quoted string */
+	EMAIL_ADDR_CC_ADDR = (1u << 3), /* significant in an angled address */
+};
+
+static const guchar email_addr_char_classes[256] = {
+	['\\'] = EMAIL_ADDR_CC_COMMENT|EMAIL_ADDR_CC_QUOTED,
+	['"'] = EMAIL_ADDR_CC_COMMENT|EMAIL_ADDR_CC_NAME|EMAIL_ADDR_CC_QUOTED,
+	['('] = EMAIL_ADDR_CC_COMMENT,
+	[')'] = EMAIL_ADDR_CC_COMMENT,
+	['<'] = EMAIL_ADDR_CC_NAME|EMAIL_ADDR_CC_QUOTED,
+	[','] = EMAIL_ADDR_CC_NAME,
+	['@'] = EMAIL_ADDR_CC_NAME|EMAIL_ADDR_CC_QUOTED|EMAIL_ADDR_CC_ADDR,
+	['>'] = EMAIL_ADDR_CC_ADDR,
+};
+
+/*
+ * Skips characters that are not significant for the specified class, so the
+ * state machines below are invoked merely for the special characters
+ */
+static inline const gchar *
+rspamd_email_address_skip (const gchar *p, const gchar *end, guchar cls)
+{
+	while (p + 4 <= end) {
+		if (email_addr_char_classes[(guchar)p[0]] & cls) {
+			return p;
+		}
+		if (email_addr_char_classes[(guchar)p[1]] & cls) {
+			return p + 1;
+		}
+		if (email_addr_char_classes[(guchar)p[2]] & cls) {
+			return p + 2;
+		}
+		if (email_addr_char_classes[(guchar)p[3]] & cls) {
+			return p + 3;
+		}
+
+		p += 4;
+	}
+
+	while (p < end && !(email_addr_char_classes[(guchar)*p] & cls)) {
+		p ++;
+	}
+
+	return p;
+}
+
 static void
 rspamd_email_address_unescape (struct rspamd_email_address *addr)
 {
@@ -100,6 +150,42 @@ rspamd_email_address_free (struct rspamd_email_address *addr)
 	}
 }
 
+/*
+ * Most of names are plain ascii, so we call mime decoder (that allocates
+ * temporary buffers) merely when there is something to decode
+ */
+static const gchar *
+rspamd_email_address_decode_name (rspamd_mempool_t *pool, const gchar *in,
+		gsize len)
+{
+	gchar *ret;
+	gsize i;
+
+	if (memchr (in, '=', len) == NULL &&
+			!rspamd_str_has_8bit ((const guchar *)in, len)) {
+		ret = rspamd_mempool_alloc (pool, len + 1);
+
+		/* Same sanitizing as the decoder does */
+		for (i = 0; i < len; i ++) {
+			if (g_ascii_isgraph (in[i])) {
+				ret[i] = in[i];
+			}
+			else if (g_ascii_isspace (in[i])) {
+				ret[i] = ' ';
+			}
+			else {
+				ret[i] = '?';
+			}
+		}
+
+		ret[len] = '\0';
+
+		return ret;
+	}
+
+	return rspamd_mime_header_decode (pool, in, len, NULL);
+}
+
 static inline void
 rspamd_email_address_add (rspamd_mempool_t *pool,
 		GPtrArray *ar,
@@ -142,7 +228,7 @@ rspamd_email_address_add (rspamd_mempool_t *pool,
 
 	if (name->len > 0) {
 		rspamd_gstring_strip (name, " \t\v");
-		elt->name = rspamd_mime_header_decode (pool, name->str, name->len, NULL);
+		elt->name = rspamd_email_address_decode_name (pool, name->str, name->len);
 	}
 
 	rspamd_mempool_notify_alloc (pool, name->len);
@@ -241,57 +327,41 @@ rspamd_email_address_check_and_add (const gchar *start, gsize len,
 	return 1;
 }
 
-GPtrArray *
-rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
-								guint len,
-								GPtrArray *src,
-								gint max_elements)
+/*
+ * Removes comments from the header, `out` must have at least `len` bytes
+ */
+static gsize
+rspamd_email_address_strip_comments (const gchar *in, gsize len, gchar *out)
 {
-	GPtrArray *res = src;
-	gboolean seen_at = FALSE, seen_obrace = FALSE;
-
-	const gchar *p = hdr, *end = hdr + len, *c = hdr, *t;
-	GString *ns, *cpy;
-	gint obraces, ebraces;
-	enum {
-		parse_name = 0,
-		parse_quoted,
-		parse_addr,
-		skip_spaces
-	} state = parse_name, next_state = parse_name;
-
-	if (res == NULL) {
-		res = g_ptr_array_sized_new (2);
-		rspamd_mempool_add_destructor (pool, rspamd_email_address_list_destroy,
-				res);
-	}
-	else if (max_elements > 0 && res->len >= max_elements) {
-		msg_info_pool_check ("reached maximum number of elements %d", max_elements);
-
-		return res;
-	}
+	const gchar *p = in, *end = in + len, *run;
+	gchar *o = out;
+	gint obraces = 0, ebraces = 0;
+	gboolean quoted = FALSE;
 
-	ns = g_string_sized_new (len);
-	cpy = g_string_sized_new (len);
+	while (p < end) {
+		run = p;
+		p = rspamd_email_address_skip (p, end, EMAIL_ADDR_CC_COMMENT);
 
-	rspamd_mempool_add_destructor (pool, rspamd_gstring_free_hard, cpy);
+		if (p > run && (quoted || obraces == 0)) {
+			memcpy (o, run, p - run);
+			o += p - run;
+		}
 
-	/* First, we need to remove all comments as they are terrible */
-	obraces = 0;
-	ebraces = 0;
+		if (p >= end) {
+			break;
+		}
 
-	while (p < end) {
-		if (state == parse_name) {
+		if (!quoted) {
 			if (*p == '\\') {
 				if (obraces == 0) {
-					g_string_append_c (cpy, *p);
+					*o++ = *p;
 				}
 
 				p++;
 			}
 			else {
 				if (*p == '"') {
-					state = parse_quoted;
+					quoted = TRUE;
 				}
 				else if (*p == '(') {
 					obraces ++; /* To avoid ) itself being copied */
@@ -308,38 +378,103 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 			}
 
 			if (p < end && obraces == 0) {
-				g_string_append_c (cpy, *p);
+				*o++ = *p;
 			}
 		}
 		else {
 			/* Quoted elt */
 			if (*p == '\\') {
-				g_string_append_c (cpy, *p);
+				*o++ = *p;
 				p++;
 			}
-			else {
-				if (*p == '"') {
-					state = parse_name;
-				}
+			else if (*p == '"') {
+				quoted = FALSE;
 			}
 
 			if (p < end) {
-				g_string_append_c (cpy, *p);
+				*o++ = *p;
 			}
 		}
 
 		p++;
 	}
 
-	state = parse_name;
+	return o - out;
+}
+
+GPtrArray *
+rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
+								guint len,
+								GPtrArray *src,
+								gint max_elements,
+								enum rspamd_email_address_parse_flags flags)
+{
+	GPtrArray *res = src;
+	gboolean seen_at = FALSE, seen_obrace = FALSE;
+
+	const gchar *p, *end, *c, *t, *buf;
+	gchar *cpy;
+	gsize buf_len;
+	GString *ns;
+	enum {
+		parse_name = 0,
+		parse_quoted,
+		parse_addr,
+		skip_spaces
+	} state = parse_name, next_state = parse_name;
+
+	if (res == NULL) {
+		res = g_ptr_array_sized_new (2);
+		rspamd_mempool_add_destructor (pool, rspamd_email_address_list_destroy,
+				res);
+	}
+	else if (max_elements > 0 && res->len >= max_elements) {
+		msg_info_pool_check ("reached maximum number of elements %d", max_elements);
+
+		return res;
+	}
+
+	/*
+	 * Addresses point to the buffer we parse, so it must live as long as the
+	 * pool. We also need to remove all comments as they are terrible, but they
+	 * are rare, so nothing is copied if they are absent and the input is
+	 * already owned by the pool.
+	 */
+	if (memchr (hdr, '(', len) == NULL && memchr (hdr, ')', len) == NULL) {
+		if (flags & RSPAMD_EMAIL_ADDR_PARSE_POOL_OWNED) {
+			buf = hdr;
+		}
+		else {
+			cpy = rspamd_mempool_alloc (pool, len + 1);
+			memcpy (cpy, hdr, len);
+			cpy[len] = '\0';
+			buf = cpy;
+		}
+
+		buf_len = len;
+	}
+	else {
+		cpy = rspamd_mempool_alloc (pool, len + 1);
+		buf_len = rspamd_email_address_strip_comments (hdr, len, cpy);
+		cpy[buf_len] = '\0';
+		buf = cpy;
+	}
+
+	ns = g_string_sized_new (MIN (len, 1024));
 
-	p = cpy->str;
+	p = buf;
 	c = p;
-	end = p + cpy->len;
+	end = p + buf_len;
 
 	while (p < end) {
 		switch (state) {
 		case parse_name:
+			p = rspamd_email_address_skip (p, end, EMAIL_ADDR_CC_NAME);
+
+			if (p == end) {
+				break;
+			}
+
 			if (*p == '"') {
 				/* We need to strip last spaces and update `ns` */
 				if (p > c) {
@@ -414,6 +549,12 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 			p ++;
 			break;
 		case parse_quoted:
+			p = rspamd_email_address_skip (p, end, EMAIL_ADDR_CC_QUOTED);
+
+			if (p == end) {
+				break;
+			}
+
 			if (*p == '\\') {
 				if (p > c) {
 					g_string_append_len (ns, c, p - c);
@@ -443,6 +584,12 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 			p ++;
 			break;
 		case parse_addr:
+			p = rspamd_email_address_skip (p, end, EMAIL_ADDR_CC_ADDR);
+
+			if (p == end) {
+				break;
+			}
+
 			if (*p == '>') {
 				int check = rspamd_email_address_check_and_add (c, p - c + 1,
 						res, pool, ns, max_elements);
@@ -482,7 +629,7 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 	case parse_name:
 		/* Assume the whole header as name (bad thing) */
 		if (p > c) {
-			while (p > c && g_ascii_isspace (*p)) {
+			while (p > c && g_ascii_isspace (*(p - 1))) {
 				p --;
 			}
 
@@ -526,7 +673,7 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 		/* Unfinished quoted string or a comment */
 		/* If we have seen obrace + at, then we still can try to resolve address */
 		if (seen_at && seen_obrace) {
-			p = rspamd_memrchr (cpy->str, '<', cpy->len);
+			p = rspamd_memrchr (buf, '<', end - buf);
 			g_assert (p != NULL);
 			if (rspamd_email_address_check_and_add (p, end - p,
 					res, pool, ns, max_elements) == 0) {
@@ -541,7 +688,6 @@ rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr,
 		break;
 	}
 end:
-	rspamd_mempool_notify_alloc (pool, cpy->len);
 	g_string_free (ns, TRUE);
 
 	return res;
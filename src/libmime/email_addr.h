@@ -58,6 +58,12 @@ struct rspamd_email_address {
 	guint flags;
 };
 
+enum rspamd_email_address_parse_flags {
+	RSPAMD_EMAIL_ADDR_PARSE_DEFAULT = 0,
+	/* Header buffer lives as long as the pool, so addresses can point to it */
+	RSPAMD_EMAIL_ADDR_PARSE_POOL_OWNED = (1 << 0),
+};
+
 struct rspamd_task;
 
 /**
@@ -73,13 +79,18 @@ struct rspamd_email_address *rspamd_email_address_from_smtp (const gchar *str, g
  * of `rspamd_email_address`. If `src` is NULL, then this function creates a new
  * array and adds a destructor to remove elements when `pool` is destroyed.
  * Otherwise, addresses are appended to `src`.
+ * Parsed addresses refer to the header buffer, which is copied to the pool
+ * unless `RSPAMD_EMAIL_ADDR_PARSE_POOL_OWNED` is set, in this case nothing is
+ * copied if the header has no comments.
  * @param hdr
  * @param len
+ * @param flags
  * @return
  */
 GPtrArray *
 rspamd_email_address_from_mime (rspamd_mempool_t *pool, const gchar *hdr, guint len,
-		GPtrArray *src, gint max_elements);
+		GPtrArray *src, gint max_elements,
+		enum rspamd_email_address_parse_flags flags);
 
 /**
  * Destroys list of email addresses
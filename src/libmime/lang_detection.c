@@ -1364,126 +1364,89 @@ rspamd_language_detector_cmp_heuristic (gconstpointer a, gconstpointer b,
 	return 0;
 }
 
-static void
-rspamd_language_detector_unicode_scripts (struct rspamd_task *task,
-										  struct rspamd_mime_text_part *part,
-										  guint *pchinese,
-										  guint *pspecial)
+void
+rspamd_language_detector_update_scripts (struct rspamd_mime_text_part *part,
+										 UChar32 uc)
 {
-	const gchar *p = part->utf_stripped_content->data, *end;
-	guint i = 0, cnt = 0;
-	end = p + part->utf_stripped_content->len;
-	gint32 uc, sc;
-	guint nlatin = 0, nchinese = 0, nspecial = 0;
-	const guint cutoff_limit = 32;
-
-	while (p + i < end) {
-		U8_NEXT (p, i, part->utf_stripped_content->len, uc);
-
-		if (((gint32) uc) < 0) {
-			break;
-		}
-
-		if (u_isalpha (uc)) {
-			sc = ublock_getCode (uc);
-			cnt ++;
-
-			switch (sc) {
-			case UBLOCK_BASIC_LATIN:
-			case UBLOCK_LATIN_1_SUPPLEMENT:
-				part->unicode_scripts |= RSPAMD_UNICODE_LATIN;
-				nlatin ++;
-				break;
-			case UBLOCK_HEBREW:
-				part->unicode_scripts |= RSPAMD_UNICODE_HEBREW;
-				nspecial ++;
-				break;
-			case UBLOCK_GREEK:
-				part->unicode_scripts |= RSPAMD_UNICODE_GREEK;
-				nspecial ++;
-				break;
-			case UBLOCK_CYRILLIC:
-				part->unicode_scripts |= RSPAMD_UNICODE_CYRILLIC;
-				nspecial ++;
-				break;
-			case UBLOCK_CJK_UNIFIED_IDEOGRAPHS:
-			case UBLOCK_CJK_COMPATIBILITY:
-			case UBLOCK_CJK_RADICALS_SUPPLEMENT:
-			case UBLOCK_CJK_UNIFIED_IDEOGRAPHS_EXTENSION_A:
-			case UBLOCK_CJK_UNIFIED_IDEOGRAPHS_EXTENSION_B:
-				part->unicode_scripts |= RSPAMD_UNICODE_CJK;
-				nchinese ++;
-				break;
-			case UBLOCK_HIRAGANA:
-			case UBLOCK_KATAKANA:
-				part->unicode_scripts |= RSPAMD_UNICODE_JP;
-				nspecial ++;
-				break;
-			case UBLOCK_HANGUL_JAMO:
-			case UBLOCK_HANGUL_COMPATIBILITY_JAMO:
-				part->unicode_scripts |= RSPAMD_UNICODE_HANGUL;
-				nspecial ++;
-				break;
-			case UBLOCK_ARABIC:
-				part->unicode_scripts |= RSPAMD_UNICODE_ARABIC;
-				nspecial ++;
-				break;
-			case UBLOCK_DEVANAGARI:
-				part->unicode_scripts |= RSPAMD_UNICODE_DEVANAGARI;
-				nspecial ++;
-				break;
-			case UBLOCK_ARMENIAN:
-				part->unicode_scripts |= RSPAMD_UNICODE_ARMENIAN;
-				nspecial ++;
-				break;
-			case UBLOCK_GEORGIAN:
-				part->unicode_scripts |= RSPAMD_UNICODE_GEORGIAN;
-				nspecial ++;
-				break;
-			case UBLOCK_GUJARATI:
-				part->unicode_scripts |= RSPAMD_UNICODE_GUJARATI;
-				nspecial ++;
-				break;
-			case UBLOCK_TELUGU:
-				part->unicode_scripts |= RSPAMD_UNICODE_TELUGU;
-				nspecial ++;
-				break;
-			case UBLOCK_TAMIL:
-				part->unicode_scripts |= RSPAMD_UNICODE_TAMIL;
-				nspecial ++;
-				break;
-			case UBLOCK_THAI:
-				part->unicode_scripts |= RSPAMD_UNICODE_THAI;
-				nspecial ++;
-				break;
-			case RSPAMD_UNICODE_MALAYALAM:
-				part->unicode_scripts |= RSPAMD_UNICODE_MALAYALAM;
-				nspecial ++;
-				break;
-			case RSPAMD_UNICODE_SINHALA:
-				part->unicode_scripts |= RSPAMD_UNICODE_SINHALA;
-				nspecial ++;
-				break;
-			}
-		}
+	gint32 sc = ublock_getCode (uc);
 
-		if (nspecial > cutoff_limit && nspecial > nlatin) {
-			break;
-		}
-		else if (nchinese > cutoff_limit && nchinese > nlatin) {
-			if (nspecial > 0) {
-				/* Likely japanese */
-				break;
-			}
-		}
+	switch (sc) {
+	case UBLOCK_BASIC_LATIN:
+	case UBLOCK_LATIN_1_SUPPLEMENT:
+		part->unicode_scripts |= RSPAMD_UNICODE_LATIN;
+		part->features.nlatin ++;
+		break;
+	case UBLOCK_HEBREW:
+		part->unicode_scripts |= RSPAMD_UNICODE_HEBREW;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_GREEK:
+		part->unicode_scripts |= RSPAMD_UNICODE_GREEK;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_CYRILLIC:
+		part->unicode_scripts |= RSPAMD_UNICODE_CYRILLIC;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_CJK_UNIFIED_IDEOGRAPHS:
+	case UBLOCK_CJK_COMPATIBILITY:
+	case UBLOCK_CJK_RADICALS_SUPPLEMENT:
+	case UBLOCK_CJK_UNIFIED_IDEOGRAPHS_EXTENSION_A:
+	case UBLOCK_CJK_UNIFIED_IDEOGRAPHS_EXTENSION_B:
+		part->unicode_scripts |= RSPAMD_UNICODE_CJK;
+		part->features.nchinese ++;
+		break;
+	case UBLOCK_HIRAGANA:
+	case UBLOCK_KATAKANA:
+		part->unicode_scripts |= RSPAMD_UNICODE_JP;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_HANGUL_JAMO:
+	case UBLOCK_HANGUL_COMPATIBILITY_JAMO:
+		part->unicode_scripts |= RSPAMD_UNICODE_HANGUL;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_ARABIC:
+		part->unicode_scripts |= RSPAMD_UNICODE_ARABIC;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_DEVANAGARI:
+		part->unicode_scripts |= RSPAMD_UNICODE_DEVANAGARI;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_ARMENIAN:
+		part->unicode_scripts |= RSPAMD_UNICODE_ARMENIAN;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_GEORGIAN:
+		part->unicode_scripts |= RSPAMD_UNICODE_GEORGIAN;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_GUJARATI:
+		part->unicode_scripts |= RSPAMD_UNICODE_GUJARATI;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_TELUGU:
+		part->unicode_scripts |= RSPAMD_UNICODE_TELUGU;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_TAMIL:
+		part->unicode_scripts |= RSPAMD_UNICODE_TAMIL;
+		part->features.nspecial ++;
+		break;
+	case UBLOCK_THAI:
+		part->unicode_scripts |= RSPAMD_UNICODE_THAI;
+		part->features.nspecial ++;
+		break;
+	case RSPAMD_UNICODE_MALAYALAM:
+		part->unicode_scripts |= RSPAMD_UNICODE_MALAYALAM;
+		part->features.nspecial ++;
+		break;
+	case RSPAMD_UNICODE_SINHALA:
+		part->unicode_scripts |= RSPAMD_UNICODE_SINHALA;
+		part->features.nspecial ++;
+		break;
 	}
-
-	msg_debug_lang_det ("stop after checking %d characters, "
-						"%d latin, %d special, %d chinese",
-			cnt, nlatin, nspecial, nchinese);
-
-	*pchinese = nchinese;
-	*pspecial = nspecial;
 }
 
 static inline void
@@ -1779,11 +1742,9 @@ rspamd_language_detector_detect (struct rspamd_task *task,
 
 	start_ticks = rspamd_get_ticks (TRUE);
 
-	guint nchinese = 0, nspecial = 0;
-	rspamd_language_detector_unicode_scripts (task, part, &nchinese, &nspecial);
-	/* Apply unicode scripts heuristic */
-
-	if (rspamd_language_detector_try_uniscript (task, part, nchinese, nspecial)) {
+	/* Apply unicode scripts heuristic, scripts are counted when words are created */
+	if (rspamd_language_detector_try_uniscript (task, part,
+			part->features.nchinese, part->features.nspecial)) {
 		ret = TRUE;
 	}
 
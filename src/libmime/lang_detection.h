@@ -103,6 +103,15 @@ gboolean rspamd_language_detector_is_stop_word (struct rspamd_lang_detector *d,
  * @return
  */
 gint rspamd_language_detector_elt_flags (const struct rspamd_language_elt *elt);
+
+/**
+ * Updates unicode scripts mask and scripts counters of a text part with
+ * an alphabetic character
+ * @param part
+ * @param uc
+ */
+void rspamd_language_detector_update_scripts (struct rspamd_mime_text_part *part,
+											  UChar32 uc);
 #ifdef  __cplusplus
 }
 #endif
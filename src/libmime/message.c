@@ -34,6 +34,7 @@
 
 #include <math.h>
 #include <unicode/uchar.h>
+#include <unicode/utf8.h>
 #include "sodium.h"
 #include "libserver/cfg_file_private.h"
 #include "lua/lua_common.h"
@@ -142,6 +143,105 @@ rspamd_mime_part_extract_words (struct rspamd_task *task,
 	}
 }
 
+/*
+ * Single pass over the words of a part: marks ASCII only words and counts
+ * unicode scripts, so consumers (language detection, chartable) do not need to
+ * decode and classify the whole text again
+ */
+static void
+rspamd_mime_part_words_features (struct rspamd_task *task,
+		struct rspamd_mime_text_part *part)
+{
+	struct rspamd_mime_text_part_features *ft = &part->features;
+	rspamd_stat_token_t *w;
+	gboolean check_scripts = TRUE, ascii;
+	const guint cutoff_limit = 32;
+	guint i, j;
+	UChar32 uc;
+
+	for (i = 0; i < part->utf_words->len; i ++) {
+		w = &g_array_index (part->utf_words, rspamd_stat_token_t, i);
+
+		if (!(w->flags & RSPAMD_STAT_TOKEN_FLAG_TEXT)) {
+			continue;
+		}
+
+		ascii = TRUE;
+
+		if (w->flags & RSPAMD_STAT_TOKEN_FLAG_UTF) {
+			if (w->flags & RSPAMD_STAT_TOKEN_FLAG_BROKEN_UNICODE) {
+				ascii = FALSE;
+			}
+
+			/* Chartable works with the normalized characters */
+			for (j = 0; j < w->unicode.len; j ++) {
+				if (w->unicode.begin[j] >= 0x80) {
+					ascii = FALSE;
+					break;
+				}
+			}
+
+			if (check_scripts) {
+				/*
+				 * Scripts are checked over the original text: NFKC changes
+				 * blocks of some characters, e.g. fullwidth latin or
+				 * halfwidth katakana
+				 */
+				gint32 off = 0, len = w->original.len;
+
+				while (off < len) {
+					U8_NEXT (w->original.begin, off, len, uc);
+
+					if (uc < 0) {
+						break;
+					}
+
+					if (uc < 0x80) {
+						if (g_ascii_isalpha (uc)) {
+							part->unicode_scripts |= RSPAMD_UNICODE_LATIN;
+							ft->nlatin ++;
+						}
+					}
+					else if (u_isalpha (uc)) {
+						rspamd_language_detector_update_scripts (part, uc);
+					}
+				}
+			}
+		}
+		else {
+			for (j = 0; j < w->original.len; j ++) {
+				guchar c = w->original.begin[j];
+
+				if (c & 0x80) {
+					/* Not an utf8 text, we cannot say anything about scripts */
+					ascii = FALSE;
+					check_scripts = FALSE;
+				}
+				else if (check_scripts && g_ascii_isalpha (c)) {
+					part->unicode_scripts |= RSPAMD_UNICODE_LATIN;
+					ft->nlatin ++;
+				}
+			}
+		}
+
+		if (ascii) {
+			w->flags |= RSPAMD_STAT_TOKEN_FLAG_ASCII;
+		}
+
+		/* Enough to guess a script */
+		if (check_scripts) {
+			if (ft->nspecial > cutoff_limit && ft->nspecial > ft->nlatin) {
+				check_scripts = FALSE;
+			}
+			else if (ft->nchinese > cutoff_limit && ft->nchinese > ft->nlatin &&
+					ft->nspecial > 0) {
+				/* Likely japanese */
+				check_scripts = FALSE;
+			}
+		}
+	}
+}
+
 static void
 rspamd_mime_part_create_words (struct rspamd_task *task,
 		struct rspamd_mime_text_part *part)
@@ -200,6 +300,7 @@ rspamd_mime_part_create_words (struct rspamd_task *task,
 		part->normalized_hashes = g_array_sized_new (FALSE, FALSE,
 				sizeof (guint64), part->utf_words->len);
 		rspamd_normalize_words (part->utf_words, task->task_pool);
+		rspamd_mime_part_words_features (task, part);
 	}
 
 }
@@ -125,6 +125,13 @@ struct rspamd_mime_part {
 #define IS_TEXT_PART_ATTACHMENT(part) ((part)->flags & RSPAMD_MIME_TEXT_PART_ATTACHMENT)
 
 
+/* Features of a text part collected by a single pass over its words */
+struct rspamd_mime_text_part_features {
+	guint nlatin; /* Latin letters */
+	guint nchinese; /* CJK ideographs */
+	guint nspecial; /* Letters of other scripts */
+};
+
 struct rspamd_mime_text_part {
 	const gchar *language;
 	GPtrArray *languages;
@@ -159,6 +166,7 @@ struct rspamd_mime_text_part {
 	guint capital_letters;
 	guint numeric_characters;
 	guint unicode_scripts;
+	struct rspamd_mime_text_part_features features;
 };
 
 struct rspamd_message_raw_headers_content {
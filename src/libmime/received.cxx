@@ -550,11 +550,12 @@ received_process_host_tcpinfo(rspamd_mempool_t *pool,
 }
 
 static void
-received_process_from(rspamd_mempool_t *pool,
-					  const received_part &rpart,
-					  received_header &rh)
+received_process_from_data(rspamd_mempool_t *pool,
+						   const std::string_view &data,
+						   const std::string_view *first_comment,
+						   received_header &rh)
 {
-	if (rpart.data.size() > 0) {
+	if (data.size() > 0) {
 		/* We have seen multiple cases:
 		 * - [ip] (hostname/unknown [real_ip])
 		 * - helo (hostname/unknown [real_ip])
@@ -565,18 +566,18 @@ received_process_from(rspamd_mempool_t *pool,
 		 */
 		auto seen_ip_in_data = false;
 
-		if (!rpart.comments.empty()) {
+		if (first_comment) {
 			/* We can have info within comment as part of RFC */
 			received_process_host_tcpinfo(
 					pool, rh,
-					rpart.comments[0].as_view());
+					*first_comment);
 		}
 
 		if (rh.real_ip.size() == 0) {
 			/* Try to do the same with data */
 			if (received_process_host_tcpinfo(
 					pool, rh,
-					rpart.data.as_view())) {
+					data)) {
 				seen_ip_in_data = true;
 			}
 		}
@@ -585,25 +586,250 @@ received_process_from(rspamd_mempool_t *pool,
 			if (rh.real_ip.size() != 0) {
 				/* Get announced hostname (usually helo) */
 				received_process_rdns(pool,
-						rpart.data.as_view(),
+						data,
 						rh.from_hostname);
 			}
 			else {
 				received_process_host_tcpinfo(pool,
-						rh, rpart.data.as_view());
+						rh, data);
 			}
 		}
 	}
 	else {
 		/* rpart->dlen = 0 */
-		if (!rpart.comments.empty()) {
+		if (first_comment) {
 			received_process_host_tcpinfo(
 					pool, rh,
-					rpart.comments[0].as_view());
+					*first_comment);
 		}
 	}
 }
 
+static void
+received_process_from(rspamd_mempool_t *pool,
+					  const received_part &rpart,
+					  received_header &rh)
+{
+	if (!rpart.comments.empty()) {
+		auto first_comment = rpart.comments[0].as_view();
+		received_process_from_data(pool, rpart.data.as_view(), &first_comment, rh);
+	}
+	else {
+		received_process_from_data(pool, rpart.data.as_view(), nullptr, rh);
+	}
+}
+
+/*
+ * Fast path for the most common layout used by Postfix, Sendmail, Gmail and
+ * many others:
+ * from helo (rdns [ip]) [(comments)] by host [(comments)]
+ *   [with proto] [id id] [for <rcpt>] [(comments)]; date
+ * Input must be lowercased already. If anything is unusual, we return false
+ * and the generic parser is used, so the results are always the same.
+ */
+struct received_fast_parts {
+	std::string_view from;
+	std::string_view from_comment;
+	std::string_view by;
+	std::string_view with;
+	std::string_view for_part;
+	std::ptrdiff_t date_pos = -1;
+};
+
+static auto
+received_fast_spill(const std::string_view &in, received_fast_parts &res) -> bool
+{
+	const auto *p = in.data();
+	const auto *end = p + in.size();
+
+	auto skip_spaces = [&]() {
+		while (p < end && g_ascii_isspace(*p)) {
+			p++;
+		}
+	};
+	/* Reads a token up to a space, comment or date delimiter */
+	auto read_token = [&](std::string_view &out) -> bool {
+		const auto *c = p;
+
+		while (p < end && !g_ascii_isspace(*p) && *p != '(' && *p != ';') {
+			if (*p == ')') {
+				return false;
+			}
+			p++;
+		}
+
+		if (p == c) {
+			return false;
+		}
+
+		out = std::string_view{c, (std::size_t)(p - c)};
+
+		return true;
+	};
+	/* Skips balanced comments, returns false on unbalanced ones */
+	auto skip_comments = [&]() -> bool {
+		skip_spaces();
+
+		while (p < end && *p == '(') {
+			auto depth = 0;
+
+			do {
+				if (*p == '(') {
+					depth++;
+				}
+				else if (*p == ')') {
+					depth--;
+				}
+				p++;
+			} while (p < end && depth > 0);
+
+			if (depth > 0) {
+				return false;
+			}
+
+			skip_spaces();
+		}
+
+		return true;
+	};
+	auto keyword = [&](const std::string_view &kw) -> bool {
+		if ((std::size_t)(end - p) > kw.size() && memcmp(p, kw.data(), kw.size()) == 0 &&
+			g_ascii_isspace(p[kw.size()])) {
+			p += kw.size();
+			skip_spaces();
+
+			return true;
+		}
+
+		return false;
+	};
+
+	skip_spaces();
+
+	if (!keyword("from") || !read_token(res.from)) {
+		return false;
+	}
+
+	skip_spaces();
+
+	if (p == end || *p != '(') {
+		return false;
+	}
+
+	/* The first comment must be flat: (rdns [ip]) */
+	const auto *c = ++p;
+
+	while (p < end && *p != ')') {
+		if (*p == '(' || (*p != ' ' && g_ascii_isspace(*p))) {
+			return false;
+		}
+		p++;
+	}
+
+	if (p == end) {
+		return false;
+	}
+
+	res.from_comment = std::string_view{c, (std::size_t)(p - c)};
+
+	while (!res.from_comment.empty() && res.from_comment.front() == ' ') {
+		res.from_comment.remove_prefix(1);
+	}
+	while (!res.from_comment.empty() && res.from_comment.back() == ' ') {
+		res.from_comment.remove_suffix(1);
+	}
+
+	if (res.from_comment.empty() || res.from_comment.find('[') == std::string_view::npos) {
+		return false;
+	}
+
+	p++;
+
+	if (!skip_comments() || !keyword("by") || !read_token(res.by)) {
+		return false;
+	}
+
+	while (p < end) {
+		if (!skip_comments()) {
+			return false;
+		}
+
+		if (p == end) {
+			break;
+		}
+
+		if (*p == ';') {
+			res.date_pos = p - in.data() + 1;
+
+			return true;
+		}
+
+		std::string_view *dest;
+
+		if (keyword("with")) {
+			dest = &res.with;
+		}
+		else if (keyword("for")) {
+			dest = &res.for_part;
+		}
+		else if (keyword("id")) {
+			std::string_view id;
+
+			if (!read_token(id)) {
+				return false;
+			}
+
+			continue;
+		}
+		else {
+			/* Unknown clause, leave it for the generic parser */
+			return false;
+		}
+
+		if (!dest->empty() || !read_token(*dest)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Copies printable ascii lowercased, returns false if anything else is found */
+static auto
+received_lowercase_ascii(const std::string_view &in, char *out) -> bool
+{
+	for (auto i = 0u; i < in.size(); i ++) {
+		auto ch = (unsigned char)in[i];
+
+		if (ch >= 0x20 && ch < 0x7f) {
+			out[i] = lc_map[ch];
+		}
+		else if (ch == '\t' || ch == '\r' || ch == '\n') {
+			out[i] = ch;
+		}
+		else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+received_header_finalize(received_header &rh, const std::string_view &in,
+						 std::ptrdiff_t date_pos)
+{
+	if (!rh.real_hostname.empty() && rh.from_hostname.empty()) {
+		rh.from_hostname.assign_copy(rh.real_hostname);
+	}
+
+	if (date_pos > 0 && date_pos < in.size()) {
+		auto date_sub = in.substr(date_pos);
+		rh.timestamp = rspamd_parse_smtp_date((const unsigned char*)date_sub.data(),
+				date_sub.size(), nullptr);
+	}
+}
+
 static auto
 received_header_parse(received_header_chain &chain, rspamd_mempool_t *pool,
 					  const std::string_view &in,
@@ -631,6 +857,40 @@ received_header_parse(received_header_chain &chain, rspamd_mempool_t *pool,
 			{"local",   received_flags::LOCAL}
 	});
 
+	/* Most of received headers are short, so we can lowercase them on stack */
+	char lc_buf[1024];
+	received_fast_parts fast_parts;
+
+	if (in.size() <= sizeof(lc_buf) && received_lowercase_ascii(in, lc_buf) &&
+		received_fast_spill(std::string_view{lc_buf, in.size()}, fast_parts)) {
+		auto &rh = chain.new_received();
+
+		rh.flags = received_flags::UNKNOWN;
+		rh.hdr = hdr;
+
+		received_process_from_data(pool, fast_parts.from,
+				&fast_parts.from_comment, rh);
+		received_process_rdns(pool, fast_parts.by, rh.by_hostname);
+
+		if (!fast_parts.with.empty()) {
+			auto proto_flag_it = protos_map.find(fast_parts.with);
+
+			if (proto_flag_it != protos_map.end()) {
+				rh.flags = proto_flag_it->second;
+			}
+		}
+
+		if (!fast_parts.for_part.empty()) {
+			rh.for_mbox.assign_copy(fast_parts.for_part);
+			rh.for_addr = rspamd_email_address_from_smtp(rh.for_mbox.data(),
+					rh.for_mbox.size());
+		}
+
+		received_header_finalize(rh, in, fast_parts.date_pos);
+
+		return true;
+	}
+
 	auto parts = received_spill(in, date_pos);
 
 	if (parts.empty()) {
@@ -672,15 +932,7 @@ received_header_parse(received_header_chain &chain, rspamd_mempool_t *pool,
 		}
 	}
 
-	if (!rh.real_hostname.empty() && rh.from_hostname.empty()) {
-		rh.from_hostname.assign_copy(rh.real_hostname);
-	}
-
-	if (date_pos > 0 && date_pos < in.size()) {
-		auto date_sub = in.substr(date_pos);
-		rh.timestamp = rspamd_parse_smtp_date((const unsigned char*)date_sub.data(),
-				date_sub.size(), nullptr);
-	}
+	received_header_finalize(rh, in, date_pos);
 
 	return true;
 }
@@ -1009,6 +1261,54 @@ TEST_CASE("parse received")
 							{"by_hostname", "pbx.xxx.com"},
 					}
 			},
+			// Common layout parsed by the fast path
+			{"from mail.example.com (mail.example.com [192.0.2.1])\n"
+			 "\t(using TLSv1.3 with cipher TLS_AES_256_GCM_SHA384 (256/256 bits)\n"
+			 "\t key-exchange X25519 server-signature RSA-PSS (2048 bits))\n"
+			 "\t(No client certificate requested)\n"
+			 "\tby mx.example.org (Postfix) with ESMTPS id 4LxYz12abc\n"
+			 "\tfor <User@Example.org>; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					{
+							{"real_ip", "192.0.2.1"},
+							{"from_hostname", "mail.example.com"},
+							{"real_hostname", "mail.example.com"},
+							{"by_hostname", "mx.example.org"},
+							{"for_mbox", "<user@example.org>"},
+					}
+			},
+			// Fast path, unknown rdns and uppercase by
+			{"from [192.0.2.5] (unknown [192.0.2.5]) by MX.example.org (Postfix) "
+			 "with ESMTPSA id 1234; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					{
+							{"real_ip", "192.0.2.5"},
+							{"from_hostname", "192.0.2.5"},
+							{"by_hostname", "mx.example.org"},
+					}
+			},
+			// Fast path, Gmail with comment after for
+			{"from mail-sor-f41.google.com (mail-sor-f41.google.com. [209.85.220.41])\n"
+			 "        by mx.google.com with SMTPS id x12sor1234\n"
+			 "        for <user@example.com> (Google Transport Security);\n"
+			 "        Tue, 02 Aug 2022 03:04:05 -0700 (PDT)"sv,
+					{
+							{"real_ip", "209.85.220.41"},
+							{"from_hostname", "mail-sor-f41.google.com"},
+							{"real_hostname", "mail-sor-f41.google.com."},
+							{"by_hostname", "mx.google.com"},
+							{"for_mbox", "<user@example.com>"},
+					}
+			},
+			// Exim helo comment falls back to the generic parser
+			{"from [192.0.2.7] (helo=host.example.net)\n"
+			 "\tby mail.example.org with esmtp (Exim 4.94)\n"
+			 "\t(envelope-from <a@example.net>)\n"
+			 "\tid 1oIa-0001; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					{
+							{"real_ip", "192.0.2.7"},
+							{"from_hostname", "192.0.2.7"},
+							{"by_hostname", "mail.example.org"},
+					}
+			},
 	};
 	rspamd_mempool_t *pool = rspamd_mempool_new_default("rcvd test", 0);
 
@@ -1035,4 +1335,68 @@ TEST_CASE("parse received")
 
 	rspamd_mempool_delete(pool);
 }
+TEST_CASE("parse received proto and date")
+{
+	using namespace std::string_view_literals;
+	using rspamd::mime::received_flags;
+	struct received_case {
+		std::string_view in;
+		received_flags flags;
+		time_t timestamp;
+	};
+	std::vector<received_case> cases{
+			// Fast path
+			{"from mail.example.com (mail.example.com [192.0.2.1])\n"
+			 "\t(using TLSv1.3 with cipher TLS_AES_256_GCM_SHA384 (256/256 bits))\n"
+			 "\tby mx.example.org (Postfix) with ESMTPS id 4LxYz12abc\n"
+			 "\tfor <User@Example.org>; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					received_flags::ESMTPS | received_flags::SSL,
+					1659348000
+			},
+			{"from [192.0.2.5] (unknown [192.0.2.5]) by MX.example.org (Postfix) "
+			 "with ESMTPSA id 1234; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					received_flags::ESMTPSA | received_flags::SSL |
+					received_flags::AUTHENTICATED,
+					1659348000
+			},
+			// Unknown proto
+			{"from mail-sor-f41.google.com (mail-sor-f41.google.com. [209.85.220.41])\n"
+			 "        by mx.google.com with SMTPS id x12sor1234\n"
+			 "        for <user@example.com> (Google Transport Security);\n"
+			 "        Tue, 02 Aug 2022 03:04:05 -0700 (PDT)"sv,
+					received_flags::UNKNOWN,
+					1659434645
+			},
+			// Generic parser
+			{"from [192.0.2.7] (helo=host.example.net)\n"
+			 "\tby mail.example.org with esmtp (Exim 4.94)\n"
+			 "\t(envelope-from <a@example.net>)\n"
+			 "\tid 1oIa-0001; Mon, 1 Aug 2022 10:00:00 +0000"sv,
+					received_flags::ESMTP,
+					1659348000
+			},
+			// No date
+			{"from [127.0.0.1] ([127.0.0.2]) by smtp.gmail.com with ESMTPSA id xxxololo"sv,
+					received_flags::ESMTPSA | received_flags::SSL |
+					received_flags::AUTHENTICATED,
+					0
+			},
+	};
+	rspamd_mempool_t *pool = rspamd_mempool_new_default("rcvd test", 0);
+
+	for (auto &&c : cases) {
+		SUBCASE(c.in.data()) {
+			rspamd::mime::received_header_chain chain;
+			auto ret = rspamd::mime::received_header_parse(chain, pool,
+					c.in, nullptr);
+			CHECK(ret == true);
+			auto &&rh = chain.get_received(0);
+			CHECK(rh.has_value());
+			CHECK(rh.value().get().flags == c.flags);
+			CHECK(rh.value().get().timestamp == c.timestamp);
+		}
+	}
+
+	rspamd_mempool_delete(pool);
+}
 }
\ No newline at end of file
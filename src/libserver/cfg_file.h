@@ -224,6 +224,8 @@ struct rspamd_worker_conf {
 	GQuark type;                                    /**< type of worker										*/
 	struct rspamd_worker_bind_conf *bind_conf;      /**< bind configuration									*/
 	gint16 count;                                   /**< number of workers									*/
+	gint16 min_count;                               /**< minimum number of workers for autoscaling			*/
+	gint16 max_count;                               /**< maximum number of workers for autoscaling (0 - off)	*/
 	GList *listen_socks;                            /**< listening sockets descriptors						*/
 	guint64 rlimit_nofile;                          /**< max files limit									*/
 	guint64 rlimit_maxcore;                         /**< maximum core file size								*/
@@ -390,6 +392,11 @@ struct rspamd_config {
 	gint default_max_shots;                         /**< default maximum count of symbols hits permitted (-1 for unlimited) */
 	gint32 heartbeats_loss_max;                     /**< number of heartbeats lost to consider worker's termination */
 	gdouble heartbeat_interval;                     /**< interval for heartbeats for workers				*/
+	gdouble autoscale_interval;                     /**< interval between workers autoscaling decisions		*/
+	gdouble autoscale_high_load;                    /**< average cpu load to spawn one more worker			*/
+	gdouble autoscale_low_load;                     /**< average cpu load to retire one worker				*/
+	gdouble autoscale_max_lag;                      /**< average loop lag to spawn one more worker			*/
+	guint autoscale_max_queue;                      /**< average tasks in progress to spawn one more worker	*/
 
 	enum rspamd_log_type log_type;                  /**< log type											*/
 	gint log_facility;                              /**< log facility in case of syslog						*/
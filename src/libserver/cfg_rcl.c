@@ -2126,6 +2126,36 @@ rspamd_rcl_config_init (struct rspamd_config *cfg, GHashTable *skip_sections)
 				RSPAMD_CL_FLAG_INT_32,
 				"Maximum count of heartbeats to be lost before trying to "
 				"terminate a worker (default: 0 - disabled)");
+		rspamd_rcl_add_default_handler (sub,
+				"autoscale_interval",
+				rspamd_rcl_parse_struct_time,
+				G_STRUCT_OFFSET (struct rspamd_config, autoscale_interval),
+				RSPAMD_CL_FLAG_TIME_FLOAT,
+				"Time between workers autoscaling decisions (default: 60s)");
+		rspamd_rcl_add_default_handler (sub,
+				"autoscale_high_load",
+				rspamd_rcl_parse_struct_double,
+				G_STRUCT_OFFSET (struct rspamd_config, autoscale_high_load),
+				0,
+				"Average cpu load of workers to spawn a new worker (default: 0.75)");
+		rspamd_rcl_add_default_handler (sub,
+				"autoscale_low_load",
+				rspamd_rcl_parse_struct_double,
+				G_STRUCT_OFFSET (struct rspamd_config, autoscale_low_load),
+				0,
+				"Average cpu load of workers to retire a worker (default: 0.25)");
+		rspamd_rcl_add_default_handler (sub,
+				"autoscale_max_lag",
+				rspamd_rcl_parse_struct_time,
+				G_STRUCT_OFFSET (struct rspamd_config, autoscale_max_lag),
+				RSPAMD_CL_FLAG_TIME_FLOAT,
+				"Average event loop lag of workers to spawn a new worker (default: 0.5s)");
+		rspamd_rcl_add_default_handler (sub,
+				"autoscale_max_queue",
+				rspamd_rcl_parse_struct_integer,
+				G_STRUCT_OFFSET (struct rspamd_config, autoscale_max_queue),
+				RSPAMD_CL_FLAG_UINT,
+				"Average number of tasks in progress per worker to spawn a new worker (default: 32)");
 		rspamd_rcl_add_default_handler (sub,
 				"max_lua_urls",
 				rspamd_rcl_parse_struct_integer,
@@ -2326,6 +2356,18 @@ rspamd_rcl_config_init (struct rspamd_config *cfg, GHashTable *skip_sections)
 				G_STRUCT_OFFSET (struct rspamd_worker_conf, count),
 				RSPAMD_CL_FLAG_INT_16,
 				"Number of workers to spawn");
+		rspamd_rcl_add_default_handler (sub,
+				"min_count",
+				rspamd_rcl_parse_struct_integer,
+				G_STRUCT_OFFSET (struct rspamd_worker_conf, min_count),
+				RSPAMD_CL_FLAG_INT_16,
+				"Minimum number of workers when autoscaling is enabled");
+		rspamd_rcl_add_default_handler (sub,
+				"max_count",
+				rspamd_rcl_parse_struct_integer,
+				G_STRUCT_OFFSET (struct rspamd_worker_conf, max_count),
+				RSPAMD_CL_FLAG_INT_16,
+				"Maximum number of workers, enables autoscaling if greater than zero");
 		rspamd_rcl_add_default_handler (sub,
 				"max_files",
 				rspamd_rcl_parse_struct_integer,
@@ -3302,7 +3344,7 @@ rspamd_rcl_parse_struct_mime_addr (rspamd_mempool_t *pool,
 		if (ucl_object_type (cur) == UCL_STRING) {
 			val = ucl_object_tostring (obj);
 			tmp_addr = rspamd_email_address_from_mime (pool, val,
-					strlen (val), tmp_addr, -1);
+					strlen (val), tmp_addr, -1, RSPAMD_EMAIL_ADDR_PARSE_DEFAULT);
 		}
 		else {
 			g_set_error (err,
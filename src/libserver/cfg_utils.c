@@ -279,6 +279,11 @@ rspamd_config_new (enum rspamd_config_init_flags flags)
 	cfg->maps_cache_dir = rspamd_mempool_strdup (cfg->cfg_pool, RSPAMD_DBDIR);
 	cfg->c_modules = g_ptr_array_new ();
 	cfg->heartbeat_interval = 10.0;
+	cfg->autoscale_interval = 60.0;
+	cfg->autoscale_high_load = 0.75;
+	cfg->autoscale_low_load = 0.25;
+	cfg->autoscale_max_lag = 0.5;
+	cfg->autoscale_max_queue = 32;
 
 	cfg->enable_css_parser = true;
 
@@ -0,0 +1,224 @@
+/*-
+ * Copyright 2022 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "rspamd.h"
+#include "crypto_executor.h"
+
+#include <openssl/opensslv.h>
+
+/*
+ * Workers are already spread over all cores, so a single thread per worker is
+ * enough to keep the event loop responsive
+ */
+#define RSPAMD_CRYPTO_EXECUTOR_THREADS 1
+/* Dispatch batch before the end of loop iteration if it is large enough */
+#define RSPAMD_CRYPTO_EXECUTOR_MAX_BATCH 32
+
+struct rspamd_crypto_job {
+	rspamd_crypto_executor_work_t work;
+	rspamd_crypto_executor_fin_t fin;
+	gpointer ud;
+};
+
+struct rspamd_crypto_batch {
+	struct rspamd_crypto_executor *executor;
+	gconstpointer key;
+	GArray *jobs;
+};
+
+struct rspamd_crypto_executor {
+	struct ev_loop *loop;
+	GThreadPool *pool;
+	GAsyncQueue *done;
+	GHashTable *open_batches;
+	ev_prepare dispatch_ev;
+	ev_async done_ev;
+	guint pending;
+};
+
+static GHashTable *executors = NULL;
+
+static void
+rspamd_crypto_executor_thread (gpointer data, gpointer unused)
+{
+	struct rspamd_crypto_batch *batch = data;
+	struct rspamd_crypto_executor *executor = batch->executor;
+	struct rspamd_crypto_job *job;
+	guint i;
+
+	for (i = 0; i < batch->jobs->len; i ++) {
+		job = &g_array_index (batch->jobs, struct rspamd_crypto_job, i);
+		job->work (job->ud);
+	}
+
+	/* Batch can be freed by the loop thread as soon as it is pushed */
+	g_async_queue_push (executor->done, batch);
+	ev_async_send (executor->loop, &executor->done_ev);
+}
+
+static void
+rspamd_crypto_executor_dispatch (struct rspamd_crypto_executor *executor,
+		struct rspamd_crypto_batch *batch)
+{
+	g_hash_table_remove (executor->open_batches, batch->key);
+	g_thread_pool_push (executor->pool, batch, NULL);
+}
+
+static void
+rspamd_crypto_executor_prepare_cb (EV_P_ ev_prepare *w, int revents)
+{
+	struct rspamd_crypto_executor *executor =
+			(struct rspamd_crypto_executor *)w->data;
+	GHashTableIter it;
+	gpointer k, v;
+
+	g_hash_table_iter_init (&it, executor->open_batches);
+
+	while (g_hash_table_iter_next (&it, &k, &v)) {
+		g_thread_pool_push (executor->pool, v, NULL);
+		g_hash_table_iter_remove (&it);
+	}
+
+	ev_prepare_stop (EV_A_ w);
+}
+
+static void
+rspamd_crypto_executor_done_cb (EV_P_ ev_async *w, int revents)
+{
+	struct rspamd_crypto_executor *executor =
+			(struct rspamd_crypto_executor *)w->data;
+	struct rspamd_crypto_batch *batch;
+	struct rspamd_crypto_job *job;
+	guint i;
+
+	while ((batch = g_async_queue_try_pop (executor->done)) != NULL) {
+		for (i = 0; i < batch->jobs->len; i ++) {
+			job = &g_array_index (batch->jobs, struct rspamd_crypto_job, i);
+			executor->pending --;
+
+			if (executor->pending == 0) {
+				/* Nothing in flight, do not keep the loop alive */
+				ev_unref (EV_A);
+			}
+
+			job->fin (job->ud);
+		}
+
+		g_array_free (batch->jobs, TRUE);
+		g_free (batch);
+	}
+}
+
+struct rspamd_crypto_executor *
+rspamd_crypto_executor_get (struct ev_loop *loop)
+{
+	struct rspamd_crypto_executor *executor;
+	GError *err = NULL;
+
+	g_assert (loop != NULL);
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	/* No implicit locking in openssl, so all signing is done inline */
+	return NULL;
+#endif
+
+	if (executors == NULL) {
+		executors = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+
+	executor = g_hash_table_lookup (executors, loop);
+
+	if (executor != NULL) {
+		return executor;
+	}
+
+	executor = g_malloc0 (sizeof (*executor));
+	executor->loop = loop;
+	executor->pool = g_thread_pool_new (rspamd_crypto_executor_thread, NULL,
+			RSPAMD_CRYPTO_EXECUTOR_THREADS, TRUE, &err);
+
+	if (executor->pool == NULL) {
+		msg_err ("cannot start crypto executor threads: %e", err);
+		g_error_free (err);
+		g_free (executor);
+
+		return NULL;
+	}
+
+	executor->done = g_async_queue_new ();
+	executor->open_batches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	ev_prepare_init (&executor->dispatch_ev, rspamd_crypto_executor_prepare_cb);
+	executor->dispatch_ev.data = executor;
+	ev_async_init (&executor->done_ev, rspamd_crypto_executor_done_cb);
+	executor->done_ev.data = executor;
+	ev_async_start (loop, &executor->done_ev);
+	/* The loop is referenced only when there are jobs in flight */
+	ev_unref (loop);
+
+	g_hash_table_insert (executors, loop, executor);
+
+	return executor;
+}
+
+void
+rspamd_crypto_executor_submit (struct rspamd_crypto_executor *executor,
+		gconstpointer batch_key,
+		rspamd_crypto_executor_work_t work,
+		rspamd_crypto_executor_fin_t fin,
+		gpointer ud)
+{
+	struct rspamd_crypto_batch *batch;
+	struct rspamd_crypto_job job;
+
+	g_assert (executor != NULL);
+	g_assert (work != NULL && fin != NULL);
+
+	batch = g_hash_table_lookup (executor->open_batches, batch_key);
+
+	if (batch == NULL) {
+		batch = g_malloc0 (sizeof (*batch));
+		batch->executor = executor;
+		batch->key = batch_key;
+		batch->jobs = g_array_sized_new (FALSE, FALSE, sizeof (job), 4);
+		g_hash_table_insert (executor->open_batches, (gpointer)batch_key, batch);
+	}
+
+	job.work = work;
+	job.fin = fin;
+	job.ud = ud;
+	g_array_append_val (batch->jobs, job);
+
+	if (executor->pending == 0) {
+		ev_ref (executor->loop);
+	}
+
+	executor->pending ++;
+
+	if (batch->jobs->len >= RSPAMD_CRYPTO_EXECUTOR_MAX_BATCH) {
+		rspamd_crypto_executor_dispatch (executor, batch);
+	}
+	else if (!ev_is_active (&executor->dispatch_ev)) {
+		/* Dispatch all batches when the loop is about to block */
+		ev_prepare_start (executor->loop, &executor->dispatch_ev);
+	}
+}
+
+guint
+rspamd_crypto_executor_pending (struct rspamd_crypto_executor *executor)
+{
+	return executor->pending;
+}
@@ -0,0 +1,78 @@
+/*-
+ * Copyright 2022 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RSPAMD_CRYPTO_EXECUTOR_H
+#define RSPAMD_CRYPTO_EXECUTOR_H
+
+#include "config.h"
+#include "contrib/libev/ev.h"
+
+/**
+ * @file crypto_executor.h
+ *
+ * Executes expensive private key operations (e.g. RSA signing) outside of the
+ * event loop thread. Jobs submitted with the same batch key during one loop
+ * iteration are executed together, and completions are delivered back to the
+ * event loop.
+ *
+ * Work functions are called from a separate thread, so they must not touch
+ * anything but their own data: no logging, no memory pools, no lua.
+ */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+struct rspamd_crypto_executor;
+
+/* Called in the executor thread */
+typedef void (*rspamd_crypto_executor_work_t) (gpointer ud);
+/* Called in the event loop thread when work is done */
+typedef void (*rspamd_crypto_executor_fin_t) (gpointer ud);
+
+/**
+ * Returns executor for the specified event loop, creating it if needed (so
+ * threads are started in the process that uses them, after fork)
+ * @param loop
+ * @return
+ */
+struct rspamd_crypto_executor *rspamd_crypto_executor_get (struct ev_loop *loop);
+
+/**
+ * Submits job to the executor
+ * @param executor
+ * @param batch_key jobs with the same key (e.g. private key) are batched
+ * @param work work function
+ * @param fin completion function
+ * @param ud user data for both functions
+ */
+void rspamd_crypto_executor_submit (struct rspamd_crypto_executor *executor,
+		gconstpointer batch_key,
+		rspamd_crypto_executor_work_t work,
+		rspamd_crypto_executor_fin_t fin,
+		gpointer ud);
+
+/**
+ * Returns number of jobs submitted but not finished yet
+ * @param executor
+ * @return
+ */
+guint rspamd_crypto_executor_pending (struct rspamd_crypto_executor *executor);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
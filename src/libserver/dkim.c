@@ -21,6 +21,7 @@
 #include "utlist.h"
 #include "unix-std.h"
 #include "mempool_vars_internal.h"
+#include "crypto_executor.h"
 
 #include <openssl/evp.h>
 #include <openssl/rsa.h>
@@ -3302,21 +3303,22 @@ rspamd_create_dkim_sign_context (struct rspamd_task *task,
 }
 
 
-GString *
-rspamd_dkim_sign (struct rspamd_task *task, const gchar *selector,
+/*
+ * Builds signature header up to the `b=` tag and computes the digest to sign
+ */
+static GString *
+rspamd_dkim_sign_prepare (struct rspamd_task *task, const gchar *selector,
 		const gchar *domain, time_t expire, gsize len, guint idx,
-		const gchar *arc_cv, rspamd_dkim_sign_context_t *ctx)
+		const gchar *arc_cv, rspamd_dkim_sign_context_t *ctx,
+		guchar *raw_digest, gsize *digest_len)
 {
 	GString *hdr;
 	struct rspamd_dkim_header *dh;
 	const gchar *body_end, *body_start, *hname;
-	guchar raw_digest[EVP_MAX_MD_SIZE];
 	struct rspamd_dkim_cached_hash *cached_bh = NULL;
 	gsize dlen = 0;
 	guint i, j;
 	gchar *b64_data;
-	guchar *sig_buf;
-	guint sig_len;
 	guint headers_len = 0, cur_len = 0;
 	union rspamd_dkim_header_stat hstat;
 
@@ -3468,10 +3470,12 @@ rspamd_dkim_sign (struct rspamd_task *task, const gchar *selector,
 
 	if (ctx->common.type != RSPAMD_DKIM_ARC_SEAL) {
 		if (!cached_bh->digest_normal) {
-			EVP_DigestFinal_ex (ctx->common.body_hash, raw_digest, NULL);
+			guchar body_digest[EVP_MAX_MD_SIZE];
+
+			EVP_DigestFinal_ex (ctx->common.body_hash, body_digest, NULL);
 			cached_bh->digest_normal = rspamd_mempool_alloc (task->task_pool,
-					sizeof (raw_digest));
-			memcpy (cached_bh->digest_normal, raw_digest, sizeof (raw_digest));
+					sizeof (body_digest));
+			memcpy (cached_bh->digest_normal, body_digest, sizeof (body_digest));
 		}
 
 
@@ -3517,33 +3521,52 @@ rspamd_dkim_sign (struct rspamd_task *task, const gchar *selector,
 				(gint)hdr->len, hdr->str);
 	}
 
-	dlen = EVP_MD_CTX_size (ctx->common.headers_hash);
+	*digest_len = EVP_MD_CTX_size (ctx->common.headers_hash);
 	EVP_DigestFinal_ex (ctx->common.headers_hash, raw_digest, NULL);
-	if (ctx->key->type == RSPAMD_DKIM_KEY_RSA) {
-		sig_len = RSA_size (ctx->key->key.key_rsa);
-		sig_buf = g_alloca (sig_len);
 
-		if (RSA_sign (NID_sha256, raw_digest, dlen, sig_buf, &sig_len,
-				ctx->key->key.key_rsa) != 1) {
-			g_string_free (hdr, TRUE);
-			msg_err_task ("rsa sign error: %s",
-					ERR_error_string (ERR_get_error (), NULL));
+	return hdr;
+}
 
-			return NULL;
-		}
-	} else if (ctx->key->type == RSPAMD_DKIM_KEY_EDDSA) {
-		sig_len = rspamd_cryptobox_signature_bytes (RSPAMD_CRYPTOBOX_MODE_25519);
-		sig_buf = g_alloca (sig_len);
+static guint
+rspamd_dkim_sign_len (rspamd_dkim_sign_key_t *key)
+{
+	if (key->type == RSPAMD_DKIM_KEY_RSA) {
+		return RSA_size (key->key.key_rsa);
+	}
+	else if (key->type == RSPAMD_DKIM_KEY_EDDSA) {
+		return rspamd_cryptobox_signature_bytes (RSPAMD_CRYPTOBOX_MODE_25519);
+	}
 
-		rspamd_cryptobox_sign (sig_buf, NULL, raw_digest, dlen,
-				ctx->key->key.key_eddsa, RSPAMD_CRYPTOBOX_MODE_25519);
-	} else {
-		g_string_free (hdr, TRUE);
-		msg_err_task ("unsupported key type for signing");
+	return 0;
+}
 
-		return NULL;
+/*
+ * Uses neither task nor logger, so it can be called from the crypto executor
+ */
+static gboolean
+rspamd_dkim_sign_digest (rspamd_dkim_sign_key_t *key,
+		const guchar *digest, gsize dlen, guchar *sig_buf, guint *sig_len)
+{
+	if (key->type == RSPAMD_DKIM_KEY_RSA) {
+		return RSA_sign (NID_sha256, digest, dlen, sig_buf, sig_len,
+				key->key.key_rsa) == 1;
+	}
+	else if (key->type == RSPAMD_DKIM_KEY_EDDSA) {
+		rspamd_cryptobox_sign (sig_buf, NULL, digest, dlen,
+				key->key.key_eddsa, RSPAMD_CRYPTOBOX_MODE_25519);
+
+		return TRUE;
 	}
 
+	return FALSE;
+}
+
+static void
+rspamd_dkim_sign_append (struct rspamd_task *task, GString *hdr,
+		const guchar *sig_buf, guint sig_len)
+{
+	gchar *b64_data;
+
 	if (task->protocol_flags & RSPAMD_TASK_PROTOCOL_FLAG_MILTER) {
 		b64_data = rspamd_encode_base64_fold (sig_buf, sig_len, 70, NULL,
 				RSPAMD_TASK_NEWLINES_LF);
@@ -3555,10 +3578,185 @@ rspamd_dkim_sign (struct rspamd_task *task, const gchar *selector,
 
 	rspamd_printf_gstring (hdr, "%s", b64_data);
 	g_free (b64_data);
+}
+
+static void
+rspamd_dkim_sign_log_error (struct rspamd_task *task,
+		rspamd_dkim_sign_key_t *key, unsigned long ssl_err)
+{
+	if (key->type == RSPAMD_DKIM_KEY_RSA) {
+		msg_err_task ("rsa sign error: %s",
+				ERR_error_string (ssl_err, NULL));
+	}
+	else {
+		msg_err_task ("unsupported key type for signing");
+	}
+}
+
+GString *
+rspamd_dkim_sign (struct rspamd_task *task, const gchar *selector,
+		const gchar *domain, time_t expire, gsize len, guint idx,
+		const gchar *arc_cv, rspamd_dkim_sign_context_t *ctx)
+{
+	GString *hdr;
+	guchar raw_digest[EVP_MAX_MD_SIZE];
+	gsize dlen = 0;
+	guchar *sig_buf;
+	guint sig_len;
+
+	g_assert (ctx != NULL);
+
+	hdr = rspamd_dkim_sign_prepare (task, selector, domain, expire, len, idx,
+			arc_cv, ctx, raw_digest, &dlen);
+
+	if (hdr == NULL) {
+		return NULL;
+	}
+
+	sig_len = rspamd_dkim_sign_len (ctx->key);
+	sig_buf = g_alloca (MAX (sig_len, 1));
+
+	if (!rspamd_dkim_sign_digest (ctx->key, raw_digest, dlen, sig_buf,
+			&sig_len)) {
+		rspamd_dkim_sign_log_error (task, ctx->key, ERR_get_error ());
+		g_string_free (hdr, TRUE);
+
+		return NULL;
+	}
+
+	rspamd_dkim_sign_append (task, hdr, sig_buf, sig_len);
 
 	return hdr;
 }
 
+struct rspamd_dkim_sign_job {
+	struct rspamd_task *task; /* NULL if task has been destroyed */
+	rspamd_dkim_sign_key_t *key;
+	GString *hdr;
+	rspamd_dkim_sign_async_cb cb;
+	gpointer ud;
+	guchar digest[EVP_MAX_MD_SIZE];
+	gsize digest_len;
+	guchar *sig;
+	guint sig_len;
+	unsigned long ssl_err;
+	gboolean success;
+};
+
+static void
+rspamd_dkim_sign_job_work (gpointer ud)
+{
+	struct rspamd_dkim_sign_job *job = (struct rspamd_dkim_sign_job *)ud;
+
+	job->success = rspamd_dkim_sign_digest (job->key, job->digest,
+			job->digest_len, job->sig, &job->sig_len);
+
+	if (!job->success) {
+		/* Openssl errors queue is thread local */
+		job->ssl_err = ERR_get_error ();
+	}
+}
+
+static void
+rspamd_dkim_sign_job_session_fin (gpointer ud)
+{
+	struct rspamd_dkim_sign_job *job = (struct rspamd_dkim_sign_job *)ud;
+
+	/* Called on job completion or when task is destroyed */
+	job->task = NULL;
+}
+
+static void
+rspamd_dkim_sign_job_fin (gpointer ud)
+{
+	struct rspamd_dkim_sign_job *job = (struct rspamd_dkim_sign_job *)ud;
+	struct rspamd_task *task = job->task;
+	GString *hdr = job->hdr;
+
+	job->hdr = NULL;
+
+	if (task != NULL) {
+		if (job->success) {
+			rspamd_dkim_sign_append (task, hdr, job->sig, job->sig_len);
+		}
+		else {
+			rspamd_dkim_sign_log_error (task, job->key, job->ssl_err);
+			g_string_free (hdr, TRUE);
+			hdr = NULL;
+		}
+
+		job->cb (task, hdr, job->ud);
+		rspamd_session_remove_event (task->s, rspamd_dkim_sign_job_session_fin,
+				job);
+	}
+	else {
+		/* Task is gone, just let the caller free its data */
+		g_string_free (hdr, TRUE);
+		job->cb (NULL, NULL, job->ud);
+	}
+
+	rspamd_dkim_sign_key_unref (job->key);
+	g_free (job->sig);
+	g_free (job);
+}
+
+gboolean
+rspamd_dkim_sign_async (struct rspamd_task *task, const gchar *selector,
+		const gchar *domain, time_t expire, gsize len, guint idx,
+		const gchar *arc_cv, rspamd_dkim_sign_context_t *ctx,
+		rspamd_dkim_sign_async_cb cb, gpointer ud)
+{
+	struct rspamd_dkim_sign_job *job;
+	struct rspamd_crypto_executor *executor = NULL;
+	GString *hdr;
+
+	g_assert (ctx != NULL);
+	g_assert (cb != NULL);
+
+	if (task->event_loop && !rspamd_session_blocked (task->s)) {
+		executor = rspamd_crypto_executor_get (task->event_loop);
+	}
+
+	if (executor == NULL) {
+		/* Sign inline */
+		hdr = rspamd_dkim_sign (task, selector, domain, expire, len, idx,
+				arc_cv, ctx);
+
+		if (hdr == NULL) {
+			return FALSE;
+		}
+
+		cb (task, hdr, ud);
+
+		return TRUE;
+	}
+
+	job = g_malloc0 (sizeof (*job));
+	job->hdr = rspamd_dkim_sign_prepare (task, selector, domain, expire, len,
+			idx, arc_cv, ctx, job->digest, &job->digest_len);
+
+	if (job->hdr == NULL) {
+		g_free (job);
+
+		return FALSE;
+	}
+
+	job->task = task;
+	job->key = rspamd_dkim_sign_key_ref (ctx->key);
+	job->cb = cb;
+	job->ud = ud;
+	job->sig_len = rspamd_dkim_sign_len (ctx->key);
+	job->sig = g_malloc (MAX (job->sig_len, 1));
+
+	rspamd_session_add_event (task->s, rspamd_dkim_sign_job_session_fin, job,
+			"dkim sign");
+	/* Signatures made with the same key are batched */
+	rspamd_crypto_executor_submit (executor, job->key,
+			rspamd_dkim_sign_job_work, rspamd_dkim_sign_job_fin, job);
+
+	return TRUE;
+}
+
 gboolean
 rspamd_dkim_match_keys (rspamd_dkim_key_t *pk,
 								 rspamd_dkim_sign_key_t *sk,
@@ -241,6 +241,33 @@ GString *rspamd_dkim_sign (struct rspamd_task *task,
 						   const gchar *arc_cv,
 						   rspamd_dkim_sign_context_t *ctx);
 
+/**
+ * Callback for asynchronous signing
+ * @param task task or NULL if task has been destroyed before signing is done
+ * @param hdr signature header (owned by callback) or NULL on error
+ * @param ud user data
+ */
+typedef void (*rspamd_dkim_sign_async_cb) (struct rspamd_task *task,
+										   GString *hdr,
+										   gpointer ud);
+
+/**
+ * Same as `rspamd_dkim_sign` but the private key operation is performed by
+ * the crypto executor, so it does not block the event loop. Headers are
+ * canonicalised immediately.
+ * @return FALSE if signing cannot be started (callback is not called then)
+ */
+gboolean rspamd_dkim_sign_async (struct rspamd_task *task,
+								 const gchar *selector,
+								 const gchar *domain,
+								 time_t expire,
+								 gsize len,
+								 guint idx,
+								 const gchar *arc_cv,
+								 rspamd_dkim_sign_context_t *ctx,
+								 rspamd_dkim_sign_async_cb cb,
+								 gpointer ud);
+
 rspamd_dkim_key_t *rspamd_dkim_key_ref (rspamd_dkim_key_t *k);
 
 void rspamd_dkim_key_unref (rspamd_dkim_key_t *k);
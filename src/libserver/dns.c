@@ -51,6 +51,8 @@ static struct rdns_upstream_context rspamd_ups_ctx = {
 		.data = NULL
 };
 
+struct rspamd_dns_flight;
+
 struct rspamd_dns_request_ud {
 	struct rspamd_async_session *session;
 	dns_callback_type cb;
@@ -60,6 +62,8 @@ struct rspamd_dns_request_ud {
 	struct rspamd_symcache_dynamic_item *item;
 	struct rdns_request *req;
 	struct rdns_reply *reply;
+	struct rspamd_dns_flight *flight;
+	struct rspamd_dns_request_ud *prev, *next;
 };
 
 struct rspamd_dns_fail_cache_entry {
@@ -68,6 +72,17 @@ struct rspamd_dns_fail_cache_entry {
 	enum rdns_request_type type;
 };
 
+/*
+ * Outstanding rdns request shared by all callers that have asked for the
+ * same name and type while it is in flight
+ */
+struct rspamd_dns_flight {
+	struct rspamd_dns_fail_cache_entry key; /* Must be the first element */
+	struct rspamd_dns_resolver *resolver;
+	struct rdns_request *req;
+	struct rspamd_dns_request_ud *waiters;
+};
+
 static const gint8 ascii_dns_table[128]={
 		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -108,6 +123,25 @@ rspamd_dns_fail_equal (gconstpointer p1, gconstpointer p2)
 	return FALSE;
 }
 
+/*
+ * Called when a waiter is gone before reply: the request is cancelled
+ * merely if there are no other waiters
+ */
+static void
+rspamd_dns_flight_detach (struct rspamd_dns_request_ud *reqdata)
+{
+	struct rspamd_dns_flight *flight = reqdata->flight;
+
+	DL_DELETE (flight->waiters, reqdata);
+	reqdata->flight = NULL;
+
+	if (flight->waiters == NULL) {
+		g_hash_table_remove (flight->resolver->inflight, &flight->key);
+		rdns_request_release (flight->req);
+		g_free (flight);
+	}
+}
+
 static void
 rspamd_dns_fin_cb (gpointer arg)
 {
@@ -132,7 +166,12 @@ rspamd_dns_fin_cb (gpointer arg)
 		reqdata->cb (&fake_reply, reqdata->ud);
 	}
 
-	rdns_request_release (reqdata->req);
+	if (reqdata->flight) {
+		rspamd_dns_flight_detach (reqdata);
+	}
+	else {
+		rdns_request_release (reqdata->req);
+	}
 
 	if (reqdata->item) {
 		rspamd_symcache_item_async_dec_check (reqdata->task,
@@ -196,6 +235,24 @@ rspamd_dns_callback (struct rdns_reply *reply, gpointer ud)
 	}
 }
 
+static void
+rspamd_dns_flight_callback (struct rdns_reply *reply, gpointer ud)
+{
+	struct rspamd_dns_flight *flight = ud;
+	struct rspamd_dns_request_ud *reqdata;
+
+	/* New requests for the same name must not join this flight anymore */
+	g_hash_table_remove (flight->resolver->inflight, &flight->key);
+
+	while ((reqdata = flight->waiters) != NULL) {
+		DL_DELETE (flight->waiters, reqdata);
+		reqdata->flight = NULL;
+		rspamd_dns_callback (reply, reqdata);
+	}
+
+	g_free (flight);
+}
+
 struct rspamd_dns_request_ud *
 rspamd_dns_resolver_request (struct rspamd_dns_resolver *resolver,
 							 struct rspamd_async_session *session,
@@ -207,6 +264,8 @@ rspamd_dns_resolver_request (struct rspamd_dns_resolver *resolver,
 {
 	struct rdns_request *req;
 	struct rspamd_dns_request_ud *reqdata = NULL;
+	struct rspamd_dns_flight *flight;
+	struct rspamd_dns_fail_cache_entry search;
 	guint nlen = strlen (name);
 	gchar *real_name = NULL;
 
@@ -262,9 +321,44 @@ rspamd_dns_resolver_request (struct rspamd_dns_resolver *resolver,
 	reqdata->cb = cb;
 	reqdata->ud = ud;
 
-	req = rdns_make_request_full (resolver->r, rspamd_dns_callback, reqdata,
-			resolver->request_timeout, resolver->max_retransmits, 1, name,
-			type);
+	search.name = name;
+	search.namelen = nlen;
+	search.type = type;
+	flight = g_hash_table_lookup (resolver->inflight, &search);
+
+	if (flight != NULL) {
+		/* Identical request is already in flight, just wait for its reply */
+		req = flight->req;
+		resolver->requests_coalesced ++;
+	}
+	else {
+		flight = g_malloc0 (sizeof (*flight) + nlen + 1);
+		flight->key.name = ((gchar *)flight) + sizeof (*flight);
+		rspamd_strlcpy ((gchar *)flight->key.name, name, nlen + 1);
+		flight->key.namelen = nlen;
+		flight->key.type = type;
+		flight->resolver = resolver;
+
+		req = rdns_make_request_full (resolver->r, rspamd_dns_flight_callback,
+				flight, resolver->request_timeout, resolver->max_retransmits, 1,
+				name, type);
+
+		if (req != NULL) {
+			flight->req = req;
+			g_hash_table_insert (resolver->inflight, &flight->key, flight);
+			resolver->requests_sent ++;
+		}
+		else {
+			g_free (flight);
+			flight = NULL;
+		}
+	}
+
+	if (req != NULL) {
+		reqdata->flight = flight;
+		DL_APPEND (flight->waiters, reqdata);
+	}
+
 	reqdata->req = req;
 
 	if (session) {
@@ -879,6 +973,8 @@ rspamd_dns_resolver_init (rspamd_logger_t *logger,
 
 	dns_resolver = g_malloc0 (sizeof (struct rspamd_dns_resolver));
 	dns_resolver->event_loop = ev_base;
+	dns_resolver->inflight = g_hash_table_new (rspamd_dns_fail_hash,
+			rspamd_dns_fail_equal);
 
 	if (cfg != NULL) {
 		dns_resolver->request_timeout = cfg->dns_timeout;
@@ -990,6 +1086,8 @@ rspamd_dns_resolver_deinit (struct rspamd_dns_resolver *resolver)
 			rspamd_lru_hash_destroy (resolver->fails_cache);
 		}
 
+		g_hash_table_unref (resolver->inflight);
+
 		uidna_close (resolver->uidna);
 
 		g_free (resolver);
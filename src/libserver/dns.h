@@ -42,6 +42,9 @@ struct rspamd_dns_resolver {
 	struct rspamd_config *cfg;
 	gdouble request_timeout;
 	guint max_retransmits;
+	GHashTable *inflight;     /* outstanding requests by name and type */
+	guint64 requests_sent;
+	guint64 requests_coalesced; /* requests merged with outstanding ones */
 };
 
 /* Rspamd DNS API */
@@ -159,26 +159,30 @@ rspamd_http_parse_key (rspamd_ftok_t *data, struct rspamd_http_connection *conn,
 			decoded_id = rspamd_decode_base32 (data->begin, eq_pos - data->begin,
 					&id_len, RSPAMD_BASE32_DEFAULT);
 
-			if (decoded_id != NULL && id_len >= RSPAMD_KEYPAIR_SHORT_ID_LEN) {
-				pk = rspamd_pubkey_from_base32 (eq_pos + 1,
-						data->begin + data->len - eq_pos - 1,
-						RSPAMD_KEYPAIR_KEX,
-						RSPAMD_CRYPTOBOX_MODE_25519);
-				if (pk != NULL) {
-					if (memcmp (rspamd_keypair_get_id (priv->local_key),
+			if (decoded_id != NULL && id_len >= RSPAMD_KEYPAIR_SHORT_ID_LEN &&
+					memcmp (rspamd_keypair_get_id (priv->local_key),
 							decoded_id,
 							RSPAMD_KEYPAIR_SHORT_ID_LEN) == 0) {
-						priv->msg->peer_key = pk;
+				if (priv->cache) {
+					/* Reuse parsed key and nm for the known peers */
+					pk = rspamd_keypair_cache_peer_key (priv->cache,
+							priv->local_key,
+							eq_pos + 1,
+							data->begin + data->len - eq_pos - 1);
+				}
+				else {
+					pk = rspamd_pubkey_from_base32 (eq_pos + 1,
+							data->begin + data->len - eq_pos - 1,
+							RSPAMD_KEYPAIR_KEX,
+							RSPAMD_CRYPTOBOX_MODE_25519);
+				}
 
-						if (priv->cache && priv->msg->peer_key) {
-							rspamd_keypair_cache_process (priv->cache,
-									priv->local_key,
-									priv->msg->peer_key);
-						}
-					}
-					else {
-						rspamd_pubkey_unref (pk);
+				if (pk != NULL) {
+					if (priv->msg->peer_key) {
+						rspamd_pubkey_unref (priv->msg->peer_key);
 					}
+
+					priv->msg->peer_key = pk;
 				}
 			}
 
@@ -1193,7 +1197,7 @@ rspamd_http_connection_new_client (struct rspamd_http_context *ctx,
 		ctx = rspamd_http_context_default ();
 	}
 
-	if (ctx->http_proxies) {
+	if (ctx->http_proxies && !(opts & RSPAMD_HTTP_CLIENT_NO_PROXY)) {
 		struct upstream *up = rspamd_upstream_get (ctx->http_proxies,
 				RSPAMD_UPSTREAM_ROUND_ROBIN, NULL, 0);
 
@@ -1244,7 +1248,8 @@ rspamd_http_connection_new_client_keepalive (struct rspamd_http_context *ctx,
 											 rspamd_http_finish_handler_t finish_handler,
 											 unsigned opts,
 											 rspamd_inet_addr_t *addr,
-											 const gchar *host)
+											 const gchar *host,
+											 const gchar *ns)
 {
 	struct rspamd_http_connection *conn;
 
@@ -1252,13 +1257,35 @@ rspamd_http_connection_new_client_keepalive (struct rspamd_http_context *ctx,
 		ctx = rspamd_http_context_default ();
 	}
 
-	conn = rspamd_http_context_check_keepalive(ctx, addr, host,
+	conn = rspamd_http_context_check_keepalive(ctx, addr, host, ns,
 			opts & RSPAMD_HTTP_CLIENT_SSL);
 
 	if (conn) {
-		struct rspamd_http_connection_private *priv;
+		struct rspamd_http_connection_private *priv = conn->priv;
+
+		/* Do not inherit anything from the previous owner */
+		if (priv->peer_key) {
+			rspamd_pubkey_unref (priv->peer_key);
+			priv->peer_key = NULL;
+		}
 
-		priv = conn->priv;
+		if (priv->local_key) {
+			rspamd_keypair_unref (priv->local_key);
+			priv->local_key = NULL;
+		}
+
+		if (ctx->client_kp) {
+			priv->local_key = rspamd_keypair_ref (ctx->client_kp);
+		}
+
+		conn->body_handler = body_handler;
+		conn->error_handler = error_handler;
+		conn->finish_handler = finish_handler;
+		conn->opts = opts|RSPAMD_HTTP_CLIENT_SIMPLE|RSPAMD_HTTP_CLIENT_KEEP_ALIVE;
+		conn->ud = NULL;
+		conn->log_tag = NULL;
+		conn->max_size = 0;
+		conn->finished = FALSE;
 
 		return conn;
 	}
@@ -1269,7 +1296,7 @@ rspamd_http_connection_new_client_keepalive (struct rspamd_http_context *ctx,
 			addr);
 
 	if (conn) {
-		rspamd_http_context_prepare_keepalive(ctx, conn, addr, host,
+		rspamd_http_context_prepare_keepalive(ctx, conn, addr, host, ns,
 				opts & RSPAMD_HTTP_CLIENT_SSL);
 	}
 
@@ -1694,6 +1721,10 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 		if (msg->method < HTTP_SYMBOLS) {
 			rspamd_ftok_t status;
 
+			if (conn->opts & RSPAMD_HTTP_SERVER_KEEP_ALIVE) {
+				conn_type = "keep-alive";
+			}
+
 			rspamd_http_date_format (datebuf, sizeof (datebuf), msg->date);
 
 			if (mime_type == NULL) {
@@ -1729,12 +1760,13 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 					meth_len =
 							rspamd_snprintf (repbuf, replen,
 									"HTTP/1.1 %d %T\r\n"
-											"Connection: close\r\n"
+											"Connection: %s\r\n"
 											"Server: %s\r\n"
 											"Date: %s\r\n"
 											"Content-Length: %z\r\n"
 											"Content-Type: %s", /* NO \r\n at the end ! */
-									msg->code, &status, priv->ctx->config.server_hdr,
+									msg->code, &status, conn_type,
+									priv->ctx->config.server_hdr,
 									datebuf,
 									bodylen, mime_type);
 				}
@@ -1742,11 +1774,12 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 					meth_len =
 							rspamd_snprintf (repbuf, replen,
 									"HTTP/1.1 %d %T\r\n"
-											"Connection: close\r\n"
+											"Connection: %s\r\n"
 											"Server: %s\r\n"
 											"Date: %s\r\n"
 											"Content-Length: %z", /* NO \r\n at the end ! */
-									msg->code, &status, priv->ctx->config.server_hdr,
+									msg->code, &status, conn_type,
+									priv->ctx->config.server_hdr,
 									datebuf,
 									bodylen);
 				}
@@ -1754,11 +1787,12 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 				/* External reply */
 				rspamd_printf_fstring (buf,
 						"HTTP/1.1 200 OK\r\n"
-						"Connection: close\r\n"
+						"Connection: %s\r\n"
 						"Server: %s\r\n"
 						"Date: %s\r\n"
 						"Content-Length: %z\r\n"
 						"Content-Type: application/octet-stream\r\n",
+						conn_type,
 						priv->ctx->config.server_hdr,
 						datebuf, enclen);
 			}
@@ -1767,12 +1801,13 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 					meth_len =
 							rspamd_printf_fstring (buf,
 									"HTTP/1.1 %d %T\r\n"
-											"Connection: close\r\n"
+											"Connection: %s\r\n"
 											"Server: %s\r\n"
 											"Date: %s\r\n"
 											"Content-Length: %z\r\n"
 											"Content-Type: %s\r\n",
-									msg->code, &status, priv->ctx->config.server_hdr,
+									msg->code, &status, conn_type,
+									priv->ctx->config.server_hdr,
 									datebuf,
 									bodylen, mime_type);
 				}
@@ -1780,11 +1815,12 @@ rspamd_http_message_write_header (const gchar* mime_type, gboolean encrypted,
 					meth_len =
 							rspamd_printf_fstring (buf,
 									"HTTP/1.1 %d %T\r\n"
-											"Connection: close\r\n"
+											"Connection: %s\r\n"
 											"Server: %s\r\n"
 											"Date: %s\r\n"
 											"Content-Length: %z\r\n",
-									msg->code, &status, priv->ctx->config.server_hdr,
+									msg->code, &status, conn_type,
+									priv->ctx->config.server_hdr,
 									datebuf,
 									bodylen);
 				}
@@ -94,6 +94,8 @@ enum rspamd_http_options {
 	RSPAMD_HTTP_REQUIRE_ENCRYPTION = 1u << 4,
 	RSPAMD_HTTP_CLIENT_KEEP_ALIVE = 1u << 5,
 	RSPAMD_HTTP_CLIENT_SSL = 1u << 6u,
+	RSPAMD_HTTP_CLIENT_NO_PROXY = 1u << 7u, /**< Do not use configured http proxies */
+	RSPAMD_HTTP_SERVER_KEEP_ALIVE = 1u << 8u, /**< Keep server connection open after reply */
 };
 
 typedef int (*rspamd_http_body_handler_t) (struct rspamd_http_connection *conn,
@@ -146,13 +148,15 @@ struct rspamd_http_connection *rspamd_http_connection_new_server (
 		unsigned opts);
 
 /**
- * Creates or reuses a new keepalive client connection identified by hostname and inet_addr
+ * Creates or reuses a new keepalive client connection identified by hostname,
+ * inet_addr and namespace; reused connection gets the handlers specified
  * @param ctx
  * @param body_handler
  * @param error_handler
  * @param finish_handler
  * @param addr
  * @param host
+ * @param ns namespace of the pool (NULL for the default one)
  * @return
  */
 struct rspamd_http_connection *rspamd_http_connection_new_client_keepalive (
@@ -162,7 +166,8 @@ struct rspamd_http_connection *rspamd_http_connection_new_client_keepalive (
 		rspamd_http_finish_handler_t finish_handler,
 		unsigned opts,
 		rspamd_inet_addr_t *addr,
-		const gchar *host);
+		const gchar *host,
+		const gchar *ns);
 
 /**
  * Creates an ordinary connection using the address specified (if proxy is not set)
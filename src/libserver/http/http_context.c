@@ -326,6 +326,10 @@ rspamd_http_context_free (struct rspamd_http_context *ctx)
 			g_free (hk->host);
 		}
 
+		if (hk->ns) {
+			g_free (hk->ns);
+		}
+
 		rspamd_inet_address_free (hk->addr);
 		rspamd_http_keepalive_queue_cleanup (&hk->conns);
 		g_free (hk);
@@ -373,6 +377,10 @@ rspamd_keep_alive_key_hash (struct rspamd_keepalive_hash_key *k)
 		rspamd_cryptobox_fast_hash_update (&hst, k->host, strlen (k->host));
 	}
 
+	if (k->ns) {
+		rspamd_cryptobox_fast_hash_update (&hst, k->ns, strlen (k->ns));
+	}
+
 	rspamd_cryptobox_fast_hash_update (&hst, &k->port, sizeof(k->port));
 	rspamd_cryptobox_fast_hash_update (&hst, &k->is_ssl, sizeof(k->is_ssl));
 
@@ -387,6 +395,12 @@ rspamd_keep_alive_key_equal (struct rspamd_keepalive_hash_key *k1,
 		return false;
 	}
 
+	if (k1->ns || k2->ns) {
+		if (!k1->ns || !k2->ns || strcmp (k1->ns, k2->ns) != 0) {
+			return false;
+		}
+	}
+
 	if (k1->host && k2->host) {
 		if (k1->port == k2->port) {
 			return strcmp (k1->host, k2->host) == 0;
@@ -400,10 +414,50 @@ rspamd_keep_alive_key_equal (struct rspamd_keepalive_hash_key *k1,
 	return false;
 }
 
+/*
+ * Checks that an idle socket is still usable: it must have no pending error,
+ * must not be closed by a peer and must have no unexpected data to read
+ * (TLS peers are allowed to send records, e.g. session tickets)
+ */
+static gint
+rspamd_http_keepalive_check_socket (gint fd, gboolean is_ssl)
+{
+	gint err = 0;
+	socklen_t len = sizeof (gint);
+	gchar c;
+	gssize r;
+
+	if (getsockopt (fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len) == -1) {
+		return errno;
+	}
+
+	if (err != 0) {
+		return err;
+	}
+
+	r = recv (fd, &c, sizeof (c), MSG_PEEK|MSG_DONTWAIT);
+
+	if (r == 0) {
+		return ECONNRESET;
+	}
+	else if (r > 0) {
+		if (!is_ssl) {
+			/* Peer should not send anything on an idle connection */
+			return EPROTO;
+		}
+	}
+	else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+		return errno;
+	}
+
+	return 0;
+}
+
 struct rspamd_http_connection *
 rspamd_http_context_check_keepalive(struct rspamd_http_context *ctx,
 									const rspamd_inet_addr_t *addr,
 									const gchar *host,
+									const gchar *ns,
 									bool is_ssl)
 {
 	struct rspamd_keepalive_hash_key hk, *phk;
@@ -415,6 +469,7 @@ rspamd_http_context_check_keepalive(struct rspamd_http_context *ctx,
 
 	hk.addr = (rspamd_inet_addr_t *)addr;
 	hk.host = (gchar *)host;
+	hk.ns = (gchar *)ns;
 	hk.port = rspamd_inet_address_get_port (addr);
 	hk.is_ssl = is_ssl;
 
@@ -429,41 +484,41 @@ rspamd_http_context_check_keepalive(struct rspamd_http_context *ctx,
 		if (g_queue_get_length (conns) > 0) {
 			struct rspamd_http_keepalive_cbdata *cbd;
 			struct rspamd_http_connection *conn;
-			gint err;
-			socklen_t len = sizeof (gint);
 
-			cbd = g_queue_pop_head (conns);
-			rspamd_ev_watcher_stop (ctx->event_loop, &cbd->ev);
-			conn = cbd->conn;
-			g_free (cbd);
+			while ((cbd = g_queue_pop_head (conns)) != NULL) {
+				gint err;
 
-			if (getsockopt (conn->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len) == -1) {
-				err = errno;
-			}
+				rspamd_ev_watcher_stop (ctx->event_loop, &cbd->ev);
+				conn = cbd->conn;
+				g_free (cbd);
+
+				err = rspamd_http_keepalive_check_socket (conn->fd, phk->is_ssl);
+
+				if (err != 0) {
+					rspamd_http_connection_unref (conn);
 
-			if (err != 0) {
-				rspamd_http_connection_unref (conn);
+					msg_debug_http_context ("invalid reused keepalive element %s (%s, ssl=%d); "
+								"%s error; "
+								"%d connections queued",
+							rspamd_inet_address_to_string_pretty (phk->addr),
+							phk->host,
+							(int)phk->is_ssl,
+							g_strerror (err),
+							conns->length);
 
-				msg_debug_http_context ("invalid reused keepalive element %s (%s, ssl=%d); "
-							"%s error; "
-							"%d connections queued",
+					/* Try the next one */
+					continue;
+				}
+
+				msg_debug_http_context ("reused keepalive element %s (%s, ssl=%d), %d connections queued",
 						rspamd_inet_address_to_string_pretty (phk->addr),
 						phk->host,
 						(int)phk->is_ssl,
-						g_strerror (err),
 						conns->length);
 
-				return NULL;
+				/* We transfer refcount here! */
+				return conn;
 			}
-
-			msg_debug_http_context ("reused keepalive element %s (%s, ssl=%d), %d connections queued",
-					rspamd_inet_address_to_string_pretty (phk->addr),
-					phk->host,
-					(int)phk->is_ssl,
-					conns->length);
-
-			/* We transfer refcount here! */
-			return conn;
 		}
 		else {
 			msg_debug_http_context ("found empty keepalive element %s (%s), cannot reuse",
@@ -489,6 +544,7 @@ rspamd_http_context_has_keepalive(struct rspamd_http_context *ctx,
 	}
 
 	hk.host = (gchar *)host;
+	hk.ns = NULL;
 	hk.port = port;
 	hk.is_ssl = is_ssl;
 
@@ -511,6 +567,7 @@ rspamd_http_context_prepare_keepalive(struct rspamd_http_context *ctx,
 									  struct rspamd_http_connection *conn,
 									  const rspamd_inet_addr_t *addr,
 									  const gchar *host,
+									  const gchar *ns,
 									  bool is_ssl)
 {
 	struct rspamd_keepalive_hash_key hk, *phk;
@@ -518,6 +575,7 @@ rspamd_http_context_prepare_keepalive(struct rspamd_http_context *ctx,
 
 	hk.addr = (rspamd_inet_addr_t *)addr;
 	hk.host = (gchar *)host;
+	hk.ns = (gchar *)ns;
 	hk.is_ssl = is_ssl;
 	hk.port = rspamd_inet_address_get_port (addr);
 
@@ -538,9 +596,12 @@ rspamd_http_context_prepare_keepalive(struct rspamd_http_context *ctx,
 		phk = g_malloc (sizeof (*phk));
 		phk->conns = empty_init;
 		phk->host = g_strdup (host);
+		phk->ns = g_strdup (ns);
 		phk->is_ssl = is_ssl;
 		phk->addr = rspamd_inet_address_copy(addr, NULL);
 		phk->port = hk.port;
+		phk->max_conns = 0;
+		phk->timeout = 0;
 
 
 		kh_put (rspamd_keep_alive_hash, ctx->keep_alive_hash, phk, &r);
@@ -552,6 +613,17 @@ rspamd_http_context_prepare_keepalive(struct rspamd_http_context *ctx,
 	}
 }
 
+void
+rspamd_http_context_set_keepalive_limits (struct rspamd_http_connection *conn,
+										  guint max_conns,
+										  gdouble timeout)
+{
+	g_assert (conn->keepalive_hash_key != NULL);
+
+	conn->keepalive_hash_key->max_conns = max_conns;
+	conn->keepalive_hash_key->timeout = timeout;
+}
+
 static void
 rspamd_http_keepalive_handler (gint fd, short what, gpointer ud)
 {
@@ -612,9 +684,14 @@ rspamd_http_context_push_keepalive (struct rspamd_http_context *ctx,
 									struct ev_loop *event_loop)
 {
 	struct rspamd_http_keepalive_cbdata *cbdata;
+	struct rspamd_keepalive_hash_key *phk = conn->keepalive_hash_key;
 	gdouble timeout = ctx->config.keepalive_interval;
 
-	g_assert (conn->keepalive_hash_key != NULL);
+	g_assert (phk != NULL);
+
+	if (phk->timeout > 0) {
+		timeout = phk->timeout;
+	}
 
 	if (msg) {
 		const rspamd_ftok_t *tok;
@@ -645,11 +722,23 @@ rspamd_http_context_push_keepalive (struct rspamd_http_context *ctx,
 			long maybe_timeout = rspamd_http_parse_keepalive_timeout(tok);
 
 			if (maybe_timeout > 0) {
-				timeout = maybe_timeout;
+				if (phk->timeout <= 0 || maybe_timeout < timeout) {
+					timeout = maybe_timeout;
+				}
 			}
 		}
 	}
 
+	if (phk->max_conns > 0 && phk->conns.length >= phk->max_conns) {
+		conn->finished = TRUE;
+		msg_debug_http_context ("do not push keepalive element %s (%s): "
+				"%d idle connections limit has been reached",
+				rspamd_inet_address_to_string_pretty (phk->addr),
+				phk->host,
+				phk->max_conns);
+		return;
+	}
+
 	/* Move connection to the keepalive pool */
 	cbdata = g_malloc0 (sizeof (*cbdata));
 
@@ -72,15 +72,17 @@ struct rspamd_http_context *rspamd_http_context_default (void);
  * @param ctx
  * @param addr
  * @param host
+ * @param ns namespace of the pool (NULL for the default one)
  * @return
  */
 struct rspamd_http_connection * rspamd_http_context_check_keepalive(struct rspamd_http_context *ctx,
 		const rspamd_inet_addr_t *addr,
 		const gchar *host,
+		const gchar *ns,
 		bool is_ssl);
 
 /**
- * Checks if there is a valid keepalive connection
+ * Checks if there is a valid keepalive connection in the default namespace
  * @param ctx
  * @param addr
  * @param host
@@ -99,9 +101,25 @@ const rspamd_inet_addr_t *rspamd_http_context_has_keepalive(struct rspamd_http_c
  * @param conn
  * @param addr
  * @param host
+ * @param ns namespace of the pool (NULL for the default one)
  */
 void rspamd_http_context_prepare_keepalive(struct rspamd_http_context *ctx, struct rspamd_http_connection *conn,
-										   const rspamd_inet_addr_t *addr, const gchar *host, bool is_ssl);
+										   const rspamd_inet_addr_t *addr, const gchar *host, const gchar *ns,
+										   bool is_ssl);
+
+/**
+ * Sets limits for the keepalive element of a connection: maximum number of
+ * idle connections to keep and an idle timeout (zero values mean no limit
+ * and the context default respectively). Limits are shared by all users of
+ * the element, so they should be set for a dedicated namespace only.
+ * Keepalive key *must* be prepared before using of this function
+ * @param conn
+ * @param max_conns
+ * @param timeout
+ */
+void rspamd_http_context_set_keepalive_limits (struct rspamd_http_connection *conn,
+											   guint max_conns,
+											   gdouble timeout);
 
 /**
  * Pushes a connection to keepalive pool after client request is finished,
@@ -86,8 +86,11 @@ struct rspamd_http_message {
 struct rspamd_keepalive_hash_key {
 	rspamd_inet_addr_t *addr;
 	gchar *host;
+	gchar *ns; /* separates pools of different users, NULL for the default one */
 	gboolean is_ssl;
 	unsigned port;
+	guint max_conns; /* 0 means no limit */
+	gdouble timeout; /* 0 means context default */
 	GQueue conns;
 };
 
@@ -683,6 +683,12 @@ rspamd_milter_process_command (struct rspamd_milter_session *session,
 
 		session->message = rspamd_fstring_append (session->message,
 				"\r\n", 2);
+
+		if (priv->eoh_cb) {
+			REF_RETAIN (session);
+			priv->eoh_cb (priv->fd, session, priv->ud);
+			REF_RELEASE (session);
+		}
 		break;
 	case RSPAMD_MILTER_CMD_OPTNEG:
 		if (cmdlen != sizeof (guint32) * 3) {
@@ -1186,6 +1192,7 @@ gboolean
 rspamd_milter_handle_socket (gint fd, ev_tstamp timeout,
 		rspamd_mempool_t *pool,
 		struct ev_loop *ev_base, rspamd_milter_finish finish_cb,
+		rspamd_milter_finish eoh_cb,
 		rspamd_milter_error error_cb, void *ud)
 {
 	struct rspamd_milter_session *session;
@@ -1209,6 +1216,7 @@ rspamd_milter_handle_socket (gint fd, ev_tstamp timeout,
 	priv->fd = nfd;
 	priv->ud = ud;
 	priv->fin_cb = finish_cb;
+	priv->eoh_cb = eoh_cb;
 	priv->err_cb = error_cb;
 	priv->parser.state = st_len_1;
 	priv->parser.buf = rspamd_fstring_sized_new (RSPAMD_MILTER_MESSAGE_CHUNK + 5);
@@ -1555,8 +1563,9 @@ rspamd_milter_macro_http (struct rspamd_milter_session *session,
 	}
 }
 
-struct rspamd_http_message *
-rspamd_milter_to_http (struct rspamd_milter_session *session)
+static struct rspamd_http_message *
+rspamd_milter_to_http_common (struct rspamd_milter_session *session,
+		gboolean with_body)
 {
 	struct rspamd_http_message *msg;
 	guint i;
@@ -1570,7 +1579,7 @@ rspamd_milter_to_http (struct rspamd_milter_session *session)
 	msg->url = rspamd_fstring_assign (msg->url, "/" MSG_CMD_CHECK_V2,
 			sizeof ("/" MSG_CMD_CHECK_V2) - 1);
 
-	if (session->message) {
+	if (with_body && session->message) {
 		rspamd_http_message_set_body_from_fstring_steal (msg, session->message);
 		session->message = NULL;
 	}
@@ -1621,6 +1630,18 @@ rspamd_milter_to_http (struct rspamd_milter_session *session)
 	return msg;
 }
 
+struct rspamd_http_message *
+rspamd_milter_to_http (struct rspamd_milter_session *session)
+{
+	return rspamd_milter_to_http_common (session, TRUE);
+}
+
+struct rspamd_http_message *
+rspamd_milter_envelope_to_http (struct rspamd_milter_session *session)
+{
+	return rspamd_milter_to_http_common (session, FALSE);
+}
+
 void *
 rspamd_milter_update_userdata (struct rspamd_milter_session *session,
 		void *ud)
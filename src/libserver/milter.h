@@ -83,7 +83,8 @@ typedef void (*rspamd_milter_error) (gint fd,
 /**
  * Handles socket with milter protocol
  * @param fd
- * @param finish_cb
+ * @param finish_cb called when the whole message has been received
+ * @param eoh_cb called when envelope and headers have been received (can be NULL)
  * @param error_cb
  * @param ud
  * @return
@@ -91,6 +92,7 @@ typedef void (*rspamd_milter_error) (gint fd,
 gboolean rspamd_milter_handle_socket (gint fd, ev_tstamp timeout,
 									  rspamd_mempool_t *pool,
 									  struct ev_loop *ev_base, rspamd_milter_finish finish_cb,
+									  rspamd_milter_finish eoh_cb,
 									  rspamd_milter_error error_cb, void *ud);
 
 /**
@@ -157,6 +159,15 @@ struct rspamd_milter_session *rspamd_milter_session_ref (
 struct rspamd_http_message *rspamd_milter_to_http (
 		struct rspamd_milter_session *session);
 
+/**
+ * Converts milter envelope to HTTP message without a body, the message
+ * collected so far is left in the session
+ * @param session
+ * @return
+ */
+struct rspamd_http_message *rspamd_milter_envelope_to_http (
+		struct rspamd_milter_session *session);
+
 /**
  * Sends task results to the
  * @param session
@@ -72,6 +72,7 @@ struct rspamd_milter_private {
 	khash_t(milter_headers_hash_t) *headers;
 	gint cur_hdr;
 	rspamd_milter_finish fin_cb;
+	rspamd_milter_finish eoh_cb;
 	rspamd_milter_error err_cb;
 	void *ud;
 	enum rspamd_milter_io_state state;
@@ -42,6 +42,7 @@ struct rspamd_monitored_methods {
 
 struct rspamd_monitored_ctx {
 	struct rspamd_config *cfg;
+	rspamd_mempool_t *shared_pool;
 	struct rdns_resolver *resolver;
 	struct ev_loop *event_loop;
 	GPtrArray *elts;
@@ -57,6 +58,19 @@ struct rspamd_monitored_ctx {
 	gboolean initialized;
 };
 
+/*
+ * State published by the process that performs checks (primary controller),
+ * allocated before fork, so all workers can read it without any messages
+ */
+struct rspamd_monitored_shared {
+	gint alive;
+	gdouble last_check;
+	gdouble max_age; /* interval is configured in the probing process only */
+	gdouble offline_time;
+	gdouble total_offline_time;
+	gdouble latency;
+};
+
 struct rspamd_monitored {
 	gchar *url;
 	gdouble monitoring_mult;
@@ -71,6 +85,7 @@ struct rspamd_monitored {
 	enum rspamd_monitored_flags flags;
 	struct rspamd_monitored_ctx *ctx;
 	struct rspamd_monitored_methods proc;
+	struct rspamd_monitored_shared *shared;
 	ev_timer periodic;
 	gchar tag[RSPAMD_MONITORED_TAG_LEN];
 };
@@ -98,6 +113,44 @@ struct rspamd_monitored {
 
 INIT_LOG_MODULE(monitored)
 
+/* Non-static for unit testing */
+void
+rspamd_monitored_publish (struct rspamd_monitored *m)
+{
+	struct rspamd_monitored_shared *sh = m->shared;
+
+	if (sh) {
+		sh->max_age = m->ctx->monitoring_interval *
+				MAX (m->ctx->max_monitored_mult, m->ctx->offline_monitored_mult) * 2.0;
+		sh->offline_time = m->offline_time;
+		sh->total_offline_time = m->total_offline_time;
+		sh->latency = m->latency;
+		g_atomic_int_set (&sh->alive, m->alive);
+		sh->last_check = rspamd_get_calendar_ticks ();
+	}
+}
+
+/*
+ * Returns shared state if it is published by another process and it is
+ * recent enough, otherwise we rely on the local state (updated by broadcasts)
+ */
+static inline struct rspamd_monitored_shared *
+rspamd_monitored_get_shared (struct rspamd_monitored *m)
+{
+	struct rspamd_monitored_shared *sh = m->shared;
+
+	if (sh == NULL || m->ctx->initialized || sh->last_check == 0) {
+		return NULL;
+	}
+
+	if (rspamd_get_calendar_ticks () - sh->last_check > sh->max_age) {
+		/* Prober is likely dead */
+		return NULL;
+	}
+
+	return sh;
+}
+
 static inline void
 rspamd_monitored_propagate_error (struct rspamd_monitored *m,
 		const gchar *error)
@@ -151,6 +204,8 @@ rspamd_monitored_propagate_error (struct rspamd_monitored *m,
 			rspamd_monitored_start (m);
 		}
 	}
+
+	rspamd_monitored_publish (m);
 }
 
 static inline void
@@ -195,6 +250,8 @@ rspamd_monitored_propagate_success (struct rspamd_monitored *m, gdouble lat)
 		m->latency = (lat + m->latency * m->nchecks) / (m->nchecks + 1);
 		m->nchecks ++;
 	}
+
+	rspamd_monitored_publish (m);
 }
 
 static void
@@ -486,6 +543,8 @@ rspamd_monitored_ctx_init (void)
 	ctx->min_monitored_mult = default_min_monitored_mult;
 	ctx->elts = g_ptr_array_new ();
 	ctx->helts = g_hash_table_new (g_str_hash, g_str_equal);
+	ctx->shared_pool = rspamd_mempool_new (rspamd_mempool_suggest_size (),
+			"monitored", 0);
 
 	return ctx;
 }
@@ -605,6 +664,8 @@ rspamd_monitored_create_ (struct rspamd_monitored_ctx *ctx,
 	g_free (cksum_encoded);
 
 	g_ptr_array_add (ctx->elts, m);
+	m->shared = rspamd_mempool_alloc0_shared (ctx->shared_pool,
+			sizeof (*m->shared));
 
 	if (ctx->event_loop) {
 		rspamd_monitored_start (m);
@@ -616,8 +677,14 @@ rspamd_monitored_create_ (struct rspamd_monitored_ctx *ctx,
 gboolean
 rspamd_monitored_alive (struct rspamd_monitored *m)
 {
+	struct rspamd_monitored_shared *sh;
+
 	g_assert (m != NULL);
 
+	if ((sh = rspamd_monitored_get_shared (m)) != NULL) {
+		return g_atomic_int_get (&sh->alive);
+	}
+
 	return m->alive;
 }
 
@@ -636,10 +703,20 @@ rspamd_monitored_set_alive (struct rspamd_monitored *m, gboolean alive)
 gdouble
 rspamd_monitored_offline_time (struct rspamd_monitored *m)
 {
+	struct rspamd_monitored_shared *sh;
+	gdouble offline_time;
+
 	g_assert (m != NULL);
 
-	if (m->offline_time > 0) {
-		return rspamd_get_calendar_ticks () - m->offline_time;
+	if ((sh = rspamd_monitored_get_shared (m)) != NULL) {
+		offline_time = sh->offline_time;
+	}
+	else {
+		offline_time = m->offline_time;
+	}
+
+	if (offline_time > 0) {
+		return rspamd_get_calendar_ticks () - offline_time;
 	}
 
 	return 0;
@@ -648,22 +725,40 @@ rspamd_monitored_offline_time (struct rspamd_monitored *m)
 gdouble
 rspamd_monitored_total_offline_time (struct rspamd_monitored *m)
 {
+	struct rspamd_monitored_shared *sh;
+	gdouble offline_time, total_offline_time;
+
 	g_assert (m != NULL);
 
-	if (m->offline_time > 0) {
-		return rspamd_get_calendar_ticks () - m->offline_time + m->total_offline_time;
+	if ((sh = rspamd_monitored_get_shared (m)) != NULL) {
+		offline_time = sh->offline_time;
+		total_offline_time = sh->total_offline_time;
+	}
+	else {
+		offline_time = m->offline_time;
+		total_offline_time = m->total_offline_time;
+	}
+
+	if (offline_time > 0) {
+		return rspamd_get_calendar_ticks () - offline_time + total_offline_time;
 	}
 
 
-	return m->total_offline_time;
+	return total_offline_time;
 }
 
 gdouble
 rspamd_monitored_latency (struct rspamd_monitored *m)
 {
+	struct rspamd_monitored_shared *sh;
+
 	g_assert (m != NULL);
 
-		return m->latency;
+	if ((sh = rspamd_monitored_get_shared (m)) != NULL) {
+		return sh->latency;
+	}
+
+	return m->latency;
 }
 
 void
@@ -712,6 +807,7 @@ rspamd_monitored_ctx_destroy (struct rspamd_monitored_ctx *ctx)
 
 	g_ptr_array_free (ctx->elts, TRUE);
 	g_hash_table_unref (ctx->helts);
+	rspamd_mempool_delete (ctx->shared_pool);
 	g_free (ctx);
 }
 
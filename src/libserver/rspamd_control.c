@@ -1004,6 +1004,9 @@ rspamd_srv_handler (EV_P_ ev_io *w, int revents)
 				break;
 			case RSPAMD_SRV_HEARTBEAT:
 				worker->hb.last_event = ev_time ();
+				worker->hb.nconns = cmd.cmd.heartbeat.nconns;
+				worker->hb.loop_lag = cmd.cmd.heartbeat.loop_lag;
+				worker->hb.load = cmd.cmd.heartbeat.load;
 				rdata->rep.reply.heartbeat.status = 0;
 				break;
 			case RSPAMD_SRV_HEALTH:
@@ -171,7 +171,9 @@ struct rspamd_srv_command {
 		} on_fork;
 		struct {
 			guint status;
-			/* TODO: add more fields */
+			guint nconns;                 /* tasks/connections in progress */
+			gdouble loop_lag;             /* event loop lag in seconds */
+			gdouble load;                 /* cpu usage since the previous beat (0..1), negative if unknown */
 		} heartbeat;
 		struct {
 			guint status;
@@ -772,6 +772,49 @@ rspamd_ssl_connection_restore_handlers (struct rspamd_ssl_connection *conn,
 	rspamd_ev_watcher_start (conn->event_loop, conn->ev, conn->ev->timeout);
 }
 
+void
+rspamd_ssl_connection_set_ev (struct rspamd_ssl_connection *conn,
+		struct rspamd_io_ev *ev)
+{
+	if (conn->ev != NULL && conn->ev != ev) {
+		rspamd_ev_watcher_stop (conn->event_loop, conn->ev);
+	}
+
+	conn->ev = ev;
+}
+
+gboolean
+rspamd_ssl_connection_check_idle (struct rspamd_ssl_connection *conn)
+{
+	guchar c;
+	gint ret;
+
+	if (conn->state != ssl_conn_connected && conn->state != ssl_next_read) {
+		return FALSE;
+	}
+
+	ERR_clear_error ();
+	ret = SSL_read (conn->ssl, &c, sizeof (c));
+
+	if (ret > 0) {
+		/* Nobody has asked for this data */
+		conn->shut = ssl_shut_unclean;
+		return FALSE;
+	}
+
+	ret = SSL_get_error (conn->ssl, ret);
+
+	if (ret == SSL_ERROR_WANT_READ) {
+		/* Protocol records are consumed, no data has been sent */
+		msg_debug_ssl ("ssl idle read: no application data");
+		return TRUE;
+	}
+
+	conn->shut = ssl_shut_unclean;
+
+	return FALSE;
+}
+
 gssize
 rspamd_ssl_read (struct rspamd_ssl_connection *conn, gpointer buf,
 		gsize buflen)
@@ -69,6 +69,25 @@ void rspamd_ssl_connection_restore_handlers (struct rspamd_ssl_connection *conn,
 											 gpointer handler_data,
 											 short ev_what);
 
+/**
+ * Attaches connection to another event structure, e.g. when a connection is
+ * passed to a new owner. The old event is stopped, no new event is started
+ * @param conn
+ * @param ev
+ */
+void rspamd_ssl_connection_set_ev (struct rspamd_ssl_connection *conn,
+								   struct rspamd_io_ev *ev);
+
+/**
+ * Processes records received on an idle connection without calling any
+ * handlers. TLS peers can send protocol records (e.g. session tickets) at any
+ * time, so a readable socket does not mean that the connection is broken
+ * @param conn
+ * @return TRUE if connection is still usable, FALSE on EOF, error or
+ * unexpected application data
+ */
+gboolean rspamd_ssl_connection_check_idle (struct rspamd_ssl_connection *conn);
+
 /**
  * Perform async read from SSL socket
  * @param conn
@@ -740,6 +740,14 @@ rspamd_task_process (struct rspamd_task *task, guint stages)
 		break;
 
 	case RSPAMD_TASK_STAGE_READ_MESSAGE:
+		if (task->flags & RSPAMD_TASK_FLAG_WAIT_MESSAGE) {
+			/* Connection stages are done, the message is still being received */
+			msg_debug_task ("wait for the message to be received");
+			task->flags &= ~RSPAMD_TASK_FLAG_PROCESSING;
+
+			return TRUE;
+		}
+
 		if (!rspamd_message_parse (task)) {
 			ret = FALSE;
 		}
@@ -1996,3 +2004,177 @@ rspamd_worker_guard_handler (EV_P_ ev_io *w, int revents)
 		}
 	}
 }
+
+/*
+ * Plain C accessors used by lua_ffi/task.lua: they must not raise errors
+ * and must only take/return scalars and pointers
+ */
+gboolean
+rspamd_task_ffi_has_symbol (struct rspamd_task *task, const gchar *sym)
+{
+	struct rspamd_symbol_result *s;
+
+	if (task == NULL || sym == NULL) {
+		return FALSE;
+	}
+
+	s = rspamd_task_find_symbol_result (task, sym, NULL);
+
+	return s != NULL && !(s->flags & RSPAMD_SYMBOL_RESULT_IGNORED);
+}
+
+gdouble
+rspamd_task_ffi_get_symbol_score (struct rspamd_task *task, const gchar *sym,
+		gboolean *found)
+{
+	struct rspamd_symbol_result *s = NULL;
+
+	if (task != NULL && sym != NULL) {
+		s = rspamd_task_find_symbol_result (task, sym, NULL);
+	}
+
+	if (s == NULL || (s->flags & RSPAMD_SYMBOL_RESULT_IGNORED)) {
+		*found = FALSE;
+
+		return 0.0;
+	}
+
+	*found = TRUE;
+
+	return s->score;
+}
+
+guint
+rspamd_task_ffi_header_count (struct rspamd_task *task, const gchar *name)
+{
+	struct rspamd_mime_header *rh, *cur;
+	guint nhdrs = 0;
+
+	if (task == NULL || name == NULL || task->message == NULL) {
+		return 0;
+	}
+
+	rh = rspamd_message_get_header_array (task, name, FALSE);
+
+	DL_FOREACH (rh, cur) {
+		nhdrs ++;
+	}
+
+	return nhdrs;
+}
+
+const gchar *
+rspamd_task_ffi_get_header (struct rspamd_task *task, const gchar *name,
+		guint idx, gboolean raw, gsize *len)
+{
+	struct rspamd_mime_header *rh, *cur;
+	const gchar *val;
+
+	if (task == NULL || name == NULL || task->message == NULL) {
+		return NULL;
+	}
+
+	rh = rspamd_message_get_header_array (task, name, FALSE);
+
+	DL_FOREACH (rh, cur) {
+		if (idx == 0) {
+			val = raw ? cur->value : cur->decoded;
+
+			if (val == NULL) {
+				return NULL;
+			}
+
+			*len = strlen (val);
+
+			return val;
+		}
+
+		idx --;
+	}
+
+	return NULL;
+}
+
+const gchar *
+rspamd_task_ffi_get_from (struct rspamd_task *task, gboolean mime, gsize *len)
+{
+	struct rspamd_email_address *addr = NULL;
+	GPtrArray *addrs;
+
+	if (task == NULL) {
+		return NULL;
+	}
+
+	if (mime) {
+		addrs = MESSAGE_FIELD_CHECK (task, from_mime);
+
+		if (addrs && addrs->len > 0) {
+			addr = g_ptr_array_index (addrs, 0);
+		}
+	}
+	else {
+		addr = task->from_envelope;
+	}
+
+	if (addr == NULL || addr->addr == NULL) {
+		return NULL;
+	}
+
+	*len = addr->addr_len;
+
+	return addr->addr;
+}
+
+guint
+rspamd_task_ffi_text_parts_count (struct rspamd_task *task)
+{
+	GPtrArray *parts;
+
+	if (task == NULL) {
+		return 0;
+	}
+
+	parts = MESSAGE_FIELD_CHECK (task, text_parts);
+
+	return parts ? parts->len : 0;
+}
+
+const gchar *
+rspamd_task_ffi_get_text_part_content (struct rspamd_task *task, guint idx,
+		gsize *len)
+{
+	struct rspamd_mime_text_part *tp;
+	GPtrArray *parts;
+
+	if (task == NULL) {
+		return NULL;
+	}
+
+	parts = MESSAGE_FIELD_CHECK (task, text_parts);
+
+	if (parts == NULL || idx >= parts->len) {
+		return NULL;
+	}
+
+	tp = g_ptr_array_index (parts, idx);
+
+	if (IS_TEXT_PART_EMPTY (tp) || tp->utf_content.begin == NULL) {
+		*len = 0;
+
+		return "";
+	}
+
+	*len = tp->utf_content.len;
+
+	return tp->utf_content.begin;
+}
+
+guint
+rspamd_task_ffi_urls_count (struct rspamd_task *task)
+{
+	if (task == NULL || task->message == NULL) {
+		return 0;
+	}
+
+	return kh_size (MESSAGE_FIELD (task, urls));
+}
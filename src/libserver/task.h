@@ -112,7 +112,9 @@ enum rspamd_task_stage {
 #define RSPAMD_TASK_FLAG_SSL (1u << 22u)
 #define RSPAMD_TASK_FLAG_BAD_UNICODE (1u << 23u)
 #define RSPAMD_TASK_FLAG_MESSAGE_REWRITE (1u << 24u)
-#define RSPAMD_TASK_FLAG_MAX_SHIFT (24u)
+/* Internal: message has not been received yet, stop before reading it */
+#define RSPAMD_TASK_FLAG_WAIT_MESSAGE (1u << 25u)
+#define RSPAMD_TASK_FLAG_MAX_SHIFT (25u)
 
 
 /* Request has a JSON control block */
@@ -383,6 +385,23 @@ void rspamd_task_timeout (EV_P_ ev_timer *w, int revents);
  */
 void rspamd_worker_guard_handler (EV_P_ ev_io *w, int revents);
 
+/*
+ * Read only accessors with a stable ABI for lua_ffi/task.lua. Strings returned
+ * are owned by the task and are NOT zero terminated in general, use `len`
+ */
+gboolean rspamd_task_ffi_has_symbol (struct rspamd_task *task, const gchar *sym);
+gdouble rspamd_task_ffi_get_symbol_score (struct rspamd_task *task,
+		const gchar *sym, gboolean *found);
+guint rspamd_task_ffi_header_count (struct rspamd_task *task, const gchar *name);
+const gchar *rspamd_task_ffi_get_header (struct rspamd_task *task,
+		const gchar *name, guint idx, gboolean raw, gsize *len);
+const gchar *rspamd_task_ffi_get_from (struct rspamd_task *task, gboolean mime,
+		gsize *len);
+guint rspamd_task_ffi_text_parts_count (struct rspamd_task *task);
+const gchar *rspamd_task_ffi_get_text_part_content (struct rspamd_task *task,
+		guint idx, gsize *len);
+guint rspamd_task_ffi_urls_count (struct rspamd_task *task);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -45,6 +45,7 @@
 #include "rspamd.h"
 #include "message.h"
 #include "multipattern.h"
+#include "suffix_index.h"
 #include "contrib/uthash/utlist.h"
 #include "contrib/http-parser/http_parser.h"
 #include <unicode/utf8.h>
@@ -284,6 +285,7 @@ struct url_match_scanner {
 	GArray *matchers_strict;
 	struct rspamd_multipattern *search_trie_full;
 	struct rspamd_multipattern *search_trie_strict;
+	struct rspamd_suffix_index *tld_index;
 };
 
 struct url_match_scanner *url_scanner = NULL;
@@ -522,6 +524,62 @@ rspamd_url_parse_tld_file (const gchar *fname,
 	return TRUE;
 }
 
+static void
+rspamd_url_tld_index_cb (const gchar *rule, gsize len, guint flags, gpointer ud)
+{
+	struct url_match_scanner *scanner = ud;
+	struct url_matcher m;
+
+	m.end = url_tld_end;
+	m.start = url_tld_start;
+	m.prefix = "http://";
+
+	/* Exceptions are handled by the index itself */
+	if (flags & RSPAMD_SUFFIX_INDEX_TERMINAL) {
+		m.flags = URL_FLAG_NOHTML | URL_FLAG_TLD_MATCH;
+		rspamd_multipattern_add_pattern_len (scanner->search_trie_full, rule, len,
+				RSPAMD_MULTIPATTERN_TLD|RSPAMD_MULTIPATTERN_ICASE|RSPAMD_MULTIPATTERN_UTF8);
+		m.pattern = rspamd_multipattern_get_pattern (scanner->search_trie_full,
+				rspamd_multipattern_get_npatterns (scanner->search_trie_full) - 1);
+		g_array_append_val (scanner->matchers_full, m);
+	}
+
+	if (flags & RSPAMD_SUFFIX_INDEX_WILDCARD) {
+		m.flags = URL_FLAG_NOHTML | URL_FLAG_TLD_MATCH | URL_FLAG_STAR_MATCH;
+		rspamd_multipattern_add_pattern_len (scanner->search_trie_full, rule, len,
+				RSPAMD_MULTIPATTERN_TLD|RSPAMD_MULTIPATTERN_ICASE|RSPAMD_MULTIPATTERN_UTF8);
+		m.pattern = rspamd_multipattern_get_pattern (scanner->search_trie_full,
+				rspamd_multipattern_get_npatterns (scanner->search_trie_full) - 1);
+		g_array_append_val (scanner->matchers_full, m);
+	}
+}
+
+/*
+ * Tries to load TLD file as a compiled suffix index (see `rspamadm suffix_index`),
+ * the index is then used for TLD lookups instead of the multipattern callbacks,
+ * the latter is still used to find urls in text
+ */
+static gboolean
+rspamd_url_load_tld_index (const gchar *fname,
+		struct url_match_scanner *scanner)
+{
+	GError *err = NULL;
+
+	scanner->tld_index = rspamd_suffix_index_open (fname, &err);
+
+	if (scanner->tld_index == NULL) {
+		msg_debug ("%s is not a compiled suffix index: %e", fname, err);
+		g_error_free (err);
+
+		return FALSE;
+	}
+
+	rspamd_suffix_index_foreach (scanner->tld_index, rspamd_url_tld_index_cb,
+			scanner);
+
+	return TRUE;
+}
+
 static void
 rspamd_url_add_static_matchers (struct url_match_scanner *sc)
 {
@@ -570,6 +628,10 @@ rspamd_url_deinit (void)
 			g_array_free (url_scanner->matchers_full, TRUE);
 		}
 
+		if (url_scanner->tld_index) {
+			rspamd_suffix_index_destroy (url_scanner->tld_index);
+		}
+
 		rspamd_multipattern_destroy (url_scanner->search_trie_strict);
 		g_array_free (url_scanner->matchers_strict, TRUE);
 		g_free (url_scanner);
@@ -588,7 +650,7 @@ rspamd_url_init (const gchar *tld_file)
 		rspamd_url_deinit ();
 	}
 
-	url_scanner = g_malloc (sizeof (struct url_match_scanner));
+	url_scanner = g_malloc0 (sizeof (struct url_match_scanner));
 
 	url_scanner->matchers_strict = g_array_sized_new (FALSE, TRUE,
 			sizeof (struct url_matcher), G_N_ELEMENTS (static_matchers));
@@ -611,7 +673,9 @@ rspamd_url_init (const gchar *tld_file)
 	rspamd_url_add_static_matchers (url_scanner);
 
 	if (tld_file != NULL) {
-		ret = rspamd_url_parse_tld_file (tld_file, url_scanner);
+		if (!rspamd_url_load_tld_index (tld_file, url_scanner)) {
+			ret = rspamd_url_parse_tld_file (tld_file, url_scanner);
+		}
 	}
 
 	if (url_scanner->matchers_full && url_scanner->matchers_full->len > 1000) {
@@ -1691,6 +1755,40 @@ rspamd_web_parse (struct http_parser_url *u, const gchar *str, gsize len,
 
 #undef SET_U
 
+/*
+ * Returns public suffix plus one label, as multipattern callbacks do
+ */
+static gboolean
+rspamd_url_find_tld_index (const gchar *in, gsize inlen, rspamd_ftok_t *out)
+{
+	rspamd_ftok_t suffix;
+	const gchar *p;
+
+	if (inlen == 0 || !rspamd_suffix_index_find (url_scanner->tld_index, in, inlen,
+			&suffix)) {
+		return FALSE;
+	}
+
+	p = suffix.begin;
+
+	if (p == in) {
+		/* Public suffix itself is not a domain, as in the text rules matcher */
+		return FALSE;
+	}
+
+	/* Skip dot and the next label */
+	p --;
+
+	while (p > in && *(p - 1) != '.') {
+		p --;
+	}
+
+	out->begin = p;
+	out->len = suffix.begin + suffix.len - p;
+
+	return TRUE;
+}
+
 static gint
 rspamd_tld_trie_callback (struct rspamd_multipattern *mp,
 		guint strnum,
@@ -2482,7 +2580,22 @@ rspamd_url_parse (struct rspamd_url *uri,
 
 	if (uri->protocol & (PROTOCOL_HTTP|PROTOCOL_HTTPS|PROTOCOL_MAILTO|PROTOCOL_FTP|PROTOCOL_FILE)) {
 		/* Find TLD part */
-		if (url_scanner->search_trie_full)  {
+		if (url_scanner->tld_index) {
+			rspamd_ftok_t tld;
+
+			if (uri->hostlen > 0 &&
+					rspamd_url_host_unsafe (uri)[uri->hostlen - 1] == '.') {
+				/* Dot at the end of domain */
+				uri->hostlen --;
+			}
+
+			if (rspamd_url_find_tld_index (rspamd_url_host_unsafe (uri),
+					uri->hostlen, &tld)) {
+				uri->tldshift = tld.begin - uri->string;
+				uri->tldlen = tld.len;
+			}
+		}
+		else if (url_scanner->search_trie_full)  {
 			rspamd_multipattern_lookup (url_scanner->search_trie_full,
 					rspamd_url_host_unsafe (uri), uri->hostlen,
 					rspamd_tld_trie_callback, uri, NULL);
@@ -2631,6 +2744,10 @@ rspamd_url_find_tld (const gchar *in, gsize inlen, rspamd_ftok_t *out)
 	cbdata.out = out;
 	out->len = 0;
 
+	if (url_scanner->tld_index) {
+		return rspamd_url_find_tld_index (in, inlen, out);
+	}
+
 	if (url_scanner->search_trie_full) {
 		rspamd_multipattern_lookup (url_scanner->search_trie_full, in, inlen,
 				rspamd_tld_trie_find_callback, &cbdata, NULL);
@@ -834,9 +834,41 @@ rspamd_worker_heartbeat_cb (EV_P_ ev_timer *w, int revents)
 {
 	struct rspamd_worker *wrk = (struct rspamd_worker *)w->data;
 	struct rspamd_srv_command cmd;
+	static gdouble last_cpu = -1.0;
+	ev_tstamp now = ev_now (EV_A), cur_lag = 0.0;
+	gdouble cur_cpu = -1.0;
+#ifdef HAVE_SYS_RESOURCE_H
+	struct rusage rusg;
+#endif
 
 	memset (&cmd, 0, sizeof (cmd));
 	cmd.type = RSPAMD_SRV_HEARTBEAT;
+	cmd.cmd.heartbeat.nconns = wrk->nconns;
+	cmd.cmd.heartbeat.load = -1.0;
+
+	/*
+	 * In the worker process hb.last_event is the time of the previous beat,
+	 * so any delay over the heartbeat interval means that the loop has been
+	 * too busy to fire this timer in time
+	 */
+	if (wrk->hb.last_event > 0) {
+		cur_lag = now - wrk->hb.last_event - w->repeat;
+		cmd.cmd.heartbeat.loop_lag = MAX (cur_lag, 0.0);
+	}
+
+#ifdef HAVE_SYS_RESOURCE_H
+	if (getrusage (RUSAGE_SELF, &rusg) != -1) {
+		cur_cpu = tv_to_double (&rusg.ru_utime) + tv_to_double (&rusg.ru_stime);
+
+		if (last_cpu >= 0 && wrk->hb.last_event > 0 && now > wrk->hb.last_event) {
+			cmd.cmd.heartbeat.load = (cur_cpu - last_cpu) /
+					(now - wrk->hb.last_event);
+		}
+	}
+#endif
+
+	last_cpu = cur_cpu;
+	wrk->hb.last_event = now;
 	rspamd_srv_send_command (wrk, EV_A, &cmd, -1, NULL, NULL);
 }
 
@@ -2013,6 +2045,7 @@ rspamd_controller_store_saved_stats (struct rspamd_main *rspamd_main,
 }
 
 static ev_timer rrd_timer;
+static ev_timer series_timer;
 
 void
 rspamd_controller_on_terminate (struct rspamd_worker *worker,
@@ -2023,6 +2056,8 @@ rspamd_controller_on_terminate (struct rspamd_worker *worker,
 	ctx = (struct rspamd_abstract_worker_ctx *)worker->ctx;
 	rspamd_controller_store_saved_stats (worker->srv, worker->srv->cfg);
 
+	ev_timer_stop (ctx->event_loop, &series_timer);
+
 	if (rrd) {
 		ev_timer_stop (ctx->event_loop, &rrd_timer);
 		msg_info ("closing rrd file: %s", rrd->filename);
@@ -2144,6 +2179,76 @@ rspamd_controller_rrd_update (EV_P_ ev_timer *w, int revents)
 	ev_timer_again (EV_A_ w);
 }
 
+/*
+ * Stores per-second actions deltas in the shared series ring, so
+ * controllers can serve high resolution graphs without touching rrd
+ */
+static void
+rspamd_controller_series_update (EV_P_ ev_timer *w, int revents)
+{
+	struct rspamd_controller_periodics_cbdata *cbd =
+			(struct rspamd_controller_periodics_cbdata *)w->data;
+	struct rspamd_stat_series *series = cbd->worker->srv->stat_series;
+	struct rspamd_stat *stat = cbd->stat;
+	guint64 now = ev_now (EV_A), elapsed, i;
+	guint cur[METRIC_ACTION_MAX], delta[METRIC_ACTION_MAX], *slot;
+	guint j;
+
+	for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+		cur[j] = stat->actions_stat[j];
+	}
+
+	if (series->last_update == 0 || now < series->last_update) {
+		/* Initial point or time went backwards */
+		memcpy (series->last_actions, cur, sizeof (cur));
+		series->last_update = now;
+		ev_timer_again (EV_A_ w);
+
+		return;
+	}
+
+	elapsed = now - series->last_update;
+
+	if (elapsed == 0) {
+		ev_timer_again (EV_A_ w);
+
+		return;
+	}
+
+	if (elapsed > RSPAMD_STAT_SERIES_SLOTS) {
+		elapsed = RSPAMD_STAT_SERIES_SLOTS;
+	}
+
+	for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+		delta[j] = cur[j] >= series->last_actions[j] ?
+				cur[j] - series->last_actions[j] : 0;
+	}
+
+	/* Spread deltas over the seconds missed (e.g. due to the timer jitter) */
+	for (i = 0; i < elapsed; i ++) {
+		slot = series->actions[series->cur_slot];
+
+		for (j = 0; j < METRIC_ACTION_MAX; j ++) {
+			slot[j] = delta[j] / elapsed;
+
+			if (i == elapsed - 1) {
+				slot[j] += delta[j] % elapsed;
+			}
+		}
+
+		series->cur_slot = (series->cur_slot + 1) % RSPAMD_STAT_SERIES_SLOTS;
+
+		if (series->nslots < RSPAMD_STAT_SERIES_SLOTS) {
+			series->nslots ++;
+		}
+	}
+
+	memcpy (series->last_actions, cur, sizeof (cur));
+	series->last_update = now;
+
+	ev_timer_again (EV_A_ w);
+}
+
 static void
 rspamd_controller_stats_save_periodic (EV_P_ ev_timer *w, int revents)
 {
@@ -2179,6 +2284,13 @@ rspamd_worker_init_controller (struct rspamd_worker *worker,
 				save_stats_interval, save_stats_interval);
 		ev_timer_start (ctx->event_loop, &cbd.save_stats_event);
 
+		if (worker->srv->stat_series) {
+			series_timer.data = &cbd;
+			ev_timer_init (&series_timer, rspamd_controller_series_update,
+					rrd_update_time, rrd_update_time);
+			ev_timer_start (ctx->event_loop, &series_timer);
+		}
+
 		rspamd_map_watch (worker->srv->cfg, ctx->event_loop,
 				ctx->resolver, worker,
 				RSPAMD_MAP_WATCH_PRIMARY_CONTROLLER);
@@ -44,6 +44,7 @@ extern "C" {
 #define RSPAMD_STAT_TOKEN_FLAG_SKIPPED (1u << 11)
 #define RSPAMD_STAT_TOKEN_FLAG_INVISIBLE_SPACES (1u << 12)
 #define RSPAMD_STAT_TOKEN_FLAG_EMOJI (1u << 13)
+#define RSPAMD_STAT_TOKEN_FLAG_ASCII (1u << 14)
 
 typedef struct rspamd_stat_token_s {
 	rspamd_ftok_t original; /* utf8 raw */
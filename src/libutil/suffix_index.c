@@ -0,0 +1,628 @@
+/*-
+ * Copyright 2022 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "suffix_index.h"
+#include "util.h"
+#include "unix-std.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/*
+ * Image layout (native byte order, a foreign one fails the version check):
+ * header | nodes[nnodes] | labels[labels_len]
+ * Node 0 is the root, children of each node are stored contiguously and
+ * sorted by their labels, so lookups are binary searches with no allocations
+ */
+static const gchar rspamd_suffix_index_magic[8] = "rsfxidx";
+
+struct rspamd_suffix_index_hdr {
+	gchar magic[8];
+	guint32 version;
+	guint32 nnodes;
+	guint32 nrules;
+	guint32 labels_len;
+};
+
+struct rspamd_suffix_index_node {
+	guint32 label_off;
+	guint32 first_child;
+	guint32 nchildren;
+	guint16 label_len;
+	guint16 flags;
+};
+
+struct rspamd_suffix_index {
+	const struct rspamd_suffix_index_hdr *hdr;
+	const struct rspamd_suffix_index_node *nodes;
+	const gchar *labels;
+	gpointer map;
+	gsize map_len;
+	GByteArray *image;
+};
+
+#define RSPAMD_SUFFIX_INDEX_MAX_LABEL 255
+
+static GQuark
+rspamd_suffix_index_quark (void)
+{
+	return g_quark_from_static_string ("suffix-index");
+}
+
+static gint
+rspamd_suffix_index_label_cmp (const gchar *a, gsize alen,
+		const gchar *b, gsize blen)
+{
+	gint r = memcmp (a, b, MIN (alen, blen));
+
+	if (r == 0) {
+		return (gint)alen - (gint)blen;
+	}
+
+	return r;
+}
+
+/* Build time trie */
+struct rspamd_suffix_build_node {
+	gchar *label;
+	gsize len;
+	guint flags;
+	GHashTable *children;
+};
+
+static struct rspamd_suffix_build_node *
+rspamd_suffix_build_node_new (const gchar *label, gsize len)
+{
+	struct rspamd_suffix_build_node *n = g_malloc0 (sizeof (*n));
+
+	n->label = g_strndup (label, len);
+	n->len = len;
+
+	return n;
+}
+
+static void
+rspamd_suffix_build_node_free (gpointer p)
+{
+	struct rspamd_suffix_build_node *n = p;
+
+	if (n->children) {
+		g_hash_table_unref (n->children);
+	}
+
+	g_free (n->label);
+	g_free (n);
+}
+
+static gint
+rspamd_suffix_build_node_cmp (gconstpointer a, gconstpointer b)
+{
+	const struct rspamd_suffix_build_node *n1 = *(const struct rspamd_suffix_build_node **)a,
+		*n2 = *(const struct rspamd_suffix_build_node **)b;
+
+	return rspamd_suffix_index_label_cmp (n1->label, n1->len, n2->label, n2->len);
+}
+
+static gboolean
+rspamd_suffix_index_add_rule (struct rspamd_suffix_build_node *root,
+		gchar *rule, gsize len)
+{
+	struct rspamd_suffix_build_node *cur = root, *next;
+	guint flags = RSPAMD_SUFFIX_INDEX_TERMINAL;
+	gchar *p, *end, *label;
+
+	if (len > 0 && rule[0] == '!') {
+		flags = RSPAMD_SUFFIX_INDEX_EXCEPTION;
+		rule ++;
+		len --;
+	}
+	else if (len > 1 && rule[0] == '*' && rule[1] == '.') {
+		flags = RSPAMD_SUFFIX_INDEX_WILDCARD;
+		rule += 2;
+		len -= 2;
+	}
+
+	if (len > 0 && rule[len - 1] == '.') {
+		len --;
+	}
+
+	if (len == 0) {
+		return FALSE;
+	}
+
+	rspamd_str_lc (rule, len);
+	end = rule + len;
+	p = end;
+
+	while (p > rule) {
+		label = p;
+
+		while (label > rule && *(label - 1) != '.') {
+			label --;
+		}
+
+		if (label == p || p - label > RSPAMD_SUFFIX_INDEX_MAX_LABEL) {
+			/* Empty or too long label */
+			return FALSE;
+		}
+
+		if (cur->children == NULL) {
+			cur->children = g_hash_table_new_full (rspamd_str_hash,
+					rspamd_str_equal, NULL, rspamd_suffix_build_node_free);
+		}
+
+		*p = '\0';
+		next = g_hash_table_lookup (cur->children, label);
+
+		if (next == NULL) {
+			next = rspamd_suffix_build_node_new (label, p - label);
+			g_hash_table_insert (cur->children, next->label, next);
+		}
+
+		cur = next;
+		p = label - 1;
+	}
+
+	cur->flags |= flags;
+
+	return TRUE;
+}
+
+GByteArray *
+rspamd_suffix_index_compile (const gchar *text, gsize len, guint *nrules)
+{
+	struct rspamd_suffix_build_node *root, *n, *child;
+	struct rspamd_suffix_index_hdr hdr;
+	struct rspamd_suffix_index_node out_node;
+	GPtrArray *queue, *children;
+	GString *labels, *linebuf;
+	GByteArray *image;
+	GHashTableIter it;
+	gpointer k, v;
+	const gchar *p = text, *end = text + len, *eol, *tok_end;
+	guint i, j, cnt = 0;
+
+	root = rspamd_suffix_build_node_new ("", 0);
+	linebuf = g_string_sized_new (256);
+
+	while (p < end) {
+		eol = memchr (p, '\n', end - p);
+
+		if (eol == NULL) {
+			eol = end;
+		}
+
+		while (p < eol && g_ascii_isspace (*p)) {
+			p ++;
+		}
+
+		tok_end = p;
+
+		while (tok_end < eol && !g_ascii_isspace (*tok_end)) {
+			tok_end ++;
+		}
+
+		if (tok_end > p && *p != '#' && !(tok_end - p > 1 && p[0] == '/' && p[1] == '/')) {
+			g_string_assign (linebuf, "");
+			g_string_append_len (linebuf, p, tok_end - p);
+
+			if (rspamd_suffix_index_add_rule (root, linebuf->str, linebuf->len)) {
+				cnt ++;
+			}
+		}
+
+		p = eol + 1;
+	}
+
+	g_string_free (linebuf, TRUE);
+
+	/* Serialize in BFS order, so children of each node are contiguous */
+	queue = g_ptr_array_new ();
+	children = g_ptr_array_new ();
+	labels = g_string_sized_new (cnt * 8);
+	image = g_byte_array_new ();
+	g_ptr_array_add (queue, root);
+
+	memset (&hdr, 0, sizeof (hdr));
+	g_byte_array_append (image, (const guint8 *)&hdr, sizeof (hdr));
+
+	for (i = 0; i < queue->len; i ++) {
+		n = g_ptr_array_index (queue, i);
+
+		memset (&out_node, 0, sizeof (out_node));
+		out_node.label_off = labels->len;
+		out_node.label_len = n->len;
+		out_node.flags = n->flags;
+		g_string_append_len (labels, n->label, n->len);
+
+		if (n->children) {
+			g_ptr_array_set_size (children, 0);
+			g_hash_table_iter_init (&it, n->children);
+
+			while (g_hash_table_iter_next (&it, &k, &v)) {
+				g_ptr_array_add (children, v);
+			}
+
+			g_ptr_array_sort (children, rspamd_suffix_build_node_cmp);
+			out_node.first_child = queue->len;
+			out_node.nchildren = children->len;
+
+			PTR_ARRAY_FOREACH (children, j, child) {
+				g_ptr_array_add (queue, child);
+			}
+		}
+
+		g_byte_array_append (image, (const guint8 *)&out_node, sizeof (out_node));
+	}
+
+	memcpy (hdr.magic, rspamd_suffix_index_magic, sizeof (hdr.magic));
+	hdr.version = RSPAMD_SUFFIX_INDEX_VERSION;
+	hdr.nnodes = queue->len;
+	hdr.nrules = cnt;
+	hdr.labels_len = labels->len;
+	memcpy (image->data, &hdr, sizeof (hdr));
+	g_byte_array_append (image, (const guint8 *)labels->str, labels->len);
+
+	g_string_free (labels, TRUE);
+	g_ptr_array_free (children, TRUE);
+	g_ptr_array_free (queue, TRUE);
+	rspamd_suffix_build_node_free (root);
+
+	if (nrules) {
+		*nrules = cnt;
+	}
+
+	return image;
+}
+
+static gboolean
+rspamd_suffix_index_validate (struct rspamd_suffix_index *idx,
+		const guchar *data, gsize len, GError **err)
+{
+	const struct rspamd_suffix_index_hdr *hdr;
+	const struct rspamd_suffix_index_node *node;
+	guint64 expected;
+	guint i;
+
+	if (len < sizeof (*hdr)) {
+		g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+				"index is too short");
+		return FALSE;
+	}
+
+	hdr = (const struct rspamd_suffix_index_hdr *)data;
+
+	if (memcmp (hdr->magic, rspamd_suffix_index_magic, sizeof (hdr->magic)) != 0) {
+		g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+				"invalid index magic");
+		return FALSE;
+	}
+
+	if (hdr->version != RSPAMD_SUFFIX_INDEX_VERSION) {
+		g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+				"unsupported index version: %u", (guint)hdr->version);
+		return FALSE;
+	}
+
+	expected = sizeof (*hdr) + (guint64)hdr->nnodes * sizeof (*node) +
+			hdr->labels_len;
+
+	if (hdr->nnodes == 0 || expected != len) {
+		g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+				"invalid index size: %" G_GSIZE_FORMAT ", %" G_GUINT64_FORMAT " expected",
+				len, expected);
+		return FALSE;
+	}
+
+	idx->hdr = hdr;
+	idx->nodes = (const struct rspamd_suffix_index_node *)(data + sizeof (*hdr));
+	idx->labels = (const gchar *)(idx->nodes + hdr->nnodes);
+
+	for (i = 0; i < hdr->nnodes; i ++) {
+		node = &idx->nodes[i];
+
+		if ((guint64)node->label_off + node->label_len > hdr->labels_len) {
+			g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+					"invalid label in node %u", i);
+			return FALSE;
+		}
+
+		/* Children must follow their parent, so there are no loops */
+		if (node->nchildren > 0 && (node->first_child <= i ||
+				(guint64)node->first_child + node->nchildren > hdr->nnodes)) {
+			g_set_error (err, rspamd_suffix_index_quark (), EINVAL,
+					"invalid children in node %u", i);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+struct rspamd_suffix_index *
+rspamd_suffix_index_open (const gchar *fname, GError **err)
+{
+	struct rspamd_suffix_index *idx;
+	gpointer map;
+	gsize len = (gsize)-1;
+
+	map = rspamd_file_xmap (fname, PROT_READ, &len, TRUE);
+
+	if (map == NULL) {
+		g_set_error (err, rspamd_suffix_index_quark (), errno,
+				"cannot map %s: %s", fname,
+				len == 0 ? "empty file" : strerror (errno));
+		return NULL;
+	}
+
+	idx = g_malloc0 (sizeof (*idx));
+	idx->map = map;
+	idx->map_len = len;
+
+	if (!rspamd_suffix_index_validate (idx, map, len, err)) {
+		rspamd_suffix_index_destroy (idx);
+
+		return NULL;
+	}
+
+	return idx;
+}
+
+struct rspamd_suffix_index *
+rspamd_suffix_index_from_image (GByteArray *image, GError **err)
+{
+	struct rspamd_suffix_index *idx;
+
+	idx = g_malloc0 (sizeof (*idx));
+	idx->image = image;
+
+	if (!rspamd_suffix_index_validate (idx, image->data, image->len, err)) {
+		rspamd_suffix_index_destroy (idx);
+
+		return NULL;
+	}
+
+	return idx;
+}
+
+static const struct rspamd_suffix_index_node *
+rspamd_suffix_index_child (const struct rspamd_suffix_index *idx,
+		const struct rspamd_suffix_index_node *parent,
+		const gchar *label, gsize len)
+{
+	const struct rspamd_suffix_index_node *node;
+	guint lo = parent->first_child, hi = parent->first_child + parent->nchildren,
+		mid;
+	gint r;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		node = &idx->nodes[mid];
+		r = rspamd_suffix_index_label_cmp (idx->labels + node->label_off,
+				node->label_len, label, len);
+
+		if (r == 0) {
+			return node;
+		}
+		else if (r < 0) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	return NULL;
+}
+
+gboolean
+rspamd_suffix_index_find (const struct rspamd_suffix_index *idx,
+		const gchar *domain, gsize len, rspamd_ftok_t *out)
+{
+	const struct rspamd_suffix_index_node *cur, *next;
+	const gchar *end, *p, *label;
+	gchar lc[RSPAMD_SUFFIX_INDEX_MAX_LABEL];
+	gsize llen, best = 0;
+
+	g_assert (idx != NULL);
+	g_assert (out != NULL);
+
+	out->begin = NULL;
+	out->len = 0;
+
+	if (len > 0 && domain[len - 1] == '.') {
+		len --;
+	}
+
+	cur = &idx->nodes[0];
+	end = domain + len;
+	p = end;
+
+	while (p > domain) {
+		label = p;
+
+		while (label > domain && *(label - 1) != '.') {
+			label --;
+		}
+
+		llen = p - label;
+
+		if (llen == 0 || llen > sizeof (lc)) {
+			break;
+		}
+
+		memcpy (lc, label, llen);
+		rspamd_str_lc (lc, llen);
+		next = rspamd_suffix_index_child (idx, cur, lc, llen);
+
+		if (cur->flags & RSPAMD_SUFFIX_INDEX_WILDCARD) {
+			/* Any label is matched by a wildcard unless it is an exception */
+			if (next == NULL || !(next->flags & RSPAMD_SUFFIX_INDEX_EXCEPTION)) {
+				best = end - label;
+			}
+		}
+
+		if (next == NULL) {
+			break;
+		}
+
+		if (next->flags & RSPAMD_SUFFIX_INDEX_EXCEPTION) {
+			/* Suffix is the parent of an exception */
+			best = p < end ? end - (p + 1) : 0;
+			break;
+		}
+
+		if (next->flags & RSPAMD_SUFFIX_INDEX_TERMINAL) {
+			best = end - label;
+		}
+
+		cur = next;
+		p = label - 1;
+	}
+
+	if (best > 0) {
+		out->begin = end - best;
+		out->len = best;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+gboolean
+rspamd_suffix_index_has (const struct rspamd_suffix_index *idx,
+		const gchar *domain, gsize len)
+{
+	const struct rspamd_suffix_index_node *cur;
+	const gchar *end, *p, *label;
+	gchar lc[RSPAMD_SUFFIX_INDEX_MAX_LABEL];
+	gsize llen;
+
+	g_assert (idx != NULL);
+
+	if (len > 0 && domain[len - 1] == '.') {
+		len --;
+	}
+
+	if (len == 0) {
+		return FALSE;
+	}
+
+	cur = &idx->nodes[0];
+	end = domain + len;
+	p = end;
+
+	while (p > domain) {
+		label = p;
+
+		while (label > domain && *(label - 1) != '.') {
+			label --;
+		}
+
+		llen = p - label;
+
+		if (llen == 0 || llen > sizeof (lc)) {
+			return FALSE;
+		}
+
+		memcpy (lc, label, llen);
+		rspamd_str_lc (lc, llen);
+		cur = rspamd_suffix_index_child (idx, cur, lc, llen);
+
+		if (cur == NULL) {
+			return FALSE;
+		}
+
+		p = label - 1;
+	}
+
+	return (cur->flags & RSPAMD_SUFFIX_INDEX_TERMINAL) != 0;
+}
+
+static void
+rspamd_suffix_index_foreach_node (const struct rspamd_suffix_index *idx,
+		const struct rspamd_suffix_index_node *node,
+		gchar *buf, gsize buflen, gsize pos,
+		rspamd_suffix_index_cb cb, gpointer ud)
+{
+	const struct rspamd_suffix_index_node *child;
+	gsize npos;
+	guint i;
+
+	if (node->flags != 0 && pos < buflen) {
+		cb (buf + pos, buflen - pos, node->flags, ud);
+	}
+
+	for (i = 0; i < node->nchildren; i ++) {
+		child = &idx->nodes[node->first_child + i];
+		npos = pos;
+
+		/* Prepend label (and a dot if it is not a top level label) */
+		if (pos < buflen) {
+			if (npos < 1) {
+				continue;
+			}
+
+			npos --;
+			buf[npos] = '.';
+		}
+
+		if (npos < child->label_len) {
+			continue;
+		}
+
+		npos -= child->label_len;
+		memcpy (buf + npos, idx->labels + child->label_off, child->label_len);
+
+		rspamd_suffix_index_foreach_node (idx, child, buf, buflen, npos, cb, ud);
+	}
+}
+
+void
+rspamd_suffix_index_foreach (const struct rspamd_suffix_index *idx,
+		rspamd_suffix_index_cb cb, gpointer ud)
+{
+	gchar buf[1024];
+
+	g_assert (idx != NULL);
+
+	rspamd_suffix_index_foreach_node (idx, &idx->nodes[0], buf, sizeof (buf),
+			sizeof (buf), cb, ud);
+}
+
+guint
+rspamd_suffix_index_count (const struct rspamd_suffix_index *idx)
+{
+	return idx->hdr->nrules;
+}
+
+void
+rspamd_suffix_index_destroy (struct rspamd_suffix_index *idx)
+{
+	if (idx) {
+		if (idx->map) {
+			munmap (idx->map, idx->map_len);
+		}
+
+		if (idx->image) {
+			g_byte_array_free (idx->image, TRUE);
+		}
+
+		g_free (idx);
+	}
+}
@@ -0,0 +1,126 @@
+/*-
+ * Copyright 2022 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_LIBUTIL_SUFFIX_INDEX_H_
+#define SRC_LIBUTIL_SUFFIX_INDEX_H_
+
+#include "config.h"
+#include "fstring.h"
+
+/**
+ * @file suffix_index.h
+ *
+ * Compact read only index of domain suffixes (e.g. public suffix list or
+ * a list of domains) stored as a trie of reversed labels. The binary image
+ * is position independent, so it can be compiled once (see `rspamadm
+ * suffix_index`) and then mapped by all processes sharing the page cache.
+ */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#define RSPAMD_SUFFIX_INDEX_VERSION 1
+
+enum rspamd_suffix_index_flags {
+	RSPAMD_SUFFIX_INDEX_TERMINAL = (1u << 0u), /* Rule `a.b` */
+	RSPAMD_SUFFIX_INDEX_WILDCARD = (1u << 1u), /* Rule `*.a.b` */
+	RSPAMD_SUFFIX_INDEX_EXCEPTION = (1u << 2u), /* Rule `!a.b` */
+};
+
+struct rspamd_suffix_index;
+
+/**
+ * Compiles text rules (one per line, `//` and `#` start comments) to the binary
+ * image of the index
+ * @param text rules text
+ * @param len length of text
+ * @param nrules output number of rules compiled (may be NULL)
+ * @return newly allocated binary image
+ */
+GByteArray *rspamd_suffix_index_compile (const gchar *text, gsize len,
+		guint *nrules);
+
+/**
+ * Opens compiled index mapping it read only
+ * @param fname
+ * @param err
+ * @return index or NULL (if file is not a valid index, err is set)
+ */
+struct rspamd_suffix_index *rspamd_suffix_index_open (const gchar *fname,
+		GError **err);
+
+/**
+ * Creates index from binary image, the image is owned by index after this call
+ * @param image
+ * @param err
+ * @return index or NULL (image is freed in this case)
+ */
+struct rspamd_suffix_index *rspamd_suffix_index_from_image (GByteArray *image,
+		GError **err);
+
+/**
+ * Finds the longest suffix of a domain matched by the index rules (taking
+ * wildcards and exceptions into account)
+ * @param idx
+ * @param domain domain name (case insensitive, trailing dot is ignored)
+ * @param len length of domain
+ * @param out suffix found, points inside domain
+ * @return TRUE if some suffix has been found
+ */
+gboolean rspamd_suffix_index_find (const struct rspamd_suffix_index *idx,
+		const gchar *domain, gsize len, rspamd_ftok_t *out);
+
+/**
+ * Checks if the exact domain is a rule in the index
+ * @param idx
+ * @param domain
+ * @param len
+ * @return
+ */
+gboolean rspamd_suffix_index_has (const struct rspamd_suffix_index *idx,
+		const gchar *domain, gsize len);
+
+typedef void (*rspamd_suffix_index_cb) (const gchar *rule, gsize len,
+		guint flags, gpointer ud);
+
+/**
+ * Calls `cb` for each rule in the index (in domain form, without `*.` or `!`)
+ * @param idx
+ * @param cb
+ * @param ud
+ */
+void rspamd_suffix_index_foreach (const struct rspamd_suffix_index *idx,
+		rspamd_suffix_index_cb cb, gpointer ud);
+
+/**
+ * Returns number of rules in the index
+ * @param idx
+ * @return
+ */
+guint rspamd_suffix_index_count (const struct rspamd_suffix_index *idx);
+
+/**
+ * Unmaps and frees index
+ * @param idx
+ */
+void rspamd_suffix_index_destroy (struct rspamd_suffix_index *idx);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* SRC_LIBUTIL_SUFFIX_INDEX_H_ */
@@ -2476,6 +2476,10 @@ rspamd_lua_push_full_word (lua_State *L, rspamd_stat_token_t *w)
 		lua_pushstring (L, "stemmed");
 		lua_rawseti (L, -2, fl_cnt ++);
 	}
+	if (w->flags & RSPAMD_STAT_TOKEN_FLAG_ASCII) {
+		lua_pushstring (L, "ascii");
+		lua_rawseti (L, -2, fl_cnt ++);
+	}
 
 	lua_rawseti (L, -2, 4);
 }
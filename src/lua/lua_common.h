@@ -163,6 +163,7 @@ struct rspamd_lua_map {
 struct rspamd_lua_cached_entry {
 	gint ref;
 	guint id;
+	gboolean is_volatile; /* Dropped when task data is modified from Lua */
 };
 
 struct rspamd_lua_upstream {
@@ -45,15 +45,61 @@ LUA_FUNCTION_DEF (zstd, compress_ctx);
  */
 LUA_FUNCTION_DEF (zstd, decompress_ctx);
 
+/***
+ * @function zstd.dictionary(data[, level=1])
+ * Creates a dictionary object from the dictionary content (e.g. a file
+ * produced by `zstd --train`). Dictionary id is stored in every frame
+ * compressed with it, so several dictionary versions can be distinguished.
+ * @param {string/text} data dictionary content
+ * @param {number} level compression level
+ * @return {zstd_dict} new dictionary
+ */
+LUA_FUNCTION_DEF (zstd, dictionary);
+
+/***
+ * @function zstd.frame_dict_id(data)
+ * Returns dictionary id required to decompress the frame (0 means no dictionary)
+ * @param {string/text} data compressed frame
+ * @return {number} dictionary id
+ */
+LUA_FUNCTION_DEF (zstd, frame_dict_id);
+
 LUA_FUNCTION_DEF (zstd_compress, stream);
 LUA_FUNCTION_DEF (zstd_compress, dtor);
 
 LUA_FUNCTION_DEF (zstd_decompress, stream);
 LUA_FUNCTION_DEF (zstd_decompress, dtor);
 
+/***
+ * @method zstd_dict:id()
+ * Returns dictionary id (0 for raw content dictionaries)
+ * @return {number} dictionary id
+ */
+LUA_FUNCTION_DEF (zstd_dict, id);
+
+/***
+ * @method zstd_dict:compress(data)
+ * Compresses data using dictionary
+ * @param {string/text} data input data
+ * @return {text} compressed data or nil
+ */
+LUA_FUNCTION_DEF (zstd_dict, compress);
+
+/***
+ * @method zstd_dict:decompress(data)
+ * Decompresses data using dictionary. Frames compressed with no dictionary
+ * are decompressed as well, so it is safe to use it for mixed data
+ * @param {string/text} data compressed data
+ * @return {error,text} error message (or nil) and decompressed data
+ */
+LUA_FUNCTION_DEF (zstd_dict, decompress);
+LUA_FUNCTION_DEF (zstd_dict, dtor);
+
 static const struct luaL_reg zstd_compress_lib_f[] = {
 		LUA_INTERFACE_DEF (zstd, compress_ctx),
 		LUA_INTERFACE_DEF (zstd, decompress_ctx),
+		LUA_INTERFACE_DEF (zstd, dictionary),
+		LUA_INTERFACE_DEF (zstd, frame_dict_id),
 		{NULL, NULL}
 };
 
@@ -69,6 +115,20 @@ static const struct luaL_reg zstd_decompress_lib_m[] = {
 		{NULL, NULL}
 };
 
+static const struct luaL_reg zstd_dict_lib_m[] = {
+		LUA_INTERFACE_DEF (zstd_dict, id),
+		LUA_INTERFACE_DEF (zstd_dict, compress),
+		LUA_INTERFACE_DEF (zstd_dict, decompress),
+		{"__gc", lua_zstd_dict_dtor},
+		{NULL, NULL}
+};
+
+struct lua_zstd_dict {
+	ZSTD_CDict *cdict;
+	ZSTD_DDict *ddict;
+	guint id;
+};
+
 static ZSTD_CStream *
 lua_check_zstd_compress_ctx (lua_State *L, gint pos)
 {
@@ -612,6 +672,218 @@ lua_zstd_decompress_stream (lua_State *L)
 	return 1;
 }
 
+static struct lua_zstd_dict *
+lua_check_zstd_dict (lua_State *L, gint pos)
+{
+	void *ud = rspamd_lua_check_udata (L, pos, "rspamd{zstd_dict}");
+	luaL_argcheck (L, ud != NULL, pos, "'zstd_dict' expected");
+	return ud ? (struct lua_zstd_dict *)ud : NULL;
+}
+
+static gint
+lua_zstd_dictionary (lua_State *L)
+{
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 1);
+	struct lua_zstd_dict *dict;
+	gint comp_level = 1;
+
+	if (t == NULL || t->len == 0) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	if (lua_type (L, 2) == LUA_TNUMBER) {
+		comp_level = lua_tointeger (L, 2);
+	}
+
+	dict = lua_newuserdata (L, sizeof (*dict));
+	memset (dict, 0, sizeof (*dict));
+	rspamd_lua_setclass (L, "rspamd{zstd_dict}", -1);
+	/* Both functions copy dictionary content */
+	dict->cdict = ZSTD_createCDict (t->start, t->len, comp_level);
+	dict->ddict = ZSTD_createDDict (t->start, t->len);
+
+	if (dict->cdict == NULL || dict->ddict == NULL) {
+		return luaL_error (L, "cannot load zstd dictionary");
+	}
+
+	dict->id = ZSTD_getDictID_fromDict (t->start, t->len);
+
+	return 1;
+}
+
+static gint
+lua_zstd_frame_dict_id (lua_State *L)
+{
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 1);
+
+	if (t == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	lua_pushinteger (L, ZSTD_getDictID_fromFrame (t->start, t->len));
+
+	return 1;
+}
+
+static gint
+lua_zstd_dict_dtor (lua_State *L)
+{
+	struct lua_zstd_dict *dict = lua_check_zstd_dict (L, 1);
+
+	if (dict) {
+		if (dict->cdict) {
+			ZSTD_freeCDict (dict->cdict);
+		}
+		if (dict->ddict) {
+			ZSTD_freeDDict (dict->ddict);
+		}
+	}
+
+	return 0;
+}
+
+static gint
+lua_zstd_dict_id (lua_State *L)
+{
+	struct lua_zstd_dict *dict = lua_check_zstd_dict (L, 1);
+
+	if (dict == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	lua_pushinteger (L, dict->id);
+
+	return 1;
+}
+
+static gint
+lua_zstd_dict_compress (lua_State *L)
+{
+	struct lua_zstd_dict *dict = lua_check_zstd_dict (L, 1);
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 2), *res;
+	/* Contexts are reused between calls to avoid allocations */
+	static ZSTD_CCtx *cctx = NULL;
+	gsize sz, r;
+
+	if (dict == NULL || t == NULL || t->start == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	if (cctx == NULL) {
+		cctx = ZSTD_createCCtx ();
+
+		if (cctx == NULL) {
+			return luaL_error (L, "context create failed");
+		}
+	}
+
+	sz = ZSTD_compressBound (t->len);
+	res = lua_new_text (L, NULL, 0, FALSE);
+	res->start = g_malloc (sz);
+	res->flags = RSPAMD_TEXT_FLAG_OWN;
+	r = ZSTD_compress_usingCDict (cctx, (void *)res->start, sz,
+			t->start, t->len, dict->cdict);
+
+	if (ZSTD_isError (r)) {
+		msg_err ("cannot compress data: %s", ZSTD_getErrorName (r));
+		lua_pop (L, 1); /* Text will be freed here */
+		lua_pushnil (L);
+
+		return 1;
+	}
+
+	res->len = r;
+
+	return 1;
+}
+
+static gint
+lua_zstd_dict_decompress (lua_State *L)
+{
+	struct lua_zstd_dict *dict = lua_check_zstd_dict (L, 1);
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 2);
+	static ZSTD_DStream *zstream = NULL;
+	ZSTD_inBuffer zin;
+	ZSTD_outBuffer zout;
+	unsigned long long outlen;
+	guint frame_dict;
+	gsize r;
+	gchar *out;
+
+	if (dict == NULL || t == NULL || t->start == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	frame_dict = ZSTD_getDictID_fromFrame (t->start, t->len);
+
+	if (frame_dict != 0 && frame_dict != dict->id) {
+		lua_pushfstring (L, "invalid dictionary id: %d, expected %d",
+				(gint)frame_dict, (gint)dict->id);
+		lua_pushnil (L);
+
+		return 2;
+	}
+
+	if (zstream == NULL) {
+		zstream = ZSTD_createDStream ();
+
+		if (zstream == NULL) {
+			return luaL_error (L, "context create failed");
+		}
+	}
+
+	ZSTD_DCtx_reset (zstream, ZSTD_reset_session_and_parameters);
+
+	if (frame_dict == dict->id) {
+		/* Raw content dictionaries have no id, so frames have no id as well */
+		ZSTD_DCtx_refDDict (zstream, dict->ddict);
+	}
+
+	zin.pos = 0;
+	zin.src = t->start;
+	zin.size = t->len;
+
+	outlen = ZSTD_getFrameContentSize (zin.src, zin.size);
+
+	if (outlen == ZSTD_CONTENTSIZE_UNKNOWN || outlen == ZSTD_CONTENTSIZE_ERROR ||
+		outlen == 0) {
+		outlen = ZSTD_DStreamOutSize ();
+	}
+
+	out = g_malloc (outlen);
+	zout.dst = out;
+	zout.pos = 0;
+	zout.size = outlen;
+
+	while (zin.pos < zin.size) {
+		r = ZSTD_decompressStream (zstream, &zout, &zin);
+
+		if (ZSTD_isError (r)) {
+			g_free (out);
+			lua_pushstring (L, ZSTD_getErrorName (r));
+			lua_pushnil (L);
+
+			return 2;
+		}
+
+		if (zin.pos < zin.size && zout.pos == zout.size) {
+			/* We need to extend output buffer */
+			zout.size = zout.size * 2;
+			out = g_realloc (zout.dst, zout.size);
+			zout.dst = out;
+		}
+	}
+
+	lua_pushnil (L); /* Error */
+	lua_new_text (L, NULL, 0, FALSE);
+	t = lua_check_text (L, -1);
+	t->start = out;
+	t->len = zout.pos;
+	t->flags = RSPAMD_TEXT_FLAG_OWN;
+
+	return 2;
+}
+
 static gint
 lua_load_zstd (lua_State * L)
 {
@@ -626,7 +898,8 @@ luaopen_compress (lua_State *L)
 {
 	rspamd_lua_new_class (L, "rspamd{zstd_compress}", zstd_compress_lib_m);
 	rspamd_lua_new_class (L, "rspamd{zstd_decompress}", zstd_decompress_lib_m);
-	lua_pop (L, 2);
+	rspamd_lua_new_class (L, "rspamd{zstd_dict}", zstd_dict_lib_m);
+	lua_pop (L, 3);
 
 	rspamd_lua_add_preload (L, "rspamd_zstd", lua_load_zstd);
 }
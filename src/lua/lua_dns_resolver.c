@@ -52,6 +52,7 @@ LUA_FUNCTION_DEF (dns_resolver, resolve_mx);
 LUA_FUNCTION_DEF (dns_resolver, resolve_ns);
 LUA_FUNCTION_DEF (dns_resolver, resolve);
 LUA_FUNCTION_DEF (dns_resolver, idna_convert_utf8);
+LUA_FUNCTION_DEF (dns_resolver, get_stats);
 
 void lua_push_dns_reply (lua_State *L, const struct rdns_reply *reply);
 
@@ -68,6 +69,7 @@ static const struct luaL_reg dns_resolverlib_m[] = {
 	LUA_INTERFACE_DEF (dns_resolver, resolve_ns),
 	LUA_INTERFACE_DEF (dns_resolver, resolve),
 	LUA_INTERFACE_DEF (dns_resolver, idna_convert_utf8),
+	LUA_INTERFACE_DEF (dns_resolver, get_stats),
 	{"__tostring", rspamd_lua_class_tostring},
 	{NULL, NULL}
 };
@@ -736,6 +738,32 @@ lua_dns_resolver_idna_convert_utf8 (lua_State *L)
 	return 1;
 }
 
+/***
+ * @method resolver:get_stats()
+ * Returns requests statistics for this resolver
+ * @return {table} table with `sent` (requests sent to servers), `coalesced` (requests merged with an identical outstanding one) and `inflight` (currently outstanding requests) fields
+ */
+static int
+lua_dns_resolver_get_stats (lua_State *L)
+{
+	struct rspamd_dns_resolver *dns_resolver = lua_check_dns_resolver (L, 1);
+
+	if (dns_resolver) {
+		lua_createtable (L, 0, 3);
+		lua_pushinteger (L, dns_resolver->requests_sent);
+		lua_setfield (L, -2, "sent");
+		lua_pushinteger (L, dns_resolver->requests_coalesced);
+		lua_setfield (L, -2, "coalesced");
+		lua_pushinteger (L, g_hash_table_size (dns_resolver->inflight));
+		lua_setfield (L, -2, "inflight");
+	}
+	else {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static gint
 lua_load_dns_resolver (lua_State *L)
 {
@@ -15,6 +15,8 @@
  */
 #include "lua_common.h"
 #include "expression.h"
+#include "libserver/re_cache.h"
+#include "libmime/scan_result.h"
 
 /***
  * @module rspamd_expression
@@ -29,6 +31,12 @@
  * @param {table} atom_functions parse_atom function and optional process_atom function
  * @param {rspamd_mempool} memory pool to use for this function
  * @return {expr, err} expression object and error message of `expr` is nil
+ *
+ * Parse function can also return a table instead of a string to define a native atom that is
+ * evaluated without calling Lua when an expression is processed by `process_task_traced`:
+ *
+ * - `{name = 'SYM', type = 'symbol', symbol = 'REAL_SYM'}`: checks if `symbol` (defaults to `name`) is in the task results
+ * - `{name = 'RE', type = 'regexp', re = re, re_type = 'header', header = 'Subject', strong = false}`: checks regexp via re_cache
  * @example
 require "fun" ()
 local rspamd_expression = require "rspamd_expression"
@@ -77,6 +85,17 @@ LUA_FUNCTION_DEF (expr, process);
  */
 LUA_FUNCTION_DEF (expr, process_traced);
 
+/***
+ * @method rspamd_expression:process_task_traced(task, [named_result], [callback][, flags])
+ * Executes the expression for the specified task. Native atoms (see `create`) are
+ * evaluated directly, other atoms are passed to the callback as `callback(atom, task)`
+ * @param {rspamd_task} task task object
+ * @param {string} named_result named result to check symbols in (default result if not specified)
+ * @param {function} callback callback for non-native atoms, process_func is used if not specified
+ * @return {number, table of matched atoms} result of the expression evaluation
+ */
+LUA_FUNCTION_DEF (expr, process_task_traced);
+
 /***
  * @method rspamd_expression:atoms()
  * Extract all atoms from the expression as table of strings
@@ -89,6 +108,7 @@ static const struct luaL_reg exprlib_m[] = {
 	LUA_INTERFACE_DEF (expr, atoms),
 	LUA_INTERFACE_DEF (expr, process),
 	LUA_INTERFACE_DEF (expr, process_traced),
+	LUA_INTERFACE_DEF (expr, process_task_traced),
 	{"__tostring", lua_expr_to_string},
 	{NULL, NULL}
 };
@@ -117,6 +137,23 @@ struct lua_expression {
 	rspamd_mempool_t *pool;
 };
 
+enum lua_expression_atom_type {
+	LUA_EXPRESSION_ATOM_CALLBACK = 0,
+	LUA_EXPRESSION_ATOM_SYMBOL,
+	LUA_EXPRESSION_ATOM_REGEXP,
+};
+
+/* Atoms that could be evaluated with no Lua calls */
+struct lua_expression_atom {
+	enum lua_expression_atom_type type;
+	const gchar *symbol;
+	rspamd_regexp_t *re;
+	enum rspamd_re_type re_type;
+	const gchar *header;
+	gsize header_len;
+	gboolean strong;
+};
+
 static GQuark
 lua_expr_quark (void)
 {
@@ -145,12 +182,109 @@ lua_expr_dtor (gpointer p)
 	}
 }
 
+static gboolean
+lua_atom_parse_native (lua_State *L, struct lua_expression *e,
+		struct lua_expression_atom *na, GError **err)
+{
+	const gchar *type_str;
+	gsize hlen;
+
+	lua_getfield (L, -1, "type");
+	type_str = lua_tostring (L, -1);
+
+	if (type_str == NULL) {
+		lua_pop (L, 1);
+		g_set_error (err, lua_expr_quark(), 500, "no type for native atom");
+
+		return FALSE;
+	}
+
+	if (strcmp (type_str, "symbol") == 0) {
+		na->type = LUA_EXPRESSION_ATOM_SYMBOL;
+		lua_pop (L, 1);
+		lua_getfield (L, -1, "symbol");
+
+		if (lua_type (L, -1) != LUA_TSTRING) {
+			lua_pop (L, 1);
+			lua_getfield (L, -1, "name");
+		}
+
+		na->symbol = rspamd_mempool_strdup (e->pool, lua_tostring (L, -1));
+		lua_pop (L, 1);
+	}
+	else if (strcmp (type_str, "regexp") == 0) {
+		struct rspamd_lua_regexp *lre;
+		void *ud;
+
+		na->type = LUA_EXPRESSION_ATOM_REGEXP;
+		lua_pop (L, 1);
+
+		lua_getfield (L, -1, "re");
+		ud = rspamd_lua_check_udata_maybe (L, -1, "rspamd{regexp}");
+		lre = ud ? *((struct rspamd_lua_regexp **)ud) : NULL;
+		lua_pop (L, 1);
+
+		if (lre == NULL || lre->re == NULL) {
+			g_set_error (err, lua_expr_quark(), 500, "no regexp for native atom");
+
+			return FALSE;
+		}
+
+		lua_getfield (L, -1, "re_type");
+		na->re_type = rspamd_re_cache_type_from_string (lua_tostring (L, -1));
+		lua_pop (L, 1);
+
+		if (na->re_type == RSPAMD_RE_MAX) {
+			g_set_error (err, lua_expr_quark(), 500, "bad regexp type for native atom");
+
+			return FALSE;
+		}
+
+		lua_getfield (L, -1, "header");
+
+		if (lua_type (L, -1) == LUA_TSTRING) {
+			const gchar *hdr = lua_tolstring (L, -1, &hlen);
+
+			na->header = rspamd_mempool_strdup (e->pool, hdr);
+			na->header_len = hlen;
+		}
+		else if (na->re_type == RSPAMD_RE_HEADER ||
+				na->re_type == RSPAMD_RE_RAWHEADER ||
+				na->re_type == RSPAMD_RE_MIMEHEADER) {
+			lua_pop (L, 1);
+			g_set_error (err, lua_expr_quark(), 500, "header is required for native atom");
+
+			return FALSE;
+		}
+
+		lua_pop (L, 1);
+
+		lua_getfield (L, -1, "strong");
+		na->strong = lua_toboolean (L, -1);
+		lua_pop (L, 1);
+
+		na->re = rspamd_regexp_ref (lre->re);
+		rspamd_mempool_add_destructor (e->pool,
+				(rspamd_mempool_destruct_t)rspamd_regexp_unref, na->re);
+	}
+	else {
+		g_set_error (err, lua_expr_quark(), 500, "bad type for native atom: %s",
+				type_str);
+		lua_pop (L, 1);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static rspamd_expression_atom_t *
 lua_atom_parse (const gchar *line, gsize len,
 			rspamd_mempool_t *pool, gpointer ud, GError **err)
 {
 	struct lua_expression *e = (struct lua_expression *)ud;
 	rspamd_expression_atom_t *atom;
+	struct lua_expression_atom *na;
 	gsize rlen;
 	const gchar *tok;
 
@@ -163,7 +297,26 @@ lua_atom_parse (const gchar *line, gsize len,
 		return NULL;
 	}
 
-	if (lua_type (e->L, -1) != LUA_TSTRING) {
+	na = rspamd_mempool_alloc0 (e->pool, sizeof (*na));
+
+	if (lua_type (e->L, -1) == LUA_TTABLE) {
+		if (!lua_atom_parse_native (e->L, e, na, err)) {
+			lua_pop (e->L, 1);
+			return NULL;
+		}
+
+		lua_getfield (e->L, -1, "name");
+
+		if (lua_type (e->L, -1) != LUA_TSTRING) {
+			g_set_error (err, lua_expr_quark(), 500, "no name for native atom");
+			lua_pop (e->L, 2);
+			return NULL;
+		}
+
+		/* Keep just the name on the stack */
+		lua_replace (e->L, -2);
+	}
+	else if (lua_type (e->L, -1) != LUA_TSTRING) {
 		g_set_error (err, lua_expr_quark(), 500, "cannot parse lua atom");
 		lua_pop (e->L, 1);
 		return NULL;
@@ -173,7 +326,11 @@ lua_atom_parse (const gchar *line, gsize len,
 	atom = rspamd_mempool_alloc0 (e->pool, sizeof (*atom));
 	atom->str = rspamd_mempool_strdup (e->pool, tok);
 	atom->len = rlen;
-	atom->data = ud;
+	atom->data = na;
+
+	if (na->type == LUA_EXPRESSION_ATOM_SYMBOL && na->symbol == NULL) {
+		na->symbol = atom->str;
+	}
 
 	lua_pop (e->L, 1);
 
@@ -185,16 +342,53 @@ struct lua_atom_process_data {
 	struct lua_expression *e;
 	gint process_cb_pos;
 	gint stack_item;
+	struct rspamd_task *task;
+	struct rspamd_scan_result *res;
 };
 
+static gdouble
+lua_atom_process_native (struct lua_atom_process_data *pd,
+		struct lua_expression_atom *na)
+{
+	struct rspamd_symbol_result *s;
+
+	switch (na->type) {
+	case LUA_EXPRESSION_ATOM_SYMBOL:
+		s = rspamd_task_find_symbol_result (pd->task, na->symbol, pd->res);
+
+		if (s && !(s->flags & RSPAMD_SYMBOL_RESULT_IGNORED)) {
+			return 1;
+		}
+		break;
+	case LUA_EXPRESSION_ATOM_REGEXP:
+		return rspamd_re_cache_process (pd->task, na->re, na->re_type,
+				na->header, na->header_len, na->strong);
+	default:
+		break;
+	}
+
+	return 0;
+}
+
 static gdouble
 lua_atom_process (gpointer runtime_ud, rspamd_expression_atom_t *atom)
 {
 	struct lua_atom_process_data *pd = (struct lua_atom_process_data *)runtime_ud;
+	struct lua_expression_atom *na = (struct lua_expression_atom *)atom->data;
 	gdouble ret = 0;
 	guint nargs;
 	gint err_idx;
 
+	if (pd->task != NULL) {
+		if (na->type != LUA_EXPRESSION_ATOM_CALLBACK) {
+			return lua_atom_process_native (pd, na);
+		}
+
+		if (pd->process_cb_pos == -1) {
+			return 0;
+		}
+	}
+
 	if (pd->stack_item != -1) {
 		nargs = 2;
 	}
@@ -238,6 +432,8 @@ lua_expr_process (lua_State *L)
 
 	pd.L = L;
 	pd.e = e;
+	pd.task = NULL;
+	pd.res = NULL;
 	old_top = lua_gettop (L);
 
 	if (e->process_idx == -1) {
@@ -294,6 +490,8 @@ lua_expr_process_traced (lua_State *L)
 
 	pd.L = L;
 	pd.e = e;
+	pd.task = NULL;
+	pd.res = NULL;
 	old_top = lua_gettop (L);
 
 	if (e->process_idx == -1) {
@@ -337,6 +535,67 @@ lua_expr_process_traced (lua_State *L)
 	return 2;
 }
 
+static gint
+lua_expr_process_task_traced (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct lua_expression *e = rspamd_lua_expression (L, 1);
+	struct rspamd_task *task = lua_check_task (L, 2);
+	struct lua_atom_process_data pd;
+	gdouble res;
+	gint flags = 0, old_top;
+	GPtrArray *trace;
+
+	if (e == NULL || task == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	pd.L = L;
+	pd.e = e;
+	pd.task = task;
+	pd.res = NULL;
+	/* Task is passed to the callbacks for non-native atoms */
+	pd.stack_item = 2;
+	old_top = lua_gettop (L);
+
+	if (lua_type (L, 3) == LUA_TSTRING) {
+		pd.res = rspamd_find_metric_result (task, lua_tostring (L, 3));
+	}
+
+	if (lua_isfunction (L, 4)) {
+		pd.process_cb_pos = 4;
+	}
+	else if (e->process_idx != -1) {
+		lua_rawgeti (L, LUA_REGISTRYINDEX, e->process_idx);
+		pd.process_cb_pos = lua_gettop (L);
+	}
+	else {
+		pd.process_cb_pos = -1;
+	}
+
+	if (lua_isnumber (L, 5)) {
+		flags = lua_tointeger (L, 5);
+	}
+
+	res = rspamd_process_expression_track (e->expr, flags, &pd, &trace);
+
+	lua_settop (L, old_top);
+	lua_pushnumber (L, res);
+
+	lua_createtable (L, trace->len, 0);
+
+	for (guint i = 0; i < trace->len; i ++) {
+		struct rspamd_expression_atom_s *atom = g_ptr_array_index (trace, i);
+
+		lua_pushlstring (L, atom->str, atom->len);
+		lua_rawseti (L, -2, i + 1);
+	}
+
+	g_ptr_array_free (trace, TRUE);
+
+	return 2;
+}
+
 static gint
 lua_expr_create (lua_State *L)
 {
@@ -422,7 +422,8 @@ lua_http_make_connection (struct lua_http_cbdata *cbd)
 				lua_http_finish_handler,
 				http_opts,
 				cbd->addr,
-				cbd->host);
+				cbd->host,
+				NULL);
 	}
 	else {
 		cbd->fd = -1;
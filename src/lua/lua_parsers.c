@@ -90,12 +90,23 @@
  * @return {number} time as unix timestamp (converted to float)
  */
 
+/***
+ * @function parsers.parse_pdf_object(input)
+ * Parses the first PDF object in the input (e.g. a dictionary preceding a stream)
+ * to Lua values: dictionaries and arrays are converted to tables, names and
+ * strings to strings, numbers to numbers and references to tables in form
+ * `{'%REF%', major, minor}`
+ * @param {string|text} input input data
+ * @return {any} parsed object or nil if it cannot be parsed
+ */
+
 static const struct luaL_reg parserslib_f[] = {
 	LUA_INTERFACE_DEF (parsers, tokenize_text),
 	LUA_INTERFACE_DEF (parsers, parse_html),
 	LUA_INTERFACE_DEF (parsers, parse_mail_address),
 	LUA_INTERFACE_DEF (parsers, parse_content_type),
 	LUA_INTERFACE_DEF (parsers, parse_smtp_date),
+	LUA_INTERFACE_DEF (parsers, parse_pdf_object),
 
 	{NULL, NULL}
 };
@@ -269,7 +280,13 @@ lua_parsers_parse_mail_address (lua_State *L)
 			own_pool = TRUE;
 		}
 
-		addrs = rspamd_email_address_from_mime (pool, str, len, NULL, max_addrs);
+		/*
+		 * Our own pool is destroyed before the string can be collected, so
+		 * addresses can refer to the lua string directly
+		 */
+		addrs = rspamd_email_address_from_mime (pool, str, len, NULL, max_addrs,
+				own_pool ? RSPAMD_EMAIL_ADDR_PARSE_POOL_OWNED :
+				RSPAMD_EMAIL_ADDR_PARSE_DEFAULT);
 
 		if (addrs == NULL) {
 			lua_pushnil (L);
@@ -399,6 +416,488 @@ lua_parsers_parse_smtp_date (lua_State *L)
 	return 1;
 }
 
+/* Nesting limit for PDF arrays and dictionaries */
+#define PDF_MAX_DEPTH 32
+
+struct lua_pdf_parser {
+	const guchar *p;
+	const guchar *end;
+};
+
+static inline gboolean
+lua_pdf_is_ws (guchar c)
+{
+	return c == '\0' || c == ' ' || c == '\r' || c == '\n' ||
+		   c == '\t' || c == '\f';
+}
+
+static inline gboolean
+lua_pdf_is_delim (guchar c)
+{
+	return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' ||
+		   c == ']' || c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+static inline gint
+lua_pdf_hexval (guchar c)
+{
+	if (g_ascii_isdigit (c)) {
+		return c - '0';
+	}
+	else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/* Skips whitespaces and comments */
+static void
+lua_pdf_skip_ws (struct lua_pdf_parser *st)
+{
+	while (st->p < st->end) {
+		if (lua_pdf_is_ws (*st->p)) {
+			st->p ++;
+		}
+		else if (*st->p == '%') {
+			while (st->p < st->end && *st->p != '\r' && *st->p != '\n') {
+				st->p ++;
+			}
+		}
+		else {
+			break;
+		}
+	}
+}
+
+static gboolean
+lua_pdf_parse_literal (lua_State *L, struct lua_pdf_parser *st)
+{
+	luaL_Buffer buf;
+	gint nesting = 1;
+	guchar c;
+
+	st->p ++; /* ( */
+	luaL_buffinit (L, &buf);
+
+	while (st->p < st->end) {
+		c = *st->p ++;
+
+		if (c == '\\') {
+			if (st->p >= st->end) {
+				break;
+			}
+
+			c = *st->p ++;
+
+			switch (c) {
+			case 'n':
+				luaL_addchar (&buf, '\n');
+				break;
+			case 'r':
+				luaL_addchar (&buf, '\r');
+				break;
+			case 't':
+				luaL_addchar (&buf, '\t');
+				break;
+			case 'b':
+				luaL_addchar (&buf, '\b');
+				break;
+			case 'f':
+				luaL_addchar (&buf, '\f');
+				break;
+			case '\r':
+				/* Line continuation */
+				if (st->p < st->end && *st->p == '\n') {
+					st->p ++;
+				}
+				break;
+			case '\n':
+				break;
+			default:
+				if (c >= '0' && c <= '7') {
+					guint oct = c - '0', i;
+
+					for (i = 0; i < 2 && st->p < st->end &&
+							*st->p >= '0' && *st->p <= '7'; i ++) {
+						oct = oct * 8 + (*st->p ++ - '0');
+					}
+
+					luaL_addchar (&buf, (guchar)(oct & 0xff));
+				}
+				else {
+					luaL_addchar (&buf, c);
+				}
+				break;
+			}
+		}
+		else if (c == '(') {
+			nesting ++;
+			luaL_addchar (&buf, c);
+		}
+		else if (c == ')') {
+			if (--nesting == 0) {
+				luaL_pushresult (&buf);
+
+				return TRUE;
+			}
+
+			luaL_addchar (&buf, c);
+		}
+		else {
+			luaL_addchar (&buf, c);
+		}
+	}
+
+	/* Unterminated string */
+	luaL_pushresult (&buf);
+	lua_pop (L, 1);
+
+	return FALSE;
+}
+
+static gboolean
+lua_pdf_parse_hexstring (lua_State *L, struct lua_pdf_parser *st)
+{
+	luaL_Buffer buf;
+	gint hi = -1, v;
+
+	st->p ++; /* < */
+	luaL_buffinit (L, &buf);
+
+	while (st->p < st->end) {
+		guchar c = *st->p ++;
+
+		if (c == '>') {
+			if (hi != -1) {
+				/* Odd number of digits, the last one is followed by an implicit 0 */
+				luaL_addchar (&buf, (guchar)(hi << 4));
+			}
+
+			luaL_pushresult (&buf);
+
+			return TRUE;
+		}
+		else if (lua_pdf_is_ws (c)) {
+			continue;
+		}
+
+		v = lua_pdf_hexval (c);
+
+		if (v == -1) {
+			break;
+		}
+
+		if (hi == -1) {
+			hi = v;
+		}
+		else {
+			luaL_addchar (&buf, (guchar)((hi << 4) | v));
+			hi = -1;
+		}
+	}
+
+	luaL_pushresult (&buf);
+	lua_pop (L, 1);
+
+	return FALSE;
+}
+
+static void
+lua_pdf_parse_name (lua_State *L, struct lua_pdf_parser *st)
+{
+	luaL_Buffer buf;
+
+	st->p ++; /* / */
+	luaL_buffinit (L, &buf);
+
+	while (st->p < st->end && !lua_pdf_is_ws (*st->p) &&
+			!lua_pdf_is_delim (*st->p)) {
+		guchar c = *st->p ++;
+
+		if (c == '#' && st->end - st->p >= 2 &&
+				lua_pdf_hexval (st->p[0]) != -1 && lua_pdf_hexval (st->p[1]) != -1) {
+			c = (lua_pdf_hexval (st->p[0]) << 4) | lua_pdf_hexval (st->p[1]);
+			st->p += 2;
+		}
+
+		luaL_addchar (&buf, c);
+	}
+
+	luaL_pushresult (&buf);
+}
+
+/* Reads unsigned integer and returns the number of digits read */
+static gsize
+lua_pdf_read_digits (const guchar *p, const guchar *end, guint64 *val)
+{
+	const guchar *start = p;
+
+	*val = 0;
+
+	while (p < end && g_ascii_isdigit (*p)) {
+		*val = *val * 10 + (*p - '0');
+		p ++;
+	}
+
+	return p - start;
+}
+
+/* Tries to parse `major minor R` reference */
+static gboolean
+lua_pdf_parse_ref (lua_State *L, struct lua_pdf_parser *st)
+{
+	const guchar *p = st->p;
+	guint64 major, minor;
+	gsize dlen;
+
+	dlen = lua_pdf_read_digits (p, st->end, &major);
+
+	if (dlen == 0 || p + dlen >= st->end || !lua_pdf_is_ws (p[dlen])) {
+		return FALSE;
+	}
+
+	p += dlen;
+
+	while (p < st->end && lua_pdf_is_ws (*p)) {
+		p ++;
+	}
+
+	dlen = lua_pdf_read_digits (p, st->end, &minor);
+
+	if (dlen == 0 || p + dlen >= st->end || !lua_pdf_is_ws (p[dlen])) {
+		return FALSE;
+	}
+
+	p += dlen;
+
+	while (p < st->end && lua_pdf_is_ws (*p)) {
+		p ++;
+	}
+
+	if (p >= st->end || *p != 'R') {
+		return FALSE;
+	}
+
+	p ++;
+
+	if (p < st->end && !lua_pdf_is_ws (*p) && !lua_pdf_is_delim (*p)) {
+		return FALSE;
+	}
+
+	st->p = p;
+	lua_createtable (L, 3, 0);
+	lua_pushstring (L, "%REF%");
+	lua_rawseti (L, -2, 1);
+	lua_pushfstring (L, "%d", (gint)major);
+	lua_rawseti (L, -2, 2);
+	lua_pushfstring (L, "%d", (gint)minor);
+	lua_rawseti (L, -2, 3);
+
+	return TRUE;
+}
+
+static gboolean
+lua_pdf_parse_number (lua_State *L, struct lua_pdf_parser *st)
+{
+	const guchar *p = st->p;
+	gdouble res = 0, mult = 0.1;
+	gboolean neg = FALSE, has_digits = FALSE;
+
+	if (*p == '-' || *p == '+') {
+		neg = (*p == '-');
+		p ++;
+	}
+
+	while (p < st->end && g_ascii_isdigit (*p)) {
+		res = res * 10.0 + (*p - '0');
+		has_digits = TRUE;
+		p ++;
+	}
+
+	if (p < st->end && *p == '.') {
+		p ++;
+
+		while (p < st->end && g_ascii_isdigit (*p)) {
+			res += (*p - '0') * mult;
+			mult /= 10.0;
+			has_digits = TRUE;
+			p ++;
+		}
+	}
+
+	if (!has_digits) {
+		return FALSE;
+	}
+
+	st->p = p;
+	lua_pushnumber (L, neg ? -res : res);
+
+	return TRUE;
+}
+
+static gboolean
+lua_pdf_match_keyword (struct lua_pdf_parser *st, const gchar *kw, gsize kwlen)
+{
+	if ((gsize)(st->end - st->p) >= kwlen && memcmp (st->p, kw, kwlen) == 0 &&
+		(st->p + kwlen == st->end || lua_pdf_is_ws (st->p[kwlen]) ||
+		lua_pdf_is_delim (st->p[kwlen]))) {
+		st->p += kwlen;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Parses a single PDF element and pushes it on the Lua stack,
+ * `null` is pushed as nil
+ */
+static gboolean
+lua_pdf_parse_elt (lua_State *L, struct lua_pdf_parser *st, guint depth)
+{
+	guchar c;
+
+	lua_pdf_skip_ws (st);
+
+	if (st->p >= st->end) {
+		return FALSE;
+	}
+
+	c = *st->p;
+
+	if (c == '<' && st->p + 1 < st->end && st->p[1] == '<') {
+		if (depth >= PDF_MAX_DEPTH || !lua_checkstack (L, 4)) {
+			return FALSE;
+		}
+
+		st->p += 2;
+		lua_createtable (L, 0, 4);
+
+		for (;;) {
+			lua_pdf_skip_ws (st);
+
+			if (st->p + 1 < st->end && st->p[0] == '>' && st->p[1] == '>') {
+				st->p += 2;
+
+				return TRUE;
+			}
+
+			if (st->p >= st->end || *st->p != '/') {
+				break;
+			}
+
+			lua_pdf_parse_name (L, st);
+
+			if (!lua_pdf_parse_elt (L, st, depth + 1)) {
+				lua_pop (L, 1); /* Key */
+				break;
+			}
+
+			lua_rawset (L, -3);
+		}
+
+		lua_pop (L, 1); /* Table */
+
+		return FALSE;
+	}
+	else if (c == '[') {
+		gint idx = 1;
+
+		if (depth >= PDF_MAX_DEPTH || !lua_checkstack (L, 4)) {
+			return FALSE;
+		}
+
+		st->p ++;
+		lua_createtable (L, 4, 0);
+
+		for (;;) {
+			lua_pdf_skip_ws (st);
+
+			if (st->p < st->end && *st->p == ']') {
+				st->p ++;
+
+				return TRUE;
+			}
+
+			if (!lua_pdf_parse_elt (L, st, depth + 1)) {
+				break;
+			}
+
+			if (lua_isnil (L, -1)) {
+				lua_pop (L, 1);
+			}
+			else {
+				lua_rawseti (L, -2, idx ++);
+			}
+		}
+
+		lua_pop (L, 1); /* Table */
+
+		return FALSE;
+	}
+	else if (c == '<') {
+		return lua_pdf_parse_hexstring (L, st);
+	}
+	else if (c == '(') {
+		return lua_pdf_parse_literal (L, st);
+	}
+	else if (c == '/') {
+		lua_pdf_parse_name (L, st);
+
+		return TRUE;
+	}
+	else if (g_ascii_isdigit (c) || c == '-' || c == '+' || c == '.') {
+		if (g_ascii_isdigit (c) && lua_pdf_parse_ref (L, st)) {
+			return TRUE;
+		}
+
+		return lua_pdf_parse_number (L, st);
+	}
+	else if (lua_pdf_match_keyword (st, "true", sizeof ("true") - 1)) {
+		lua_pushstring (L, "true");
+
+		return TRUE;
+	}
+	else if (lua_pdf_match_keyword (st, "false", sizeof ("false") - 1)) {
+		lua_pushstring (L, "false");
+
+		return TRUE;
+	}
+	else if (lua_pdf_match_keyword (st, "null", sizeof ("null") - 1)) {
+		lua_pushnil (L);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+int
+lua_parsers_parse_pdf_object (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 1);
+	struct lua_pdf_parser st;
+
+	if (t == NULL) {
+		return luaL_argerror (L, 1, "invalid argument");
+	}
+
+	st.p = (const guchar *)t->start;
+	st.end = st.p + t->len;
+
+	if (!lua_pdf_parse_elt (L, &st, 0)) {
+		lua_pushnil (L);
+	}
+
+	return 1;
+}
+
 static gint
 lua_load_parsers (lua_State * L)
 {
@@ -84,5 +84,16 @@ LUA_PUBLIC_FUNCTION_DEF (parsers, parse_content_type);
  */
 LUA_PUBLIC_FUNCTION_DEF (parsers, parse_smtp_date);
 
+/***
+ * @function parsers.parse_pdf_object(input)
+ * Parses the first PDF object in the input (e.g. a dictionary preceding a stream)
+ * to Lua values: dictionaries and arrays are converted to tables, names and
+ * strings to strings, numbers to numbers and references to tables in form
+ * `{'%REF%', major, minor}`
+ * @param {string|text} input input data
+ * @return {any} parsed object or nil if it cannot be parsed
+ */
+LUA_PUBLIC_FUNCTION_DEF (parsers, parse_pdf_object);
+
 
 #endif //RSPAMD_LUA_PARSERS_H
@@ -132,6 +132,8 @@ struct lua_redis_request_specific_userdata {
 	gsize *arglens;
 	struct lua_redis_userdata *c;
 	struct lua_redis_ctx *ctx;
+	/* Symcache item of the caller, commands may come from different symbols */
+	struct rspamd_symcache_dynamic_item *item;
 	struct lua_redis_request_specific_userdata *next;
 	ev_timer timeout_ev;
 	guint flags;
@@ -306,8 +308,8 @@ lua_redis_push_error (const gchar *err,
 			/* Data is nil */
 			lua_pushnil (cbs.L);
 
-			if (ud->item) {
-				rspamd_symcache_set_cur_item (ud->task, ud->item);
+			if (sp_ud->item) {
+				rspamd_symcache_set_cur_item (ud->task, sp_ud->item);
 			}
 
 			if (lua_pcall (cbs.L, 2, 0, err_idx) != 0) {
@@ -321,8 +323,8 @@ lua_redis_push_error (const gchar *err,
 		sp_ud->flags |= LUA_REDIS_SPECIFIC_REPLIED;
 
 		if (connected && ud->s) {
-			if (ud->item) {
-				rspamd_symcache_item_async_dec_check (ud->task, ud->item, M);
+			if (sp_ud->item) {
+				rspamd_symcache_item_async_dec_check (ud->task, sp_ud->item, M);
 			}
 
 			rspamd_session_remove_event (ud->s, lua_redis_fin, sp_ud);
@@ -400,8 +402,8 @@ lua_redis_push_data (const redisReply *r, struct lua_redis_ctx *ctx,
 			/* Data */
 			lua_redis_push_reply (cbs.L, r, ctx->flags & LUA_REDIS_TEXTDATA);
 
-			if (ud->item) {
-				rspamd_symcache_set_cur_item (ud->task, ud->item);
+			if (sp_ud->item) {
+				rspamd_symcache_set_cur_item (ud->task, sp_ud->item);
 			}
 
 			gint ret = lua_pcall (cbs.L, 2, 0, err_idx);
@@ -428,9 +430,9 @@ lua_redis_push_data (const redisReply *r, struct lua_redis_ctx *ctx,
 
 		if (!(sp_ud->flags & LUA_REDIS_SUBSCRIBED)) {
 			if (ud->s) {
-				if (ud->item) {
+				if (sp_ud->item) {
 					rspamd_symcache_item_async_dec_check (ud->task,
-							ud->item, M);
+							sp_ud->item, M);
 				}
 
 				rspamd_session_remove_event (ud->s, lua_redis_fin, sp_ud);
@@ -502,6 +504,7 @@ lua_redis_callback (redisAsyncContext *c, gpointer r, gpointer priv)
 		if (ctx->cmds_pending == 0 && !ud->terminated) {
 			/* Disconnect redis early as we don't need it anymore */
 			ud->terminated = 1;
+			ctx->flags |= LUA_REDIS_TERMINATED;
 			ac = ud->ctx;
 			ud->ctx = NULL;
 
@@ -661,7 +664,7 @@ lua_redis_callback_sync (redisAsyncContext *ac, gpointer r, gpointer priv)
 
 		result->result_ref = luaL_ref (L, LUA_REGISTRYINDEX);
 		result->s = ud->s;
-		result->item = ud->item;
+		result->item = sp_ud->item;
 		result->task = ud->task;
 		result->sp_ud = sp_ud;
 
@@ -1123,6 +1126,7 @@ lua_redis_make_request (lua_State *L)
 		sp_ud->cbref = cbref;
 		sp_ud->c = ud;
 		sp_ud->ctx = ctx;
+		sp_ud->item = ud->item;
 
 		lua_pushstring (L, "cmd");
 		lua_gettable (L, -2);
@@ -1158,8 +1162,8 @@ lua_redis_make_request (lua_State *L)
 						lua_redis_fin, sp_ud,
 						M);
 
-				if (ud->item) {
-					rspamd_symcache_item_async_inc (ud->task, ud->item, M);
+				if (sp_ud->item) {
+					rspamd_symcache_item_async_inc (ud->task, sp_ud->item, M);
 				}
 			}
 
@@ -1461,7 +1465,11 @@ lua_redis_add_cmd (lua_State *L)
 	gint cbref = -1, ret;
 
 	if (ctx) {
-		if (ctx->flags & LUA_REDIS_TERMINATED) {
+		/*
+		 * Connection is also released as soon as all pending replies are
+		 * received, so it cannot be reused after that
+		 */
+		if ((ctx->flags & LUA_REDIS_TERMINATED) || ctx->async.ctx == NULL) {
 			lua_pushboolean (L, FALSE);
 			lua_pushstring (L, "Connection is terminated");
 
@@ -1496,6 +1504,18 @@ lua_redis_add_cmd (lua_State *L)
 		}
 		sp_ud->ctx = ctx;
 
+		/*
+		 * Command can be added on behalf of another symbol, otherwise it is
+		 * held by the symbol that has created the connection
+		 */
+		if (ud->task) {
+			sp_ud->item = rspamd_symcache_get_cur_item (ud->task);
+		}
+
+		if (sp_ud->item == NULL) {
+			sp_ud->item = ud->item;
+		}
+
 		lua_redis_parse_args (L, args_pos, cmd, &sp_ud->args,
 					&sp_ud->arglens, &sp_ud->nargs);
 
@@ -1532,8 +1552,8 @@ lua_redis_add_cmd (lua_State *L)
 						sp_ud,
 						M);
 
-				if (ud->item) {
-					rspamd_symcache_item_async_inc (ud->task, ud->item, M);
+				if (sp_ud->item) {
+					rspamd_symcache_item_async_inc (ud->task, sp_ud->item, M);
 				}
 			}
 
@@ -20,6 +20,8 @@
  */
 
 #include "lua_common.h"
+#include "lua_thread_pool.h"
+#include "libserver/crypto_executor.h"
 #include "unix-std.h"
 #include <openssl/err.h>
 #include <openssl/pem.h>
@@ -42,10 +44,12 @@ LUA_FUNCTION_DEF (rsa_signature, base64);
 LUA_FUNCTION_DEF (rsa_signature, gc);
 LUA_FUNCTION_DEF (rsa,			 verify_memory);
 LUA_FUNCTION_DEF (rsa,			 sign_memory);
+LUA_FUNCTION_DEF (rsa,			 sign_memory_async);
 
 static const struct luaL_reg rsalib_f[] = {
 	LUA_INTERFACE_DEF (rsa, verify_memory),
 	LUA_INTERFACE_DEF (rsa, sign_memory),
+	LUA_INTERFACE_DEF (rsa, sign_memory_async),
 	{NULL, NULL}
 };
 
@@ -685,6 +689,167 @@ lua_rsa_sign_memory (lua_State *L)
 	return 1;
 }
 
+struct lua_rsa_sign_cbdata {
+	struct rspamd_task *task; /* NULL if task has been destroyed */
+	struct rspamd_config *cfg;
+	struct rspamd_symcache_dynamic_item *item;
+	RSA *rsa;
+	gchar *data;
+	gsize len;
+	rspamd_fstring_t *signature;
+	unsigned long ssl_err;
+	gint cbref;
+};
+
+static void
+lua_rsa_sign_work (gpointer ud)
+{
+	struct lua_rsa_sign_cbdata *cbd = (struct lua_rsa_sign_cbdata *)ud;
+	guint siglen = cbd->signature->allocated;
+
+	if (RSA_sign (NID_sha256, cbd->data, cbd->len,
+			cbd->signature->str, &siglen, cbd->rsa) != 1) {
+		/* Openssl errors queue is thread local */
+		cbd->ssl_err = ERR_get_error ();
+	}
+	else {
+		cbd->signature->len = siglen;
+	}
+}
+
+static void
+lua_rsa_sign_session_fin (gpointer ud)
+{
+	struct lua_rsa_sign_cbdata *cbd = (struct lua_rsa_sign_cbdata *)ud;
+
+	cbd->task = NULL;
+}
+
+static void
+lua_rsa_sign_fin (gpointer ud)
+{
+	struct lua_rsa_sign_cbdata *cbd = (struct lua_rsa_sign_cbdata *)ud;
+	struct rspamd_task *task = cbd->task;
+	struct lua_callback_state lcbd;
+	rspamd_fstring_t **psig;
+	lua_State *L;
+
+	if (task != NULL) {
+		lua_thread_pool_prepare_callback (cbd->cfg->lua_thread_pool, &lcbd);
+		L = lcbd.L;
+
+		lua_rawgeti (L, LUA_REGISTRYINDEX, cbd->cbref);
+
+		if (cbd->ssl_err != 0) {
+			lua_pushfstring (L, "cannot sign: %s",
+					ERR_error_string (cbd->ssl_err, NULL));
+			lua_pushnil (L);
+		}
+		else {
+			lua_pushnil (L);
+			psig = lua_newuserdata (L, sizeof (rspamd_fstring_t *));
+			rspamd_lua_setclass (L, "rspamd{rsa_signature}", -1);
+			*psig = cbd->signature;
+			cbd->signature = NULL;
+		}
+
+		if (cbd->item) {
+			rspamd_symcache_set_cur_item (task, cbd->item);
+		}
+
+		if (lua_pcall (L, 2, 0, 0) != 0) {
+			msg_err_task ("call to rsa sign callback failed: %s",
+					lua_tostring (L, -1));
+			lua_pop (L, 1);
+		}
+
+		lua_thread_pool_restore_callback (&lcbd);
+
+		if (cbd->item) {
+			rspamd_symcache_item_async_dec_check (task, cbd->item, "rsa sign");
+		}
+
+		rspamd_session_remove_event (task->s, lua_rsa_sign_session_fin, cbd);
+	}
+
+	luaL_unref (cbd->cfg->lua_state, LUA_REGISTRYINDEX, cbd->cbref);
+
+	if (cbd->signature) {
+		rspamd_fstring_free (cbd->signature);
+	}
+
+	RSA_free (cbd->rsa);
+	g_free (cbd->data);
+	g_free (cbd);
+}
+
+/**
+ * Sign memory using specified rsa key without blocking the event loop
+ *
+ * arguments:
+ * (task, rsa_privkey, string, callback)
+ *
+ * callback is called as callback(err, signature)
+ *
+ * returns:
+ * true if signing has been started
+ */
+static gint
+lua_rsa_sign_memory_async (lua_State *L)
+{
+	struct rspamd_task *task = lua_check_task (L, 1);
+	struct rspamd_crypto_executor *executor;
+	struct lua_rsa_sign_cbdata *cbd;
+	RSA *rsa;
+	const gchar *data;
+	gsize sz;
+
+	rsa = lua_check_rsa_privkey (L, 2);
+	data = luaL_checklstring (L, 3, &sz);
+
+	if (task == NULL || rsa == NULL || data == NULL ||
+			lua_type (L, 4) != LUA_TFUNCTION) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	if (task->event_loop == NULL || rspamd_session_blocked (task->s) ||
+			(executor = rspamd_crypto_executor_get (task->event_loop)) == NULL) {
+		lua_pushboolean (L, FALSE);
+
+		return 1;
+	}
+
+	cbd = g_malloc0 (sizeof (*cbd));
+	cbd->task = task;
+	cbd->cfg = task->cfg;
+	/* Key is used by the executor thread, so it must outlive lua object */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	CRYPTO_add (&rsa->references, 1, CRYPTO_LOCK_RSA);
+#else
+	RSA_up_ref (rsa);
+#endif
+	cbd->rsa = rsa;
+	cbd->data = g_malloc (sz);
+	memcpy (cbd->data, data, sz);
+	cbd->len = sz;
+	cbd->signature = rspamd_fstring_sized_new (RSA_size (rsa));
+	lua_pushvalue (L, 4);
+	cbd->cbref = luaL_ref (L, LUA_REGISTRYINDEX);
+	cbd->item = rspamd_symcache_get_cur_item (task);
+
+	if (cbd->item) {
+		rspamd_symcache_item_async_inc (task, cbd->item, "rsa sign");
+	}
+
+	rspamd_session_add_event (task->s, lua_rsa_sign_session_fin, cbd,
+			"rsa sign");
+	rspamd_crypto_executor_submit (executor, rsa, lua_rsa_sign_work,
+			lua_rsa_sign_fin, cbd);
+	lua_pushboolean (L, TRUE);
+
+	return 1;
+}
+
 static gint
 lua_load_pubkey (lua_State * L)
 {
@@ -126,6 +126,16 @@ LUA_FUNCTION_DEF (task, set_session);
  * @return {rspamd_ev_base} event base
  */
 LUA_FUNCTION_DEF (task, get_ev_base);
+/***
+ * @method task:add_timer(timeout, callback)
+ * Calls `callback(task)` after `timeout` seconds. The task is not finished until
+ * the callback is called. If the callback returns a number, then it is called
+ * once again after this number of seconds.
+ * @param {number} timeout time in seconds (could be fractional)
+ * @param {function} callback function to be called
+ * @return {boolean} `true` if a timer has been added
+ */
+LUA_FUNCTION_DEF (task, add_timer);
 /***
  * @method task:get_worker()
  * Returns a worker object associated with the task
@@ -969,10 +979,11 @@ LUA_FUNCTION_DEF (task, set_milter_reply);
 LUA_FUNCTION_DEF (task, process_regexp);
 
 /***
- * @method task:cache_set(key, value)
+ * @method task:cache_set(key, value[, volatile])
  * Store some value to the task cache
  * @param {string} key key to use
  * @param {any} value any value (including functions and tables)
+ * @param {boolean} volatile if true, then value is dropped when task urls, addresses, headers or from ip are modified from Lua
  */
 LUA_FUNCTION_DEF (task, cache_set);
 /***
@@ -1040,6 +1051,7 @@ LUA_FUNCTION_DEF (task, set_flag);
  * - `learn_spam`: learn message as spam
  * - `learn_ham`: learn message as ham
  * - `broken_headers`: header data is broken for a message
+ * - `wait_message`: message body has not been received yet (milter)
  * @param {string} flag to check
  * @return {boolean} true if flags is set
  */
@@ -1058,6 +1070,7 @@ LUA_FUNCTION_DEF (task, has_flag);
  * - `learn_spam`: learn message as spam
  * - `learn_ham`: learn message as ham
  * - `broken_headers`: header data is broken for a message
+ * - `wait_message`: message body has not been received yet (milter)
  * - `milter`: task is initiated by milter connection
  * @return {array of strings} table with all flags as strings
  */
@@ -1225,6 +1238,7 @@ static const struct luaL_reg tasklib_m[] = {
 	LUA_INTERFACE_DEF (task, get_session),
 	LUA_INTERFACE_DEF (task, set_session),
 	LUA_INTERFACE_DEF (task, get_ev_base),
+	LUA_INTERFACE_DEF (task, add_timer),
 	LUA_INTERFACE_DEF (task, get_worker),
 	LUA_INTERFACE_DEF (task, insert_result),
 	LUA_INTERFACE_DEF (task, insert_result_named),
@@ -1431,12 +1445,36 @@ lua_task_set_cached (lua_State *L, struct rspamd_task *task, const gchar *key,
 	}
 
 	entry->ref = luaL_ref (L, LUA_REGISTRYINDEX);
+	entry->is_volatile = FALSE;
 
 	if (task->message) {
 		entry->id = GPOINTER_TO_UINT (task->message);
 	}
 }
 
+/*
+ * Drops cached values that are derived from task data, called when
+ * task data is modified
+ */
+static void
+lua_task_drop_volatile_cached (lua_State *L, struct rspamd_task *task)
+{
+	GHashTableIter it;
+	gpointer k, v;
+	struct rspamd_lua_cached_entry *entry;
+
+	g_hash_table_iter_init (&it, task->lua_cache);
+
+	while (g_hash_table_iter_next (&it, &k, &v)) {
+		entry = (struct rspamd_lua_cached_entry *)v;
+
+		if (entry->is_volatile) {
+			luaL_unref (L, LUA_REGISTRYINDEX, entry->ref);
+			g_hash_table_iter_remove (&it);
+		}
+	}
+}
+
 
 static gboolean
 lua_task_get_cached (lua_State *L, struct rspamd_task *task, const gchar *key)
@@ -1946,6 +1984,104 @@ lua_task_get_ev_base (lua_State * L)
 	return 1;
 }
 
+struct lua_task_timer_cbdata {
+	struct rspamd_task *task;
+	struct rspamd_symcache_dynamic_item *item;
+	lua_State *L;
+	ev_timer ev;
+	gint cbref;
+};
+
+static void
+lua_task_timer_fin (gpointer ud)
+{
+	struct lua_task_timer_cbdata *cbd = (struct lua_task_timer_cbdata *)ud;
+
+	ev_timer_stop (cbd->task->event_loop, &cbd->ev);
+	luaL_unref (cbd->L, LUA_REGISTRYINDEX, cbd->cbref);
+}
+
+static void
+lua_task_timer_cb (struct ev_loop *loop, ev_timer *w, int revents)
+{
+	struct lua_task_timer_cbdata *cbd = (struct lua_task_timer_cbdata *)w->data;
+	struct rspamd_task *task = cbd->task;
+	lua_State *L = cbd->L;
+	gdouble next = -1;
+	gint err_idx;
+
+	lua_pushcfunction (L, &rspamd_lua_traceback);
+	err_idx = lua_gettop (L);
+	lua_rawgeti (L, LUA_REGISTRYINDEX, cbd->cbref);
+	rspamd_lua_task_push (L, task);
+
+	if (cbd->item) {
+		/* Async requests started from the callback belong to our symbol */
+		rspamd_symcache_set_cur_item (task, cbd->item);
+	}
+
+	if (lua_pcall (L, 1, 1, err_idx) != 0) {
+		msg_err_task ("call to timer callback failed: %s", lua_tostring (L, -1));
+	}
+	else if (lua_type (L, -1) == LUA_TNUMBER) {
+		next = lua_tonumber (L, -1);
+	}
+
+	lua_settop (L, err_idx - 1);
+
+	if (next > 0 && !rspamd_session_blocked (task->s)) {
+		ev_timer_set (w, next, 0.0);
+		ev_timer_start (loop, w);
+
+		return;
+	}
+
+	if (cbd->item) {
+		rspamd_symcache_item_async_dec_check (task, cbd->item, "lua timer");
+		cbd->item = NULL;
+	}
+
+	rspamd_session_remove_event (task->s, lua_task_timer_fin, cbd);
+}
+
+static int
+lua_task_add_timer (lua_State * L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_task *task = lua_check_task (L, 1);
+	struct lua_task_timer_cbdata *cbd;
+	gdouble timeout = luaL_checknumber (L, 2);
+
+	if (task == NULL || !lua_isfunction (L, 3)) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	if (task->s == NULL || rspamd_session_blocked (task->s)) {
+		lua_pushboolean (L, FALSE);
+
+		return 1;
+	}
+
+	cbd = rspamd_mempool_alloc0 (task->task_pool, sizeof (*cbd));
+	cbd->task = task;
+	cbd->L = L;
+	lua_pushvalue (L, 3);
+	cbd->cbref = luaL_ref (L, LUA_REGISTRYINDEX);
+	cbd->item = rspamd_symcache_get_cur_item (task);
+
+	if (cbd->item) {
+		rspamd_symcache_item_async_inc (task, cbd->item, "lua timer");
+	}
+
+	rspamd_session_add_event (task->s, lua_task_timer_fin, cbd, "lua timer");
+	ev_timer_init (&cbd->ev, lua_task_timer_cb, timeout, 0.0);
+	cbd->ev.data = cbd;
+	ev_timer_start (task->event_loop, &cbd->ev);
+	lua_pushboolean (L, TRUE);
+
+	return 1;
+}
+
 static int
 lua_task_get_worker (lua_State * L)
 {
@@ -2640,6 +2776,8 @@ lua_task_inject_url (lua_State * L)
 				/* Also add url to the mime part */
 				g_ptr_array_add (mpart->urls, url->url);
 			}
+
+			lua_task_drop_volatile_cached (L, task);
 		}
 	}
 	else {
@@ -3785,6 +3923,7 @@ lua_task_set_recipients (lua_State *L)
 			}
 
 			lua_pop (L, 1);
+			lua_task_drop_volatile_cached (L, task);
 			lua_pushboolean (L, true);
 		}
 		else {
@@ -4053,6 +4192,7 @@ lua_task_set_from (lua_State *L)
 				}
 
 				g_ptr_array_add (addrs, addr);
+				lua_task_drop_volatile_cached (L, task);
 				lua_pushboolean (L, true);
 			}
 			else {
@@ -4064,6 +4204,7 @@ lua_task_set_from (lua_State *L)
 			if (lua_import_email_address (L, task, 3, &addr)) {
 				task->from_envelope_orig = *paddr;
 				task->from_envelope = addr;
+				lua_task_drop_volatile_cached (L, task);
 				lua_pushboolean (L, true);
 			}
 			else {
@@ -4119,7 +4260,8 @@ lua_task_get_reply_sender (lua_State *L)
 			GPtrArray *addrs;
 
 			addrs = rspamd_email_address_from_mime (task->task_pool, rh->decoded,
-					strlen (rh->decoded), NULL, -1);
+					strlen (rh->decoded), NULL, -1,
+					RSPAMD_EMAIL_ADDR_PARSE_POOL_OWNED);
 
 			if (addrs == NULL || addrs->len == 0) {
 				lua_pushnil (L);
@@ -4266,6 +4408,7 @@ lua_task_set_from_ip (lua_State *L)
 				}
 
 				task->from_addr = addr;
+				lua_task_drop_volatile_cached (L, task);
 			}
 		}
 		else if (lua_type (L, 2) == LUA_TUSERDATA) {
@@ -4277,6 +4420,7 @@ lua_task_set_from_ip (lua_State *L)
 				}
 
 				task->from_addr = rspamd_inet_address_copy(ip->addr, NULL);
+				lua_task_drop_volatile_cached (L, task);
 			}
 			else {
 				return luaL_error (L, "invalid IP object");
@@ -5466,6 +5610,8 @@ lua_task_has_flag (lua_State *L)
 				RSPAMD_TASK_FLAG_MIME);
 		LUA_TASK_GET_FLAG (flag, "message_rewrite",
 				RSPAMD_TASK_FLAG_MESSAGE_REWRITE);
+		LUA_TASK_GET_FLAG (flag, "wait_message",
+				RSPAMD_TASK_FLAG_WAIT_MESSAGE);
 		LUA_TASK_GET_PROTOCOL_FLAG (flag, "milter",
 				RSPAMD_TASK_PROTOCOL_FLAG_MILTER);
 
@@ -5539,6 +5685,10 @@ lua_task_get_flags (lua_State *L)
 					lua_pushstring (L, "message_rewrite");
 					lua_rawseti (L, -2, idx++);
 					break;
+				case RSPAMD_TASK_FLAG_WAIT_MESSAGE:
+					lua_pushstring (L, "wait_message");
+					lua_rawseti (L, -2, idx++);
+					break;
 				default:
 					break;
 				}
@@ -6014,6 +6164,13 @@ lua_task_cache_set (lua_State *L)
 
 	if (task && key && lua_gettop (L) >= 3) {
 		lua_task_set_cached (L, task, key, 3);
+
+		if (lua_toboolean (L, 4)) {
+			struct rspamd_lua_cached_entry *entry;
+
+			entry = g_hash_table_lookup (task->lua_cache, key);
+			entry->is_volatile = TRUE;
+		}
 	}
 	else {
 		luaL_error (L, "invalid arguments");
@@ -6729,6 +6886,7 @@ lua_task_modify_header (lua_State *L)
 			rspamd_message_set_modified_header(task,
 					MESSAGE_FIELD_CHECK (task, raw_headers), hname, mods);
 			ucl_object_unref(mods);
+			lua_task_drop_volatile_cached (L, task);
 
 			lua_pushboolean (L, true);
 		}
@@ -306,6 +306,8 @@ struct lua_tcp_dtor {
 #define LUA_TCP_FLAG_RESOLVED (1u << 6u)
 #define LUA_TCP_FLAG_SSL (1u << 7u)
 #define LUA_TCP_FLAG_SSL_NOVERIFY (1u << 8u)
+#define LUA_TCP_FLAG_KEEPALIVE (1u << 9u)
+#define LUA_TCP_FLAG_ERROR (1u << 10u)
 
 #undef TCP_DEBUG_REFS
 #ifdef TCP_DEBUG_REFS
@@ -346,6 +348,21 @@ struct lua_tcp_cbdata {
 	gchar *hostname;
 	struct upstream *up;
 	gboolean eof;
+	gchar *ka_key;
+	gchar *ka_prologue;
+	gsize ka_prologue_len;
+	gdouble ka_timeout;
+	guint ka_max_idle;
+};
+
+/* Idle connection in the keepalive pool */
+struct lua_tcp_keepalive_elt {
+	gint fd;
+	struct rspamd_ssl_connection *ssl_conn;
+	struct ev_loop *event_loop;
+	struct rspamd_io_ev ev;
+	GQueue *queue;
+	GList *link;
 };
 
 #define IS_SYNC(c) (((c)->flags & LUA_TCP_FLAG_SYNC) != 0)
@@ -366,6 +383,11 @@ static void
 lua_tcp_void_finalyser (gpointer arg) {}
 
 static const gdouble default_tcp_timeout = 5.0;
+static const gdouble default_keepalive_timeout = 10.0;
+static const guint default_keepalive_max_idle = 8;
+
+/* Per worker pool of idle connections: key -> GQueue of lua_tcp_keepalive_elt */
+static GHashTable *lua_tcp_keepalive_pool = NULL;
 
 static struct rspamd_dns_resolver *
 lua_tcp_global_resolver (struct ev_loop *ev_base,
@@ -426,6 +448,188 @@ lua_tcp_shift_handler (struct lua_tcp_cbdata *cbd)
 	return TRUE;
 }
 
+static void
+lua_tcp_keepalive_elt_free (struct lua_tcp_keepalive_elt *elt)
+{
+	rspamd_ev_watcher_stop (elt->event_loop, &elt->ev);
+
+	if (elt->ssl_conn) {
+		/* It also closes socket */
+		rspamd_ssl_connection_free (elt->ssl_conn);
+	}
+	else {
+		close (elt->fd);
+	}
+
+	g_free (elt);
+}
+
+static void
+lua_tcp_keepalive_idle_handler (int fd, short what, gpointer ud)
+{
+	struct lua_tcp_keepalive_elt *elt = (struct lua_tcp_keepalive_elt *)ud;
+
+	if ((what & EV_READ) && elt->ssl_conn &&
+			rspamd_ssl_connection_check_idle (elt->ssl_conn)) {
+		/* TLS protocol records (e.g. session tickets), keep waiting */
+		return;
+	}
+
+	/* Either timeout or peer has closed connection/sent something unexpected */
+	g_queue_delete_link (elt->queue, elt->link);
+	lua_tcp_keepalive_elt_free (elt);
+}
+
+/*
+ * Checks that an idle socket is still usable, TLS peers are allowed to send
+ * records on an idle connection (e.g. session tickets), so readable data is
+ * processed by TLS library to tell them from unexpected data
+ */
+static gboolean
+lua_tcp_keepalive_check_socket (struct lua_tcp_keepalive_elt *elt)
+{
+	gint fd = elt->fd;
+	gint so_error = 0;
+	socklen_t so_len = sizeof (so_error);
+	guchar c;
+	gssize r;
+
+	if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &so_error, &so_len) == -1 ||
+			so_error != 0) {
+		return FALSE;
+	}
+
+	r = recv (fd, &c, sizeof (c), MSG_PEEK | MSG_DONTWAIT);
+
+	if (r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+		return TRUE;
+	}
+
+	if (r > 0 && elt->ssl_conn) {
+		return rspamd_ssl_connection_check_idle (elt->ssl_conn);
+	}
+
+	/* EOF, error or some data that we have not requested */
+	return FALSE;
+}
+
+static void
+lua_tcp_keepalive_make_key (struct lua_tcp_cbdata *cbd)
+{
+	GString *key;
+	guint64 h = 0;
+
+	if (cbd->ka_prologue) {
+		h = rspamd_cryptobox_fast_hash (cbd->ka_prologue, cbd->ka_prologue_len,
+				rspamd_hash_seed ());
+	}
+
+	key = g_string_sized_new (64);
+	rspamd_printf_gstring (key, "%s:%s:%ud:%uL",
+			rspamd_inet_address_to_string_pretty (cbd->addr),
+			cbd->hostname,
+			cbd->flags & (LUA_TCP_FLAG_SSL|LUA_TCP_FLAG_SSL_NOVERIFY),
+			h);
+
+	g_free (cbd->ka_key);
+	cbd->ka_key = g_string_free (key, FALSE);
+}
+
+static struct lua_tcp_keepalive_elt *
+lua_tcp_keepalive_pop (struct lua_tcp_cbdata *cbd)
+{
+	struct lua_tcp_keepalive_elt *elt;
+	GQueue *queue;
+
+	if (lua_tcp_keepalive_pool == NULL) {
+		return NULL;
+	}
+
+	queue = g_hash_table_lookup (lua_tcp_keepalive_pool, cbd->ka_key);
+
+	if (queue == NULL) {
+		return NULL;
+	}
+
+	while ((elt = g_queue_pop_head (queue)) != NULL) {
+		rspamd_ev_watcher_stop (elt->event_loop, &elt->ev);
+
+		if (lua_tcp_keepalive_check_socket (elt)) {
+			msg_debug_tcp ("reuse keepalive connection to %s; %d more idle",
+					cbd->ka_key, g_queue_get_length (queue));
+			return elt;
+		}
+
+		msg_debug_tcp ("drop dead keepalive connection to %s", cbd->ka_key);
+		lua_tcp_keepalive_elt_free (elt);
+	}
+
+	return NULL;
+}
+
+/*
+ * Moves socket of a finished connection to the keepalive pool if a connection
+ * is in a clean state, returns TRUE if fd and ssl connection are stolen
+ */
+static gboolean
+lua_tcp_keepalive_push (struct lua_tcp_cbdata *cbd)
+{
+	struct lua_tcp_keepalive_elt *elt;
+	GQueue *queue;
+
+	if (!(cbd->flags & LUA_TCP_FLAG_KEEPALIVE) ||
+			!(cbd->flags & LUA_TCP_FLAG_FINISHED) ||
+			(cbd->flags & LUA_TCP_FLAG_ERROR) ||
+			IS_SYNC (cbd) || cbd->eof || cbd->fd == -1 || cbd->ka_key == NULL ||
+			!g_queue_is_empty (cbd->handlers) || (cbd->in && cbd->in->len > 0)) {
+		return FALSE;
+	}
+
+	if (lua_tcp_keepalive_pool == NULL) {
+		lua_tcp_keepalive_pool = g_hash_table_new_full (g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify)g_queue_free);
+	}
+
+	queue = g_hash_table_lookup (lua_tcp_keepalive_pool, cbd->ka_key);
+
+	if (queue == NULL) {
+		queue = g_queue_new ();
+		g_hash_table_insert (lua_tcp_keepalive_pool, g_strdup (cbd->ka_key), queue);
+	}
+
+	if (g_queue_get_length (queue) >= cbd->ka_max_idle) {
+		msg_debug_tcp ("too many idle connections to %s, close connection",
+				cbd->ka_key);
+		return FALSE;
+	}
+
+	rspamd_ev_watcher_stop (cbd->event_loop, &cbd->ev);
+
+	elt = g_malloc0 (sizeof (*elt));
+	elt->fd = cbd->fd;
+	elt->ssl_conn = cbd->ssl_conn;
+	elt->event_loop = cbd->event_loop;
+	elt->queue = queue;
+
+	rspamd_ev_watcher_init (&elt->ev, elt->fd, EV_READ,
+			lua_tcp_keepalive_idle_handler, elt);
+
+	if (elt->ssl_conn) {
+		/* Event structure of the cbd is going to be freed */
+		rspamd_ssl_connection_set_ev (elt->ssl_conn, &elt->ev);
+	}
+
+	rspamd_ev_watcher_start (elt->event_loop, &elt->ev, cbd->ka_timeout);
+
+	g_queue_push_head (queue, elt);
+	elt->link = queue->head;
+
+	msg_debug_tcp ("push connection to %s into keepalive pool; %d idle",
+			cbd->ka_key, g_queue_get_length (queue));
+
+	return TRUE;
+}
+
 static void
 lua_tcp_fin (gpointer arg)
 {
@@ -447,6 +651,12 @@ lua_tcp_fin (gpointer arg)
 		luaL_unref (cbd->cfg->lua_state, LUA_REGISTRYINDEX, cbd->connect_cb);
 	}
 
+	if (lua_tcp_keepalive_push (cbd)) {
+		/* Socket is now owned by the keepalive pool */
+		cbd->ssl_conn = NULL;
+		cbd->fd = -1;
+	}
+
 	if (cbd->ssl_conn) {
 		/* TODO: postpone close in case ssl is used ! */
 		rspamd_ssl_connection_free (cbd->ssl_conn);
@@ -476,6 +686,8 @@ lua_tcp_fin (gpointer arg)
 
 	g_byte_array_unref (cbd->in);
 	g_free (cbd->hostname);
+	g_free (cbd->ka_key);
+	g_free (cbd->ka_prologue);
 	g_free (cbd);
 }
 
@@ -542,6 +754,9 @@ lua_tcp_push_error (struct lua_tcp_cbdata *cbd, gboolean is_fatal,
 	lua_State *L;
 	gboolean callback_called = FALSE;
 
+	/* Connection is in an unknown state, so it cannot be reused */
+	cbd->flags |= LUA_TCP_FLAG_ERROR;
+
 	if (is_fatal && cbd->up) {
 		rspamd_upstream_fail(cbd->up, false, err);
 	}
@@ -1283,12 +1498,64 @@ lua_tcp_ssl_on_error (gpointer ud, GError *err)
 	TCP_RELEASE (cbd);
 }
 
+static void
+lua_tcp_keepalive_reuse (struct lua_tcp_cbdata *cbd,
+		struct lua_tcp_keepalive_elt *elt)
+{
+	cbd->fd = elt->fd;
+
+	if (elt->ssl_conn) {
+		cbd->ssl_conn = elt->ssl_conn;
+		rspamd_ssl_connection_set_ev (cbd->ssl_conn, &cbd->ev);
+		rspamd_ssl_connection_restore_handlers (cbd->ssl_conn,
+				lua_tcp_handler, lua_tcp_ssl_on_error, cbd, EV_WRITE);
+	}
+	else {
+		rspamd_ev_watcher_init (&cbd->ev, cbd->fd, EV_WRITE,
+				lua_tcp_handler, cbd);
+	}
+
+	g_free (elt);
+
+	lua_tcp_register_event (cbd);
+	lua_tcp_plan_handler_event (cbd, TRUE, TRUE);
+}
+
 static gboolean
 lua_tcp_make_connection (struct lua_tcp_cbdata *cbd)
 {
 	int fd;
 
 	rspamd_inet_address_set_port (cbd->addr, cbd->port);
+
+	if (cbd->flags & LUA_TCP_FLAG_KEEPALIVE) {
+		struct lua_tcp_keepalive_elt *elt;
+
+		lua_tcp_keepalive_make_key (cbd);
+		elt = lua_tcp_keepalive_pop (cbd);
+
+		if (elt) {
+			lua_tcp_keepalive_reuse (cbd, elt);
+
+			return TRUE;
+		}
+
+		if (cbd->ka_prologue) {
+			/* New connection, so we need to send prologue first */
+			struct lua_tcp_handler *wh;
+
+			wh = g_malloc0 (sizeof (*wh));
+			wh->type = LUA_WANT_WRITE;
+			wh->h.w.iov = g_malloc (sizeof (struct iovec));
+			wh->h.w.iov[0].iov_base = cbd->ka_prologue;
+			wh->h.w.iov[0].iov_len = cbd->ka_prologue_len;
+			wh->h.w.iovlen = 1;
+			wh->h.w.total_bytes = cbd->ka_prologue_len;
+			wh->h.w.cbref = -1;
+			g_queue_push_head (cbd->handlers, wh);
+		}
+	}
+
 	fd = rspamd_inet_address_connect (cbd->addr, SOCK_STREAM, TRUE);
 
 	if (fd == -1) {
@@ -1469,6 +1736,14 @@ lua_tcp_arg_toiovec (lua_State *L, gint pos, struct lua_tcp_cbdata *cbd,
  * - `shutdown`: half-close socket after writing (boolean: default false)
  * - `read`: read response after sending request (boolean: default true)
  * - `upstream`: optional upstream object that would be used to get an address
+ * - `keepalive`: return connection to the per-worker pool when all handlers are done
+ *   and reuse idle connections to the same peer (boolean: default false). Calling `conn:close()`
+ *   prevents connection from being reused
+ * - `keepalive_timeout`: how long an idle connection is kept in the pool in **seconds** (default: 10)
+ * - `keepalive_max_idle`: maximum number of idle connections per peer (default: 8)
+ * - `keepalive_prologue`: data that is sent only over a newly established connection,
+ *   e.g. a command to start a session for the stream protocols (connections with different prologues
+ *   are never mixed)
  * @return {boolean} true if request has been sent
  */
 static gint
@@ -1801,6 +2076,44 @@ lua_tcp_request (lua_State *L)
 		cbd->flags |= LUA_TCP_FLAG_SHUTDOWN;
 	}
 
+	lua_getfield (L, 1, "keepalive");
+
+	/* Half closed connections cannot be reused */
+	if (lua_toboolean (L, -1) && !do_shutdown) {
+		cbd->flags |= LUA_TCP_FLAG_KEEPALIVE;
+		cbd->ka_timeout = default_keepalive_timeout;
+		cbd->ka_max_idle = default_keepalive_max_idle;
+
+		lua_getfield (L, 1, "keepalive_timeout");
+		if (lua_type (L, -1) == LUA_TNUMBER) {
+			cbd->ka_timeout = lua_tonumber (L, -1);
+		}
+		lua_pop (L, 1);
+
+		lua_getfield (L, 1, "keepalive_max_idle");
+		if (lua_type (L, -1) == LUA_TNUMBER) {
+			cbd->ka_max_idle = lua_tointeger (L, -1);
+		}
+		lua_pop (L, 1);
+
+		lua_getfield (L, 1, "keepalive_prologue");
+		if (lua_type (L, -1) == LUA_TSTRING) {
+			const gchar *p;
+			gsize plen;
+
+			p = lua_tolstring (L, -1, &plen);
+
+			if (plen > 0) {
+				cbd->ka_prologue = g_malloc (plen);
+				memcpy (cbd->ka_prologue, p, plen);
+				cbd->ka_prologue_len = plen;
+			}
+		}
+		lua_pop (L, 1);
+	}
+
+	lua_pop (L, 1);
+
 	if (do_read) {
 		struct lua_tcp_handler *rh;
 
@@ -2094,7 +2407,9 @@ lua_tcp_close (lua_State *L)
 		return luaL_error (L, "invalid arguments");
 	}
 
+	/* Explicitly closed connections are never reused */
 	cbd->flags |= LUA_TCP_FLAG_FINISHED;
+	cbd->flags &= ~LUA_TCP_FLAG_KEEPALIVE;
 	TCP_RELEASE (cbd);
 
 	return 0;
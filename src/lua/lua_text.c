@@ -142,6 +142,23 @@ LUA_FUNCTION_DEF (text, memchr);
  * @return {table|integer} bytes in the array (as unsigned char)
  */
 LUA_FUNCTION_DEF (text, bytes);
+/***
+ * @method rspamd_text:count_nonprintable()
+ * Returns number of non-printable characters in the text. Control characters
+ * except CR, LF and TAB are counted as well as 8 bit characters that are neither
+ * a part of a valid UTF8 sequence nor a run of at least 3 8 bit characters
+ * (that is likely some localized text in an 8 bit charset)
+ * @return {integer} number of non-printable characters
+ */
+LUA_FUNCTION_DEF (text, count_nonprintable);
+/***
+ * @method rspamd_text:count_csv_fields([max_lines])
+ * Checks if the first `max_lines` non empty lines of the text (10 by default)
+ * are CSV records with the same number of fields. Fields are separated by
+ * commas (or tabs after quoted fields) and might be quoted with `""` escapes
+ * @return {integer|nil} number of fields in a record or nil if text is not CSV
+ */
+LUA_FUNCTION_DEF (text, count_csv_fields);
 /***
  * @method rspamd_text:lower([is_utf, [inplace]])
  * Return a new text with lowercased characters, if is_utf is true then Rspamd applies utf8 lowercase
@@ -251,6 +268,8 @@ static const struct luaL_reg textlib_m[] = {
 		LUA_INTERFACE_DEF (text, memchr),
 		LUA_INTERFACE_DEF (text, byte),
 		LUA_INTERFACE_DEF (text, bytes),
+		LUA_INTERFACE_DEF (text, count_nonprintable),
+		LUA_INTERFACE_DEF (text, count_csv_fields),
 		LUA_INTERFACE_DEF (text, lower),
 		LUA_INTERFACE_DEF (text, exclude_chars),
 		LUA_INTERFACE_DEF (text, oneline),
@@ -1103,6 +1122,198 @@ lua_text_bytes (lua_State *L)
 	return 1;
 }
 
+/*
+ * Checks 8 bit sequence at the position `idx`, returns number of characters
+ * to skip if it looks like a text or -1 otherwise
+ */
+static gint
+lua_text_check_8bit (const guchar *p, gsize idx, gsize len)
+{
+	gsize remain = len - idx - 1;
+	gint n8bit = 0;
+
+	while (idx + 1 < len && p[idx] >= 127) {
+		guchar b = p[idx];
+
+		/* UTF8 sequences */
+		if ((b & 0xe0) == 0xc0 && remain > 1 &&
+			(p[idx + 1] & 0xc0) == 0x80) {
+			return 1;
+		}
+		else if ((b & 0xf0) == 0xe0 && remain > 2 &&
+				 (p[idx + 1] & 0xc0) == 0x80 &&
+				 (p[idx + 2] & 0xc0) == 0x80) {
+			return 2;
+		}
+		else if ((b & 0xf8) == 0xf0 && remain > 3 &&
+				 (p[idx + 1] & 0xc0) == 0x80 &&
+				 (p[idx + 2] & 0xc0) == 0x80 &&
+				 (p[idx + 3] & 0xc0) == 0x80) {
+			return 3;
+		}
+
+		n8bit ++;
+		idx ++;
+		remain --;
+	}
+
+	if (n8bit >= 3) {
+		return n8bit;
+	}
+
+	return -1;
+}
+
+static gint
+lua_text_count_nonprintable (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t = lua_check_text (L, 1);
+
+	if (t) {
+		const guchar *p = (const guchar *)t->start;
+		gsize non_printable = 0;
+
+		for (gsize i = 0; i < t->len; i ++) {
+			guchar c = p[i];
+
+			if (c < 0x20) {
+				if (c != '\r' && c != '\n' && c != '\t') {
+					non_printable ++;
+				}
+			}
+			else if (c >= 127) {
+				gint skip = lua_text_check_8bit (p, i, t->len);
+
+				if (skip < 0) {
+					non_printable ++;
+				}
+				else {
+					i += skip;
+				}
+			}
+		}
+
+		lua_pushinteger (L, non_printable);
+	}
+	else {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	return 1;
+}
+
+/*
+ * Returns number of fields in a CSV record or -1 if a line is not a record
+ * with at least two fields
+ */
+static gint
+lua_text_csv_record_fields (const gchar *p, const gchar *end)
+{
+	gint nfields = 0;
+
+	for (;;) {
+		if (p < end && *p == '"') {
+			p ++;
+
+			for (;;) {
+				if (p == end) {
+					/* Unterminated quoted field */
+					return -1;
+				}
+
+				if (*p == '"') {
+					if (p + 1 < end && p[1] == '"') {
+						p += 2;
+						continue;
+					}
+
+					p ++;
+					break;
+				}
+
+				p ++;
+			}
+		}
+		else {
+			while (p < end && *p != ',' && *p != '\n' && *p != '"') {
+				p ++;
+			}
+		}
+
+		nfields ++;
+
+		if (p < end && (*p == ',' || *p == '\t')) {
+			p ++;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (nfields < 2 || (p < end && *p != '\r' && *p != '\n')) {
+		return -1;
+	}
+
+	return nfields;
+}
+
+static gint
+lua_text_count_csv_fields (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t = lua_check_text (L, 1);
+	gint64 max_lines = luaL_optinteger (L, 2, 10);
+
+	if (t) {
+		const gchar *p = t->start, *end = t->start + t->len, *sep, *line_end;
+		gint nfields = -1, cur;
+
+		/* Lines are split just like rspamd_text:lines() does */
+		while (p < end && max_lines > 0) {
+			sep = memchr (p, '\n', end - p);
+
+			if (sep == NULL) {
+				sep = memchr (p, '\r', end - p);
+			}
+
+			line_end = sep ? sep : end;
+
+			while (line_end > p && (line_end[-1] == '\r' || line_end[-1] == '\n')) {
+				line_end --;
+			}
+
+			cur = lua_text_csv_record_fields (p, line_end);
+
+			if (cur == -1 || (nfields != -1 && cur != nfields)) {
+				lua_pushnil (L);
+
+				return 1;
+			}
+
+			nfields = cur;
+			max_lines --;
+			p = sep ? sep : end;
+
+			while (p < end && (*p == '\n' || *p == '\r')) {
+				p ++;
+			}
+		}
+
+		if (nfields == -1) {
+			lua_pushnil (L);
+		}
+		else {
+			lua_pushinteger (L, nfields);
+		}
+	}
+	else {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	return 1;
+}
+
 static gint
 lua_text_save_in_file (lua_State *L)
 {
@@ -20,6 +20,7 @@
 #include "libmime/content_type.h"
 #include "libmime/mime_headers.h"
 #include "libutil/hash.h"
+#include "libutil/suffix_index.h"
 
 #include "lua_parsers.h"
 
@@ -646,6 +647,33 @@ LUA_FUNCTION_DEF (util, btc_polymod);
  */
 LUA_FUNCTION_DEF (util, parse_smtp_date);
 
+/***
+ * @function util.clickhouse_row(row)
+ * Encodes a row table as a single TabSeparated line suitable for Clickhouse
+ * insertion. Strings and text values are escaped, numbers that are integers
+ * are printed without fraction and tables are encoded as Clickhouse arrays.
+ * @param {table} row array of values
+ * @return {rspamd_text} encoded row (without trailing newline)
+ */
+LUA_FUNCTION_DEF (util, clickhouse_row);
+
+/***
+ * @function util.load_suffix_index(path)
+ * Loads a domain suffixes index compiled by `rspamadm suffix_index`. The file
+ * is mapped read only, so its pages are shared by all processes.
+ * @param {string} path index file
+ * @return {suffix_index} index object or nil and error message
+ */
+LUA_FUNCTION_DEF (util, load_suffix_index);
+
+/***
+ * @function util.compile_suffix_index(rules)
+ * Compiles domain suffixes in the public suffix list format to an index
+ * @param {string|text} rules rules, one per line
+ * @return {suffix_index} index object or nil and error message
+ */
+LUA_FUNCTION_DEF (util, compile_suffix_index);
+
 
 static const struct luaL_reg utillib_f[] = {
 	LUA_INTERFACE_DEF (util, create_event_base),
@@ -712,6 +740,9 @@ static const struct luaL_reg utillib_f[] = {
 	LUA_INTERFACE_DEF (util, packsize),
 	LUA_INTERFACE_DEF (util, btc_polymod),
 	LUA_INTERFACE_DEF (util, parse_smtp_date),
+	LUA_INTERFACE_DEF (util, clickhouse_row),
+	LUA_INTERFACE_DEF (util, load_suffix_index),
+	LUA_INTERFACE_DEF (util, compile_suffix_index),
 	{NULL, NULL}
 };
 
@@ -732,6 +763,38 @@ static const struct luaL_reg int64lib_m[] = {
 	{NULL, NULL}
 };
 
+/***
+ * @method suffix_index:find(domain)
+ * Finds the longest suffix of the domain in the index (wildcard and exception
+ * rules are taken into account)
+ * @param {string} domain domain name
+ * @return {string} suffix or nil
+ */
+LUA_FUNCTION_DEF (suffix_index, find);
+/***
+ * @method suffix_index:has(domain)
+ * Checks if the domain itself is in the index
+ * @param {string} domain domain name
+ * @return {boolean} true if the domain is in the index
+ */
+LUA_FUNCTION_DEF (suffix_index, has);
+/***
+ * @method suffix_index:count()
+ * Returns number of rules in the index
+ * @return {number} number of rules
+ */
+LUA_FUNCTION_DEF (suffix_index, count);
+LUA_FUNCTION_DEF (suffix_index, gc);
+
+static const struct luaL_reg suffix_indexlib_m[] = {
+	LUA_INTERFACE_DEF (suffix_index, find),
+	LUA_INTERFACE_DEF (suffix_index, has),
+	LUA_INTERFACE_DEF (suffix_index, count),
+	{"__gc", lua_suffix_index_gc},
+	{"__tostring", rspamd_lua_class_tostring},
+	{NULL, NULL}
+};
+
 LUA_FUNCTION_DEF (ev_base, loop);
 
 static const struct luaL_reg ev_baselib_m[] = {
@@ -748,6 +811,13 @@ lua_check_int64 (lua_State * L, gint pos)
 	return ud ? *((gint64 *)ud) : 0LL;
 }
 
+static struct rspamd_suffix_index *
+lua_check_suffix_index (lua_State * L, gint pos)
+{
+	void *ud = rspamd_lua_check_udata (L, pos, "rspamd{suffix_index}");
+	luaL_argcheck (L, ud != NULL, pos, "'suffix_index' expected");
+	return ud ? *((struct rspamd_suffix_index **)ud) : NULL;
+}
 
 static gint
 lua_util_create_event_base (lua_State *L)
@@ -3438,6 +3508,189 @@ lua_util_parse_smtp_date (lua_State *L)
 	return lua_parsers_parse_smtp_date (L);
 }
 
+static void
+lua_util_ch_quote (GString *buf, const gchar *s, gsize len)
+{
+	const gchar *p = s, *end = s + len, *c;
+
+	while (p < end) {
+		c = p;
+
+		while (c < end && *c != '\'' && *c != '\\' && *c != '\n' &&
+			   *c != '\t' && *c != '\r') {
+			c ++;
+		}
+
+		if (c > p) {
+			g_string_append_len (buf, p, c - p);
+		}
+
+		if (c == end) {
+			break;
+		}
+
+		switch (*c) {
+		case '\n':
+			g_string_append_len (buf, "\\n", 2);
+			break;
+		case '\t':
+			g_string_append_len (buf, "\\t", 2);
+			break;
+		case '\r':
+			g_string_append_len (buf, "\\r", 2);
+			break;
+		default:
+			g_string_append_c (buf, '\\');
+			g_string_append_c (buf, *c);
+			break;
+		}
+
+		p = c + 1;
+	}
+}
+
+static void
+lua_util_ch_number (GString *buf, lua_Number n)
+{
+	static const lua_Number pow52 = 4503599627370496.0,
+			pow63 = 9223372036854775808.0;
+
+	/* Conversion to integer is undefined for nan, inf and out of range values */
+	if (isfinite (n) && n >= -pow63 && n < pow63 &&
+			(n + pow52) - pow52 == n) {
+		rspamd_printf_gstring (buf, "%L", (gint64)n);
+	}
+	else {
+		rspamd_printf_gstring (buf, "%g", (gdouble)n);
+	}
+}
+
+/* Appends a scalar value at the specified position, quoting it if needed */
+static void
+lua_util_ch_scalar (lua_State *L, gint pos, GString *buf, gboolean in_array)
+{
+	struct rspamd_lua_text *t;
+	const gchar *s;
+	gsize len;
+	gboolean pushed = FALSE;
+
+	switch (lua_type (L, pos)) {
+	case LUA_TNUMBER:
+		lua_util_ch_number (buf, lua_tonumber (L, pos));
+		break;
+	case LUA_TSTRING:
+		s = lua_tolstring (L, pos, &len);
+
+		if (in_array) {
+			g_string_append_c (buf, '\'');
+			lua_util_ch_quote (buf, s, len);
+			g_string_append_c (buf, '\'');
+		}
+		else {
+			lua_util_ch_quote (buf, s, len);
+		}
+		break;
+	case LUA_TUSERDATA:
+		t = rspamd_lua_check_udata_maybe (L, pos, "rspamd{text}");
+
+		if (t) {
+			s = t->start;
+			len = t->len;
+		}
+		else if (luaL_callmeta (L, pos, "__tostring")) {
+			s = lua_tolstring (L, -1, &len);
+			pushed = TRUE;
+		}
+		else {
+			s = NULL;
+			len = 0;
+		}
+
+		if (in_array) {
+			g_string_append_c (buf, '\'');
+		}
+
+		if (s) {
+			lua_util_ch_quote (buf, s, len);
+		}
+
+		if (in_array) {
+			g_string_append_c (buf, '\'');
+		}
+
+		if (pushed) {
+			lua_pop (L, 1);
+		}
+		break;
+	case LUA_TBOOLEAN:
+		g_string_append_c (buf, lua_toboolean (L, pos) ? '1' : '0');
+		break;
+	default:
+		break;
+	}
+}
+
+static int
+lua_util_clickhouse_row (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t;
+	GString *buf;
+	gsize nelts, nsub, i, j;
+
+	if (!lua_istable (L, 1)) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	nelts = rspamd_lua_table_size (L, 1);
+	buf = g_string_sized_new (nelts * 16);
+
+	for (i = 1; i <= nelts; i ++) {
+		lua_rawgeti (L, 1, i);
+
+		if (i > 1) {
+			g_string_append_c (buf, '\t');
+		}
+
+		if (lua_type (L, -1) == LUA_TTABLE) {
+			nsub = rspamd_lua_table_size (L, -1);
+			g_string_append_c (buf, '[');
+
+			for (j = 1; j <= nsub; j ++) {
+				lua_rawgeti (L, -1, j);
+
+				if (j > 1) {
+					g_string_append_c (buf, ',');
+				}
+
+				lua_util_ch_scalar (L, lua_gettop (L), buf, TRUE);
+				lua_pop (L, 1);
+			}
+
+			g_string_append_c (buf, ']');
+		}
+		else {
+			lua_util_ch_scalar (L, lua_gettop (L), buf, FALSE);
+		}
+
+		lua_pop (L, 1);
+	}
+
+	t = lua_new_text (L, NULL, 0, FALSE);
+	t->len = buf->len;
+
+	if (buf->len > 0) {
+		t->start = g_string_free (buf, FALSE);
+		t->flags = RSPAMD_TEXT_FLAG_OWN;
+	}
+	else {
+		t->start = "";
+		g_string_free (buf, TRUE);
+	}
+
+	return 1;
+}
+
 
 static gint
 lua_load_util (lua_State * L)
@@ -3465,6 +3718,8 @@ luaopen_util (lua_State * L)
 	lua_pop (L, 1);
 	rspamd_lua_new_class (L, "rspamd{int64}", int64lib_m);
 	lua_pop (L, 1);
+	rspamd_lua_new_class (L, "rspamd{suffix_index}", suffix_indexlib_m);
+	lua_pop (L, 1);
 	rspamd_lua_add_preload (L, "rspamd_util", lua_load_util);
 	rspamd_lua_add_preload (L, "rspamd_int64", lua_load_int64);
 }
@@ -3577,3 +3832,130 @@ lua_ev_base_loop (lua_State *L)
 
 	return 1;
 }
+
+static gint
+lua_util_push_suffix_index (lua_State *L, struct rspamd_suffix_index *idx,
+		GError *err)
+{
+	struct rspamd_suffix_index **pidx;
+
+	if (idx == NULL) {
+		lua_pushnil (L);
+		lua_pushstring (L, err ? err->message : "unknown error");
+
+		if (err) {
+			g_error_free (err);
+		}
+
+		return 2;
+	}
+
+	pidx = lua_newuserdata (L, sizeof (*pidx));
+	*pidx = idx;
+	rspamd_lua_setclass (L, "rspamd{suffix_index}", -1);
+
+	return 1;
+}
+
+static gint
+lua_util_load_suffix_index (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	const gchar *fname = luaL_checkstring (L, 1);
+	struct rspamd_suffix_index *idx;
+	GError *err = NULL;
+
+	idx = rspamd_suffix_index_open (fname, &err);
+
+	return lua_util_push_suffix_index (L, idx, err);
+}
+
+static gint
+lua_util_compile_suffix_index (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_lua_text *t = lua_check_text_or_string (L, 1);
+	struct rspamd_suffix_index *idx;
+	GError *err = NULL;
+
+	if (t == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	idx = rspamd_suffix_index_from_image (
+			rspamd_suffix_index_compile (t->start, t->len, NULL), &err);
+
+	return lua_util_push_suffix_index (L, idx, err);
+}
+
+static gint
+lua_suffix_index_find (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_suffix_index *idx = lua_check_suffix_index (L, 1);
+	const gchar *domain;
+	gsize len;
+	rspamd_ftok_t suffix;
+
+	domain = luaL_checklstring (L, 2, &len);
+
+	if (idx == NULL || domain == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	if (rspamd_suffix_index_find (idx, domain, len, &suffix)) {
+		lua_pushlstring (L, suffix.begin, suffix.len);
+	}
+	else {
+		lua_pushnil (L);
+	}
+
+	return 1;
+}
+
+static gint
+lua_suffix_index_has (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_suffix_index *idx = lua_check_suffix_index (L, 1);
+	const gchar *domain;
+	gsize len;
+
+	domain = luaL_checklstring (L, 2, &len);
+
+	if (idx == NULL || domain == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	lua_pushboolean (L, rspamd_suffix_index_has (idx, domain, len));
+
+	return 1;
+}
+
+static gint
+lua_suffix_index_count (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_suffix_index *idx = lua_check_suffix_index (L, 1);
+
+	if (idx == NULL) {
+		return luaL_error (L, "invalid arguments");
+	}
+
+	lua_pushinteger (L, rspamd_suffix_index_count (idx));
+
+	return 1;
+}
+
+static gint
+lua_suffix_index_gc (lua_State *L)
+{
+	LUA_TRACE_POINT;
+	struct rspamd_suffix_index *idx = lua_check_suffix_index (L, 1);
+
+	if (idx) {
+		rspamd_suffix_index_destroy (idx);
+	}
+
+	return 0;
+}
@@ -606,6 +606,11 @@ rspamd_chartable_process_part (struct rspamd_task *task,
 		if ((w->flags & RSPAMD_STAT_TOKEN_FLAG_TEXT)) {
 
 			if (w->flags & RSPAMD_STAT_TOKEN_FLAG_UTF) {
+				if (w->flags & RSPAMD_STAT_TOKEN_FLAG_ASCII) {
+					/* Basic latin only words have zero badness */
+					continue;
+				}
+
 				cur_score += rspamd_chartable_process_word_utf (task, w, FALSE,
 						&ncap, chartable_module_ctx, part->language, ignore_diacritics);
 			}
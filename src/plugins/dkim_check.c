@@ -40,6 +40,7 @@
 #include "utlist.h"
 #include "unix-std.h"
 #include "lua/lua_common.h"
+#include "lua/lua_thread_pool.h"
 #include "libserver/mempool_vars_internal.h"
 
 #define DEFAULT_SYMBOL_REJECT "R_DKIM_REJECT"
@@ -696,6 +697,101 @@ dkim_module_load_key_format (struct rspamd_task *task,
 	return ret;
 }
 
+static void
+dkim_module_cache_signature (struct rspamd_task *task, GString *hdr)
+{
+	GList *sigs;
+
+	sigs = rspamd_mempool_get_variable (task->task_pool, "dkim-signature");
+
+	if (sigs == NULL) {
+		sigs = g_list_append (sigs, hdr);
+		rspamd_mempool_set_variable (task->task_pool, "dkim-signature",
+				sigs, dkim_module_free_list);
+	} else {
+		sigs = g_list_append (sigs, hdr);
+		(void)sigs;
+	}
+}
+
+struct dkim_sign_cbdata {
+	struct rspamd_config *cfg;
+	struct rspamd_symcache_dynamic_item *item;
+	gint cbref;
+	gboolean no_cache;
+	/* Callback can be called before `rspamd_dkim_sign_async` returns */
+	gboolean in_handler;
+	gboolean done;
+};
+
+static void
+dkim_module_sign_async_cb (struct rspamd_task *task, GString *hdr, gpointer ud)
+{
+	struct dkim_sign_cbdata *cbd = (struct dkim_sign_cbdata *)ud;
+	struct lua_callback_state lcbd;
+	lua_State *L;
+
+	/* Task is NULL if it has been destroyed before signing is done */
+	if (task != NULL) {
+		lua_thread_pool_prepare_callback (task->cfg->lua_thread_pool, &lcbd);
+		L = lcbd.L;
+
+		lua_rawgeti (L, LUA_REGISTRYINDEX, cbd->cbref);
+		lua_pushboolean (L, hdr != NULL);
+
+		if (hdr) {
+			lua_pushlstring (L, hdr->str, hdr->len);
+		}
+		else {
+			lua_pushnil (L);
+		}
+
+		if (cbd->item) {
+			rspamd_symcache_set_cur_item (task, cbd->item);
+		}
+
+		if (lua_pcall (L, 2, 0, 0) != 0) {
+			msg_err_task ("call to dkim sign callback failed: %s",
+					lua_tostring (L, -1));
+			lua_pop (L, 1);
+		}
+
+		lua_thread_pool_restore_callback (&lcbd);
+
+		if (hdr) {
+			if (cbd->no_cache) {
+				g_string_free (hdr, TRUE);
+			}
+			else {
+				dkim_module_cache_signature (task, hdr);
+			}
+		}
+
+		if (cbd->item) {
+			if (cbd->in_handler) {
+				/* Symbol is still running, so it is finalised as usual */
+				rspamd_symcache_item_async_dec (task, cbd->item, "dkim sign");
+			}
+			else {
+				rspamd_symcache_item_async_dec_check (task, cbd->item, "dkim sign");
+			}
+		}
+	}
+
+	luaL_unref (cbd->cfg->lua_state, LUA_REGISTRYINDEX, cbd->cbref);
+	cbd->done = TRUE;
+
+	if (!cbd->in_handler) {
+		g_free (cbd);
+	}
+}
+
+/*
+ * rspamd_plugins.dkim.sign(task, params[, callback]): if callback is specified,
+ * then the private key operation is performed by the crypto executor and the
+ * callback is called with the same results as returned by the synchronous
+ * version; the function itself returns whether signing has been started
+ */
 static gint
 lua_dkim_sign_handler (lua_State *L)
 {
@@ -704,7 +800,6 @@ lua_dkim_sign_handler (lua_State *L)
 	enum rspamd_dkim_type sign_type = RSPAMD_DKIM_NORMAL;
 	GError *err = NULL;
 	GString *hdr;
-	GList *sigs = NULL;
 	const gchar *selector = NULL, *domain = NULL, *key = NULL, *rawkey = NULL,
 			*headers = NULL, *sign_type_str = NULL, *arc_cv = NULL,
 			*pubkey = NULL;
@@ -864,22 +959,53 @@ lua_dkim_sign_handler (lua_State *L)
 		return 1;
 	}
 
+	if (lua_type (L, 3) == LUA_TFUNCTION) {
+		struct dkim_sign_cbdata *cbd;
+
+		cbd = g_malloc0 (sizeof (*cbd));
+		cbd->cfg = task->cfg;
+		cbd->no_cache = no_cache;
+		cbd->in_handler = TRUE;
+		cbd->item = rspamd_symcache_get_cur_item (task);
+		lua_pushvalue (L, 3);
+		cbd->cbref = luaL_ref (L, LUA_REGISTRYINDEX);
+
+		if (cbd->item) {
+			rspamd_symcache_item_async_inc (task, cbd->item, "dkim sign");
+		}
+
+		if (!rspamd_dkim_sign_async (task, selector, domain, 0,
+				expire, arc_idx, arc_cv, ctx, dkim_module_sign_async_cb, cbd)) {
+			if (cbd->item) {
+				rspamd_symcache_item_async_dec (task, cbd->item, "dkim sign");
+			}
+
+			luaL_unref (L, LUA_REGISTRYINDEX, cbd->cbref);
+			g_free (cbd);
+			lua_pushboolean (L, FALSE);
+
+			return 1;
+		}
+
+		if (cbd->done) {
+			g_free (cbd);
+		}
+		else {
+			cbd->in_handler = FALSE;
+		}
+
+		lua_pushboolean (L, TRUE);
+
+		return 1;
+	}
+
 	hdr = rspamd_dkim_sign (task, selector, domain, 0,
 			expire, arc_idx, arc_cv, ctx);
 
 	if (hdr) {
 
 		if (!no_cache) {
-			sigs = rspamd_mempool_get_variable (task->task_pool, "dkim-signature");
-
-			if (sigs == NULL) {
-				sigs = g_list_append (sigs, hdr);
-				rspamd_mempool_set_variable (task->task_pool, "dkim-signature",
-						sigs, dkim_module_free_list);
-			} else {
-				sigs = g_list_append (sigs, hdr);
-				(void)sigs;
-			}
+			dkim_module_cache_signature (task, hdr);
 		}
 
 		lua_pushboolean (L, TRUE);
@@ -78,6 +78,7 @@ local settings = {
   adjust_dmarc = true, -- Adjust DMARC rejected policy for trusted forwarders
   allowed_ids = nil, -- Allowed settings id
   forbidden_ids = nil, -- Banned settings id
+  sign_async = true, -- do not block worker on private key operations
 }
 
 -- To match normal AR
@@ -582,22 +583,40 @@ local function arc_sign_seal(task, params, header)
     nl_type = task:get_newlines_type()
   end
 
-  local sig = rspamd_rsa.sign_memory(privkey, sha_ctx:bin())
-  cur_arc_seal = string.format('%s%s', cur_arc_seal,
-    sig:base64(70, nl_type))
-
-  lua_mime.modify_headers(task, {
-    add = {
-      ['ARC-Authentication-Results'] = {order = 1, value = cur_auth_results},
-      ['ARC-Message-Signature'] = {order = 1, value = header},
-      ['ARC-Seal'] = {order = 1, value = lua_util.fold_header(task,
-              'ARC-Seal', cur_arc_seal) }
-    },
-    -- RFC requires a strict order for these headers to be inserted
-    order = {'ARC-Authentication-Results', 'ARC-Message-Signature', 'ARC-Seal'},
-  })
-  task:insert_result(settings.sign_symbol, 1.0,
-      string.format('%s:s=%s:i=%d', params.domain, params.selector, cur_idx))
+  local function insert_arc_headers(sig)
+    cur_arc_seal = string.format('%s%s', cur_arc_seal,
+        sig:base64(70, nl_type))
+
+    lua_mime.modify_headers(task, {
+      add = {
+        ['ARC-Authentication-Results'] = {order = 1, value = cur_auth_results},
+        ['ARC-Message-Signature'] = {order = 1, value = header},
+        ['ARC-Seal'] = {order = 1, value = lua_util.fold_header(task,
+            'ARC-Seal', cur_arc_seal) }
+      },
+      -- RFC requires a strict order for these headers to be inserted
+      order = {'ARC-Authentication-Results', 'ARC-Message-Signature', 'ARC-Seal'},
+    })
+    task:insert_result(settings.sign_symbol, 1.0,
+        string.format('%s:s=%s:i=%d', params.domain, params.selector, cur_idx))
+  end
+
+  if settings.sign_async then
+    local started = rspamd_rsa.sign_memory_async(task, privkey, sha_ctx:bin(),
+        function(err, sig)
+          if err then
+            rspamd_logger.errx(task, 'cannot sign ARC seal: %s', err)
+          else
+            insert_arc_headers(sig)
+          end
+        end)
+
+    if started then
+      return
+    end
+  end
+
+  insert_arc_headers(rspamd_rsa.sign_memory(privkey, sha_ctx:bin()))
 end
 
 local function prepare_arc_selector(task, sel)
@@ -657,6 +676,27 @@ local function prepare_arc_selector(task, sel)
   return true
 end
 
+local function sign_and_seal(task, sign_params)
+  if settings.sign_async then
+    local started = dkim_sign(task, sign_params, function(dret, hdr)
+      if dret then
+        arc_sign_seal(task, sign_params, hdr)
+      end
+    end)
+
+    if not started then
+      -- Signing has failed and the error has been already logged
+      lua_util.debugm(N, task, 'cannot start arc signing for %s',
+          sign_params.domain)
+    end
+  else
+    local dret, hdr = dkim_sign(task, sign_params)
+    if dret then
+      arc_sign_seal(task, sign_params, hdr)
+    end
+  end
+end
+
 local function do_sign(task, sign_params)
   if sign_params.alg and sign_params.alg ~= 'rsa' then
     -- No support for ed25519 keys
@@ -686,19 +726,12 @@ local function do_sign(task, sign_params)
               sign_params.domain, sign_params.selector, err)
         end
 
-        local dret, hdr = dkim_sign(task, sign_params)
-        if dret then
-          arc_sign_seal(task, sign_params, hdr)
-        end
-
+        sign_and_seal(task, sign_params)
       end,
       forced = true
     })
   else
-    local dret, hdr = dkim_sign(task, sign_params)
-    if dret then
-      arc_sign_seal(task, sign_params, hdr)
-    end
+    sign_and_seal(task, sign_params)
   end
 end
 
@@ -25,10 +25,16 @@ local logger = require "rspamd_logger"
 local rspamd_util = require "rspamd_util"
 local lutil = require "lua_util"
 local lredis = require "lua_redis"
+local rspamd_cryptobox_hash = require "rspamd_cryptobox_hash"
 
 local settings = {
-  interval = 60, -- one iteration step per minute
-  count = 1000, -- check up to 1000 keys on each iteration
+  interval = 60, -- maximum delay between iteration steps
+  min_interval = 1.0, -- minimum delay between iteration steps
+  count = 1000, -- initial number of keys checked on each iteration
+  min_count = 100, -- limits for the adaptive number of keys per iteration
+  max_count = 10000,
+  latency_budget = 0.2, -- maximum redis latency of a single iteration
+  cycle_time = 86400, -- desired time to check the whole keyspace
   epsilon_common = 0.01, -- eliminate common if spam to ham rate is equal to this epsilon
   common_ttl = 10 * 86400, -- TTL of discriminated common elements
   significant_factor = 3.0 / 4.0, -- which tokens should we update
@@ -36,8 +42,6 @@ local settings = {
   cluster_nodes = 0,
 }
 
-local template = {}
-
 local function check_redis_classifier(cls, cfg)
   -- Skip old classifiers
   if cls.new_schema then
@@ -175,324 +179,417 @@ if settings.cluster_nodes == 0 then
   settings.cluster_nodes = n_neighbours
 end
 
-  -- Fill template
-template.count = settings.count
-template.threshold = settings.threshold
-template.common_ttl = settings.common_ttl
-template.epsilon_common = settings.epsilon_common
-template.significant_factor = settings.significant_factor
-template.expire_step = settings.interval
-template.hostname = rspamd_util.get_hostname()
-
-for k,v in pairs(template) do
-  template[k] = tostring(v)
+-- All statistics tokens are checked using the same pattern, service keys are
+-- named after its hash (compatible with the former server side script)
+local tokens_pattern = 'RS*_*'
+local pattern_sha1 = rspamd_cryptobox_hash.create_specific('sha1',
+    tokens_pattern):hex()
+local hostname = rspamd_util.get_hostname()
+
+local counters_fields = {'nelts', 'extended', 'discriminated', 'sum', 'sum_squares',
+  'common', 'significant', 'infrequent', 'infrequent_ttls_set', 'insignificant',
+  'insignificant_ttls_set'}
+local occur_classes = {'ham', 'spam', 'total'}
+
+local function service_key(suffix)
+  return pattern_sha1 .. '_' .. suffix
+end
+
+-- Deletes the lock only if it is still owned by this host: a step could
+-- outlive the lock, so another host might have already taken it
+local unlock_script = [[
+if redis.call('GET', KEYS[1]) == ARGV[1] then
+  return redis.call('DEL', KEYS[1])
 end
+return 0
+]]
+
+-- Returns a command to apply the classifier expiry to a token (or nil)
+local function ttl_cmd(key, ttl, expire)
+  if expire < 0 then
+    if ttl ~= -1 then
+      return {'PERSIST', {key}}
+    end
+  elseif ttl == -1 or ttl > expire then
+    return {'EXPIRE', {key, tostring(expire)}}
+  end
+
+  return nil
+end
+
+-- Fills step statistics and returns a list of commands to update tokens' TTLs
+-- tokens: array of {key, ham, spam, ttl}
+local function process_tokens(cls, tokens, st)
+  local c = st.c
+  local expire = math.floor(cls.expiry)
+  local cmds = {}
+
+  for _,tok in ipairs(tokens) do
+    local total = tok[2] + tok[3]
+    c.sum = c.sum + total
+    c.sum_squares = c.sum_squares + total * total
+
+    for cl,v in pairs({ham = tok[2], spam = tok[3], total = total}) do
+      if v > 19 then v = 20 end
+      st.occur[cl][v] = (st.occur[cl][v] or 0) + 1
+    end
+  end
+
+  c.nelts = #tokens
 
--- Arguments:
--- [1] = symbol pattern
--- [2] = expire value
--- [3] = cursor
--- returns {cursor for the next step, step number, step statistic counters, cycle statistic counters, tokens occurrences distribution}
-local expiry_script = [[
-  local unpack_function = table.unpack or unpack
-
-  local hash2list = function (hash)
-    local res = {}
-    for k, v in pairs(hash) do
-      table.insert(res, k)
-      table.insert(res, v)
-    end
-    return res
+  if c.nelts > 0 then
+    st.mean = c.sum / c.nelts
+    st.stddev = math.sqrt(c.sum_squares / c.nelts - st.mean * st.mean)
   end
 
-  local function merge_list(table, list)
-    local k
-    for i, v in ipairs(list) do
-      if i % 2 == 1 then
-        k = v
+  for _,tok in ipairs(tokens) do
+    local key, ham, spam, ttl = tok[1], tok[2], tok[3], tok[4]
+    local total = spam + ham
+
+    if total == 0 or math.abs(ham - spam) <= total * settings.epsilon_common then
+      c.common = c.common + 1
+      if ttl > settings.common_ttl then
+        c.discriminated = c.discriminated + 1
+        table.insert(cmds, {'EXPIRE', {key, tostring(settings.common_ttl)}})
+      end
+    elseif total >= st.mean and total > 0 then
+      if ham / total > settings.significant_factor or
+          spam / total > settings.significant_factor then
+        c.significant = c.significant + 1
+        if ttl ~= -1 then
+          table.insert(cmds, {'PERSIST', {key}})
+          c.extended = c.extended + 1
+        end
       else
-        table[k] = v
+        local cmd = ttl_cmd(key, ttl, expire)
+        c.insignificant = c.insignificant + 1
+        if cmd then
+          table.insert(cmds, cmd)
+          c.insignificant_ttls_set = c.insignificant_ttls_set + 1
+        end
+      end
+    else
+      local cmd = ttl_cmd(key, ttl, expire)
+      c.infrequent = c.infrequent + 1
+      if cmd then
+        table.insert(cmds, cmd)
+        c.infrequent_ttls_set = c.infrequent_ttls_set + 1
       end
     end
   end
 
-  local expire = math.floor(KEYS[2])
-  local pattern_sha1 = redis.sha1hex(KEYS[1])
+  return cmds
+end
+
+-- Adapts the number of keys per step to the latency budget and the interval
+-- between steps to the keyspace size
+local function adjust_pace(cls, latency)
+  if latency > settings.latency_budget then
+    cls.count = math.max(settings.min_count, math.floor(cls.count / 2))
+  elseif latency < settings.latency_budget / 2 then
+    cls.count = math.min(settings.max_count, cls.count * 2)
+  end
+
+  local interval = settings.interval
 
-  local lock_key = pattern_sha1 .. '_lock' -- Check locking
-  local lock = redis.call('GET', lock_key)
+  if cls.dbsize and cls.dbsize > 0 then
+    -- All nodes of a cluster share the same cursor, so each of them can go slower
+    interval = settings.cycle_time * cls.count / cls.dbsize *
+        math.max(settings.cluster_nodes, 1)
+  end
+
+  cls.interval = math.max(settings.min_interval, math.min(settings.interval, interval))
+end
 
-  if lock then
-    if lock ~= '${hostname}' then
-      return 'locked by ' .. lock
+local function log_stat(cls, st, cycle)
+  local infrequent_action = (cls.expiry < 0) and 'made persistent' or 'ttls set'
+  local c = cycle and st.cycle or st.c
+  local mean, stddev = st.mean, st.stddev
+
+  if cycle then
+    mean, stddev = 0, 0
+    if c.nelts ~= 0 then
+      mean = c.sum / c.nelts
+      stddev = math.floor(.5 + math.sqrt(c.sum_squares / c.nelts - mean * mean))
+      mean = math.floor(.5 + mean)
     end
   end
 
-  redis.replicate_commands()
-  redis.call('SETEX', lock_key, ${expire_step}, '${hostname}')
+  logger.infox(rspamd_config,
+      'finished expiry %s: %s items checked, %s significant (%s %s), ' ..
+          '%s insignificant (%s %s), %s common (%s discriminated), ' ..
+          '%s infrequent (%s %s), %s mean, %s std',
+      cycle and ('cycle in ' .. st.step .. ' steps') or ('step ' .. st.step), c.nelts,
+      c.significant, c.extended, 'made persistent',
+      c.insignificant, c.insignificant_ttls_set, infrequent_action,
+      c.common, c.discriminated,
+      c.infrequent, c.infrequent_ttls_set, infrequent_action,
+      mean, stddev)
+
+  if cycle then
+    for _,cl in ipairs(occur_classes) do
+      local distr = st.cycle_occur[cl]
+      local str = {}
+      for i = 0,20 do
+        if distr[i] then
+          table.insert(str, string.format('%s:%s,', i == 20 and '>19' or i, distr[i]))
+        end
+      end
+      logger.infox(rspamd_config, 'tokens occurrences, %s: {%s}',
+          cl == 'total' and cl or ('in ' .. cl), table.concat(str))
+    end
+  end
+end
 
-  local cursor_key = pattern_sha1 .. '_cursor'
-  local cursor = tonumber(redis.call('GET', cursor_key) or 0)
+local function hash_reply_to_table(data)
+  local res = {}
 
-  local step = 1
-  local step_key = pattern_sha1 .. '_step'
-  if cursor > 0 then
-    step = redis.call('GET', step_key)
-    step = step and (tonumber(step) + 1) or 1
+  if type(data) == 'table' then
+    for i = 1,#data,2 do
+      res[data[i]] = tonumber(data[i + 1]) or 0
+    end
   end
 
-  local ret = redis.call('SCAN', cursor, 'MATCH', KEYS[1], 'COUNT', '${count}')
-  local next_cursor = ret[1]
-  local keys = ret[2]
-  local tokens = {}
+  return res
+end
+
+-- A single expiry step: SCAN the next portion of keys, fetch them in a pipeline
+-- and update TTLs from the client side, so redis is never blocked by a script
+local function expire_step(cls, ev_base)
+  local now = rspamd_util.get_time()
 
-  -- Tokens occurrences distribution counters
-  local occur = {
-    ham = {},
-    spam = {},
-    total = {}
+  if cls.running and now - cls.running < settings.interval then
+    -- Previous step has not finished yet (or has been lost on connection errors)
+    return
+  end
+
+  local st = {
+    c = {},
+    occur = {ham = {}, spam = {}, total = {}},
+    mean = 0,
+    stddev = 0,
+    step = 1,
   }
+  for _,f in ipairs(counters_fields) do st.c[f] = 0 end
+
+  local conn
+  local cursor, next_cursor = 0, 0
+  local keys, tokens = {}, {}
+  local nreplies, scan_start = 0, 0
+  local failed = false
+
+  local function step_error(err)
+    if not failed then
+      failed = true
+      cls.running = nil
+      logger.errx(rspamd_config, 'cannot perform expiry step: %s', err)
+    end
+  end
 
-  -- Expiry step statistics counters
-  local nelts, extended, discriminated, sum, sum_squares, common, significant,
-   infrequent, infrequent_ttls_set, insignificant, insignificant_ttls_set =
-    0,0,0,0,0,0,0,0,0,0,0
-
-  for _,key in ipairs(keys) do
-    local t = redis.call('TYPE', key)["ok"]
-    if t == 'hash' then
-      local values = redis.call('HMGET', key, 'H', 'S')
-      local ham = tonumber(values[1]) or 0
-      local spam = tonumber(values[2]) or 0
-      local ttl = redis.call('TTL', key)
-      tokens[key] = {
-        ham,
-        spam,
-        ttl
-      }
-      local total = spam + ham
-      sum = sum + total
-      sum_squares = sum_squares + total * total
-      nelts = nelts + 1
-
-      for k,v in pairs({['ham']=ham, ['spam']=spam, ['total']=total}) do
-        if tonumber(v) > 19 then v = 20 end
-        occur[k][v] = occur[k][v] and occur[k][v] + 1 or 1
-      end
+  local function write_cb(err)
+    if err then
+      step_error(err)
     end
   end
 
-  local mean, stddev = 0, 0
+  local function done_cb(err, data)
+    if err then
+      step_error(err)
+      return
+    end
+
+    if failed then return end
+
+    cls.running = nil
+
+    if tonumber(data) ~= 1 then
+      logger.warnx(rspamd_config, 'expiry lock has expired before the step ' ..
+          'has been finished, consider increasing interval')
+    end
+    adjust_pace(cls, st.latency)
+    log_stat(cls, st, false)
 
-  if nelts > 0 then
-    mean = sum / nelts
-    stddev = math.sqrt(sum_squares / nelts - mean * mean)
+    if next_cursor == 0 then
+      log_stat(cls, st, true)
+    end
+
+    lutil.debugm(N, rspamd_config,
+        'expiry step latency: %s, keys per step: %s, next step in %s',
+        st.latency, cls.count, cls.interval)
   end
 
-  for key,token in pairs(tokens) do
-    local ham, spam, ttl = token[1], token[2], tonumber(token[3])
-    local threshold = mean
-    local total = spam + ham
+  local function write_results()
+    st.latency = rspamd_util.get_time() - scan_start
 
-    local function set_ttl()
-      if expire < 0 then
-        if ttl ~= -1 then
-          redis.call('PERSIST', key)
-          return 1
-        end
-      elseif ttl == -1 or ttl > expire then
-        redis.call('EXPIRE', key, expire)
-        return 1
+    for _,cmd in ipairs(process_tokens(cls, tokens, st)) do
+      conn:add_cmd(write_cb, cmd[1], cmd[2])
+    end
+
+    local counters_key = service_key('counters')
+
+    if cursor == 0 then
+      -- New cycle
+      conn:add_cmd(write_cb, 'DEL', {counters_key})
+      for _,cl in ipairs(occur_classes) do
+        conn:add_cmd(write_cb, 'DEL', {service_key('occurrence_' .. cl)})
       end
-      return 0
     end
 
-    if total == 0 or math.abs(ham - spam) <= total * ${epsilon_common} then
-      common = common + 1
-      if ttl > ${common_ttl} then
-        discriminated = discriminated + 1
-        redis.call('EXPIRE', key, ${common_ttl})
+    for _,f in ipairs(counters_fields) do
+      if st.c[f] ~= 0 then
+        conn:add_cmd(write_cb, 'HINCRBY', {counters_key, f, tostring(st.c[f])})
       end
-    elseif total >= threshold and total > 0 then
-      if ham / total > ${significant_factor} or spam / total > ${significant_factor} then
-        significant = significant + 1
-        if ttl ~= -1 then
-          redis.call('PERSIST', key)
-          extended = extended + 1
-        end
-      else
-        insignificant = insignificant + 1
-        insignificant_ttls_set = insignificant_ttls_set + set_ttl()
+    end
+
+    for _,cl in ipairs(occur_classes) do
+      for n,v in pairs(st.occur[cl]) do
+        conn:add_cmd(write_cb, 'HINCRBY', {service_key('occurrence_' .. cl),
+                                  tostring(n), tostring(v)})
       end
-    else
-      infrequent = infrequent + 1
-      infrequent_ttls_set = infrequent_ttls_set + set_ttl()
     end
-  end
 
-  -- Expiry cycle statistics counters
-  local c = {nelts = 0, extended = 0, discriminated = 0, sum = 0, sum_squares = 0,
-    common = 0, significant = 0, infrequent = 0, infrequent_ttls_set = 0, insignificant = 0, insignificant_ttls_set = 0}
+    conn:add_cmd(write_cb, 'SET', {service_key('cursor'), tostring(next_cursor)})
+    conn:add_cmd(write_cb, 'SET', {service_key('step'), tostring(st.step)})
 
-  local counters_key = pattern_sha1 .. '_counters'
+    if next_cursor == 0 then
+      -- End of cycle, fetch the overall statistics
+      conn:add_cmd(function(err, data)
+        if not err then
+          st.cycle = hash_reply_to_table(data)
+          for _,f in ipairs(counters_fields) do
+            st.cycle[f] = st.cycle[f] or 0
+          end
+        end
+      end, 'HGETALL', {counters_key})
+      st.cycle_occur = {}
+      for _,cl in ipairs(occur_classes) do
+        conn:add_cmd(function(err, data)
+          local distr = {}
+          if not err then
+            for k,v in pairs(hash_reply_to_table(data)) do
+              distr[tonumber(k)] = v
+            end
+          end
+          st.cycle_occur[cl] = distr
+        end, 'HGETALL', {service_key('occurrence_' .. cl)})
+      end
+    end
 
-  if cursor ~= 0 then
-    merge_list(c, redis.call('HGETALL', counters_key))
+    conn:add_cmd(done_cb, 'EVAL', {unlock_script, '1', service_key('lock'),
+                                   hostname})
   end
 
-  c.nelts = c.nelts + nelts
-  c.extended = c.extended + extended
-  c.discriminated = c.discriminated + discriminated
-  c.sum = c.sum + sum
-  c.sum_squares = c.sum_squares + sum_squares
-  c.common = c.common + common
-  c.significant = c.significant + significant
-  c.infrequent = c.infrequent + infrequent
-  c.infrequent_ttls_set = c.infrequent_ttls_set + infrequent_ttls_set
-  c.insignificant = c.insignificant + insignificant
-  c.insignificant_ttls_set = c.insignificant_ttls_set + insignificant_ttls_set
-
-  redis.call('HMSET', counters_key, unpack_function(hash2list(c)))
-  redis.call('SET', cursor_key, tostring(next_cursor))
-  redis.call('SET', step_key, tostring(step))
-  redis.call('DEL', lock_key)
-
-  local occ_distr = {}
-  for _,cl in pairs({'ham', 'spam', 'total'}) do
-    local occur_key = pattern_sha1 .. '_occurrence_' .. cl
-
-    if cursor ~= 0 then
-      local n
-      for i,v in ipairs(redis.call('HGETALL', occur_key)) do
-        if i % 2 == 1 then
-          n = tonumber(v)
-        else
-          occur[cl][n] = occur[cl][n] and occur[cl][n] + v or v
-        end
-      end
+  -- HMGET and TTL replies come in order for each key
+  local function token_cb(err, data)
+    nreplies = nreplies + 1
+    local idx = math.floor((nreplies + 1) / 2)
 
-      local str = ''
-      if occur[cl][0] ~= nil then
-        str = '0:' .. occur[cl][0] .. ','
-      end
-      for k,v in ipairs(occur[cl]) do
-        if k == 20 then k = '>19' end
-        str = str .. k .. ':' .. v .. ','
+    if not err then
+      if nreplies % 2 == 1 then
+        if type(data) == 'table' then
+          keys[idx] = {keys[idx], tonumber(data[1]) or 0, tonumber(data[2]) or 0}
+        end
+      elseif type(keys[idx]) == 'table' then
+        local tok = keys[idx]
+        tok[4] = tonumber(data) or -1
+        table.insert(tokens, tok)
       end
-      table.insert(occ_distr, str)
-    else
-      redis.call('DEL', occur_key)
     end
 
-    if next(occur[cl]) ~= nil then
-      redis.call('HMSET', occur_key, unpack_function(hash2list(occur[cl])))
+    if nreplies == #keys * 2 then
+      write_results()
     end
   end
 
-  return {
-    next_cursor, step,
-    {nelts, extended, discriminated, mean, stddev, common, significant, infrequent,
-     infrequent_ttls_set, insignificant, insignificant_ttls_set},
-    {c.nelts, c.extended, c.discriminated, c.sum, c.sum_squares, c.common,
-     c.significant, c.infrequent, c.infrequent_ttls_set, c.insignificant, c.insignificant_ttls_set},
-    occ_distr
-  }
-]]
-
-local function expire_step(cls, ev_base, worker)
-  local function redis_step_cb(err, args)
+  local function scan_cb(err, data)
     if err then
-      logger.errx(rspamd_config, 'cannot perform expiry step: %s', err)
-    elseif type(args) == 'table' then
-      local cur = tonumber(args[1])
-      local step = args[2]
-      local data = args[3]
-      local c_data = args[4]
-      local occ_distr = args[5]
-
-      local function log_stat(cycle)
-        local infrequent_action = (cls.expiry < 0) and 'made persistent' or 'ttls set'
-
-        local c_mean, c_stddev = 0, 0
-        if cycle and c_data[1] ~= 0 then
-          c_mean = c_data[4] / c_data[1]
-          c_stddev = math.floor(.5 + math.sqrt(c_data[5] / c_data[1] - c_mean * c_mean))
-          c_mean = math.floor(.5 + c_mean)
-        end
+      step_error(err)
+      return
+    end
 
-        local d = cycle and {
-          'cycle in ' .. step .. ' steps', c_data[1],
-          c_data[7], c_data[2], 'made persistent',
-          c_data[10], c_data[11], infrequent_action,
-          c_data[6], c_data[3],
-          c_data[8], c_data[9], infrequent_action,
-          c_mean,
-          c_stddev
-        } or {
-          'step ' .. step, data[1],
-          data[7], data[2], 'made persistent',
-          data[10], data[11], infrequent_action,
-          data[6], data[3],
-          data[8], data[9], infrequent_action,
-          data[4],
-          data[5]
-        }
-        logger.infox(rspamd_config,
-                'finished expiry %s: %s items checked, %s significant (%s %s), ' ..
-                    '%s insignificant (%s %s), %s common (%s discriminated), ' ..
-                    '%s infrequent (%s %s), %s mean, %s std',
-                lutil.unpack(d))
-        if cycle then
-          for i,cl in ipairs({'in ham', 'in spam', 'total'}) do
-            logger.infox(rspamd_config, 'tokens occurrences, %s: {%s}', cl, occ_distr[i])
-          end
-        end
-      end
-      log_stat(false)
-      if cur == 0 then
-        log_stat(true)
+    next_cursor = tonumber(data[1]) or 0
+    keys = data[2] or {}
+
+    if #keys == 0 then
+      write_results()
+    else
+      for _,key in ipairs(keys) do
+        -- Keys of other types yield errors and are skipped
+        conn:add_cmd(token_cb, 'HMGET', {key, 'H', 'S'})
+        conn:add_cmd(token_cb, 'TTL', {key})
       end
-    elseif type(args) == 'string' then
-      logger.infox(rspamd_config, 'skip expiry step: %s', args)
     end
   end
-  lredis.exec_redis_script(cls.script,
-      {ev_base = ev_base, is_write = true},
-      redis_step_cb,
-      {'RS*_*', cls.expiry}
-  )
-end
 
-rspamd_config:add_on_load(function (_, ev_base, worker)
-  -- Exit unless we're the first 'controller' worker
-  if not worker:is_primary_controller() then return end
+  local function cursor_cb(err, data)
+    if err then
+      step_error(err)
+      return
+    end
 
-  local unique_redis_params = {}
-  -- Push redis script to all unique redis servers
-  for _,cls in ipairs(settings.classifiers) do
-    if not unique_redis_params[cls.redis_params.hash] then
-      unique_redis_params[cls.redis_params.hash] = cls.redis_params
+    cursor = tonumber(data[1]) or 0
+    if cursor > 0 then
+      st.step = (tonumber(data[2]) or 0) + 1
     end
+
+    if cursor == 0 or not cls.dbsize then
+      conn:add_cmd(function(_err, dbsize)
+        if not _err then
+          cls.dbsize = tonumber(dbsize)
+        end
+      end, 'DBSIZE', {})
+    end
+
+    scan_start = rspamd_util.get_time()
+    conn:add_cmd(scan_cb, 'SCAN', {tostring(cursor), 'MATCH', tokens_pattern,
+                                   'COUNT', tostring(cls.count)})
   end
 
-  for h,rp in pairs(unique_redis_params) do
-    local script_id = lredis.add_redis_script(lutil.template(expiry_script,
-        template), rp)
+  local function lock_cb(err, data)
+    if err then
+      step_error(err)
+      return
+    end
 
-    for _,cls in ipairs(settings.classifiers) do
-      if cls.redis_params.hash == h then
-        cls.script = script_id
-      end
+    if data ~= 'OK' then
+      cls.running = nil
+      lutil.debugm(N, rspamd_config, 'skip expiry step: locked by another host')
+      return
     end
+
+    conn:add_cmd(cursor_cb, 'MGET', {service_key('cursor'), service_key('step')})
+  end
+
+  local ret
+  ret,conn = lredis.redis_make_request_taskless(ev_base,
+      rspamd_config,
+      cls.redis_params,
+      nil,
+      true, -- is write
+      lock_cb, --callback
+      'SET', -- command
+      {service_key('lock'), hostname, 'NX', 'EX',
+       tostring(math.ceil(settings.interval))}
+  )
+
+  if ret then
+    cls.running = now
   end
+end
+
+rspamd_config:add_on_load(function (_, ev_base, worker)
+  -- Exit unless we're the first 'controller' worker
+  if not worker:is_primary_controller() then return end
 
-  -- Expire tokens at regular intervals
+  -- Expire tokens at adaptive intervals
   for _,cls in ipairs(settings.classifiers) do
+    cls.count = settings.count
+    cls.interval = settings.interval
     rspamd_config:add_periodic(ev_base,
-        settings['interval'],
+        settings.interval,
         function ()
-          expire_step(cls, ev_base, worker)
-          return true
+          expire_step(cls, ev_base)
+          return cls.interval
         end, true)
   end
 end)
@@ -48,6 +48,7 @@ local settings = {
   use_redis = false,
   key_prefix = 'dkim_keys', -- default hash name
   use_milter_headers = false, -- use milter headers instead of `dkim_signature`
+  sign_async = true, -- do not block worker on private key operations
 }
 
 local N = 'dkim_signing'
@@ -68,6 +69,21 @@ local function insert_sign_results(task, ret, hdr, dkim_params)
   end
 end
 
+local function sign_and_insert(task, p)
+  if settings.sign_async then
+    local started = sign_func(task, p, function(sret, hdr)
+      insert_sign_results(task, sret, hdr, p)
+    end)
+
+    if not started then
+      insert_sign_results(task, false, nil, p)
+    end
+  else
+    local sret, hdr = sign_func(task, p)
+    insert_sign_results(task, sret, hdr, p)
+  end
+end
+
 local function do_sign(task, p)
   if settings.use_milter_headers then
     p.no_cache = true -- Disable caching in rspamd_mempool
@@ -90,14 +106,12 @@ local function do_sign(task, p)
               p.domain, p.selector, err)
         end
 
-        local sret, hdr = sign_func(task, p)
-        insert_sign_results(task, sret, hdr, p)
+        sign_and_insert(task, p)
       end,
       forced = true
     })
   else
-    local sret, hdr = sign_func(task, p)
-    insert_sign_results(task, sret, hdr, p)
+    sign_and_insert(task, p)
   end
 end
 
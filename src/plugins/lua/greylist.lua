@@ -292,7 +292,7 @@ local function greylist_check(task)
     end
   end
 
-  local ret = lua_redis.redis_make_request(task,
+  local ret = lua_redis.redis_batch_request(task,
       redis_params, -- connect params
       hash_key, -- hash key
       false, -- is write
@@ -381,7 +381,7 @@ local function greylist_set(task)
   end
   local body_key = data_key(task)
   local meta_key = envelope_key(task)
-  local upstream, ret, conn
+  local upstream, ret
   local hash_key = body_key .. meta_key
 
   local function redis_set_cb(err)
@@ -407,7 +407,7 @@ local function greylist_set(task)
 
     if not settings.check_local and is_rspamc then return end
 
-    ret,conn,upstream = lua_redis.redis_make_request(task,
+    ret,_,upstream = lua_redis.redis_batch_request(task,
       redis_params, -- connect params
       hash_key, -- hash key
       true, -- is write
@@ -417,9 +417,9 @@ local function greylist_set(task)
     )
     -- Update greylisting record expire
     if ret then
-      conn:add_cmd('EXPIRE', {
-        meta_key, tostring(toint(settings['expire']))
-      })
+      lua_redis.redis_batch_request(task, redis_params, hash_key, true,
+          nil, 'EXPIRE',
+          {meta_key, tostring(toint(settings['expire']))})
     else
       rspamd_logger.errx(task, 'got error while connecting to redis')
     end
@@ -430,7 +430,7 @@ local function greylist_set(task)
     rspamd_logger.infox(task, 'greylisted until "%s", new record', end_time)
     greylist_message(task, end_time, 'new record')
     -- Create new record
-    ret,conn,upstream = lua_redis.redis_make_request(task,
+    ret,_,upstream = lua_redis.redis_batch_request(task,
       redis_params, -- connect params
       hash_key, -- hash key
       true, -- is write
@@ -440,9 +440,9 @@ local function greylist_set(task)
     )
 
     if ret then
-      conn:add_cmd('SETEX', {
-        meta_key, tostring(toint(settings['expire'])), t
-      })
+      lua_redis.redis_batch_request(task, redis_params, hash_key, true,
+          nil, 'SETEX',
+          {meta_key, tostring(toint(settings['expire'])), t})
     else
       rspamd_logger.errx(task, 'got error while connecting to redis')
     end
@@ -27,6 +27,8 @@ redis_history {
   nrows = 200;
   # Use zstd compression when storing data in redis
   compress = true;
+  # Optional zstd dictionary (e.g. trained with `zstd --train` on history rows)
+  #compress_dictionary = "/var/lib/rspamd/history.dict";
   # Obfuscate subjects for privacy
   subject_privacy = false;
   # Default hash-algorithm to obfuscate subject
@@ -46,18 +48,21 @@ local lua_util = require "lua_util"
 local lua_redis = require "lua_redis"
 local fun = require "fun"
 local ucl = require "ucl"
+local rspamd_zstd = require "rspamd_zstd"
 local ts = (require "tableshape").types
 local E = {}
 local N = "history_redis"
 local hostname = rspamd_util.get_hostname()
 
 local redis_params
+local compress_dict -- zstd dictionary if configured
 
 local settings = {
   key_prefix = 'rs_history', -- default key name
   expire = nil, -- default no expire
   nrows = 200, -- default rows limit
   compress = true, -- use zstd compression when storing data in redis
+  compress_dictionary = nil, -- path to zstd dictionary
   subject_privacy = false, -- subject privacy is off
   subject_privacy_alg = 'blake2', -- default hash-algorithm to obfuscate subject
   subject_privacy_prefix = 'obf', -- prefix to show it's obfuscated
@@ -69,6 +74,7 @@ local settings_schema = ts.shape({
   expire = (ts.number + ts.string / lua_util.parse_time_interval):is_optional(),
   nrows = ts.number,
   compress = ts.boolean,
+  compress_dictionary = ts.string:is_optional(),
   subject_privacy = ts.boolean:is_optional(),
   subject_privacy_alg = ts.string:is_optional(),
   subject_privacy_prefix = ts.string:is_optional(),
@@ -152,12 +158,16 @@ local function history_save(task)
   local json = ucl.to_format(data, 1)
 
   if settings.compress then
-    json = rspamd_util.zstd_compress(json)
+    if compress_dict then
+      json = compress_dict:compress(json)
+    else
+      json = rspamd_util.zstd_compress(json)
+    end
     -- Distinguish between compressed and non-compressed options
     prefix = prefix .. '_zst'
   end
 
-  local ret, conn, _ = lua_redis.rspamd_redis_make_request(task,
+  local ret, conn, _ = lua_redis.redis_batch_request(task,
     redis_params, -- connect params
     nil, -- hash key
     true, -- is write
@@ -211,7 +221,13 @@ local function handle_history_request(task, conn, from, to, reset)
 
           data = fun.totable(fun.filter(function(e) return e ~= nil end,
             fun.map(function(e)
-              local _,dec = rspamd_util.zstd_decompress(e)
+              local _,dec
+              if compress_dict then
+                -- Rows compressed with no dictionary are handled as well
+                _,dec = compress_dict:decompress(e)
+              else
+                _,dec = rspamd_util.zstd_decompress(e)
+              end
               if dec then
                 return dec
               end
@@ -280,6 +296,26 @@ if opts then
   end
   settings = res
 
+  if settings.compress and settings.compress_dictionary then
+    local f, ferr = io.open(settings.compress_dictionary, 'rb')
+
+    if f then
+      local content = f:read('*a')
+      f:close()
+      local ok, dict = pcall(rspamd_zstd.dictionary, content)
+
+      if ok then
+        compress_dict = dict
+      else
+        rspamd_logger.errx(rspamd_config, 'cannot load zstd dictionary %s: %s',
+            settings.compress_dictionary, dict)
+      end
+    else
+      rspamd_logger.errx(rspamd_config, 'cannot open zstd dictionary %s: %s',
+          settings.compress_dictionary, ferr)
+    end
+  end
+
   redis_params = lua_redis.parse_redis_server('history_redis')
   if not redis_params then
     rspamd_logger.infox(rspamd_config, 'no servers are specified, disabling module')
@@ -87,6 +87,114 @@ local value_types = {
   },
 }
 
+-- Values extracted from a task are the same for all rules of the same type,
+-- so they are extracted once per task and shared between rules. The cache is
+-- volatile, so it is dropped when task is modified (e.g. urls are injected)
+local function task_values_cache(task)
+  local cache = task:cache_get('multimap_values')
+
+  if not cache then
+    cache = {
+      values = {},
+      headers = {},
+      filters = {},
+    }
+    task:cache_set('multimap_values', cache, true)
+  end
+
+  return cache
+end
+
+local function task_extract(task, what, extractor)
+  local values = task_values_cache(task).values
+  local res = values[what]
+
+  if res == nil then
+    res = extractor(task) or false
+    values[what] = res
+  end
+
+  return res or nil
+end
+
+local function task_extract_header(task, hname)
+  local headers = task_values_cache(task).headers
+  local res = headers[hname]
+
+  if res == nil then
+    res = task:get_header_full(hname) or false
+    headers[hname] = res
+  end
+
+  return res or nil
+end
+
+-- Filter results are cached per rule, as the same value can be met many times
+-- (e.g. urls with the same host)
+local function task_filter_value(task, r, value, fn)
+  local filters = task_values_cache(task).filters
+  local rule_filters = filters[r]
+
+  if not rule_filters then
+    rule_filters = {}
+    filters[r] = rule_filters
+  end
+
+  local res = rule_filters[value]
+
+  if res == nil then
+    res = fn(task, r.filter, value, r) or false
+    rule_filters[value] = res
+  end
+
+  return res or nil
+end
+
+local function extract_from_ip(task)
+  local ip = task:get_from_ip()
+  if ip and ip:is_valid() then
+    return ip
+  end
+end
+
+local function extract_rcpts(task)
+  if task:has_recipients('smtp') then
+    return task:get_recipients('smtp')
+  elseif task:has_recipients('mime') then
+    return task:get_recipients('mime')
+  end
+end
+
+local function extract_from(task)
+  if task:has_from('smtp') then
+    return task:get_from('smtp')
+  elseif task:has_from('mime') then
+    return task:get_from('mime')
+  end
+end
+
+local function extract_urls(task)
+  if task:has_urls() then
+    return task:get_urls()
+  end
+end
+
+local function extract_received(task)
+  local hdrs = task:get_received_headers()
+  if hdrs and hdrs[1] then
+    return hdrs
+  end
+end
+
+local function extract_received_real(task)
+  local hdrs = task_extract(task, 'received', extract_received)
+  if hdrs then
+    return fun.filter(function(h)
+      return not h['flags']['artificial']
+    end, hdrs):totable()
+  end
+end
+
 local function ip_to_rbl(ip, rbl)
   return table.concat(ip:inversed_str_octets(), ".") .. '.' .. rbl
 end
@@ -623,8 +731,13 @@ local function multimap_callback(task, rule)
       local fn = multimap_filters[r.type]
 
       if fn then
+        local filtered_value
 
-        local filtered_value = fn(task, r.filter, value, r)
+        if r.filter and type(value) == 'string' then
+          filtered_value = task_filter_value(task, r, value, fn)
+        else
+          filtered_value = fn(task, r.filter, value, r)
+        end
         lua_util.debugm(N, task, 'apply filter %s for rule %s: %s -> %s',
             r.filter, r.symbol, value, filtered_value)
         value = filtered_value
@@ -776,14 +889,14 @@ local function multimap_callback(task, rule)
 
   local process_rule_funcs = {
     ip = function()
-      local ip = task:get_from_ip()
-      if ip and ip:is_valid() then
+      local ip = task_extract(task, 'from_ip', extract_from_ip)
+      if ip then
         match_rule(rule, ip)
       end
     end,
     dnsbl = function()
-      local ip = task:get_from_ip()
-      if ip and ip:is_valid() then
+      local ip = task_extract(task, 'from_ip', extract_from_ip)
+      if ip then
         local to_resolve = ip_to_rbl(ip, rule['map'])
         local function dns_cb(_, _, results, err)
           lua_util.debugm(N, rspamd_config,
@@ -814,29 +927,21 @@ local function multimap_callback(task, rule)
     header = function()
       if type(rule['header']) == 'table' then
         for _,rh in ipairs(rule['header']) do
-          local hv = task:get_header_full(rh)
-          match_list(rule, hv, {'decoded'})
+          match_list(rule, task_extract_header(task, rh), {'decoded'})
         end
       else
-        local hv = task:get_header_full(rule['header'])
-        match_list(rule, hv, {'decoded'})
+        match_list(rule, task_extract_header(task, rule['header']), {'decoded'})
       end
     end,
     rcpt = function()
-      if task:has_recipients('smtp') then
-        local rcpts = task:get_recipients('smtp')
-        match_addr(rule, rcpts)
-      elseif task:has_recipients('mime') then
-        local rcpts = task:get_recipients('mime')
+      local rcpts = task_extract(task, 'rcpt', extract_rcpts)
+      if rcpts then
         match_addr(rule, rcpts)
       end
     end,
     from = function()
-      if task:has_from('smtp') then
-        local from = task:get_from('smtp')
-        match_addr(rule, from)
-      elseif task:has_from('mime') then
-        local from = task:get_from('mime')
+      local from = task_extract(task, 'from', extract_from)
+      if from then
         match_addr(rule, from)
       end
     end,
@@ -847,9 +952,9 @@ local function multimap_callback(task, rule)
       end
     end,
     url = function()
-      if task:has_urls() then
-        local msg_urls = task:get_urls()
+      local msg_urls = task_extract(task, 'url', extract_urls)
 
+      if msg_urls then
         for _,url in ipairs(msg_urls) do
           match_url(rule, url)
         end
@@ -947,13 +1052,15 @@ local function multimap_callback(task, rule)
       end
     end,
     received = function()
-      local hdrs = task:get_received_headers()
-      if hdrs and hdrs[1] then
-        if not rule['artificial'] then
-          hdrs = fun.filter(function(h)
-            return not h['flags']['artificial']
-          end, hdrs):totable()
-        end
+      local hdrs
+
+      if rule['artificial'] then
+        hdrs = task_extract(task, 'received', extract_received)
+      else
+        hdrs = task_extract(task, 'received_real', extract_received_real)
+      end
+
+      if hdrs then
         for pos, h in ipairs(hdrs) do
           match_received_header(rule, pos, #hdrs, h)
         end
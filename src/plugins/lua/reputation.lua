@@ -1025,7 +1025,7 @@ local function reputation_redis_get_token(task, rule, prefix, token, continuatio
   end
 
   local ret = lua_redis.exec_redis_script(rule.backend.script_get,
-      {task = task, is_write = false},
+      {task = task, is_write = false, batch = true},
       redis_get_cb,
       {key})
   if not ret then
@@ -1056,7 +1056,7 @@ local function reputation_redis_set_token(task, rule, prefix, token, sc, continu
   lua_util.debugm(N, task, 'rule %s - set values for key %s -> %s',
       rule['symbol'], key, sc)
   local ret = lua_redis.exec_redis_script(rule.backend.script_set,
-      {task = task, is_write = true},
+      {task = task, is_write = true, batch = true},
       redis_set_cb,
       {key, tostring(os.time() * 1000),
        tostring(sc),
@@ -1179,6 +1179,43 @@ local function parse_atom(str)
   return atom
 end
 
+-- Types of SA rules that are just a regexp match
+local native_re_types = {
+  part = function(r) if r['raw'] then return 'rawmime' end return 'mime' end,
+  sabody = function(r) return r['type'] end,
+  message = function(r) return r['type'] end,
+  sarawbody = function(r) return r['type'] end,
+  uri = function() return 'url' end,
+}
+
+-- Parses meta atoms converting regexp rules and external symbols to
+-- native atoms that are evaluated with no Lua calls
+local function parse_meta_atom(str)
+  local atom = parse_atom(str)
+  local r = rules[atom]
+
+  if r then
+    local re_type = native_re_types[r['type']]
+    if re_type and r['re'] and atoms[atom] then
+      return {
+        name = atom,
+        type = 'regexp',
+        re = r['re'],
+        re_type = re_type(r),
+      }
+    end
+  else
+    -- External symbol
+    return {
+      name = atom,
+      type = 'symbol',
+      symbol = replace_symbol(atom),
+    }
+  end
+
+  return atom
+end
+
 local function gen_process_atom_cb(result_name, task)
   return  function (atom)
     local atom_cb = atoms[atom]
@@ -1503,7 +1540,8 @@ local function post_process()
         if not (already_processed and already_processed[res_name or 'default']) then
           -- Execute symbol
           local function exec_symbol(cur_res)
-            local res,trace = expression:process_traced(gen_process_atom_cb(cur_res, task))
+            local res,trace = expression:process_task_traced(task, cur_res,
+                gen_process_atom_cb(cur_res, task))
             lua_util.debugm(N, task, 'meta result for %s: %s; result name: %s', k, res, cur_res)
             if res > 0 then
               -- Symbol should be one shot to make it working properly
@@ -1542,7 +1580,8 @@ local function post_process()
         -- No return if invoked directly from Rspamd as we use task:insert_result_named directly
       end
 
-      expression = rspamd_expression.create(r['meta'], parse_atom, rspamd_config:get_mempool())
+      expression = rspamd_expression.create(r['meta'], parse_meta_atom,
+          rspamd_config:get_mempool())
       if not expression then
         rspamd_logger.errx(rspamd_config, 'Cannot parse expression ' .. r['meta'])
       else
@@ -54,7 +54,8 @@ local settings = {
   redirectors_only = true, -- follow merely redirectors
   top_urls_key = 'rdr:top_urls', -- key for top urls
   top_urls_count = 200, -- how many top urls to save
-  redirector_hosts_map = nil -- check only those redirectors
+  redirector_hosts_map = nil, -- check only those redirectors
+  redirector_hosts_index = nil, -- same but compiled by `rspamadm suffix_index`
 }
 
 local function adjust_url(task, orig_url, redir_url)
@@ -335,13 +336,33 @@ if opts then
     lua_util.disable_module(N, "redis")
   else
 
+    if settings.redirector_hosts_index then
+      -- Mapped index is shared between processes and needs no parsing
+      local rspamd_util = require "rspamd_util"
+      local idx, err = rspamd_util.load_suffix_index(settings.redirector_hosts_index)
+
+      if idx then
+        settings.redirector_hosts_map = {
+          get_key = function(_, host)
+            return idx:has(host)
+          end
+        }
+      else
+        rspamd_logger.errx(rspamd_config, 'cannot load redirectors index %s: %s',
+            settings.redirector_hosts_index, err)
+        settings.redirector_hosts_index = nil
+      end
+    end
+
     if not settings.redirector_hosts_map then
       rspamd_logger.infox(rspamd_config, 'no redirector_hosts_map option is specified, disabling module')
       lua_util.disable_module(N, "config")
     else
-      local lua_maps = require "lua_maps"
-      settings.redirector_hosts_map = lua_maps.map_add_from_ucl(settings.redirector_hosts_map,
-          'set', 'Redirectors definitions')
+      if not settings.redirector_hosts_index then
+        local lua_maps = require "lua_maps"
+        settings.redirector_hosts_map = lua_maps.map_add_from_ucl(settings.redirector_hosts_map,
+            'set', 'Redirectors definitions')
+      end
 
       lua_redis.register_prefix(settings.key_prefix .. '[a-z0-9]{32}', N,
           'URL redirector hashes', {
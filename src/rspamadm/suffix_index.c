@@ -0,0 +1,166 @@
+/*-
+ * Copyright 2022 Vsevolod Stakhov
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include "rspamadm.h"
+#include "printf.h"
+#include "libutil/suffix_index.h"
+#include "unix-std.h"
+
+static gchar *output_file = NULL;
+static gboolean check_only = FALSE;
+
+static void rspamadm_suffix_index (gint argc, gchar **argv,
+								   const struct rspamadm_command *cmd);
+static const char *rspamadm_suffix_index_help (gboolean full_help,
+											   const struct rspamadm_command *cmd);
+
+struct rspamadm_command suffix_index_command = {
+		.name = "suffix_index",
+		.flags = 0,
+		.help = rspamadm_suffix_index_help,
+		.run = rspamadm_suffix_index,
+		.lua_subrs = NULL,
+};
+
+static GOptionEntry entries[] = {
+		{"output",  'o', 0, G_OPTION_ARG_FILENAME, &output_file,
+				"Write compiled index to the specified file", NULL},
+		{"check",  'c', 0, G_OPTION_ARG_NONE, &check_only,
+				"Check the compiled index and print number of rules", NULL},
+		{NULL,       0,   0, G_OPTION_ARG_NONE, NULL, NULL, NULL}
+};
+
+static const char *
+rspamadm_suffix_index_help (gboolean full_help, const struct rspamadm_command *cmd)
+{
+	const char *help_str;
+
+	if (full_help) {
+		help_str = "Compile domain suffixes list (e.g. effective_tld_names.dat or "
+				"a list of redirectors) to a binary index\n\n"
+				"Usage: rspamadm suffix_index -o <output> <input>\n"
+				"       rspamadm suffix_index -c <index>\n"
+				"Where options are:\n\n"
+				"-o: write compiled index to the specified file\n"
+				"-c: check the compiled index\n"
+				"--help: shows available options and commands";
+	}
+	else {
+		help_str = "Compile domain suffixes to a binary index";
+	}
+
+	return help_str;
+}
+
+static void
+rspamadm_suffix_index_check (const gchar *fname)
+{
+	struct rspamd_suffix_index *idx;
+	GError *err = NULL;
+
+	idx = rspamd_suffix_index_open (fname, &err);
+
+	if (idx == NULL) {
+		rspamd_fprintf (stderr, "cannot load index %s: %e\n", fname, err);
+		g_error_free (err);
+		exit (EXIT_FAILURE);
+	}
+
+	rspamd_printf ("%s: %ud rules\n", fname, rspamd_suffix_index_count (idx));
+	rspamd_suffix_index_destroy (idx);
+}
+
+static void
+rspamadm_suffix_index (gint argc, gchar **argv, const struct rspamadm_command *cmd)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GByteArray *image;
+	gchar *content, *tmp_name;
+	gsize len;
+	guint nrules;
+
+	context = g_option_context_new (
+			"suffix_index - compile domain suffixes to a binary index");
+	g_option_context_set_summary (context,
+			"Summary:\n  Rspamd administration utility version "
+					RVERSION
+					"\n  Release id: "
+					RID);
+	g_option_context_add_main_entries (context, entries, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		rspamd_fprintf (stderr, "option parsing failed: %s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		exit (EXIT_FAILURE);
+	}
+
+	g_option_context_free (context);
+
+	if (argc < 2) {
+		rspamd_fprintf (stderr, "input file is missing\n");
+		exit (EXIT_FAILURE);
+	}
+
+	if (check_only) {
+		rspamadm_suffix_index_check (argv[1]);
+
+		return;
+	}
+
+	if (output_file == NULL) {
+		rspamd_fprintf (stderr, "output file is missing\n");
+		exit (EXIT_FAILURE);
+	}
+
+	if (!g_file_get_contents (argv[1], &content, &len, &error)) {
+		rspamd_fprintf (stderr, "cannot read %s: %e\n", argv[1], error);
+		g_error_free (error);
+		exit (EXIT_FAILURE);
+	}
+
+	image = rspamd_suffix_index_compile (content, len, &nrules);
+	g_free (content);
+
+	/*
+	 * Index files are mapped by the running processes, so we never rewrite
+	 * them in place but replace atomically
+	 */
+	tmp_name = g_strdup_printf ("%s.new", output_file);
+
+	if (!g_file_set_contents (tmp_name, (const gchar *)image->data, image->len,
+			&error) || rename (tmp_name, output_file) == -1) {
+		if (error) {
+			rspamd_fprintf (stderr, "cannot write %s: %e\n", tmp_name, error);
+			g_error_free (error);
+		}
+		else {
+			rspamd_fprintf (stderr, "cannot rename %s to %s: %s\n", tmp_name,
+					output_file, strerror (errno));
+			unlink (tmp_name);
+		}
+
+		g_free (tmp_name);
+		g_byte_array_free (image, TRUE);
+		exit (EXIT_FAILURE);
+	}
+
+	rspamd_printf ("compiled %ud rules from %s to %s (%uz bytes)\n",
+			nrules, argv[1], output_file, (gsize)image->len);
+	g_free (tmp_name);
+	g_byte_array_free (image, TRUE);
+}
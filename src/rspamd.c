@@ -73,6 +73,7 @@ static gint control_fd;
 static ev_io control_ev;
 static struct rspamd_stat old_stat;
 static ev_timer stat_ev;
+static ev_timer autoscale_ev;
 
 static gboolean valgrind_mode = FALSE;
 
@@ -620,7 +621,21 @@ spawn_worker_type (struct rspamd_main *rspamd_main, struct ev_loop *event_loop,
 				listen_sockets);
 	}
 	else {
-		for (i = 0; i < cf->count; i++) {
+		gint count = cf->count;
+
+		if (cf->max_count > 0) {
+			gint min_count = MAX (cf->min_count, 1),
+				max_count = MAX (cf->max_count, min_count);
+
+			if (count < min_count || count > max_count) {
+				msg_info_main ("adjust initial count of %s workers from %d to "
+							   "autoscaling limits [%d..%d]",
+						cf->worker->name, count, min_count, max_count);
+				count = CLAMP (count, min_count, max_count);
+			}
+		}
+
+		for (i = 0; i < count; i++) {
 			rspamd_fork_worker (rspamd_main, cf, i, event_loop,
 					rspamd_cld_handler, listen_sockets);
 		}
@@ -1153,6 +1168,153 @@ rspamd_hup_handler (struct ev_loop *loop, ev_signal *w, int revents)
 	}
 }
 
+static gboolean
+rspamd_worker_conf_can_autoscale (struct rspamd_worker_conf *cf)
+{
+	if (cf->worker == NULL || !cf->enabled || cf->count <= 0 ||
+			cf->max_count <= 0) {
+		return FALSE;
+	}
+
+	/* Only stateless scanners can be safely added or removed */
+	if (!(cf->worker->flags & RSPAMD_WORKER_SCANNER) ||
+			!(cf->worker->flags & RSPAMD_WORKER_KILLABLE) ||
+			(cf->worker->flags & (RSPAMD_WORKER_UNIQUE|RSPAMD_WORKER_THREADED|
+					RSPAMD_WORKER_CONTROLLER))) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+rspamd_autoscale_worker_type (struct rspamd_main *rspamd_main,
+		struct rspamd_worker_conf *cf)
+{
+	struct rspamd_config *cfg = rspamd_main->cfg;
+	struct rspamd_worker *wrk, *victim = NULL;
+	GHashTableIter it;
+	gpointer k, v;
+	GPtrArray *running;
+	guint i, nreported = 0, nconns = 0, min_count, max_count, new_index;
+	gdouble load = 0.0, lag = 0.0, queue;
+
+	running = g_ptr_array_new ();
+	g_hash_table_iter_init (&it, rspamd_main->workers);
+
+	while (g_hash_table_iter_next (&it, &k, &v)) {
+		wrk = (struct rspamd_worker *)v;
+
+		if (wrk->cf != cf || wrk->state != rspamd_worker_state_running ||
+				(wrk->flags & RSPAMD_WORKER_OLD_CONFIG)) {
+			continue;
+		}
+
+		g_ptr_array_add (running, wrk);
+
+		/* Workers that have not reported their load yet are not counted */
+		if (wrk->hb.last_event > 0 && wrk->hb.nbeats >= 0 && wrk->hb.load >= 0) {
+			nreported ++;
+			load += wrk->hb.load;
+			lag += wrk->hb.loop_lag;
+			nconns += wrk->hb.nconns;
+		}
+
+		/* Retire workers with the highest index to keep indexes compact */
+		if (victim == NULL || wrk->index > victim->index) {
+			victim = wrk;
+		}
+	}
+
+	min_count = MAX (cf->min_count, 1);
+	max_count = MAX (cf->max_count, min_count);
+
+	/* Do not make any decisions while some workers are starting or hung */
+	if (running->len == 0 || nreported != running->len) {
+		g_ptr_array_free (running, TRUE);
+
+		return;
+	}
+
+	load /= nreported;
+	lag /= nreported;
+	queue = (gdouble)nconns / nreported;
+
+	if (running->len < max_count && (load >= cfg->autoscale_high_load ||
+			lag >= cfg->autoscale_max_lag ||
+			(cfg->autoscale_max_queue > 0 && queue >= cfg->autoscale_max_queue))) {
+		/* Find the lowest free index */
+		for (new_index = 0; ; new_index ++) {
+			for (i = 0; i < running->len; i ++) {
+				wrk = g_ptr_array_index (running, i);
+
+				if (wrk->index == new_index) {
+					break;
+				}
+			}
+
+			if (i == running->len) {
+				break;
+			}
+		}
+
+		msg_info_main ("spawn %s worker (%ud of %ud max): load=%.2f, "
+					   "loop lag=%.3fs, queue=%.1f",
+				cf->worker->name, running->len + 1, max_count,
+				load, lag, queue);
+		rspamd_fork_worker (rspamd_main, cf, new_index,
+				rspamd_main->event_loop, rspamd_cld_handler, listen_sockets);
+	}
+	else if (running->len > min_count && load <= cfg->autoscale_low_load &&
+			/* Remaining workers should not immediately trigger scaling up */
+			load * running->len / (running->len - 1) < cfg->autoscale_high_load &&
+			lag < cfg->autoscale_max_lag / 2.0 &&
+			(cfg->autoscale_max_queue == 0 ||
+					queue * running->len / (running->len - 1) <
+							cfg->autoscale_max_queue / 2.0)) {
+		msg_info_main ("retire %s worker %P (%ud of %ud min): load=%.2f, "
+					   "loop lag=%.3fs, queue=%.1f",
+				cf->worker->name, victim->pid, running->len - 1, min_count,
+				load, lag, queue);
+		/*
+		 * Worker stops accepting connections on SIGUSR2 and finishes the
+		 * pending ones, it is not reforked as it is not in the running state
+		 */
+		rspamd_detach_worker (rspamd_main, victim);
+		victim->state = rspamd_worker_state_wanna_die;
+		kill_old_workers (NULL, victim, NULL);
+	}
+
+	g_ptr_array_free (running, TRUE);
+}
+
+static void
+rspamd_autoscale_handler (struct ev_loop *loop, ev_timer *w, int revents)
+{
+	struct rspamd_main *rspamd_main = (struct rspamd_main *)w->data;
+	struct rspamd_worker_conf *cf;
+	GList *cur;
+
+	if (rspamd_main->wanna_die) {
+		return;
+	}
+
+	for (cur = rspamd_main->cfg->workers; cur != NULL; cur = g_list_next (cur)) {
+		cf = (struct rspamd_worker_conf *)cur->data;
+
+		if (rspamd_worker_conf_can_autoscale (cf)) {
+			rspamd_autoscale_worker_type (rspamd_main, cf);
+		}
+	}
+
+	/* Interval might be changed on reload */
+	if (rspamd_main->cfg->autoscale_interval > 0 &&
+			w->repeat != rspamd_main->cfg->autoscale_interval) {
+		w->repeat = rspamd_main->cfg->autoscale_interval;
+		ev_timer_again (loop, w);
+	}
+}
+
 /* Called when a dead child has been found */
 
 static void
@@ -1363,6 +1525,11 @@ main (gint argc, gchar **argv, gchar **env)
 		rspamd_main->stat->avg_time.avg_time[i] = NAN;
 	}
 
+	rspamd_main->stat_series = rspamd_mempool_alloc0_shared_ (rspamd_main->server_pool,
+			sizeof (struct rspamd_stat_series),
+			RSPAMD_ALIGNOF(struct rspamd_stat_series),
+			G_STRLOC);
+
 	rspamd_main->cfg = rspamd_config_new (RSPAMD_CONFIG_INIT_DEFAULT);
 	rspamd_main->spairs = g_hash_table_new_full (rspamd_spair_hash,
 			rspamd_spair_equal, g_free, rspamd_spair_close);
@@ -1611,6 +1778,15 @@ main (gint argc, gchar **argv, gchar **env)
 			stat_update_time, stat_update_time);
 	ev_timer_start (event_loop, &stat_ev);
 
+	/* Adjust number of scanners according to their load */
+	if (rspamd_main->cfg->autoscale_interval > 0) {
+		autoscale_ev.data = rspamd_main;
+		ev_timer_init (&autoscale_ev, rspamd_autoscale_handler,
+				rspamd_main->cfg->autoscale_interval,
+				rspamd_main->cfg->autoscale_interval);
+		ev_timer_start (event_loop, &autoscale_ev);
+	}
+
 	rspamd_check_core_limits (rspamd_main);
 	rspamd_mempool_lock_mutex (rspamd_main->start_mtx);
 	spawn_workers (rspamd_main, event_loop);
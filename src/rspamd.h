@@ -84,6 +84,9 @@ struct rspamd_worker_heartbeat {
 	ev_timer heartbeat_ev;          /**< used by main for checking heartbeats and by workers to send heartbeats */
 	ev_tstamp last_event;           /**< last heartbeat received timestamp */
 	gint64 nbeats;                  /**< positive for beats received, negative for beats missed */
+	guint nconns;                   /**< connections in progress as reported by the last beat */
+	gdouble loop_lag;               /**< event loop lag as reported by the last beat */
+	gdouble load;                   /**< cpu load as reported by the last beat (negative if unknown) */
 };
 
 enum rspamd_worker_state {
@@ -296,6 +299,19 @@ struct RSPAMD_ALIGNED(64) rspamd_stat {
 	struct rspamd_avg_time avg_time;                    /**< average time stats								*/
 };
 
+#define RSPAMD_STAT_SERIES_SLOTS 3600
+/**
+ * Per-second actions rates for the last hour, shared between all processes.
+ * It is written by the primary controller only and read by all controllers.
+ */
+struct RSPAMD_ALIGNED(64) rspamd_stat_series {
+	guint64 last_update;                                /**< timestamp of the last written slot				*/
+	guint32 cur_slot;                                   /**< next slot to be written						*/
+	guint32 nslots;                                     /**< number of valid slots							*/
+	guint last_actions[METRIC_ACTION_MAX];              /**< actions counters at the last update			*/
+	guint actions[RSPAMD_STAT_SERIES_SLOTS][METRIC_ACTION_MAX]; /**< actions per each second			*/
+};
+
 /**
  * Struct that determine main server object (for logging purposes)
  */
@@ -306,6 +322,7 @@ struct rspamd_main {
 	rspamd_pidfh_t *pfh;                                        /**< struct pidfh for pidfile						*/
 	GQuark type;                                                /**< process type									*/
 	struct rspamd_stat *stat;                                   /**< pointer to statistics							*/
+	struct rspamd_stat_series *stat_series;                     /**< per-second statistics series					*/
 
 	rspamd_mempool_t *server_pool;                              /**< server's memory pool							*/
 	rspamd_mempool_mutex_t *start_mtx;                          /**< server is starting up							*/
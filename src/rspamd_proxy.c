@@ -52,6 +52,19 @@
 /* Rotate keys each minute by default */
 #define DEFAULT_ROTATION_TIME 60.0
 #define DEFAULT_RETRIES 5
+/* Number of recent replies used to estimate upstream latency */
+#define LATENCY_SAMPLES 256
+/* Minimum number of samples to start hedging */
+#define HEDGE_MIN_SAMPLES 32
+/* Maximum number of hedged requests that could be sent in a burst */
+#define HEDGE_MAX_BURST 10.0
+#define DEFAULT_HEDGE_MAX_RATE 0.05
+#define DEFAULT_HEDGE_MIN_DELAY 0.05
+/* How often to log latency and hedging statistics */
+#define HEDGE_STAT_INTERVAL 60.0
+/* Idle connections kept per backend address when keepalive is enabled */
+#define DEFAULT_KEEPALIVE_MAX_CONNS 16
+#define DEFAULT_KEEPALIVE_TIMEOUT 30.0
 
 #define msg_err_session(...) rspamd_default_log_function (G_LOG_LEVEL_CRITICAL, \
         session->pool->tag.tagname, session->pool->tag.uid, \
@@ -85,6 +98,23 @@ worker_t rspamd_proxy_worker = {
 	RSPAMD_WORKER_VER
 };
 
+/* Recent replies of a single upstream host */
+struct rspamd_http_upstream_samples {
+	gdouble samples[LATENCY_SAMPLES];
+	guint64 nsamples;
+	/* Cached hedge delay, recalculated each LATENCY_SAMPLES / 16 replies */
+	gdouble hedge_delay;
+};
+
+struct rspamd_http_upstream_latency {
+	/* struct upstream * -> struct rspamd_http_upstream_samples * */
+	GHashTable *hosts;
+	gdouble hedge_tokens;
+	guint64 requests;
+	guint64 hedged;
+	guint64 hedge_wins;
+};
+
 struct rspamd_http_upstream {
 	gchar *name;
 	gchar *settings_id;
@@ -96,6 +126,15 @@ struct rspamd_http_upstream {
 	gboolean local;
 	gboolean self_scan;
 	gboolean compress;
+	/* Hedging: send a second request if the first is slower than percentile */
+	gdouble hedge_percentile;
+	gdouble hedge_max_rate;
+	gdouble hedge_min_delay;
+	struct rspamd_http_upstream_latency *latency;
+	/* Reuse connections to backends */
+	gboolean keepalive;
+	guint keepalive_max_conns;
+	gdouble keepalive_timeout;
 };
 
 struct rspamd_http_mirror {
@@ -157,12 +196,16 @@ struct rspamd_proxy_ctx {
 	struct rspamd_milter_context milter_ctx;
 	/* Language detector */
 	struct rspamd_lang_detector *lang_det;
+	/* Periodic latency and hedging statistics */
+	ev_timer hedge_stat_ev;
+	gboolean has_hedging;
 };
 
 enum rspamd_backend_flags {
 	RSPAMD_BACKEND_REPLIED = 1 << 0,
 	RSPAMD_BACKEND_CLOSED = 1 << 1,
 	RSPAMD_BACKEND_PARSED = 1 << 2,
+	RSPAMD_BACKEND_KEEPALIVE = 1 << 3,
 };
 
 struct rspamd_proxy_session;
@@ -182,6 +225,7 @@ struct rspamd_proxy_backend_connection {
 	gint parser_from_ref;
 	gint parser_to_ref;
 	struct rspamd_task *task;
+	ev_tstamp start_ts;
 };
 
 enum rspamd_proxy_legacy_support {
@@ -202,7 +246,10 @@ struct rspamd_proxy_session {
 	gchar *fname;
 	gpointer shmem_ref;
 	struct rspamd_proxy_backend_connection *master_conn;
+	struct rspamd_proxy_backend_connection *hedge_conn;
+	ev_timer hedge_ev;
 	struct rspamd_http_message *client_message;
+	struct rspamd_http_message *envelope_message;
 	GPtrArray *mirror_conns;
 	gsize map_len;
 	gint client_sock;
@@ -466,6 +513,88 @@ rspamd_proxy_parse_upstream (rspamd_mempool_t *pool,
 		up->settings_id = rspamd_mempool_strdup (pool, ucl_object_tostring (elt));
 	}
 
+	up->hedge_max_rate = DEFAULT_HEDGE_MAX_RATE;
+	up->hedge_min_delay = DEFAULT_HEDGE_MIN_DELAY;
+
+	elt = ucl_object_lookup (obj, "hedge_percentile");
+	if (elt) {
+		ucl_object_todouble_safe (elt, &up->hedge_percentile);
+
+		/* Allow both 0.95 and 95 */
+		if (up->hedge_percentile > 1.0) {
+			up->hedge_percentile /= 100.0;
+		}
+
+		if (up->hedge_percentile < 0 || up->hedge_percentile > 1.0) {
+			g_set_error (err, rspamd_proxy_quark (), 100,
+					"hedge_percentile must be in range (0, 100]");
+
+			goto err;
+		}
+	}
+
+	elt = ucl_object_lookup (obj, "hedge_max_rate");
+	if (elt) {
+		ucl_object_todouble_safe (elt, &up->hedge_max_rate);
+	}
+
+	elt = ucl_object_lookup (obj, "hedge_min_delay");
+	if (elt) {
+		ucl_object_todouble_safe (elt, &up->hedge_min_delay);
+	}
+
+	if (up->hedge_percentile > 0 && up->self_scan) {
+		msg_warn_pool_check ("hedging is not supported for self_scan upstream %s",
+				up->name);
+		up->hedge_percentile = 0;
+	}
+
+	if (up->hedge_percentile > 0) {
+		ctx->has_hedging = TRUE;
+	}
+
+	up->latency = rspamd_mempool_alloc0 (pool, sizeof (*up->latency));
+	up->latency->hosts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+			NULL, g_free);
+	rspamd_mempool_add_destructor (pool,
+			(rspamd_mempool_destruct_t)g_hash_table_unref,
+			up->latency->hosts);
+
+	up->keepalive_max_conns = DEFAULT_KEEPALIVE_MAX_CONNS;
+	up->keepalive_timeout = DEFAULT_KEEPALIVE_TIMEOUT;
+
+	elt = ucl_object_lookup (obj, "keepalive");
+	if (elt && ucl_object_toboolean (elt)) {
+		up->keepalive = TRUE;
+	}
+
+	elt = ucl_object_lookup (obj, "keepalive_max_conns");
+	if (elt) {
+		gint64 max_conns = 0;
+
+		ucl_object_toint_safe (elt, &max_conns);
+
+		if (max_conns < 0) {
+			g_set_error (err, rspamd_proxy_quark (), 100,
+					"keepalive_max_conns must be non-negative");
+
+			goto err;
+		}
+
+		up->keepalive_max_conns = max_conns;
+	}
+
+	elt = ucl_object_lookup (obj, "keepalive_timeout");
+	if (elt) {
+		ucl_object_todouble_safe (elt, &up->keepalive_timeout);
+	}
+
+	if (up->keepalive && up->self_scan) {
+		msg_warn_pool_check ("keepalive is not supported for self_scan upstream %s",
+				up->name);
+		up->keepalive = FALSE;
+	}
+
 	/*
 	 * Accept lua function here in form
 	 * fun :: String -> UCL
@@ -880,7 +1009,11 @@ proxy_backend_close_connection (struct rspamd_proxy_backend_connection *conn)
 		if (conn->backend_conn) {
 			rspamd_http_connection_reset (conn->backend_conn);
 			rspamd_http_connection_unref (conn->backend_conn);
-			close (conn->backend_sock);
+
+			/* Keep-alive connections own their sockets */
+			if (!(conn->flags & RSPAMD_BACKEND_KEEPALIVE)) {
+				close (conn->backend_sock);
+			}
 		}
 
 		conn->flags |= RSPAMD_BACKEND_CLOSED;
@@ -1038,10 +1171,16 @@ proxy_session_dtor (struct rspamd_proxy_session *session)
 		}
 	}
 
+	ev_timer_stop (session->ctx->event_loop, &session->hedge_ev);
+
 	if (session->master_conn) {
 		proxy_backend_close_connection (session->master_conn);
 	}
 
+	if (session->hedge_conn) {
+		proxy_backend_close_connection (session->hedge_conn);
+	}
+
 	if (session->client_milter_conn) {
 		rspamd_milter_session_unref (session->client_milter_conn);
 	}
@@ -1080,6 +1219,10 @@ proxy_session_dtor (struct rspamd_proxy_session *session)
 	rspamd_http_message_shmem_unref (session->shmem_ref);
 	rspamd_http_message_unref (session->client_message);
 
+	if (session->envelope_message) {
+		rspamd_http_message_unref (session->envelope_message);
+	}
+
 	if (session->client_addr) {
 		rspamd_inet_address_free (session->client_addr);
 	}
@@ -1203,6 +1346,79 @@ proxy_request_decompress (struct rspamd_http_message *msg)
 	}
 }
 
+static gint
+proxy_latency_cmp (const void *a, const void *b)
+{
+	gdouble da = *(const gdouble *)a, db = *(const gdouble *)b;
+
+	if (da < db) {
+		return -1;
+	}
+	else if (da > db) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static gdouble
+proxy_upstream_latency_percentile (struct rspamd_http_upstream_samples *lat,
+		gdouble percentile)
+{
+	gdouble sorted[LATENCY_SAMPLES];
+	guint n = MIN (lat->nsamples, LATENCY_SAMPLES), idx;
+
+	if (n == 0) {
+		return 0.0;
+	}
+
+	memcpy (sorted, lat->samples, n * sizeof (gdouble));
+	qsort (sorted, n, sizeof (gdouble), proxy_latency_cmp);
+	idx = MIN ((guint)(percentile * n), n - 1);
+
+	return sorted[idx];
+}
+
+static struct rspamd_http_upstream_samples *
+proxy_upstream_get_samples (struct rspamd_http_upstream *backend,
+		struct upstream *up)
+{
+	struct rspamd_http_upstream_samples *lat;
+
+	lat = g_hash_table_lookup (backend->latency->hosts, up);
+
+	if (lat == NULL) {
+		lat = g_malloc0 (sizeof (*lat));
+		g_hash_table_insert (backend->latency->hosts, up, lat);
+	}
+
+	return lat;
+}
+
+static void
+proxy_upstream_add_latency (struct rspamd_http_upstream *backend,
+		struct upstream *up,
+		gdouble latency)
+{
+	struct rspamd_http_upstream_samples *lat;
+
+	if (up == NULL) {
+		return;
+	}
+
+	lat = proxy_upstream_get_samples (backend, up);
+	lat->samples[lat->nsamples % LATENCY_SAMPLES] = latency;
+	lat->nsamples ++;
+
+	/* Sorting is not cheap, so recalculate the hedge delay periodically */
+	if (backend->hedge_percentile > 0 &&
+			lat->nsamples % (LATENCY_SAMPLES / 16) == 0) {
+		lat->hedge_delay = MAX (backend->hedge_min_delay,
+				proxy_upstream_latency_percentile (lat,
+						backend->hedge_percentile));
+	}
+}
+
 static struct rspamd_proxy_session *
 proxy_session_refresh (struct rspamd_proxy_session *session)
 {
@@ -1563,6 +1779,28 @@ proxy_backend_master_error_handler (struct rspamd_http_connection *conn, GError
 	struct rspamd_proxy_session *session;
 
 	session = bk_conn->s;
+
+	if (session->hedge_conn) {
+		/* One of two concurrent requests has failed, wait for another one */
+		msg_info_session ("abnormally closing %s connection from backend: %s, "
+						  "error: %e; waiting for another request",
+				bk_conn->name,
+				rspamd_inet_address_to_string_pretty (
+						rspamd_upstream_addr_cur (bk_conn->up)),
+				err);
+		rspamd_upstream_fail (bk_conn->up, FALSE, err ? err->message : "unknown");
+		proxy_backend_close_connection (bk_conn);
+
+		if (bk_conn == session->master_conn) {
+			session->master_conn = session->hedge_conn;
+		}
+
+		session->hedge_conn = NULL;
+
+		return;
+	}
+
+	ev_timer_stop (session->ctx->event_loop, &session->hedge_ev);
 	session->retries ++;
 	msg_info_session ("abnormally closing connection from backend: %s, error: %e,"
 					  " retries left: %d",
@@ -1604,6 +1842,30 @@ proxy_backend_master_error_handler (struct rspamd_http_connection *conn, GError
 	}
 }
 
+/*
+ * Drops our reference to a keep-alive connection after a reply has been read:
+ * http library returns it to the keep-alive pool if the backend agrees
+ */
+static void
+proxy_backend_release_keepalive (struct rspamd_proxy_backend_connection *bk_conn,
+		struct rspamd_http_message *msg)
+{
+	const rspamd_ftok_t *tok;
+	rspamd_ftok_t cmp;
+
+	RSPAMD_FTOK_ASSIGN (&cmp, "keep-alive");
+	tok = rspamd_http_message_find_header (msg, "Connection");
+
+	if (tok == NULL || rspamd_ftok_casecmp (tok, &cmp) != 0) {
+		/* Backend will close this connection, so do not pool it */
+		bk_conn->backend_conn->opts &= ~RSPAMD_HTTP_CLIENT_KEEP_ALIVE;
+	}
+
+	rspamd_http_connection_unref (bk_conn->backend_conn);
+	bk_conn->backend_conn = NULL;
+	bk_conn->flags |= RSPAMD_BACKEND_CLOSED;
+}
+
 static gint
 proxy_backend_master_finish_handler (struct rspamd_http_connection *conn,
 									 struct rspamd_http_message *msg)
@@ -1615,7 +1877,69 @@ proxy_backend_master_finish_handler (struct rspamd_http_connection *conn,
 	goffset body_offset = -1;
 
 	session = bk_conn->s;
+	ev_timer_stop (session->ctx->event_loop, &session->hedge_ev);
+
+	if (session->hedge_conn && msg->code >= 300) {
+		/* Prefer a successful reply of another request */
+		msg_info_session ("%s request to %s has failed with HTTP code %d; "
+						  "waiting for another request",
+				bk_conn->name,
+				rspamd_upstream_name (bk_conn->up),
+				msg->code);
+		/* Do not return the reset connection to the pool */
+		conn->opts &= ~RSPAMD_HTTP_CLIENT_KEEP_ALIVE;
+		proxy_backend_close_connection (bk_conn);
+
+		if (bk_conn == session->master_conn) {
+			session->master_conn = session->hedge_conn;
+		}
+
+		session->hedge_conn = NULL;
+
+		return 0;
+	}
+
+	if (session->hedge_conn) {
+		struct rspamd_proxy_backend_connection *loser;
+
+		/* The first successful reply wins */
+		if (bk_conn == session->hedge_conn) {
+			msg_info_session ("hedged request to %s has finished before "
+					"the original one",
+					rspamd_upstream_name (bk_conn->up));
+			loser = session->master_conn;
+			session->master_conn = bk_conn;
+			session->backend->latency->hedge_wins ++;
+		}
+		else {
+			loser = session->hedge_conn;
+		}
+
+		/*
+		 * The cancelled request would have taken at least that long, so
+		 * record it as well: otherwise slow hosts are sampled only when they
+		 * win, which biases the percentile low and causes more hedging
+		 */
+		if (session->backend && session->backend->latency) {
+			proxy_upstream_add_latency (session->backend, loser->up,
+					ev_now (session->ctx->event_loop) - loser->start_ts);
+		}
+
+		proxy_backend_close_connection (loser);
+		session->hedge_conn = NULL;
+	}
+
+	if (session->backend && session->backend->latency) {
+		proxy_upstream_add_latency (session->backend, bk_conn->up,
+				ev_now (session->ctx->event_loop) - bk_conn->start_ts);
+	}
+
 	rspamd_http_connection_steal_msg (session->master_conn->backend_conn);
+
+	if (bk_conn->flags & RSPAMD_BACKEND_KEEPALIVE) {
+		proxy_backend_release_keepalive (bk_conn, msg);
+	}
+
 	proxy_request_decompress (msg);
 
 	/*
@@ -1628,7 +1952,10 @@ proxy_backend_master_finish_handler (struct rspamd_http_connection *conn,
 	rspamd_http_message_remove_header (msg, "Server");
 	rspamd_http_message_remove_header (msg, "Key");
 	orig_ct = rspamd_http_message_find_header (msg, "Content-Type");
-	rspamd_http_connection_reset (session->master_conn->backend_conn);
+
+	if (!(bk_conn->flags & RSPAMD_BACKEND_KEEPALIVE)) {
+		rspamd_http_connection_reset (session->master_conn->backend_conn);
+	}
 
 	if (!proxy_backend_parse_results (session, bk_conn, session->ctx->lua_state,
 			bk_conn->parser_from_ref, msg, &body_offset, orig_ct)) {
@@ -1797,6 +2124,15 @@ rspamd_proxy_task_fin (void *ud)
 
 	msg_debug_task ("finish task");
 
+	if (task->flags & RSPAMD_TASK_FLAG_WAIT_MESSAGE) {
+		/* Run what is possible without a message and wait for it */
+		if (!RSPAMD_TASK_IS_PROCESSED (task)) {
+			rspamd_task_process (task, RSPAMD_TASK_PROCESS_ALL);
+		}
+
+		return FALSE;
+	}
+
 	if (RSPAMD_TASK_IS_PROCESSED (task)) {
 		rspamd_proxy_scan_self_reply (task);
 		return TRUE;
@@ -1816,15 +2152,17 @@ rspamd_proxy_task_fin (void *ud)
 	return FALSE;
 }
 
-static gboolean
-rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
+/*
+ * Creates a task for self scan and fills it with the request data except
+ * the message itself
+ */
+static struct rspamd_task *
+rspamd_proxy_self_scan_task (struct rspamd_proxy_session *session,
+		struct rspamd_milter_session *rms,
+		struct rspamd_http_message *msg)
 {
 	struct rspamd_task *task;
-	struct rspamd_http_message *msg;
-	const gchar *data;
-	gsize len;
 
-	msg = session->client_message;
 	task = rspamd_task_new (session->worker, session->ctx->cfg,
 			session->pool, session->ctx->lang_det,
 			session->ctx->event_loop, FALSE);
@@ -1837,9 +2175,8 @@ rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
 
 	task->sock = -1;
 
-	if (session->client_milter_conn) {
-		task->client_addr = rspamd_inet_address_copy(
-				session->client_milter_conn->addr, NULL);
+	if (rms) {
+		task->client_addr = rspamd_inet_address_copy(rms->addr, NULL);
 	}
 	else {
 		task->client_addr = rspamd_inet_address_copy(session->client_addr, NULL);
@@ -1851,7 +2188,6 @@ rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
 	task->flags |= RSPAMD_TASK_FLAG_LEARN_AUTO;
 	task->s = rspamd_session_create (task->task_pool, rspamd_proxy_task_fin,
 			NULL, (event_finalizer_t )rspamd_task_free, task);
-	data = rspamd_http_message_get_body (msg, &len);
 
 	if (session->backend->settings_id) {
 		rspamd_http_message_remove_header (msg, "Settings-ID");
@@ -1859,21 +2195,37 @@ rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
 				session->backend->settings_id);
 	}
 
-	/* Process message */
+	/* Process request */
 	if (!rspamd_protocol_handle_request (task, msg)) {
 		msg_err_task ("cannot handle request: %e", task->err);
 		task->flags |= RSPAMD_TASK_FLAG_SKIP;
 	}
-	else {
-		if (task->cmd == CMD_PING) {
+	else if (task->cmd == CMD_PING) {
+		task->flags |= RSPAMD_TASK_FLAG_SKIP;
+	}
+
+	return task;
+}
+
+/*
+ * Loads message into a self scan task and processes it
+ */
+static void
+rspamd_proxy_self_scan_message (struct rspamd_proxy_session *session,
+		struct rspamd_task *task,
+		struct rspamd_http_message *msg)
+{
+	const gchar *data;
+	gsize len;
+
+	task->flags &= ~RSPAMD_TASK_FLAG_WAIT_MESSAGE;
+	data = rspamd_http_message_get_body (msg, &len);
+
+	if (!RSPAMD_TASK_IS_SKIPPED (task) && !RSPAMD_TASK_IS_PROCESSED (task)) {
+		if (!rspamd_task_load_message (task, msg, data, len)) {
+			msg_err_task ("cannot load message: %e", task->err);
 			task->flags |= RSPAMD_TASK_FLAG_SKIP;
 		}
-		else {
-			if (!rspamd_task_load_message (task, msg, data, len)) {
-				msg_err_task ("cannot load message: %e", task->err);
-				task->flags |= RSPAMD_TASK_FLAG_SKIP;
-			}
-		}
 	}
 
 	/* Set global timeout for the task */
@@ -1899,10 +2251,322 @@ rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
 	rspamd_task_process (task, RSPAMD_TASK_PROCESS_ALL);
 
 	rspamd_session_pending (task->s);
+}
+
+static gboolean
+rspamd_proxy_self_scan (struct rspamd_proxy_session *session)
+{
+	struct rspamd_task *task;
+	struct rspamd_http_message *msg = session->client_message;
+
+	task = session->master_conn->task;
+
+	if (task == NULL || !(task->flags & RSPAMD_TASK_FLAG_WAIT_MESSAGE)) {
+		task = rspamd_proxy_self_scan_task (session,
+				session->client_milter_conn, msg);
+	}
+	else {
+		const rspamd_ftok_t *hv;
+
+		/* Task has been started early, some macros might arrive late */
+		if ((task->queue_id == NULL || strcmp (task->queue_id, "undef") == 0) &&
+				(hv = rspamd_http_message_find_header (msg, "Queue-Id")) != NULL) {
+			task->queue_id = rspamd_mempool_ftokdup (task->task_pool, hv);
+		}
+
+		msg_debug_task ("message has been received for an early started task");
+	}
+
+	rspamd_proxy_self_scan_message (session, task, msg);
 
 	return TRUE;
 }
 
+/*
+ * Starts self scan of a milter message as soon as its envelope and headers
+ * are known: connection stage can be processed while the body is received
+ */
+static void
+proxy_milter_eoh_handler (gint fd,
+		struct rspamd_milter_session *rms,
+		void *ud)
+{
+	struct rspamd_proxy_session *session = ud;
+	struct rspamd_http_message *msg;
+	struct rspamd_task *task;
+
+	if (session->ctx->default_upstream == NULL ||
+			!session->ctx->default_upstream->self_scan) {
+		return;
+	}
+
+	if (!session->master_conn) {
+		session->master_conn = rspamd_mempool_alloc0 (session->pool,
+				sizeof (*session->master_conn));
+		session->master_conn->s = session;
+		session->master_conn->name = "master";
+	}
+	else if (session->master_conn->task) {
+		/* Previous message has been aborted */
+		rspamd_session_destroy (session->master_conn->task->s);
+		session->master_conn->task = NULL;
+	}
+
+	session->backend = session->ctx->default_upstream;
+	msg = rspamd_milter_envelope_to_http (rms);
+
+	/*
+	 * Task might refer to the request headers, so we keep them till the next
+	 * envelope, as the previous task has been destroyed at this point
+	 */
+	if (session->envelope_message) {
+		rspamd_http_message_unref (session->envelope_message);
+	}
+
+	session->envelope_message = msg;
+
+	task = rspamd_proxy_self_scan_task (session, rms, msg);
+	task->flags |= RSPAMD_TASK_FLAG_WAIT_MESSAGE;
+	session->master_conn->task = task;
+
+	msg_debug_session ("start processing of the envelope before the message "
+			"is received");
+	rspamd_task_process (task, RSPAMD_TASK_PROCESS_ALL);
+}
+
+/*
+ * Opens a connection to the selected upstream of a backend or takes an idle
+ * one from the keep-alive pool; returns FALSE if connection has failed
+ */
+static gboolean
+proxy_backend_connect (struct rspamd_proxy_session *session,
+		struct rspamd_proxy_backend_connection *bk_conn,
+		struct rspamd_http_upstream *backend)
+{
+	rspamd_inet_addr_t *addr = rspamd_upstream_addr_next (bk_conn->up);
+
+	if (backend->keepalive) {
+		/* Socket is owned by the connection and might be reused */
+		bk_conn->backend_sock = -1;
+		bk_conn->backend_conn = rspamd_http_connection_new_client_keepalive (
+				session->ctx->http_ctx,
+				NULL,
+				proxy_backend_master_error_handler,
+				proxy_backend_master_finish_handler,
+				RSPAMD_HTTP_CLIENT_NO_PROXY,
+				addr,
+				rspamd_upstream_name (bk_conn->up),
+				backend->name);
+
+		if (bk_conn->backend_conn == NULL) {
+			return FALSE;
+		}
+
+		/*
+		 * Backend name is a namespace of its pool, so neither lua_http nor
+		 * other backends share these connections and limits
+		 */
+		rspamd_http_context_set_keepalive_limits (bk_conn->backend_conn,
+				backend->keepalive_max_conns, backend->keepalive_timeout);
+		bk_conn->flags |= RSPAMD_BACKEND_KEEPALIVE;
+	}
+	else {
+		bk_conn->backend_sock = rspamd_inet_address_connect (addr,
+				SOCK_STREAM, TRUE);
+
+		if (bk_conn->backend_sock == -1) {
+			return FALSE;
+		}
+
+		bk_conn->backend_conn = rspamd_http_connection_new_client_socket (
+				session->ctx->http_ctx,
+				NULL,
+				proxy_backend_master_error_handler,
+				proxy_backend_master_finish_handler,
+				RSPAMD_HTTP_CLIENT_SIMPLE,
+				bk_conn->backend_sock);
+		bk_conn->flags &= ~RSPAMD_BACKEND_KEEPALIVE;
+	}
+
+	bk_conn->flags &= ~RSPAMD_BACKEND_CLOSED;
+
+	return TRUE;
+}
+
+static void
+proxy_backend_write_message (struct rspamd_proxy_session *session,
+		struct rspamd_proxy_backend_connection *bk_conn,
+		struct rspamd_http_upstream *backend,
+		struct rspamd_http_message *msg)
+{
+	bk_conn->parser_from_ref = backend->parser_from_ref;
+	bk_conn->parser_to_ref = backend->parser_to_ref;
+	bk_conn->start_ts = ev_now (session->ctx->event_loop);
+
+	if (backend->key) {
+		msg->peer_key = rspamd_pubkey_ref (backend->key);
+	}
+
+	if (backend->settings_id != NULL) {
+		rspamd_http_message_remove_header (msg, "Settings-ID");
+		rspamd_http_message_add_header (msg, "Settings-ID",
+				backend->settings_id);
+	}
+
+	if (backend->local ||
+			rspamd_inet_address_is_local (
+					rspamd_upstream_addr_cur (bk_conn->up))) {
+
+		if (session->fname) {
+			rspamd_http_message_add_header (msg, "File", session->fname);
+		}
+
+		msg->method = HTTP_GET;
+
+		rspamd_http_connection_write_message_shared (
+				bk_conn->backend_conn,
+				msg, rspamd_upstream_name (bk_conn->up),
+				NULL, bk_conn,
+				bk_conn->timeout);
+	}
+	else {
+		if (session->fname) {
+			msg->flags &= ~RSPAMD_HTTP_FLAG_SHMEM;
+			rspamd_http_message_set_body (msg,
+					session->map, session->map_len);
+		}
+
+		msg->method = HTTP_POST;
+
+		if (backend->compress) {
+			proxy_request_compress (msg);
+			if (session->client_milter_conn) {
+				rspamd_http_message_add_header (msg, "Content-Type",
+						"application/octet-stream");
+			}
+		}
+		else {
+			if (session->client_milter_conn) {
+				rspamd_http_message_add_header (msg, "Content-Type",
+						"text/plain");
+			}
+		}
+
+		rspamd_http_connection_write_message (
+				bk_conn->backend_conn,
+				msg, rspamd_upstream_name (bk_conn->up),
+				NULL, bk_conn,
+				bk_conn->timeout);
+	}
+}
+
+static void
+proxy_backend_hedge_cb (EV_P_ ev_timer *w, int revents)
+{
+	struct rspamd_proxy_session *session =
+			(struct rspamd_proxy_session *)w->data;
+	struct rspamd_http_upstream *backend = session->backend;
+	struct rspamd_proxy_backend_connection *bk_conn;
+	struct rspamd_http_message *msg;
+	struct upstream *up;
+	GError *err = NULL;
+
+	ev_timer_stop (EV_A_ w);
+
+	if (backend == NULL || session->master_conn == NULL ||
+			(session->master_conn->flags & RSPAMD_BACKEND_CLOSED) ||
+			session->hedge_conn != NULL) {
+		return;
+	}
+
+	/* Limit extra load on upstreams */
+	if (backend->latency->hedge_tokens < 1.0) {
+		msg_debug_session ("do not send hedged request to %s: "
+				"hedging rate limit has been reached", backend->name);
+
+		return;
+	}
+
+	up = rspamd_upstream_get_except (backend->u, session->master_conn->up,
+			RSPAMD_UPSTREAM_ROUND_ROBIN, NULL, 0);
+
+	if (up == NULL || up == session->master_conn->up) {
+		msg_debug_session ("do not send hedged request to %s: "
+				"no other upstreams available", backend->name);
+
+		return;
+	}
+
+	bk_conn = rspamd_mempool_alloc0 (session->pool, sizeof (*bk_conn));
+	bk_conn->s = session;
+	bk_conn->name = "hedge";
+	bk_conn->up = up;
+	bk_conn->timeout = backend->timeout;
+	bk_conn->flags = RSPAMD_BACKEND_CLOSED;
+
+	if (!proxy_backend_connect (session, bk_conn, backend)) {
+		msg_info_session ("cannot connect upstream for hedged request: %s",
+				rspamd_inet_address_to_string_pretty (
+						rspamd_upstream_addr_cur (up)));
+		rspamd_upstream_fail (up, TRUE, strerror (errno));
+
+		return;
+	}
+
+	msg = rspamd_http_connection_copy_msg (session->client_message, &err);
+
+	if (msg == NULL) {
+		msg_err_session ("cannot copy message to send hedged request: %e",
+				err);
+
+		if (err) {
+			g_error_free (err);
+		}
+
+		proxy_backend_close_connection (bk_conn);
+
+		return;
+	}
+
+	backend->latency->hedge_tokens -= 1.0;
+	backend->latency->hedged ++;
+	session->hedge_conn = bk_conn;
+
+	msg_info_session ("send hedged request to %s as %s has not replied "
+			"in %.3f seconds",
+			rspamd_upstream_name (up),
+			rspamd_upstream_name (session->master_conn->up),
+			ev_now (EV_A) - session->master_conn->start_ts);
+	proxy_backend_write_message (session, bk_conn, backend, msg);
+}
+
+static void
+proxy_backend_schedule_hedge (struct rspamd_proxy_session *session,
+		struct rspamd_http_upstream *backend)
+{
+	struct rspamd_http_upstream_samples *lat;
+
+	ev_timer_stop (session->ctx->event_loop, &session->hedge_ev);
+
+	if (backend->hedge_percentile <= 0 || session->hedge_conn != NULL ||
+			session->master_conn->up == NULL) {
+		return;
+	}
+
+	/* The delay depends on the host that has got the original request */
+	lat = proxy_upstream_get_samples (backend, session->master_conn->up);
+
+	if (lat->nsamples < HEDGE_MIN_SAMPLES || lat->hedge_delay <= 0 ||
+			lat->hedge_delay >= session->master_conn->timeout) {
+		return;
+	}
+
+	session->hedge_ev.data = session;
+	ev_timer_init (&session->hedge_ev, proxy_backend_hedge_cb,
+			lat->hedge_delay, 0.0);
+	ev_timer_start (session->ctx->event_loop, &session->hedge_ev);
+}
+
 static gboolean
 proxy_send_master_message (struct rspamd_proxy_session *session)
 {
@@ -1937,6 +2601,13 @@ proxy_send_master_message (struct rspamd_proxy_session *session)
 		if (backend->self_scan) {
 			return rspamd_proxy_self_scan (session);
 		}
+
+		if (session->retries == 0) {
+			/* Each request allows a fraction of a hedged request */
+			backend->latency->requests ++;
+			backend->latency->hedge_tokens = MIN (HEDGE_MAX_BURST,
+					backend->latency->hedge_tokens + backend->hedge_max_rate);
+		}
 retry:
 		if (session->ctx->max_retries &&
 				session->retries > session->ctx->max_retries) {
@@ -1972,11 +2643,7 @@ retry:
 			goto err;
 		}
 
-		session->master_conn->backend_sock = rspamd_inet_address_connect (
-				rspamd_upstream_addr_next (session->master_conn->up),
-				SOCK_STREAM, TRUE);
-
-		if (session->master_conn->backend_sock == -1) {
+		if (!proxy_backend_connect (session, session->master_conn, backend)) {
 			msg_err_session ("cannot connect upstream: %s(%s)",
 					host ? hostbuf : "default",
 							rspamd_inet_address_to_string_pretty (
@@ -2000,73 +2667,8 @@ retry:
 			goto err; /* No fallback here */
 		}
 
-		session->master_conn->backend_conn = rspamd_http_connection_new_client_socket (
-				session->ctx->http_ctx,
-				NULL,
-				proxy_backend_master_error_handler,
-				proxy_backend_master_finish_handler,
-				RSPAMD_HTTP_CLIENT_SIMPLE,
-				session->master_conn->backend_sock);
-		session->master_conn->flags &= ~RSPAMD_BACKEND_CLOSED;
-		session->master_conn->parser_from_ref = backend->parser_from_ref;
-		session->master_conn->parser_to_ref = backend->parser_to_ref;
-
-		if (backend->key) {
-			msg->peer_key = rspamd_pubkey_ref (backend->key);
-		}
-
-		if (backend->settings_id != NULL) {
-			rspamd_http_message_remove_header (msg, "Settings-ID");
-			rspamd_http_message_add_header (msg, "Settings-ID",
-					backend->settings_id);
-		}
-
-		if (backend->local ||
-				rspamd_inet_address_is_local (
-						rspamd_upstream_addr_cur (
-								session->master_conn->up))) {
-
-			if (session->fname) {
-				rspamd_http_message_add_header (msg, "File", session->fname);
-			}
-
-			msg->method = HTTP_GET;
-
-			rspamd_http_connection_write_message_shared (
-					session->master_conn->backend_conn,
-					msg, rspamd_upstream_name(session->master_conn->up),
-					NULL, session->master_conn,
-					session->master_conn->timeout);
-		}
-		else {
-			if (session->fname) {
-				msg->flags &= ~RSPAMD_HTTP_FLAG_SHMEM;
-				rspamd_http_message_set_body (msg,
-						session->map, session->map_len);
-			}
-
-			msg->method = HTTP_POST;
-
-			if (backend->compress) {
-				proxy_request_compress (msg);
-				if (session->client_milter_conn) {
-					rspamd_http_message_add_header (msg, "Content-Type",
-							"application/octet-stream");
-				}
-			}
-			else {
-				if (session->client_milter_conn) {
-					rspamd_http_message_add_header (msg, "Content-Type",
-							"text/plain");
-				}
-			}
-
-			rspamd_http_connection_write_message (
-					session->master_conn->backend_conn,
-					msg, rspamd_upstream_name(session->master_conn->up),
-					NULL, session->master_conn,
-					session->master_conn->timeout);
-		}
+		proxy_backend_write_message (session, session->master_conn, backend, msg);
+		proxy_backend_schedule_hedge (session, backend);
 	}
 
 	return TRUE;
@@ -2095,6 +2697,7 @@ proxy_client_error_handler (struct rspamd_http_connection *conn, GError *err)
 		rspamd_inet_address_to_string (session->client_addr), err->message);
 	/* Terminate session immediately */
 	proxy_backend_close_connection (session->master_conn);
+	proxy_backend_close_connection (session->hedge_conn);
 	REF_RELEASE (session);
 }
 
@@ -2312,11 +2915,63 @@ proxy_accept_socket (EV_P_ ev_io *w, int revents)
 				session->pool,
 				ctx->event_loop,
 				proxy_milter_finish_handler,
+				proxy_milter_eoh_handler,
 				proxy_milter_error_handler,
 				session);
 	}
 }
 
+static void
+proxy_hedge_stat_cb (EV_P_ ev_timer *w, int revents)
+{
+	struct rspamd_proxy_ctx *ctx = (struct rspamd_proxy_ctx *)w->data;
+	struct rspamd_http_upstream *backend;
+	struct rspamd_http_upstream_latency *lat;
+	struct rspamd_http_upstream_samples *samples;
+	gpointer k, v;
+	GHashTableIter it, hit;
+
+	g_hash_table_iter_init (&it, ctx->upstreams);
+
+	while (g_hash_table_iter_next (&it, &k, &v)) {
+		backend = (struct rspamd_http_upstream *)v;
+		lat = backend->latency;
+
+		if (backend->hedge_percentile <= 0 || lat == NULL ||
+				lat->requests == 0) {
+			continue;
+		}
+
+		msg_info ("upstream %s: %uL requests, %uL hedged (%.2f%%), "
+				  "%uL won by hedged requests",
+				backend->name,
+				lat->requests,
+				lat->hedged,
+				(gdouble)lat->hedged * 100.0 / lat->requests,
+				lat->hedge_wins);
+
+		g_hash_table_iter_init (&hit, lat->hosts);
+
+		while (g_hash_table_iter_next (&hit, &k, &v)) {
+			samples = (struct rspamd_http_upstream_samples *)v;
+
+			if (samples->nsamples == 0) {
+				continue;
+			}
+
+			msg_info ("upstream %s, host %s: latency p50: %.3f, p%.0f: %.3f, "
+					  "hedge delay: %.3f",
+					backend->name,
+					rspamd_upstream_name ((struct upstream *)k),
+					proxy_upstream_latency_percentile (samples, 0.5),
+					backend->hedge_percentile * 100.0,
+					proxy_upstream_latency_percentile (samples,
+							backend->hedge_percentile),
+					samples->hedge_delay);
+		}
+	}
+}
+
 static void
 adjust_upstreams_limits (struct rspamd_proxy_ctx *ctx)
 {
@@ -2445,6 +3100,13 @@ start_rspamd_proxy (struct rspamd_worker *worker)
 			worker);
 	adjust_upstreams_limits (ctx);
 
+	if (ctx->has_hedging) {
+		ctx->hedge_stat_ev.data = ctx;
+		ev_timer_init (&ctx->hedge_stat_ev, proxy_hedge_stat_cb,
+				HEDGE_STAT_INTERVAL, HEDGE_STAT_INTERVAL);
+		ev_timer_start (ctx->event_loop, &ctx->hedge_stat_ev);
+	}
+
 	ev_loop (ctx->event_loop, 0);
 	rspamd_worker_block_signals ();
 
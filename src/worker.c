@@ -74,6 +74,7 @@ struct rspamd_worker_session {
 	struct rspamd_worker_ctx *ctx;
 	struct rspamd_http_connection *http_conn;
 	struct rspamd_worker *worker;
+	gboolean keepalive;
 };
 /*
  * Reduce number of tasks proceeded
@@ -115,6 +116,21 @@ rspamd_worker_body_handler (struct rspamd_http_connection *conn,
 
 	ctx = session->ctx;
 
+	/* Check if a client wants to reuse this connection */
+	conn->opts &= ~RSPAMD_HTTP_SERVER_KEEP_ALIVE;
+
+	if (ctx->keepalive_timeout > 0 && msg->method < HTTP_SYMBOLS &&
+			session->worker->state == rspamd_worker_state_running &&
+			(hv_tok = rspamd_http_message_find_header (msg, "Connection")) != NULL) {
+		rspamd_ftok_t cmp;
+
+		RSPAMD_FTOK_ASSIGN (&cmp, "keep-alive");
+
+		if (rspamd_ftok_casecmp (hv_tok, &cmp) == 0) {
+			conn->opts |= RSPAMD_HTTP_SERVER_KEEP_ALIVE;
+		}
+	}
+
 	/* Check debug */
 	if ((hv_tok = rspamd_http_message_find_header (msg, "Memory")) != NULL) {
 		rspamd_ftok_t cmp;
@@ -266,6 +282,8 @@ rspamd_worker_error_handler (struct rspamd_http_connection *conn, GError *err)
 			}
 
 			msg->date = time (NULL);
+			/* Do not reuse connection after an error */
+			task->http_conn->opts &= ~RSPAMD_HTTP_SERVER_KEEP_ALIVE;
 
 			reply = rspamd_fstring_sized_new (msg->status->len + 16);
 			rspamd_printf_fstring (&reply, "{\"error\":\"%V\"}", msg->status);
@@ -282,8 +300,14 @@ rspamd_worker_error_handler (struct rspamd_http_connection *conn, GError *err)
 	}
 	else {
 		/* If there was no task, then session is unmanaged */
-		msg_info ("no data received from: %s, error: %e",
-				rspamd_inet_address_to_string_pretty (session->addr), err);
+		if (session->keepalive) {
+			msg_debug ("keep-alive connection from: %s has been closed: %e",
+					rspamd_inet_address_to_string_pretty (session->addr), err);
+		}
+		else {
+			msg_info ("no data received from: %s, error: %e",
+					rspamd_inet_address_to_string_pretty (session->addr), err);
+		}
 		rspamd_http_connection_reset (session->http_conn);
 		rspamd_http_connection_unref (session->http_conn);
 		rspamd_inet_address_free (session->addr);
@@ -292,6 +316,37 @@ rspamd_worker_error_handler (struct rspamd_http_connection *conn, GError *err)
 	}
 }
 
+/*
+ * Takes connection from a finished task and waits for the next request on it
+ */
+static void
+rspamd_worker_keepalive_session (struct rspamd_task *task)
+{
+	struct rspamd_worker_session *session;
+	struct rspamd_worker_ctx *ctx = task->worker->ctx;
+
+	session = g_malloc0 (sizeof (*session));
+	session->magic = G_MAXINT64;
+	session->ctx = ctx;
+	session->worker = task->worker;
+	session->keepalive = TRUE;
+	session->addr = rspamd_inet_address_copy (task->client_addr, NULL);
+	/* Both socket and connection are now owned by the session */
+	session->fd = task->sock;
+	session->http_conn = task->http_conn;
+	task->sock = -1;
+	task->http_conn = NULL;
+
+	msg_debug_task ("keep connection from: %s alive",
+			rspamd_inet_address_to_string (task->client_addr));
+	rspamd_session_destroy (task->s);
+
+	rspamd_http_connection_reset (session->http_conn);
+	rspamd_http_connection_read_message (session->http_conn,
+			session,
+			ctx->keepalive_timeout);
+}
+
 static gint
 rspamd_worker_finish_handler (struct rspamd_http_connection *conn,
 	struct rspamd_http_message *msg)
@@ -311,9 +366,15 @@ rspamd_worker_finish_handler (struct rspamd_http_connection *conn,
 	if (task) {
 		if (task->processed_stages & RSPAMD_TASK_STAGE_REPLIED) {
 			/* We are done here */
-			msg_debug_task ("normally closing connection from: %s",
-					rspamd_inet_address_to_string (task->client_addr));
-			rspamd_session_destroy (task->s);
+			if ((conn->opts & RSPAMD_HTTP_SERVER_KEEP_ALIVE) &&
+					task->worker->state == rspamd_worker_state_running) {
+				rspamd_worker_keepalive_session (task);
+			}
+			else {
+				msg_debug_task ("normally closing connection from: %s",
+						rspamd_inet_address_to_string (task->client_addr));
+				rspamd_session_destroy (task->s);
+			}
 		}
 		else if (task->processed_stages & RSPAMD_TASK_STAGE_DONE) {
 			rspamd_session_pending (task->s);
@@ -454,6 +515,17 @@ init_worker (struct rspamd_config *cfg)
 			RSPAMD_CL_FLAG_TIME_FLOAT,
 			"Maximum task processing time, default: 8.0 seconds");
 
+	rspamd_rcl_register_worker_option (cfg,
+			type,
+			"keepalive_timeout",
+			rspamd_rcl_parse_struct_time,
+			ctx,
+			G_STRUCT_OFFSET (struct rspamd_worker_ctx,
+						keepalive_timeout),
+			RSPAMD_CL_FLAG_TIME_FLOAT,
+			"Keep connections open for this time between requests if a client "
+			"asks for keep-alive (0 disables keep-alive, default)");
+
 	rspamd_rcl_register_worker_option (cfg,
 			type,
 			"max_tasks",
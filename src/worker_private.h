@@ -49,6 +49,8 @@ struct rspamd_worker_ctx {
 	guint32 max_tasks;
 	/* Maximum time for task processing */
 	ev_tstamp task_timeout;
+	/* Idle timeout for keep-alive connections, 0 disables keep-alive */
+	ev_tstamp keepalive_timeout;
 	/* Encryption key */
 	struct rspamd_cryptobox_keypair *key;
 	/* Keys cache */
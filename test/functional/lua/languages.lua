@@ -0,0 +1,11 @@
+rspamd_config:register_symbol({
+  name = 'TEST_LANGUAGE',
+  score = 1.0,
+  callback = function(task)
+    local langs = {}
+    for _,tp in ipairs(task:get_text_parts() or {}) do
+      table.insert(langs, tp:get_language() or 'unknown')
+    end
+    return true, langs
+  end
+})
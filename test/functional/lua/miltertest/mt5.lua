@@ -0,0 +1,41 @@
+print('Check we will accept a message after aborted ones')
+
+dofile './lib.lua'
+dofile './data.lua'
+
+setup()
+
+local function send_headers(id)
+  mt.macro(conn, SMFIC_MAIL, "i", id)
+  if mt.mailfrom(conn, "nerf@example.org") then
+    error "mt.mailfrom() failed"
+  end
+  if mt.getreply(conn) ~= SMFIR_CONTINUE then
+    error "mt.mailfrom() unexpected reply"
+  end
+  mt.rcptto(conn, "nerf@example.org")
+  for k, v in pairs(innocuous_hdrs) do
+    if mt.header(conn, k, v) then
+      error (string.format("mt.header(%s) failed", k))
+    end
+  end
+  if mt.eoh(conn) then
+    error "mt.eoh() failed"
+  end
+  if mt.getreply(conn) ~= SMFIR_CONTINUE then
+    error "mt.eoh() unexpected reply"
+  end
+end
+
+-- Messages are aborted after their envelopes have been scanned
+for i = 1, 3 do
+  send_headers('aborted-' .. i)
+  if mt.abort(conn) then
+    error "mt.abort() failed"
+  end
+end
+
+send_message(innocuous_msg, innocuous_hdrs, 'test-id', 'nerf@example.org', {'nerf@example.org'})
+check_accept()
+
+teardown()
@@ -88,6 +88,39 @@ local function redis_symbol(task)
 
 end
 
+-- Two symbols send requests to the same key, so the second one is pipelined
+-- into the connection opened by the first one
+local function redis_batch_first(task)
+  local function redis_cb(err, data)
+    if err then
+      task:insert_result('REDIS_BATCH_ERROR', 1.0, err)
+    else
+      task:insert_result('REDIS_BATCH_FIRST', 1.0, data)
+    end
+  end
+
+  local _,conn = redis_lua.redis_batch_request(task, redis_params, 'test_key',
+      false, redis_cb, 'GET', {'test_key'})
+  task:cache_set('redis_batch_test_conn', conn)
+end
+
+local function redis_batch_second(task)
+  local function redis_cb(err, data)
+    if err then
+      task:insert_result('REDIS_BATCH_ERROR', 1.0, err)
+    else
+      task:insert_result('REDIS_BATCH_SECOND', 1.0, data)
+    end
+  end
+
+  local _,conn = redis_lua.redis_batch_request(task, redis_params, 'test_key',
+      false, redis_cb, 'GET', {'test_key'})
+
+  if conn and conn == task:cache_get('redis_batch_test_conn') then
+    task:insert_result('REDIS_BATCH_PIPELINED', 1.0)
+  end
+end
+
 redis_params = rspamd_parse_redis_server(N)
 
 rspamd_config:register_symbol({
@@ -104,6 +137,21 @@ rspamd_config:register_symbol({
   no_squeeze = true
 })
 
+rspamd_config:register_symbol({
+  name = 'REDIS_BATCH_FIRST_TEST',
+  score = 1.0,
+  priority = 10,
+  callback = redis_batch_first,
+  no_squeeze = true
+})
+
+rspamd_config:register_symbol({
+  name = 'REDIS_BATCH_SECOND_TEST',
+  score = 1.0,
+  callback = redis_batch_second,
+  no_squeeze = true
+})
+
 rspamd_config:register_symbol({
   name = 'REDIS_TEST',
   score = 1.0,
@@ -244,6 +244,25 @@ local function http_tcp_symbol(task)
   logger.errx(task, '(is_ok: %1) content [%2 bytes] %3', is_ok, content_length, content)
 end
 
+local function tcp_ssl_keepalive_symbol(task)
+  local function ssl_keepalive_cb(err, data, conn)
+    logger.errx(task, 'ssl_keepalive_cb: got reply: %s, error: %s, conn: %s', data, err, conn)
+    task:insert_result('TCP_SSL_KEEPALIVE', 1.0, tostring(data):gsub('%s', ''))
+  end
+  rspamd_tcp:request({
+    task = task,
+    callback = ssl_keepalive_cb,
+    host = '127.0.0.1',
+    data = {'test\n'},
+    stop_pattern = '\n',
+    read = true,
+    ssl = true,
+    ssl_noverify = true,
+    keepalive = true,
+    port = 14433,
+  })
+end
+
 rspamd_config:register_symbol({
   name = 'SIMPLE_TCP_ASYNC_TEST',
   score = 1.0,
@@ -262,6 +281,12 @@ rspamd_config:register_symbol({
   callback = http_large_tcp_ssl_symbol,
   no_squeeze = true
 })
+rspamd_config:register_symbol({
+  name = 'TCP_ASYNC_SSL_KEEPALIVE_TEST',
+  score = 1.0,
+  callback = tcp_ssl_keepalive_symbol,
+  no_squeeze = true
+})
 rspamd_config:register_symbol({
   name = 'SIMPLE_TCP_TEST',
   score = 1.0,
@@ -0,0 +1,35 @@
+rspamd_config:register_symbol({
+  name = 'TEST_TIMER',
+  score = 1.0,
+  callback = function(task)
+    local calls = 0
+
+    task:add_timer(0.05, function()
+      calls = calls + 1
+
+      if calls < 3 then
+        -- Call us once again
+        return 0.05
+      end
+
+      -- Nested timer must keep this symbol pending as well
+      task:add_timer(0.05, function()
+        task:insert_result('TEST_TIMER', 1.0, tostring(calls))
+      end)
+    end)
+  end
+})
+
+rspamd_config:register_symbol({
+  name = 'TEST_TIMER_DEP',
+  score = 1.0,
+  callback = function(task)
+    if task:has_symbol('TEST_TIMER') then
+      return true, 'timer finished'
+    end
+
+    return true, 'timer pending'
+  end
+})
+
+rspamd_config:register_dependency('TEST_TIMER_DEP', 'TEST_TIMER')
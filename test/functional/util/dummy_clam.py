@@ -6,6 +6,7 @@ import os
 import socket
 import socketserver
 import sys
+import time
 
 import dummy_killer
 
@@ -13,6 +14,8 @@ class MyTCPHandler(socketserver.BaseRequestHandler):
 
     def handle(self):
         self.data = self.request.recv(1024).strip()
+        if self.server.delay:
+            time.sleep(self.server.delay)
         if self.server.foundvirus:
             self.request.sendall(b"stream: Eicar-Test-Signature FOUND\0")
         else:
@@ -29,13 +32,20 @@ if __name__ == "__main__":
             foundvirus = bool(sys.argv[2])
         else:
             foundvirus = False
+        # The last argument is a pid file
+        if alen >= 5 and sys.argv[3]:
+            delay = float(sys.argv[3])
+        else:
+            delay = 0
     else:
         port = 3310
         foundvirus = False
+        delay = 0
 
     server = socketserver.TCPServer((HOST, port), MyTCPHandler, bind_and_activate=False)
     server.allow_reuse_address = True
     server.foundvirus = foundvirus
+    server.delay = delay
     server.server_bind()
     server.server_activate()
 
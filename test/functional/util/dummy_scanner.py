@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+# Pretends to be a scanner backend of the proxy
+# Usage: dummy_scanner.py <port> <delay> <code> <pid file>
+
+import http.server
+import socket
+import socketserver
+import sys
+import time
+
+import dummy_killer
+
+REPLY = b'{"action": "no action", "score": 0.0, "required_score": 15.0, "symbols": {}}'
+
+
+class MyHandler(http.server.BaseHTTPRequestHandler):
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        self.rfile.read(length)
+
+        if self.server.delay:
+            time.sleep(self.server.delay)
+
+        if self.server.code == 200:
+            response = REPLY
+        else:
+            response = b'{"error": "dummy error"}'
+
+        self.send_response(self.server.code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(response)))
+        self.end_headers()
+        self.wfile.write(response)
+
+    def log_message(self, format, *args):
+        return
+
+
+class ThreadingSimpleServer(socketserver.ThreadingMixIn,
+                   http.server.HTTPServer):
+    def __init__(self, port):
+        self.allow_reuse_address = True
+        self.daemon_threads = True
+        self.timeout = 1
+        http.server.HTTPServer.__init__(self, ('127.0.0.1', port), MyHandler)
+
+
+if __name__ == '__main__':
+    server = ThreadingSimpleServer(int(sys.argv[1]))
+    server.delay = float(sys.argv[2])
+    server.code = int(sys.argv[3])
+
+    dummy_killer.setup_killer(server)
+    dummy_killer.write_pid(sys.argv[4])
+
+    try:
+        while 1:
+            server.handle_request()
+    except socket.error:
+        print("Socket closed")
@@ -53,4 +53,21 @@ context("Rspamd compression", function()
     assert_rspamd_eq({actual = dctx:stream(rspamd_text.fromtable(tout)),
                       expect = rspamd_text.fromtable(tin)})
   end)
-end)
\ No newline at end of file
+
+  test("Dictionary compression", function()
+    local str = '{"action":"no action","score":1.5,"symbols":["DKIM_TRACE"]}'
+    local dict = rspamd_zstd.dictionary(string.rep(str, 16))
+    local rspamd_util = require "rspamd_util"
+
+    assert_equal(dict:id(), 0)
+    local compressed = dict:compress(str)
+    assert_true(#compressed < #rspamd_util.zstd_compress(str))
+    local err, res = dict:decompress(compressed)
+    assert_nil(err)
+    assert_rspamd_eq({actual = res, expect = rspamd_text.fromstring(str)})
+    -- Data compressed without dictionary
+    err, res = dict:decompress(rspamd_util.zstd_compress(str))
+    assert_nil(err)
+    assert_rspamd_eq({actual = res, expect = rspamd_text.fromstring(str)})
+  end)
+end)
@@ -109,4 +109,51 @@ context("Rspamd expressions", function()
           expr:to_string(), c[1], res, c[2]))
     end)
   end
+
+  test("Expression native atoms", function()
+    local rspamd_task = require "rspamd_task"
+    local msg = [[
+From: <user@example.com>
+To: <nobody@example.com>
+Subject: test
+
+Test.
+]]
+    local res,task = rspamd_task.load_from_string(msg)
+    assert_true(res, "failed to load message")
+
+    local function native_parse(str)
+      local token = parse_func(str)
+      if token:sub(1, 4) == 'SYM_' then
+        return {name = token, type = 'symbol'}
+      end
+      return token
+    end
+    local function lua_atom(token, t)
+      assert_equal(t, task)
+      return atoms[token] or 0
+    end
+
+    local ncases = {
+      {'!SYM_A & A', 1, {'A'}},
+      {'SYM_A | B', 0, {}},
+      {'(SYM_A + SYM_B + C + E) >= 2', 1, {'C', 'E'}},
+    }
+
+    for _,c in ipairs(ncases) do
+      local expr,err = rspamd_expression.create(c[1], native_parse, pool)
+      assert_not_nil(expr, "Cannot parse " .. c[1] .. '; error: ' .. (err or 'wut??'))
+      local r,trace = expr:process_task_traced(task, nil, lua_atom)
+      assert_equal(r, c[2], string.format("Processed expr '%s' returned '%s', expected: '%s'",
+          c[1], r, c[2]))
+      assert_rspamd_table_eq_sorted({actual = trace, expect = c[3]})
+    end
+
+    local expr = rspamd_expression.create('RE', function()
+      return {name = 'RE', type = 'regexp', re_type = 'mime'}
+    end, pool)
+    assert_nil(expr, "Should not be able to parse native atom without regexp")
+
+    task:destroy()
+  end)
 end)
@@ -0,0 +1,64 @@
+-- Task ffi accessors tests
+
+context("Task ffi accessors", function()
+  if type(jit) ~= 'table' then return end
+
+  local rspamd_task = require "rspamd_task"
+  local lua_ffi = require "lua_ffi"
+  local ffi_task = lua_ffi.task
+
+  local msg = [[
+From: Sender <Sender@Example.com>
+To: <rcpt@example.org>
+X-Test: =?UTF-8?Q?caf=C3=A9?=
+X-Test: second
+Subject: test
+
+Test text http://example.com/ and http://example.net/
+]]
+
+  test("Compare with task methods", function()
+    local res,task = rspamd_task.load_from_string(msg)
+    assert_true(res, "failed to load message")
+    task:process_message()
+
+    assert_equal(ffi_task.get_header_count(task, 'x-test'), 2)
+    assert_equal(ffi_task.get_header(task, 'X-Test'), task:get_header('X-Test'))
+    assert_equal(ffi_task.get_header_raw(task, 'X-Test'),
+        task:get_header_raw('X-Test'))
+    assert_equal(ffi_task.get_header(task, 'X-Test', 2), 'second')
+    assert_nil(ffi_task.get_header(task, 'X-Test', 3))
+    assert_nil(ffi_task.get_header(task, 'X-Missing'))
+    assert_equal(ffi_task.get_from_addr(task, 'mime'), 'Sender@Example.com')
+    assert_nil(ffi_task.get_from_addr(task, 'smtp'))
+    assert_equal(ffi_task.get_text_parts_count(task), #task:get_text_parts())
+    assert_equal(ffi_task.get_text_part_content(task, 1),
+        tostring(task:get_text_parts()[1]:get_content()))
+    assert_nil(ffi_task.get_text_part_content(task, 2))
+    assert_equal(ffi_task.get_urls_count(task), #task:get_urls())
+
+    assert_false(ffi_task.has_symbol(task, 'TEST_SYMBOL'))
+    assert_nil(ffi_task.get_symbol_score(task, 'TEST_SYMBOL'))
+    task:insert_result('TEST_SYMBOL', 1.0)
+    assert_true(ffi_task.has_symbol(task, 'TEST_SYMBOL'))
+    assert_equal(ffi_task.get_symbol_score(task, 'TEST_SYMBOL'),
+        task:get_symbol('TEST_SYMBOL')[1].score)
+
+    task:destroy()
+  end)
+
+  test("Raw task pointer", function()
+    local res,task = rspamd_task.load_from_string(msg)
+    assert_true(res, "failed to load message")
+    task:process_message()
+
+    local ptr = ffi_task.task_ptr(task)
+    assert_equal(type(ptr), 'cdata')
+    assert_equal(ffi_task.task_ptr(task), ptr)
+    assert_equal(ffi_task.task_ptr(ptr), ptr)
+    assert_equal(ffi_task.get_header(ptr, 'X-Test', 2), 'second')
+    assert_equal(ffi_task.get_urls_count(ptr), #task:get_urls())
+
+    task:destroy()
+  end)
+end)
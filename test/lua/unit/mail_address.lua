@@ -0,0 +1,95 @@
+-- MIME address list parser tests
+
+context("MIME address list parser", function()
+  local rspamd_parsers = require "rspamd_parsers"
+  local util = require "rspamd_util"
+  local fun = require "fun"
+
+  local cases = {
+    {'Test <test@example.com>',
+     {{addr = 'test@example.com', user = 'test', domain = 'example.com', name = 'Test'}}},
+    {'test@example.com',
+     {{addr = 'test@example.com', user = 'test', domain = 'example.com', name = ''}}},
+    {'"Some, Name" <a@example.com>, b@example.org',
+     {{addr = 'a@example.com', name = 'Some, Name'},
+      {addr = 'b@example.org', domain = 'example.org'}}},
+    {'Name (comment) <a@example.com>',
+     {{addr = 'a@example.com', name = 'Name'}}},
+    {'"Name (not a comment)" <a@example.com>',
+     {{addr = 'a@example.com', name = 'Name (not a comment)'}}},
+    {'=?UTF-8?B?0J/RgNC40LLQtdGC?= <a@example.com>',
+     {{addr = 'a@example.com', name = 'Привет'}}},
+    {'<a@example.com>, <b@example.com>,<c@example.com>',
+     {{addr = 'a@example.com'}, {addr = 'b@example.com'}, {addr = 'c@example.com'}}},
+    -- Control characters in names are sanitized
+    {'"A\tB" <a@example.com>',
+     {{addr = 'a@example.com', name = 'A B'}}},
+    {'"A\1B\27" <a@example.com>',
+     {{addr = 'a@example.com', name = 'A?B?'}}},
+    -- Trailing spaces after a bare address
+    {'a@example.com   ',
+     {{addr = 'a@example.com', user = 'a', domain = 'example.com'}}},
+    {'b@example.com, a@example.com \t',
+     {{addr = 'b@example.com'}, {addr = 'a@example.com', domain = 'example.com'}}},
+  }
+
+  fun.each(function(case)
+    test("Parse address list: " .. case[1], function()
+      local res = rspamd_parsers.parse_mail_address(case[1])
+
+      assert_not_nil(res, "should be able to parse " .. case[1])
+      assert_equal(#res, #case[2])
+
+      for i,expected in ipairs(case[2]) do
+        for k,v in pairs(expected) do
+          assert_equal(res[i][k], v,
+              string.format('%s[%d].%s: expected %s, got %s',
+                  case[1], i, k, v, res[i][k]))
+        end
+      end
+    end)
+  end, cases)
+
+  local function gen_list(nrcpts)
+    local rcpts = {}
+
+    for i = 1,nrcpts do
+      if i % 2 == 0 then
+        rcpts[i] = string.format('"Recipient %d" <rcpt%d@example%d.com>', i, i, i % 10)
+      else
+        rcpts[i] = string.format('rcpt%d@example%d.com', i, i % 10)
+      end
+    end
+
+    return table.concat(rcpts, ', ')
+  end
+
+  test("Large recipients list", function()
+    local res = rspamd_parsers.parse_mail_address(gen_list(5000))
+
+    assert_equal(#res, 5000)
+    assert_equal(res[1].addr, 'rcpt1@example1.com')
+    assert_equal(res[5000].addr, 'rcpt5000@example0.com')
+    assert_equal(res[5000].name, 'Recipient 5000')
+  end)
+
+  test("Speed test", function()
+    local niter = 100
+    local total = 0
+
+    for _,nrcpts in ipairs({10, 1000, 10000}) do
+      local hdr = gen_list(nrcpts)
+      total = 0
+
+      for _ = 1,niter do
+        local t1 = util.get_ticks()
+        rspamd_parsers.parse_mail_address(hdr, nil, nrcpts)
+        local t2 = util.get_ticks()
+        total = total + t2 - t1
+      end
+
+      print(string.format('Spend %f seconds in processing %d lists of %d recipients',
+          total, niter, nrcpts))
+    end
+  end)
+end)
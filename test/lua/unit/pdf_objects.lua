@@ -0,0 +1,38 @@
+-- PDF objects parser tests
+
+context("PDF objects parser", function()
+  local rspamd_parsers = require "rspamd_parsers"
+  local rspamd_text = require "rspamd_text"
+
+  local cases = {
+    {'<< /Type /Page /Parent 3 0 R /MediaBox [0 0 612.5 -792] >>',
+     {Type = 'Page', Parent = {'%REF%', '3', '0'}, MediaBox = {0, 0, 612.5, -792}}},
+    {'\n<</Length 42/Filter/FlateDecode>>stream',
+     {Length = 42, Filter = 'FlateDecode'}},
+    {'<< /URI (http://example.com/\\(a\\)\\101) /S /URI >>',
+     {URI = 'http://example.com/(a)A', S = 'URI'}},
+    {'<< /JS <6a73 2> /Flag true /Opt null >>',
+     {JS = 'js ', Flag = 'true'}},
+    {'% comment\n<< /A#20B [ (x) <79> /z ] >>',
+     {['A B'] = {'x', 'y', 'z'}}},
+    {'[1 2 R 3]', {{'%REF%', '1', '2'}, 3}},
+    {'(nested (string) here)', 'nested (string) here'},
+    {'<< /Broken [1 2 3 >>', nil},
+    {'<< /Unterminated (abc >>', nil},
+    {'', nil},
+  }
+
+  for i,c in ipairs(cases) do
+    test("Parse PDF object " .. tostring(i), function()
+      local res = rspamd_parsers.parse_pdf_object(c[1])
+      assert_rspamd_table_eq({actual = res, expect = c[2]})
+      res = rspamd_parsers.parse_pdf_object(rspamd_text.fromstring(c[1]))
+      assert_rspamd_table_eq({actual = res, expect = c[2]})
+    end)
+  end
+
+  test("Nesting limit", function()
+    local deep = string.rep('[', 100) .. string.rep(']', 100)
+    assert_nil(rspamd_parsers.parse_pdf_object(deep))
+  end)
+end)
@@ -77,3 +77,45 @@ context("Rspamd_text:find() test", function()
     end)
   end
 end)
+
+context("Rspamd_text:count_nonprintable() test", function()
+  local rspamd_text = require "rspamd_text"
+
+  local cases = {
+    {'plain ascii\r\n\ttext', 0},
+    {'control\0chars\1here', 2},
+    {'utf8: \xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 text', 0},
+    {'koi8: \xd0\xd2\xc9\xd7\xc5\xd4 text', 0},
+    {'lone \xff byte', 1},
+    {'', 0},
+  }
+
+  for i,c in ipairs(cases) do
+    test("count_nonprintable " .. tostring(i), function()
+      local t = rspamd_text.fromstring(c[1])
+      assert_equal(t:count_nonprintable(), c[2])
+    end)
+  end
+end)
+
+context("Rspamd_text:count_csv_fields() test", function()
+  local rspamd_text = require "rspamd_text"
+
+  local cases = {
+    {'a,b,c\r\n1,2,3\r\n', 3},
+    {'"x,""y",b\n\n"1",2', 2},
+    {'"quoted"\tfield\nnext\tone', nil},
+    {'a,b\n1,2,3', nil},
+    {'a,b\n1,"2', nil},
+    {'single field\n', nil},
+    {'a,b\n1,2\n1,2,3', 2, 2},
+    {'\n\n', nil},
+  }
+
+  for i,c in ipairs(cases) do
+    test("count_csv_fields " .. tostring(i), function()
+      local t = rspamd_text.fromstring(c[1])
+      assert_equal(t:count_csv_fields(c[3]), c[2])
+    end)
+  end
+end)
@@ -133,4 +133,25 @@ char ** rspamd_string_len_split (const char *in, size_t len,
             ffi.C.g_strfreev(ret)
         end)
     end
-end)
\ No newline at end of file
+end)
+context("Rspamd util for lua - clickhouse rows", function()
+    local util = require 'rspamd_util'
+    local rspamd_text = require 'rspamd_text'
+
+    local cases = {
+        {{'a', 'b'}, "a\tb"},
+        {{1, 2.5, -3}, "1\t2.5\t-3"},
+        {{"it's\ta\\test\n"}, "it\\'s\\ta\\\\test\\n"},
+        {{rspamd_text.fromstring("x\ry")}, "x\\ry"},
+        {{{}, {'a', 1, "b'c"}}, "[]\t['a',1,'b\\'c']"},
+        {{}, ""},
+        {{1/0, -1/0, 0/0}, "inf\t-inf\tnan"},
+    }
+
+    for i,case in ipairs(cases) do
+        test("clickhouse_row: case " .. tostring(i), function()
+            local res = util.clickhouse_row(case[1])
+            assert_equal(tostring(res), case[2])
+        end)
+    end
+end)
@@ -0,0 +1,58 @@
+-- Compiled domain suffixes index tests
+
+context("Suffix index", function()
+  local rspamd_util = require "rspamd_util"
+
+  local rules = [[
+// comment
+com
+uk
+co.uk
+*.ck
+!www.ck
+jp
+kawasaki.jp
+*.kawasaki.jp
+!city.kawasaki.jp
+# another comment
+  Example.ORG.
+]]
+
+  local idx = rspamd_util.compile_suffix_index(rules)
+
+  test("Rules count", function()
+    assert_not_nil(idx)
+    assert_equal(idx:count(), 10)
+  end)
+
+  local cases = {
+    {'example.com', 'com'},
+    {'www.example.co.uk', 'co.uk'},
+    {'WWW.Example.CO.UK', 'CO.UK'},
+    {'co.uk', 'co.uk'},
+    {'foo.bar.ck', 'bar.ck'},
+    {'www.ck', 'ck'},
+    {'a.www.ck', 'ck'},
+    {'www.city.kawasaki.jp', 'kawasaki.jp'},
+    {'www.town.kawasaki.jp', 'town.kawasaki.jp'},
+    {'test.example.org.', 'example.org'},
+    {'example.net', nil},
+    {'', nil},
+  }
+
+  for _,c in ipairs(cases) do
+    test("Find suffix for " .. c[1], function()
+      assert_equal(idx:find(c[1]), c[2])
+    end)
+  end
+
+  test("Exact lookups", function()
+    assert_true(idx:has('co.uk'))
+    assert_true(idx:has('EXAMPLE.org'))
+    assert_true(idx:has('kawasaki.jp'))
+    assert_false(idx:has('www.co.uk'))
+    assert_false(idx:has('ck'))
+    assert_false(idx:has('www.ck'))
+    assert_false(idx:has(''))
+  end)
+end)
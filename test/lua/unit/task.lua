@@ -159,4 +159,47 @@ Thank you,
 
     task:destroy()
   end)
+
+  test("Volatile cache entries are dropped on task modification", function()
+    local msg = hdrs .. body
+    local res,task = rspamd_task.load_from_string(msg)
+    assert_true(res, "failed to load message")
+    task:process_message()
+    task:cache_set('stable', 1)
+    task:cache_set('volatile', 2, true)
+    assert_equal(task:cache_get('volatile'), 2)
+    task:set_recipients('smtp', {{user = 'a', domain = 'example.com', addr = 'a@example.com'}})
+    assert_nil(task:cache_get('volatile'))
+    assert_equal(task:cache_get('stable'), 1)
+    task:cache_set('volatile', 3, true)
+    task:set_from_ip('192.0.2.1')
+    assert_nil(task:cache_get('volatile'))
+    assert_equal(task:cache_get('stable'), 1)
+    task:destroy()
+  end)
+
+  test("ASCII words are flagged after normalisation", function()
+    local msg = hdrs .. [[
+Content-Type: text/plain; charset=utf-8
+Content-Transfer-Encoding: 8bit
+
+Hello привет ｗｏｒｌｄ
+]]
+    local res,task = rspamd_task.load_from_string(msg)
+    assert_true(res, "failed to load message")
+    task:process_message()
+    local flags = {}
+    for _,w in ipairs(task:get_text_parts()[1]:get_words('full')) do
+      flags[w[3]] = {}
+      for _,fl in ipairs(w[4]) do
+        flags[w[3]][fl] = true
+      end
+    end
+    assert_true(flags['Hello'].ascii)
+    assert_nil(flags['привет'].ascii)
+    -- Fullwidth latin is ASCII after NFKC
+    assert_true(flags['ｗｏｒｌｄ'].normalised)
+    assert_true(flags['ｗｏｒｌｄ'].ascii)
+    task:destroy()
+  end)
 end)
\ No newline at end of file
@@ -57,6 +57,10 @@ context("URL check functions", function()
     end)
   end
 
+  test("Public suffix alone is not a domain", function()
+    assert_nil(url.create(pool, "http://com/ text"))
+  end)
+
   cases = {
     {[[http://example.net/path/]], true, {
       host = 'example.net', path = 'path/'
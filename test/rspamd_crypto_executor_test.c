@@ -0,0 +1,154 @@
+/*-
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "util.h"
+#include "ottery.h"
+#include "libserver/crypto_executor.h"
+#include "tests.h"
+
+#include <openssl/rsa.h>
+#include <openssl/bn.h>
+#include <openssl/objects.h>
+
+extern struct ev_loop *event_loop;
+
+static const guint nsigs = 200;
+
+struct crypto_executor_test_job {
+	RSA *rsa;
+	guchar digest[32];
+	guchar sig[512];
+	guint siglen;
+	gboolean signed_ok;
+	gboolean finished;
+	guint *nfinished;
+};
+
+static void
+crypto_executor_test_work (gpointer ud)
+{
+	struct crypto_executor_test_job *job = ud;
+
+	job->signed_ok = RSA_sign (NID_sha256, job->digest, sizeof (job->digest),
+			job->sig, &job->siglen, job->rsa) == 1;
+}
+
+static void
+crypto_executor_test_fin (gpointer ud)
+{
+	struct crypto_executor_test_job *job = ud;
+
+	job->finished = TRUE;
+	(*job->nfinished) ++;
+}
+
+static void
+crypto_executor_test_init_jobs (struct crypto_executor_test_job *jobs,
+		RSA *rsa, guint *nfinished)
+{
+	guint i;
+
+	for (i = 0; i < nsigs; i ++) {
+		memset (&jobs[i], 0, sizeof (jobs[i]));
+		jobs[i].rsa = rsa;
+		jobs[i].nfinished = nfinished;
+		ottery_rand_bytes (jobs[i].digest, sizeof (jobs[i].digest));
+	}
+}
+
+static void
+crypto_executor_test_verify_jobs (struct crypto_executor_test_job *jobs,
+		RSA *rsa)
+{
+	guint i;
+
+	for (i = 0; i < nsigs; i ++) {
+		g_assert (jobs[i].finished);
+		g_assert (jobs[i].signed_ok);
+		g_assert (RSA_verify (NID_sha256, jobs[i].digest, sizeof (jobs[i].digest),
+				jobs[i].sig, jobs[i].siglen, rsa) == 1);
+	}
+}
+
+void
+rspamd_crypto_executor_test_func (void)
+{
+	struct rspamd_crypto_executor *executor;
+	struct crypto_executor_test_job *jobs;
+	RSA *rsa;
+	BIGNUM *e;
+	guint i, nfinished;
+	gdouble t1, t2, loop_cpu;
+
+	executor = rspamd_crypto_executor_get (event_loop);
+
+	if (executor == NULL) {
+		msg_notice ("crypto executor is not supported, skip test");
+		return;
+	}
+
+	rsa = RSA_new ();
+	e = BN_new ();
+	BN_set_word (e, RSA_F4);
+	g_assert (RSA_generate_key_ex (rsa, 2048, e, NULL) == 1);
+	BN_free (e);
+
+	jobs = g_malloc (sizeof (*jobs) * nsigs);
+
+	/* Inline signing as it was done in the worker */
+	nfinished = 0;
+	crypto_executor_test_init_jobs (jobs, rsa, &nfinished);
+	t1 = rspamd_get_ticks (FALSE);
+
+	for (i = 0; i < nsigs; i ++) {
+		crypto_executor_test_work (&jobs[i]);
+		crypto_executor_test_fin (&jobs[i]);
+	}
+
+	t2 = rspamd_get_ticks (FALSE);
+	crypto_executor_test_verify_jobs (jobs, rsa);
+	msg_notice ("inline: %ud RSA-2048 signatures in %.3f ms (%.1f sig/s)",
+			nsigs, (t2 - t1) * 1000.0, nsigs / (t2 - t1));
+
+	/* Executor, all jobs share the same key, so they are batched */
+	nfinished = 0;
+	crypto_executor_test_init_jobs (jobs, rsa, &nfinished);
+	t1 = rspamd_get_ticks (FALSE);
+	loop_cpu = rspamd_get_virtual_ticks ();
+
+	for (i = 0; i < nsigs; i ++) {
+		rspamd_crypto_executor_submit (executor, rsa,
+				crypto_executor_test_work, crypto_executor_test_fin, &jobs[i]);
+	}
+
+	g_assert (rspamd_crypto_executor_pending (executor) == nsigs);
+
+	while (nfinished < nsigs) {
+		ev_run (event_loop, EVRUN_ONCE);
+	}
+
+	t2 = rspamd_get_ticks (FALSE);
+	loop_cpu = rspamd_get_virtual_ticks () - loop_cpu;
+	g_assert (rspamd_crypto_executor_pending (executor) == 0);
+	crypto_executor_test_verify_jobs (jobs, rsa);
+	/* Virtual ticks count CPU time of the whole process, including executor */
+	msg_notice ("executor: %ud RSA-2048 signatures in %.3f ms (%.1f sig/s), "
+			"%.3f ms of process CPU time",
+			nsigs, (t2 - t1) * 1000.0, nsigs / (t2 - t1), loop_cpu * 1000.0);
+
+	g_free (jobs);
+	RSA_free (rsa);
+}
@@ -0,0 +1,117 @@
+/*-
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "libserver/http/http_private.h"
+#include "libserver/http/http_context.h"
+#include "unix-std.h"
+#include "tests.h"
+
+extern struct ev_loop *event_loop;
+
+static void
+http_keepalive_test_error (struct rspamd_http_connection *conn, GError *err)
+{
+	g_assert_not_reached ();
+}
+
+static gint
+http_keepalive_test_finish (struct rspamd_http_connection *conn,
+		struct rspamd_http_message *msg)
+{
+	return 0;
+}
+
+static gint
+http_keepalive_test_other_finish (struct rspamd_http_connection *conn,
+		struct rspamd_http_message *msg)
+{
+	return 0;
+}
+
+void
+rspamd_http_keepalive_test_func (void)
+{
+	struct rspamd_http_context_cfg http_cfg;
+	struct rspamd_http_context *ctx;
+	struct rspamd_http_connection *conn, *other, *reused;
+	struct sockaddr_in sin;
+	socklen_t slen = sizeof (sin);
+	rspamd_inet_addr_t *addr = NULL;
+	guint port;
+	gint lfd, afd;
+
+	memset (&http_cfg, 0, sizeof (http_cfg));
+	http_cfg.keepalive_interval = 60.0;
+	ctx = rspamd_http_context_create_config (&http_cfg, event_loop, NULL);
+
+	g_assert (rspamd_parse_inet_address (&addr, "127.0.0.1",
+			sizeof ("127.0.0.1") - 1, RSPAMD_INET_ADDRESS_PARSE_DEFAULT));
+	rspamd_inet_address_set_port (addr, 0);
+	lfd = rspamd_inet_address_listen (addr, SOCK_STREAM,
+			RSPAMD_INET_ADDRESS_LISTEN_DEFAULT, -1);
+	g_assert (lfd != -1);
+	g_assert (getsockname (lfd, (struct sockaddr *)&sin, &slen) == 0);
+	port = ntohs (sin.sin_port);
+	rspamd_inet_address_set_port (addr, port);
+
+	/* Idle connection of a proxy backend with its own limits */
+	conn = rspamd_http_connection_new_client_keepalive (ctx, NULL,
+			http_keepalive_test_error, http_keepalive_test_finish,
+			0, addr, "127.0.0.1", "backend");
+	g_assert (conn != NULL);
+	afd = accept (lfd, NULL, NULL);
+	g_assert (afd != -1);
+	rspamd_http_context_set_keepalive_limits (conn, 1, 10.0);
+	/* State that must not leak to the next owner */
+	conn->ud = conn;
+	conn->max_size = 1;
+	rspamd_http_context_push_keepalive (ctx, conn, NULL, event_loop);
+	/* Pool holds its own reference now */
+	rspamd_http_connection_unref (conn);
+
+	/* Default namespace can neither take it, nor inherit the limits */
+	g_assert (rspamd_http_context_has_keepalive (ctx, "127.0.0.1", port,
+			false) == NULL);
+	g_assert (rspamd_http_context_check_keepalive (ctx, addr, "127.0.0.1",
+			NULL, false) == NULL);
+	other = rspamd_http_connection_new_client_keepalive (ctx, NULL,
+			http_keepalive_test_error, http_keepalive_test_other_finish,
+			0, addr, "127.0.0.1", NULL);
+	g_assert (other != NULL);
+	g_assert (other != conn);
+	g_assert (other->keepalive_hash_key != conn->keepalive_hash_key);
+	g_assert (other->keepalive_hash_key->max_conns == 0);
+	g_assert (conn->keepalive_hash_key->max_conns == 1);
+	rspamd_http_connection_unref (other);
+
+	/* Reused connection is owned by a new caller and has its handlers */
+	reused = rspamd_http_connection_new_client_keepalive (ctx, NULL,
+			http_keepalive_test_error, http_keepalive_test_other_finish,
+			0, addr, "127.0.0.1", "backend");
+	g_assert (reused == conn);
+	g_assert (reused->finish_handler == http_keepalive_test_other_finish);
+	g_assert (reused->ud == NULL);
+	g_assert (reused->max_size == 0);
+	g_assert (reused->opts & RSPAMD_HTTP_CLIENT_KEEP_ALIVE);
+	g_assert (rspamd_http_context_check_keepalive (ctx, addr, "127.0.0.1",
+			"backend", false) == NULL);
+	rspamd_http_connection_unref (reused);
+
+	close (afd);
+	close (lfd);
+	rspamd_inet_address_free (addr);
+	rspamd_http_context_free (ctx);
+}
@@ -0,0 +1,61 @@
+/*-
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "rspamd.h"
+#include "libserver/monitored.h"
+#include "unix-std.h"
+#include "tests.h"
+
+#include <sys/wait.h>
+
+/* Defined in monitored.c */
+void rspamd_monitored_publish (struct rspamd_monitored *m);
+
+void
+rspamd_monitored_test_func (void)
+{
+	struct rspamd_monitored_ctx *ctx;
+	struct rspamd_monitored *m;
+	pid_t pid;
+	gint status;
+
+	/* Workers never configure context, so they use the published state */
+	ctx = rspamd_monitored_ctx_init ();
+	m = rspamd_monitored_create (ctx, "example.com", RSPAMD_MONITORED_DNS,
+			RSPAMD_MONITORED_DEFAULT, NULL);
+	g_assert (m != NULL);
+
+	/* Nothing is published yet, so local state is used */
+	g_assert (rspamd_monitored_alive (m));
+	g_assert (rspamd_monitored_latency (m) == 0);
+
+	/* Probing process publishes the object as dead */
+	pid = fork ();
+	g_assert (pid != -1);
+
+	if (pid == 0) {
+		rspamd_monitored_set_alive (m, FALSE);
+		rspamd_monitored_publish (m);
+		_exit (EXIT_SUCCESS);
+	}
+
+	g_assert (waitpid (pid, &status, 0) == pid);
+	g_assert (WIFEXITED (status) && WEXITSTATUS (status) == EXIT_SUCCESS);
+
+	/* Local state is still alive, but the published one is fresh */
+	g_assert (rspamd_monitored_alive (m) == FALSE);
+
+	rspamd_monitored_ctx_destroy (ctx);
+}
@@ -44,6 +44,12 @@ void rspamd_heap_test_func (void);
 
 void rspamd_lua_lua_pcall_vs_resume_test_func (void);
 
+void rspamd_crypto_executor_test_func (void);
+
+void rspamd_http_keepalive_test_func (void);
+
+void rspamd_monitored_test_func (void);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -17,7 +17,9 @@
 #include "config.h"
 #include "printf.h"
 #include "message.h"
-#include "smtp_parsers.h"
+#include "task.h"
+#include "libmime/received.h"
+#include "libmime/received.hxx"
 
 static gdouble total_time = 0;
 static gint total_parsed = 0;
@@ -35,7 +37,6 @@ rspamd_process_file (const gchar *fname)
 	GIOChannel *f;
 	GError *err = NULL;
 	GString *buf;
-	struct received_header rh;
 	gdouble t1, t2;
 
 	f = g_io_channel_new_file (fname, "r", &err);
@@ -49,8 +50,8 @@ rspamd_process_file (const gchar *fname)
 
 	g_io_channel_set_encoding (f, NULL, NULL);
 	buf = g_string_sized_new (8192);
-	task = g_malloc0 (sizeof (*task));
-	task->task_pool = rspamd_mempool_new (rspamd_mempool_suggest_size (), "test");
+	task = rspamd_task_new (nullptr, nullptr, nullptr, nullptr, nullptr, FALSE);
+	task->message = rspamd_message_new (task);
 
 	while (g_io_channel_read_line_string (f, buf, NULL, &err)
 			== G_IO_STATUS_NORMAL) {
@@ -60,23 +61,32 @@ rspamd_process_file (const gchar *fname)
 		}
 
 		t1 = rspamd_get_virtual_ticks ();
-		rspamd_smtp_received_parse (task, buf->str, buf->len, &rh);
+		auto parsed = rspamd_received_header_parse (task, buf->str, buf->len,
+				nullptr);
 		t2 = rspamd_get_virtual_ticks ();
 
 		total_time += t2 - t1;
 		total_parsed ++;
 
+		if (!parsed) {
+			continue;
+		}
+
+		auto *chain = static_cast<rspamd::mime::received_header_chain *>(
+				MESSAGE_FIELD (task, received_headers));
+		const auto &rh = chain->get_received (chain->size () - 1).value ().get ();
+
 		if (rh.addr) {
 			total_real_ip ++;
 		}
-		if (rh.real_hostname) {
+		if (!rh.real_hostname.empty ()) {
 			total_real_host ++;
 		}
-		if (rh.type != RSPAMD_RECEIVED_UNKNOWN) {
+		if (!(rh.flags & rspamd::mime::received_flags::UNKNOWN)) {
 			total_known_proto ++;
 		}
 
-		if (rh.by_hostname || rh.timestamp > 0) {
+		if (!rh.by_hostname.empty () || rh.timestamp > 0) {
 			total_valid ++;
 		}
 
@@ -84,7 +94,7 @@ rspamd_process_file (const gchar *fname)
 			total_known_ts ++;
 		}
 
-		if (rh.for_mbox) {
+		if (!rh.for_mbox.empty ()) {
 			total_known_for ++;
 		}
 	}
@@ -96,8 +106,7 @@ rspamd_process_file (const gchar *fname)
 
 	g_io_channel_unref (f);
 	g_string_free (buf, TRUE);
-	rspamd_mempool_delete (task->task_pool);
-	g_free (task);
+	rspamd_task_free (task);
 }
 
 int